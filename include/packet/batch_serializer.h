@@ -0,0 +1,143 @@
+#ifndef PACKET_BATCH_SERIALIZER_H_
+#define PACKET_BATCH_SERIALIZER_H_
+
+#include <vector>
+#include <thread>
+#include <cstdint>
+#include <algorithm>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/packet.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The BatchSerializerT class serializes many packets contiguously into a single
+ *        buffer. The size and offset of each packet are computed while adding them so
+ *        the output is allocated once and, for big batches, it can be written by several
+ *        threads at the same time (each one writing a disjoint range of packets).
+ * @tparam Cfg  The configuration to be used on the packets
+ * @note the contents are not copied when added, they must be kept alive until the batch
+ *       is serialized. The packets are written uncompressed since their sizes must be
+ *       known up front
+ */
+template<typename Cfg>
+class BatchSerializerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using message_type_t = typename PacketType::message_type_t;
+    using data_len_t = typename PacketType::data_len_t;
+
+    /**
+     * @brief PARALLEL_MIN_BYTES is the minimum amount of bytes each thread should write
+     *                           to be worth to split the work
+     */
+    static constexpr const std::size_t PARALLEL_MIN_BYTES = 1024 * 1024;
+
+  public:
+    inline BatchSerializerT(void);
+
+    /**
+     * @brief Remove all the packets added so far (keeping the allocated memory)
+     */
+    inline void
+    clear(void);
+
+    /**
+     * @brief Reserve memory for a number of packets
+     * @param count the number of packets
+     */
+    inline void
+    reserve(const std::size_t count);
+
+    /**
+     * @brief Adds a new packet to the batch
+     * @param packet_content  The packet content
+     * @param len             The length of the content
+     * @param type            The message type (ignored if the configuration has none)
+     * @return true on success | false otherwise (same rules than PacketT::serialize)
+     */
+    inline bool
+    add(const byte_t* packet_content,
+        const data_len_t len,
+        const message_type_t type = message_type_t());
+
+    /**
+     * @brief Returns the number of packets added
+     * @return the number of packets added
+     */
+    inline std::size_t
+    packetsCount(void) const;
+
+    /**
+     * @brief Returns the total number of bytes of the serialized batch
+     * @return the total number of bytes of the serialized batch
+     */
+    inline std::size_t
+    totalBytes(void) const;
+
+    /**
+     * @brief Returns the offset of a packet on the serialized batch
+     * @param index the index of the packet (in order of addition)
+     * @return the offset of the packet on the serialized batch
+     */
+    inline std::size_t
+    packetOffset(const std::size_t index) const;
+
+    /**
+     * @brief Serializes all the packets contiguously into the output
+     * @param out         The output buffer, it must have at least totalBytes() bytes
+     * @param max_threads The maximum number of threads to use. Only batches big enough
+     *                    (PARALLEL_MIN_BYTES per thread) are split
+     * @return the number of bytes written
+     */
+    inline std::size_t
+    serialize(byte_t* out, const std::size_t max_threads = 1) const;
+
+    /**
+     * @brief Serializes all the packets contiguously into a buffer resized to totalBytes()
+     *        (the buffer is not zero filled first, every byte is written once)
+     * @param out         The output buffer
+     * @param max_threads The maximum number of threads to use (check above)
+     * @return the number of bytes written
+     */
+    inline std::size_t
+    serialize(Buffer& out, const std::size_t max_threads = 1) const;
+
+
+  private:
+
+    struct Entry {
+      const byte_t* content;
+      data_len_t len;
+      message_type_t type;
+      std::size_t offset;
+    };
+
+    inline void
+    serializeRange(const std::size_t begin, const std::size_t end, byte_t* out) const;
+
+    inline std::size_t
+    entryAtOffset(const std::size_t offset) const;
+
+  private:
+    std::vector<Entry> entries_;
+    std::size_t total_bytes_;
+};
+
+
+
+#include <packet/batch_serializer_impl.h>
+
+
+// Default definition of the batch serializer
+using DefaultBatchSerializer = BatchSerializerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_BATCH_SERIALIZER_H_
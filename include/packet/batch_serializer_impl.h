@@ -0,0 +1,130 @@
+
+
+template<typename Cfg>
+inline void
+BatchSerializerT<Cfg>::serializeRange(const std::size_t begin,
+                                      const std::size_t end,
+                                      byte_t* out) const
+{
+  for (std::size_t i = begin; i < end; ++i) {
+    const Entry& entry = entries_[i];
+    PacketType::writeFrame(entry.content, entry.len, out + entry.offset, entry.type);
+  }
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::entryAtOffset(const std::size_t offset) const
+{
+  // first entry starting at or after the offset
+  const auto it = std::lower_bound(entries_.begin(), entries_.end(), offset,
+                                   [](const Entry& entry, const std::size_t value) {
+                                     return entry.offset < value;
+                                   });
+  return std::size_t(it - entries_.begin());
+}
+
+
+template<typename Cfg>
+inline BatchSerializerT<Cfg>::BatchSerializerT(void) :
+  total_bytes_(0)
+{}
+
+template<typename Cfg>
+inline void
+BatchSerializerT<Cfg>::clear(void)
+{
+  entries_.clear();
+  total_bytes_ = 0;
+}
+
+template<typename Cfg>
+inline void
+BatchSerializerT<Cfg>::reserve(const std::size_t count)
+{
+  entries_.reserve(count);
+}
+
+template<typename Cfg>
+inline bool
+BatchSerializerT<Cfg>::add(const byte_t* packet_content,
+                           const data_len_t len,
+                           const message_type_t type)
+{
+  if (packet_content == nullptr || len == 0 || len > Cfg::MAX_DATA_LEN) {
+    return false;
+  }
+  entries_.push_back(Entry{packet_content, len, type, total_bytes_});
+  total_bytes_ += PacketType::serializedSize(len);
+  return true;
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::packetsCount(void) const
+{
+  return entries_.size();
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::totalBytes(void) const
+{
+  return total_bytes_;
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::packetOffset(const std::size_t index) const
+{
+  PKT_ASSERT(index < entries_.size());
+  return entries_[index].offset;
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::serialize(byte_t* out, const std::size_t max_threads) const
+{
+  if (entries_.empty()) {
+    return 0;
+  }
+  PKT_ASSERT_PTR(out);
+
+  const std::size_t threads_count = std::min(std::max(max_threads, std::size_t(1)),
+                                             std::max(total_bytes_ / PARALLEL_MIN_BYTES, std::size_t(1)));
+  if (threads_count == 1) {
+    serializeRange(0, entries_.size(), out);
+    return total_bytes_;
+  }
+
+  // split the packets so each thread writes roughly the same amount of bytes
+  std::vector<std::thread> threads;
+  threads.reserve(threads_count - 1);
+  std::size_t begin = 0;
+  for (std::size_t i = 1; i <= threads_count; ++i) {
+    const std::size_t end = (i == threads_count) ?
+                            entries_.size() :
+                            entryAtOffset((total_bytes_ / threads_count) * i);
+    if (begin < end) {
+      if (i == threads_count) {
+        serializeRange(begin, end, out);
+      } else {
+        threads.emplace_back([this, begin, end, out]() { serializeRange(begin, end, out); });
+      }
+    }
+    begin = end;
+  }
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+  return total_bytes_;
+}
+
+template<typename Cfg>
+inline std::size_t
+BatchSerializerT<Cfg>::serialize(Buffer& out, const std::size_t max_threads) const
+{
+  out.clear();
+  out.resize(total_bytes_);
+  return serialize(out.data(), max_threads);
+}
@@ -0,0 +1,54 @@
+#ifndef PACKET_BUFFER_H_
+#define PACKET_BUFFER_H_
+
+#include <vector>
+#include <memory>
+#include <utility>
+#include <type_traits>
+
+#include <packet/defs.h>
+
+
+namespace packet {
+
+/**
+ * @brief Allocator adaptor that default-initializes the elements instead of
+ *        value-initializing them, so growing a byte buffer does not zero memory that is
+ *        about to be overwritten
+ */
+template<typename T, typename BaseAllocator = std::allocator<T> >
+class DefaultInitAllocator : public BaseAllocator {
+    using traits = std::allocator_traits<BaseAllocator>;
+
+  public:
+    template<typename U>
+    struct rebind {
+      using other = DefaultInitAllocator<U, typename traits::template rebind_alloc<U> >;
+    };
+
+    using BaseAllocator::BaseAllocator;
+
+    template<typename U>
+    inline void
+    construct(U* ptr) noexcept(std::is_nothrow_default_constructible<U>::value)
+    {
+      ::new (static_cast<void*>(ptr)) U;
+    }
+
+    template<typename U, typename... Args>
+    inline void
+    construct(U* ptr, Args&&... args)
+    {
+      ::new (static_cast<void*>(ptr)) U(std::forward<Args>(args)...);
+    }
+};
+
+/**
+ * @brief Buffer is the byte buffer type used to hold packets. It behaves as a
+ *        std::vector<byte_t> but resize() does not zero the new bytes
+ */
+using Buffer = std::vector<byte_t, DefaultInitAllocator<byte_t> >;
+
+}
+
+#endif // PACKET_BUFFER_H_
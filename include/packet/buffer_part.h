@@ -7,6 +7,7 @@
 #include <algorithm>
 
 #include <packet/defs.h>
+#include <packet/buffer.h>
 
 #include <packet/debug_helper.h>
 
@@ -15,23 +16,29 @@ namespace packet {
 
 /**
  * @brief Provides an interface of a buffer using just a part of a real one
+ * @tparam BufferType  The real buffer type (Buffer or one of the packet storages, check
+ *                     packet_storage.h)
  */
-class BufferPart {
+template<typename BufferType>
+class BufferPartT {
   public:
-    inline BufferPart(void);
+    inline BufferPartT(void);
 
     /**
-     * @brief Construct it from the real buffer that must be allocated from start_idx till
+     * @brief Construct it from the real buffer that will hold the part from start_idx till
      *        start_idx + size
-     * @param real_buffer the real buffer that must be allocated
+     * @param real_buffer the real buffer
      * @param start_idx the starting index of the buffer part
      * @param size the size of the buffer part
-     * @param auto_resize flag indicating if we should resize the real buffer or not
+     * @param auto_resize flag indicating if we should resize the real buffer or not. The
+     *                    real buffer grows as the data is added, so no memory is used
+     *                    for data not received yet. If false the real buffer must be
+     *                    already allocated till start_idx + size
      */
-    inline BufferPart(std::vector<byte_t>* real_buffer,
-                      const std::size_t start_idx,
-                      const std::size_t size,
-                      bool auto_resize = true) noexcept;
+    inline BufferPartT(BufferType* real_buffer,
+                       const std::size_t start_idx,
+                       const std::size_t size,
+                       bool auto_resize = true) noexcept;
 
     /**
      * @brief How many bytes we still need to fill for completing the buffer
@@ -85,13 +92,30 @@ class BufferPart {
     inline byte_t*
     remainingBuffer(void);
 
+    /**
+     * @brief Makes sure the real buffer can hold the next min(len, remainingSize()) bytes
+     *        so they can be written directly on remainingBuffer()
+     * @param len the number of bytes we want to write
+     * @return the number of bytes that can be written on remainingBuffer()
+     */
+    inline std::size_t
+    reserveAhead(const std::size_t len);
+
     /**
      * @brief Returns the real buffer associated to this buffer part
      * @return the real buffer pointer associated
      */
-    inline std::vector<byte_t>*
+    inline BufferType*
     realBuffer(void);
 
+    /**
+     * @brief Points the part to another real buffer holding the same bytes (for example the
+     *        one of a moved packet), the indexes are kept
+     * @param real_buffer the new real buffer
+     */
+    inline void
+    rebind(BufferType* real_buffer);
+
     /**
      * @brief Provides a way to notify the buffer that we added more data into the buffer
      *        writing it directly on it (useful when reading from sockets for example)
@@ -114,10 +138,11 @@ class BufferPart {
 
 
   private:
-    std::vector<byte_t>* real_buffer_;
+    BufferType* real_buffer_;
     std::size_t start_idx_;
     std::size_t size_;
     std::size_t data_idx_;
+    bool auto_resize_;
 };
 
 
@@ -126,6 +151,10 @@ class BufferPart {
 
 
 #include <packet/buffer_part_impl.h>
+
+
+// Part of a plain byte buffer
+using BufferPart = BufferPartT<Buffer>;
 }
 
 #endif // PACKET_BUFFER_PART_H_
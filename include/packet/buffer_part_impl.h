@@ -1,96 +1,140 @@
 
-inline BufferPart::BufferPart(void) :
+template<typename BufferType>
+inline BufferPartT<BufferType>::BufferPartT(void) :
   real_buffer_(nullptr)
 , start_idx_(0)
 , size_(0)
 , data_idx_(0)
+, auto_resize_(false)
 {}
 
 
-inline BufferPart::BufferPart(std::vector<byte_t>* real_buffer,
-                              const std::size_t start_idx,
-                              const std::size_t size,
-                              bool auto_resize) noexcept :
+template<typename BufferType>
+inline BufferPartT<BufferType>::BufferPartT(BufferType* real_buffer,
+                                            const std::size_t start_idx,
+                                            const std::size_t size,
+                                            bool auto_resize) noexcept :
   real_buffer_(real_buffer)
 , start_idx_(start_idx)
 , size_(size)
 , data_idx_(start_idx)
+, auto_resize_(auto_resize)
 {
   PKT_ASSERT_PTR(real_buffer_);
-  if (auto_resize) {
-    real_buffer_->resize(std::max(real_buffer_->size(), (start_idx_ + size_)));
+  if (auto_resize_) {
+    real_buffer_->resize(std::max(real_buffer_->size(), start_idx_));
   }
-  PKT_ASSERT(real_buffer_->size() >= (start_idx_ + size_));
+  PKT_ASSERT(auto_resize_ || real_buffer_->size() >= (start_idx_ + size_));
 }
 
 
+template<typename BufferType>
 inline std::size_t
-BufferPart::remainingSize(void) const
+BufferPartT<BufferType>::remainingSize(void) const
 {
   return (start_idx_ + size_) - data_idx_;
 }
 
+template<typename BufferType>
 inline std::size_t
-BufferPart::fullSize(void) const
+BufferPartT<BufferType>::fullSize(void) const
 {
   return size_;
 }
 
+template<typename BufferType>
 inline std::size_t
-BufferPart::dataSize(void) const
+BufferPartT<BufferType>::dataSize(void) const
 {
   return data_idx_ - start_idx_;
 }
 
+template<typename BufferType>
 inline bool
-BufferPart::isFull(void) const
+BufferPartT<BufferType>::isFull(void) const
 {
   return data_idx_ >= (start_idx_ + size_);
 }
 
+template<typename BufferType>
 inline std::size_t
-BufferPart::append(const byte_t* data, const std::size_t len)
+BufferPartT<BufferType>::append(const byte_t* data, const std::size_t len)
 {
   const std::size_t to_copy = std::min(remainingSize(), len);
+  if (to_copy == 0) {
+    return 0;
+  }
+  reserveAhead(to_copy);
   std::memcpy(remainingBuffer(), data, to_copy);
   data_idx_ += to_copy;
   return to_copy;
 }
 
+template<typename BufferType>
 inline std::size_t
-BufferPart::append(const std::vector<byte_t>& data)
+BufferPartT<BufferType>::append(const std::vector<byte_t>& data)
 {
   return append(data.data(), data.size());
 }
 
+template<typename BufferType>
 inline const byte_t*
-BufferPart::buffer(void) const
+BufferPartT<BufferType>::buffer(void) const
 {
   return real_buffer_->data() + start_idx_;
 }
 
+template<typename BufferType>
 inline byte_t*
-BufferPart::buffer(void)
+BufferPartT<BufferType>::buffer(void)
 {
   return real_buffer_->data() + start_idx_;
 }
 
+template<typename BufferType>
 inline byte_t*
-BufferPart::remainingBuffer(void)
+BufferPartT<BufferType>::remainingBuffer(void)
 {
   return isFull() ? nullptr : (real_buffer_->data() + data_idx_);
 }
 
-inline std::vector<byte_t>*
-BufferPart::realBuffer(void)
+template<typename BufferType>
+inline std::size_t
+BufferPartT<BufferType>::reserveAhead(const std::size_t len)
+{
+  const std::size_t to_reserve = std::min(len, remainingSize());
+  if (to_reserve == 0) {
+    return 0;
+  }
+  if (auto_resize_ && real_buffer_->size() < (data_idx_ + to_reserve)) {
+    real_buffer_->resize(data_idx_ + to_reserve);
+  }
+  return std::min(to_reserve, real_buffer_->size() - data_idx_);
+}
+
+template<typename BufferType>
+inline BufferType*
+BufferPartT<BufferType>::realBuffer(void)
 {
   return real_buffer_;
 }
 
+template<typename BufferType>
+inline void
+BufferPartT<BufferType>::rebind(BufferType* real_buffer)
+{
+  // a part without buffer (invalid packets) stays that way
+  if (real_buffer_ != nullptr) {
+    real_buffer_ = real_buffer;
+  }
+}
+
+template<typename BufferType>
 inline std::size_t
-BufferPart::updateDataOffset(const std::size_t data_len_added)
+BufferPartT<BufferType>::updateDataOffset(const std::size_t data_len_added)
 {
   const std::size_t to_add = std::min(data_len_added, remainingSize());
-  data_idx_ += data_len_added;
+  PKT_ASSERT(real_buffer_->size() >= (data_idx_ + to_add));
+  data_idx_ += to_add;
   return to_add;
 }
@@ -0,0 +1,141 @@
+#ifndef PACKET_BUFFER_POOL_H_
+#define PACKET_BUFFER_POOL_H_
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <algorithm>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+/**
+ * @brief The BufferPool class recycles byte buffers using power of two size classes so
+ *        buffers can be reused without going to the allocator every time. It is not
+ *        thread safe, check BufferPool::local() for a per thread instance.
+ */
+class BufferPool {
+  public:
+
+    /**
+     * @brief MIN_CLASS_SHIFT / MAX_CLASS_SHIFT define the range of size classes handled by
+     *        the pool (64 B to 64 MiB). Bigger buffers are never cached
+     */
+    static constexpr const std::size_t MIN_CLASS_SHIFT = 6;
+    static constexpr const std::size_t MAX_CLASS_SHIFT = 26;
+    static constexpr const std::size_t CLASSES_COUNT = MAX_CLASS_SHIFT - MIN_CLASS_SHIFT + 1;
+
+    /**
+     * @brief DEFAULT_MAX_CACHED is the default maximum number of buffers cached per class
+     */
+    static constexpr const std::size_t DEFAULT_MAX_CACHED = 32;
+
+  public:
+    /**
+     * @brief Construct the pool
+     * @param max_cached the maximum number of buffers cached per size class
+     */
+    inline explicit BufferPool(const std::size_t max_cached = DEFAULT_MAX_CACHED);
+
+    /**
+     * @brief Returns an empty buffer with at least the given capacity, reusing a cached
+     *        one if possible
+     * @param capacity the minimum capacity required
+     * @return an empty buffer with at least the given capacity
+     */
+    inline Buffer
+    acquire(const std::size_t capacity);
+
+    /**
+     * @brief Gives back a buffer to the pool so it can be reused later
+     * @param buffer the buffer to give back
+     */
+    inline void
+    release(Buffer&& buffer);
+
+    /**
+     * @brief Returns the number of buffers currently cached
+     * @return the number of buffers currently cached
+     */
+    inline std::size_t
+    cachedCount(void) const;
+
+    /**
+     * @brief Returns the number of times a buffer had to be allocated because there was
+     *        no cached one available
+     * @return the number of allocations performed by the pool
+     */
+    inline std::size_t
+    allocationsCount(void) const;
+
+    /**
+     * @brief Drops all the cached buffers
+     */
+    inline void
+    clear(void);
+
+    /**
+     * @brief Returns the pool associated to the current thread
+     * @return the pool associated to the current thread
+     */
+    static inline BufferPool&
+    local(void);
+
+
+  private:
+
+    static inline std::size_t
+    classForCapacity(const std::size_t capacity);
+
+  private:
+    std::array<std::vector<Buffer>, CLASSES_COUNT> bins_;
+    std::size_t max_cached_;
+    std::size_t allocations_count_;
+};
+
+
+/**
+ * @brief The HeapBufferPolicy is the default buffer policy: buffers are just allocated
+ *        and freed
+ */
+struct HeapBufferPolicy {
+    static inline Buffer
+    acquire(const std::size_t capacity)
+    {
+      Buffer buffer;
+      buffer.reserve(capacity);
+      return buffer;
+    }
+
+    static inline void
+    release(Buffer&&)
+    {}
+};
+
+/**
+ * @brief The PooledBufferPolicy takes the buffers from, and returns them to, the pool of
+ *        the current thread
+ */
+struct PooledBufferPolicy {
+    static inline Buffer
+    acquire(const std::size_t capacity)
+    {
+      return BufferPool::local().acquire(capacity);
+    }
+
+    static inline void
+    release(Buffer&& buffer)
+    {
+      BufferPool::local().release(std::move(buffer));
+    }
+};
+
+
+#include <packet/buffer_pool_impl.h>
+}
+
+#endif // PACKET_BUFFER_POOL_H_
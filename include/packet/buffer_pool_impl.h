@@ -0,0 +1,91 @@
+
+inline std::size_t
+BufferPool::classForCapacity(const std::size_t capacity)
+{
+  std::size_t shift = MIN_CLASS_SHIFT;
+  while (shift < MAX_CLASS_SHIFT && (std::size_t(1) << shift) < capacity) {
+    ++shift;
+  }
+  return shift - MIN_CLASS_SHIFT;
+}
+
+
+inline BufferPool::BufferPool(const std::size_t max_cached) :
+  max_cached_(max_cached)
+, allocations_count_(0)
+{}
+
+inline Buffer
+BufferPool::acquire(const std::size_t capacity)
+{
+  Buffer buffer;
+  if (capacity > (std::size_t(1) << MAX_CLASS_SHIFT)) {
+    ++allocations_count_;
+    buffer.reserve(capacity);
+    return buffer;
+  }
+
+  const std::size_t class_idx = classForCapacity(capacity);
+  std::vector<Buffer>& bin = bins_[class_idx];
+  if (!bin.empty()) {
+    buffer = std::move(bin.back());
+    bin.pop_back();
+    PKT_ASSERT(buffer.capacity() >= capacity);
+    return buffer;
+  }
+  ++allocations_count_;
+  buffer.reserve(std::size_t(1) << (class_idx + MIN_CLASS_SHIFT));
+  return buffer;
+}
+
+inline void
+BufferPool::release(Buffer&& buffer)
+{
+  const std::size_t capacity = buffer.capacity();
+  if (capacity < (std::size_t(1) << MIN_CLASS_SHIFT) ||
+      capacity > (std::size_t(1) << MAX_CLASS_SHIFT)) {
+    return;
+  }
+  // the buffer goes to the biggest class it can fully serve
+  std::size_t class_idx = classForCapacity(capacity);
+  if ((std::size_t(1) << (class_idx + MIN_CLASS_SHIFT)) > capacity) {
+    --class_idx;
+  }
+  std::vector<Buffer>& bin = bins_[class_idx];
+  if (bin.size() >= max_cached_) {
+    return;
+  }
+  buffer.clear();
+  bin.push_back(std::move(buffer));
+}
+
+inline std::size_t
+BufferPool::cachedCount(void) const
+{
+  std::size_t count = 0;
+  for (const auto& bin : bins_) {
+    count += bin.size();
+  }
+  return count;
+}
+
+inline std::size_t
+BufferPool::allocationsCount(void) const
+{
+  return allocations_count_;
+}
+
+inline void
+BufferPool::clear(void)
+{
+  for (auto& bin : bins_) {
+    bin.clear();
+  }
+}
+
+inline BufferPool&
+BufferPool::local(void)
+{
+  static thread_local BufferPool pool;
+  return pool;
+}
@@ -0,0 +1,195 @@
+#ifndef PACKET_CAPTURE_SCANNER_H_
+#define PACKET_CAPTURE_SCANNER_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <thread>
+#include <functional>
+#include <algorithm>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/packet.h>
+#include <packet/pattern_search.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief A range of a capture that does not hold valid packets
+ */
+struct InvalidRegion {
+    std::uint64_t offset;
+    std::uint64_t len;
+};
+
+/**
+ * @brief The result of scanning a capture
+ */
+struct ScanReport {
+    // the valid packets found and the bytes of their frames
+    std::uint64_t packets_count = 0;
+    std::uint64_t packets_bytes = 0;
+    // the ranges without valid packets (only the first MAX_REPORTED_REGIONS are listed)
+    std::uint64_t invalid_count = 0;
+    std::uint64_t invalid_bytes = 0;
+    std::vector<InvalidRegion> invalid_regions;
+    // the bytes of a partial packet ending the capture
+    std::uint64_t trailing_bytes = 0;
+
+    /**
+     * @brief MAX_REPORTED_REGIONS is the max number of invalid_regions listed
+     */
+    static constexpr const std::size_t MAX_REPORTED_REGIONS = 1024;
+
+    /**
+     * @brief Returns INVALID if invalid data was found, INCOMPLETE if the capture ends
+     *        with a partial packet and COMPLETE otherwise
+     * @return the state of the capture
+     */
+    inline Status
+    status(void) const
+    {
+      return invalid_count > 0 ? Status::INVALID : trailing_bytes > 0 ? Status::INCOMPLETE : Status::COMPLETE;
+    }
+};
+
+
+/**
+ * @brief The CaptureScannerT class validates (and optionally extracts the packets of) a
+ *        capture, a concatenation of serialized packets, using several threads:
+ *        - the capture is split in ranges, each thread synchronizes on the first plausible
+ *          packet of its range (an occurrence of the head pattern where peekFrame()
+ *          validates the length, tail and checksum) and walks the packets from there
+ *        - invalid data is skipped up to the next plausible packet
+ *        - the ranges are stitched afterwards: the walk coming from the previous range is
+ *          followed until it meets the one of the range (a false synchronization, for
+ *          example on a packet nested in a content, only affects a few packets), so every
+ *          packet is counted exactly once and the report is the same than a sequential
+ *          scan
+ *        With a callback the packets are delivered on a second pass once the ranges are
+ *        known, from the scanning threads (in order within a range, but the ranges are
+ *        processed concurrently).
+ *        Configurations without head pattern can not synchronize, they are scanned by a
+ *        single thread and the scan stops on the first invalid packet.
+ * @tparam Cfg  The configuration the capture was written with
+ */
+template<typename Cfg>
+class CaptureScannerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+
+    /**
+     * @brief Handler of the packets found, it gets the offset of the packet on the capture
+     *        and the view of its content (decompressed if needed, valid during the call).
+     *        Called concurrently from the scanning threads
+     */
+    using Handler = std::function<void(std::uint64_t offset, const PacketView& view)>;
+
+    /**
+     * @brief MIN_RANGE_SIZE is the default min size of the range of each thread
+     */
+    static constexpr const std::size_t MIN_RANGE_SIZE = 4 * 1024 * 1024;
+
+  public:
+    /**
+     * @brief Construct the scanner
+     * @param threads_count   The number of threads (0 means one per core)
+     * @param min_range_size  Captures are only split in ranges of at least this size
+     */
+    inline explicit CaptureScannerT(const std::size_t threads_count = 0,
+                                    const std::size_t min_range_size = MIN_RANGE_SIZE);
+
+    /**
+     * @brief Scans a capture in memory
+     * @param data    The capture
+     * @param len     The length of the capture
+     * @param report  The result of the scan
+     * @param handler Optional handler for the valid packets
+     */
+    inline void
+    scan(const byte_t* data, const std::size_t len, ScanReport& report, const Handler& handler = Handler());
+
+    /**
+     * @brief Scans a capture file (memory mapped)
+     * @param path    The capture file
+     * @param report  The result of the scan
+     * @param handler Optional handler for the valid packets
+     * @return true on success | false if the file can not be read (errno is kept)
+     */
+    inline bool
+    scanFile(const std::string& path, ScanReport& report, const Handler& handler = Handler());
+
+    /**
+     * @brief Returns the max number of threads used
+     * @return the max number of threads used
+     */
+    inline std::size_t
+    threadsCount(void) const;
+
+
+  private:
+
+    struct Range {
+      std::uint64_t begin;
+      std::uint64_t end;
+      // the first packet of the walk of the range and where the walk left the range
+      std::uint64_t sync;
+      std::uint64_t next;
+      ScanReport report;
+    };
+
+    static inline void
+    addInvalid(ScanReport& report, const std::uint64_t offset, const std::uint64_t len);
+
+    static inline void
+    merge(ScanReport& report, const ScanReport& other);
+
+    inline std::uint64_t
+    findFrame(std::uint64_t from) const;
+
+    inline std::uint64_t
+    step(const std::uint64_t offset, ScanReport& report, const Handler* handler, Buffer& decompressed) const;
+
+    inline void
+    walkRange(Range& range, const std::size_t index) const;
+
+    inline void
+    stitch(ScanReport& report);
+
+    inline void
+    deliver(const Range& range, const Handler& handler) const;
+
+    template<typename Fn>
+    inline void
+    forEachRange(Fn&& fn);
+
+  private:
+    std::size_t threads_count_;
+    std::size_t min_range_size_;
+    const byte_t* data_;
+    std::uint64_t size_;
+    std::vector<Range> ranges_;
+};
+
+
+
+#include <packet/capture_scanner_impl.h>
+
+
+// Default definition of a capture scanner
+using DefaultCaptureScanner = CaptureScannerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_CAPTURE_SCANNER_H_
@@ -0,0 +1,267 @@
+
+
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::addInvalid(ScanReport& report, const std::uint64_t offset, const std::uint64_t len)
+{
+  ++report.invalid_count;
+  report.invalid_bytes += len;
+  if (report.invalid_regions.size() < ScanReport::MAX_REPORTED_REGIONS) {
+    report.invalid_regions.push_back(InvalidRegion{offset, len});
+  }
+}
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::merge(ScanReport& report, const ScanReport& other)
+{
+  report.packets_count += other.packets_count;
+  report.packets_bytes += other.packets_bytes;
+  report.invalid_count += other.invalid_count;
+  report.invalid_bytes += other.invalid_bytes;
+  report.trailing_bytes += other.trailing_bytes;
+  for (const InvalidRegion& region : other.invalid_regions) {
+    if (report.invalid_regions.size() >= ScanReport::MAX_REPORTED_REGIONS) {
+      break;
+    }
+    report.invalid_regions.push_back(region);
+  }
+}
+
+template<typename Cfg>
+inline std::uint64_t
+CaptureScannerT<Cfg>::findFrame(std::uint64_t from) const
+{
+  if (PacketType::HEAD_PATTERN_SIZE == 0) {
+    // nothing to synchronize on
+    return size_;
+  }
+  const byte_t* pattern = reinterpret_cast<const byte_t*>(Cfg::HEAD_PATTERN);
+  while (from < size_) {
+    const std::size_t len = std::size_t(size_ - from);
+    const std::size_t found = findPattern(data_ + from, len, pattern, std::size_t(PacketType::HEAD_PATTERN_SIZE));
+    if (found == len) {
+      break;
+    }
+    from += found;
+    FrameInfo info;
+    if (PacketType::peekFrame(data_ + from, std::size_t(size_ - from), info) == Status::COMPLETE) {
+      return from;
+    }
+    ++from;
+  }
+  return size_;
+}
+
+template<typename Cfg>
+inline std::uint64_t
+CaptureScannerT<Cfg>::step(const std::uint64_t offset,
+                           ScanReport& report,
+                           const Handler* handler,
+                           Buffer& decompressed) const
+{
+  FrameInfo info;
+  const Status status = PacketType::peekFrame(data_ + offset, std::size_t(size_ - offset), info);
+  if (status == Status::COMPLETE) {
+    ++report.packets_count;
+    report.packets_bytes += info.frame_size;
+    if (handler != nullptr) {
+      PacketView view{data_ + offset + info.data_offset, info.data_len, true, info.message_type};
+      if ((info.flags & PacketType::FLAG_COMPRESSED) != 0) {
+        if (!PacketType::decompress(view.data, view.len, decompressed,
+                                    typename PacketType::message_type_t(info.message_type))) {
+          return offset + info.frame_size;
+        }
+        view.data = decompressed.data();
+        view.len = decompressed.size();
+        view.in_place = false;
+      }
+      (*handler)(offset, view);
+    }
+    return offset + info.frame_size;
+  }
+
+  // the walk depends only on the offset, so walks reaching the same offset go on together
+  const std::uint64_t next = findFrame(offset + 1);
+  if (next == size_ && status == Status::INCOMPLETE) {
+    report.trailing_bytes += size_ - offset;
+  } else {
+    addInvalid(report, offset, next - offset);
+  }
+  return next;
+}
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::walkRange(Range& range, const std::size_t index) const
+{
+  // only the first range knows where a packet begins
+  std::uint64_t offset = index == 0 ? range.begin : findFrame(range.begin);
+  range.sync = offset;
+  Buffer unused;
+  while (offset < range.end) {
+    offset = step(offset, range.report, nullptr, unused);
+  }
+  range.next = offset;
+}
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::stitch(ScanReport& report)
+{
+  report = ranges_.front().report;
+  Buffer unused;
+  for (std::size_t i = 1; i < ranges_.size(); ++i) {
+    Range& range = ranges_[i];
+    // a: the walk coming from the previous range, b: the one of this range. The smaller
+    // one advances until they meet or leave the range
+    std::uint64_t a = ranges_[i - 1].next;
+    std::uint64_t b = range.sync;
+    ScanReport a_report;
+    ScanReport b_report;
+    while (a != b) {
+      if (a < b) {
+        if (a >= range.end) {
+          break;
+        }
+        a = step(a, a_report, nullptr, unused);
+      } else {
+        if (b >= range.end) {
+          break;
+        }
+        b = step(b, b_report, nullptr, unused);
+      }
+    }
+
+    if (a == b) {
+      // the part of the range before the meeting point is replaced by a's
+      ScanReport& fixed = range.report;
+      fixed.packets_count = fixed.packets_count - b_report.packets_count + a_report.packets_count;
+      fixed.packets_bytes = fixed.packets_bytes - b_report.packets_bytes + a_report.packets_bytes;
+      fixed.invalid_count = fixed.invalid_count - b_report.invalid_count + a_report.invalid_count;
+      fixed.invalid_bytes = fixed.invalid_bytes - b_report.invalid_bytes + a_report.invalid_bytes;
+      fixed.trailing_bytes = fixed.trailing_bytes - b_report.trailing_bytes + a_report.trailing_bytes;
+      std::vector<InvalidRegion> regions;
+      regions.swap(a_report.invalid_regions);
+      for (const InvalidRegion& region : fixed.invalid_regions) {
+        if (region.offset >= a) {
+          regions.push_back(region);
+        }
+      }
+      fixed.invalid_regions.swap(regions);
+    } else {
+      // they never met, the range is what the walk from the previous one found
+      range.report = std::move(a_report);
+      range.next = a;
+    }
+    range.sync = ranges_[i - 1].next;
+    merge(report, range.report);
+  }
+}
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::deliver(const Range& range, const Handler& handler) const
+{
+  ScanReport unused;
+  Buffer decompressed;
+  for (std::uint64_t offset = range.sync; offset < range.next;) {
+    offset = step(offset, unused, &handler, decompressed);
+    // only the invalid regions could grow it and they are not needed here
+    unused.invalid_regions.clear();
+  }
+}
+
+template<typename Cfg>
+template<typename Fn>
+inline void
+CaptureScannerT<Cfg>::forEachRange(Fn&& fn)
+{
+  std::vector<std::thread> threads;
+  threads.reserve(ranges_.size() - 1);
+  for (std::size_t i = 1; i < ranges_.size(); ++i) {
+    threads.emplace_back([this, &fn, i]() { fn(ranges_[i], i); });
+  }
+  fn(ranges_.front(), 0);
+  for (std::thread& thread : threads) {
+    thread.join();
+  }
+}
+
+
+template<typename Cfg>
+inline CaptureScannerT<Cfg>::CaptureScannerT(const std::size_t threads_count, const std::size_t min_range_size) :
+  threads_count_(threads_count > 0 ? threads_count : std::max(1u, std::thread::hardware_concurrency()))
+, min_range_size_(std::max(min_range_size, std::size_t(1)))
+, data_(nullptr)
+, size_(0)
+{}
+
+template<typename Cfg>
+inline void
+CaptureScannerT<Cfg>::scan(const byte_t* data, const std::size_t len, ScanReport& report, const Handler& handler)
+{
+  PKT_ASSERT(data != nullptr || len == 0);
+  data_ = data;
+  size_ = len;
+  std::size_t ranges_count = PacketType::HEAD_PATTERN_SIZE > 0 ? std::min(threads_count_, len / min_range_size_) : 1;
+  ranges_count = std::max(ranges_count, std::size_t(1));
+  ranges_.clear();
+  ranges_.resize(ranges_count);
+  for (std::size_t i = 0; i < ranges_count; ++i) {
+    ranges_[i].begin = len / ranges_count * i;
+    ranges_[i].end = i + 1 == ranges_count ? len : len / ranges_count * (i + 1);
+  }
+
+  forEachRange([this](Range& range, const std::size_t index) { walkRange(range, index); });
+  stitch(report);
+  if (handler) {
+    forEachRange([this, &handler](Range& range, const std::size_t) { deliver(range, handler); });
+  }
+  ranges_.clear();
+  data_ = nullptr;
+  size_ = 0;
+}
+
+template<typename Cfg>
+inline bool
+CaptureScannerT<Cfg>::scanFile(const std::string& path, ScanReport& report, const Handler& handler)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    return false;
+  }
+  const std::size_t size = std::size_t(file_stat.st_size);
+  void* mapping = nullptr;
+  if (size > 0) {
+    mapping = ::mmap(nullptr, size, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      ::close(fd);
+      errno = error;
+      return false;
+    }
+    ::madvise(mapping, size, MADV_SEQUENTIAL);
+  }
+  ::close(fd);
+  scan(static_cast<const byte_t*>(mapping), size, report, handler);
+  if (mapping != nullptr) {
+    ::munmap(mapping, size);
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline std::size_t
+CaptureScannerT<Cfg>::threadsCount(void) const
+{
+  return threads_count_;
+}
@@ -0,0 +1,197 @@
+#ifndef PACKET_CHECKSUM_H_
+#define PACKET_CHECKSUM_H_
+
+#include <cstdint>
+#include <cstring>
+
+#include <packet/defs.h>
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+#  include <nmmintrin.h>
+#  define PACKET_CRC32C_HW 1
+#endif
+
+
+namespace packet {
+
+/**
+ * @brief Checksum policies define the optional integrity field written after the packet
+ *        content. All of them provide the same static interface:
+ *        - value_type: the type of the checksum
+ *        - SIZE: the number of bytes of the checksum on the wire (0 disables it)
+ *        - init(): the initial state
+ *        - update(state, data, len): the state after processing len more bytes
+ *        - finish(state): the checksum value from the state
+ *        - write(value, out) / read(in): wire representation of the value
+ */
+
+/**
+ * @brief NoChecksum is the default policy: no checksum is written nor validated
+ */
+struct NoChecksum {
+    using value_type = std::uint32_t;
+    static constexpr const std::size_t SIZE = 0;
+
+    static inline value_type init(void) { return 0; }
+    static inline value_type update(const value_type state, const byte_t*, const std::size_t) { return state; }
+    static inline value_type finish(const value_type state) { return state; }
+    static inline void write(const value_type, byte_t*) {}
+    static inline value_type read(const byte_t*) { return 0; }
+};
+
+
+namespace detail {
+
+/**
+ * @brief Slicing by 8 tables for the CRC32C (Castagnoli) polynomial, computed at compile
+ *        time
+ */
+struct Crc32cTables {
+    std::uint32_t table[8][256];
+
+    constexpr Crc32cTables(void) :
+      table()
+    {
+      for (std::uint32_t i = 0; i < 256; ++i) {
+        std::uint32_t crc = i;
+        for (int bit = 0; bit < 8; ++bit) {
+          crc = (crc & 1) ? (crc >> 1) ^ 0x82F63B78u : (crc >> 1);
+        }
+        table[0][i] = crc;
+      }
+      for (std::uint32_t i = 0; i < 256; ++i) {
+        for (int slice = 1; slice < 8; ++slice) {
+          table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xff];
+        }
+      }
+    }
+};
+
+inline const Crc32cTables&
+crc32cTables(void)
+{
+  static constexpr Crc32cTables tables;
+  return tables;
+}
+
+inline std::uint32_t
+crc32cSoftware(std::uint32_t crc, const byte_t* data, std::size_t len)
+{
+  const auto& table = crc32cTables().table;
+  while (len >= 8) {
+    std::uint32_t low;
+    std::uint32_t high;
+    std::memcpy(&low, data, 4);
+    std::memcpy(&high, data + 4, 4);
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    low = __builtin_bswap32(low);
+    high = __builtin_bswap32(high);
+#endif
+    low ^= crc;
+    crc = table[7][low & 0xff] ^ table[6][(low >> 8) & 0xff] ^
+          table[5][(low >> 16) & 0xff] ^ table[4][low >> 24] ^
+          table[3][high & 0xff] ^ table[2][(high >> 8) & 0xff] ^
+          table[1][(high >> 16) & 0xff] ^ table[0][high >> 24];
+    data += 8;
+    len -= 8;
+  }
+  while (len-- > 0) {
+    crc = table[0][(crc ^ *data++) & 0xff] ^ (crc >> 8);
+  }
+  return crc;
+}
+
+#ifdef PACKET_CRC32C_HW
+__attribute__((target("sse4.2")))
+inline std::uint32_t
+crc32cHardware(std::uint32_t crc, const byte_t* data, std::size_t len)
+{
+  std::uint64_t crc64 = crc;
+  while (len >= 8) {
+    std::uint64_t value;
+    std::memcpy(&value, data, 8);
+    crc64 = _mm_crc32_u64(crc64, value);
+    data += 8;
+    len -= 8;
+  }
+  crc = std::uint32_t(crc64);
+  while (len-- > 0) {
+    crc = _mm_crc32_u8(crc, *data++);
+  }
+  return crc;
+}
+#endif
+
+}
+
+
+/**
+ * @brief Updates a raw (not inverted) CRC32C state with more data. Uses the SSE4.2 crc32
+ *        instruction when the cpu supports it, a slicing by 8 table otherwise
+ * @param crc   The current raw state
+ * @param data  The data
+ * @param len   The length of the data
+ * @return the new raw state
+ */
+inline std::uint32_t
+crc32cUpdate(const std::uint32_t crc, const byte_t* data, const std::size_t len)
+{
+#ifdef PACKET_CRC32C_HW
+  static const bool has_sse42 = __builtin_cpu_supports("sse4.2");
+  if (has_sse42) {
+    return detail::crc32cHardware(crc, data, len);
+  }
+#endif
+  return detail::crc32cSoftware(crc, data, len);
+}
+
+/**
+ * @brief Computes the CRC32C of a buffer
+ * @param data  The data
+ * @param len   The length of the data
+ * @return the CRC32C of the buffer
+ */
+inline std::uint32_t
+crc32c(const byte_t* data, const std::size_t len)
+{
+  return ~crc32cUpdate(0xFFFFFFFFu, data, len);
+}
+
+
+/**
+ * @brief Crc32cChecksum policy: CRC32C (Castagnoli) written in big endian
+ */
+struct Crc32cChecksum {
+    using value_type = std::uint32_t;
+    static constexpr const std::size_t SIZE = 4;
+
+    static inline value_type init(void) { return 0xFFFFFFFFu; }
+
+    static inline value_type
+    update(const value_type state, const byte_t* data, const std::size_t len)
+    {
+      return crc32cUpdate(state, data, len);
+    }
+
+    static inline value_type finish(const value_type state) { return ~state; }
+
+    static inline void
+    write(const value_type value, byte_t* out)
+    {
+      out[0] = byte_t(value >> 24);
+      out[1] = byte_t(value >> 16);
+      out[2] = byte_t(value >> 8);
+      out[3] = byte_t(value);
+    }
+
+    static inline value_type
+    read(const byte_t* in)
+    {
+      return (value_type(in[0]) << 24) | (value_type(in[1]) << 16) |
+             (value_type(in[2]) << 8) | value_type(in[3]);
+    }
+};
+
+}
+
+#endif // PACKET_CHECKSUM_H_
@@ -0,0 +1,75 @@
+#ifndef PACKET_COMPRESSION_H_
+#define PACKET_COMPRESSION_H_
+
+#include <cstdint>
+
+#include <packet/defs.h>
+#include <packet/lz4.h>
+
+
+namespace packet {
+
+/**
+ * @brief Compression policies define if (and how) the packet content is compressed on
+ *        the wire. All of them provide the same static interface:
+ *        - ENABLED: if false the packets have no flags field and are never compressed
+ *        - MIN_SIZE: contents smaller than this are always sent raw
+ *        - maxCompressedSize(len): the maximum output size of compress()
+ *        - maxExpandedSize(len): the maximum output size of decompress() for len bytes
+ *        - compress(src, len, dst, dst_capacity): returns the compressed size or 0 if it
+ *          does not fit
+ *        - decompress(src, len, dst, dst_len): returns true if src was successfully
+ *          decompressed into exactly dst_len bytes
+ */
+
+/**
+ * @brief NoCompression is the default policy
+ */
+struct NoCompression {
+    static constexpr const bool ENABLED = false;
+    static constexpr const std::size_t MIN_SIZE = 0;
+
+    static inline std::size_t maxCompressedSize(const std::size_t len) { return len; }
+    static inline std::size_t maxExpandedSize(const std::size_t len) { return len; }
+    static inline std::size_t compress(const byte_t*, const std::size_t, byte_t*, const std::size_t) { return 0; }
+    static inline bool decompress(const byte_t*, const std::size_t, byte_t*, const std::size_t) { return false; }
+};
+
+/**
+ * @brief Lz4Compression compresses the contents of at least MinSize bytes with the
+ *        built-in LZ4 block codec (check lz4.h). Contents that do not shrink are sent raw
+ * @tparam MinSize the minimum content size to try to compress it
+ */
+template<std::size_t MinSize = 256>
+struct Lz4Compression {
+    static constexpr const bool ENABLED = true;
+    static constexpr const std::size_t MIN_SIZE = MinSize;
+
+    static inline std::size_t
+    maxCompressedSize(const std::size_t len)
+    {
+      return lz4::compressBound(len);
+    }
+
+    static inline std::size_t
+    maxExpandedSize(const std::size_t len)
+    {
+      return lz4::decompressBound(len);
+    }
+
+    static inline std::size_t
+    compress(const byte_t* src, const std::size_t len, byte_t* dst, const std::size_t dst_capacity)
+    {
+      return lz4::compress(src, len, dst, dst_capacity);
+    }
+
+    static inline bool
+    decompress(const byte_t* src, const std::size_t len, byte_t* dst, const std::size_t dst_len)
+    {
+      return lz4::decompress(src, len, dst, dst_len);
+    }
+};
+
+}
+
+#endif // PACKET_COMPRESSION_H_
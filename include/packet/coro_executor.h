@@ -0,0 +1,204 @@
+#ifndef PACKET_CORO_EXECUTOR_H_
+#define PACKET_CORO_EXECUTOR_H_
+
+#if __cplusplus < 202002L
+#  error "the coroutine support of packet requires c++20"
+#endif
+
+#include <coroutine>
+#include <vector>
+#include <cstdint>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/types.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/coro_task.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The LocalExecutor class is a single threaded executor for the coroutines: a
+ *        queue of ready coroutines and an epoll set used to resume the coroutines waiting
+ *        for a file descriptor to be readable / writable.
+ *        After the first iterations the executor does not allocate (the queues and the
+ *        per fd waiters keep their capacity).
+ */
+class LocalExecutor {
+  public:
+
+    /**
+     * @brief MAX_EVENTS is the maximum number of epoll events handled per wait
+     */
+    static constexpr const std::size_t MAX_EVENTS = 64;
+
+  public:
+    inline LocalExecutor();
+    inline ~LocalExecutor();
+
+    // not copyable
+    LocalExecutor(const LocalExecutor&) = delete;
+    LocalExecutor& operator=(const LocalExecutor&) = delete;
+
+    /**
+     * @brief Returns true if the epoll set could be created
+     * @return true if the epoll set could be created
+     */
+    inline bool
+    isValid(void) const;
+
+    /**
+     * @brief Starts the task on the executor. The executor takes the ownership of the
+     *        coroutine, which is destroyed once finished
+     * @param task the task to run
+     */
+    inline void
+    spawn(Task<void> task);
+
+    /**
+     * @brief Queues a coroutine to be resumed on the next iteration
+     * @param handle the coroutine
+     */
+    inline void
+    post(std::coroutine_handle<> handle);
+
+    /**
+     * @brief Runs the coroutines until none is ready nor waiting for a file descriptor
+     */
+    inline void
+    run(void);
+
+    /**
+     * @brief Runs a single iteration: resumes the ready coroutines or, if there is none,
+     *        waits (at most timeout_ms, -1 forever) for a file descriptor
+     * @param timeout_ms the maximum time to wait for a file descriptor
+     * @return false if there is nothing else to run
+     */
+    inline bool
+    runOnce(const int timeout_ms = -1);
+
+    /**
+     * @brief Returns an awaitable resuming the coroutine once fd is readable
+     * @param fd the file descriptor
+     * @return the awaitable
+     */
+    inline auto
+    readable(const int fd);
+
+    /**
+     * @brief Returns an awaitable resuming the coroutine once fd is writable
+     * @param fd the file descriptor
+     * @return the awaitable
+     */
+    inline auto
+    writable(const int fd);
+
+    /**
+     * @brief Drops the registration of fd, must be called before closing a file
+     *        descriptor used with readable() / writable() (no coroutine must be waiting)
+     * @param fd the file descriptor
+     */
+    inline void
+    forget(const int fd);
+
+
+  private:
+
+    struct FdWaiters {
+      std::coroutine_handle<> reader;
+      std::coroutine_handle<> writer;
+      bool registered = false;
+    };
+
+    struct FdAwaiter {
+      LocalExecutor& executor;
+      int fd;
+      bool write;
+
+      bool await_ready(void) const noexcept { return false; }
+      void await_suspend(std::coroutine_handle<> handle) { executor.wait(fd, write, handle); }
+      void await_resume(void) const noexcept {}
+    };
+
+  private:
+
+    inline void
+    wait(const int fd, const bool write, std::coroutine_handle<> handle);
+
+    inline void
+    updateRegistration(const int fd);
+
+    inline void
+    waitEvents(const int timeout_ms);
+
+  private:
+    int epoll_fd_;
+    std::vector<std::coroutine_handle<>> ready_;
+    std::vector<std::coroutine_handle<>> running_;
+    std::vector<FdWaiters> fds_;
+    std::size_t waiting_count_;
+};
+
+
+/**
+ * @brief The FdStream class is an async byte source / sink over a file descriptor (a
+ *        socket, a pipe, ...) driven by a LocalExecutor. The descriptor is set as non
+ *        blocking and it is not owned (it is not closed by the stream)
+ */
+class FdStream {
+  public:
+    /**
+     * @brief Construct the stream
+     * @param executor  The executor resuming the operations
+     * @param fd        The file descriptor
+     */
+    inline FdStream(LocalExecutor& executor, const int fd);
+    inline ~FdStream();
+
+    // not copyable
+    FdStream(const FdStream&) = delete;
+    FdStream& operator=(const FdStream&) = delete;
+
+    /**
+     * @brief Returns the file descriptor
+     * @return the file descriptor
+     */
+    inline int
+    fd(void) const;
+
+    /**
+     * @brief Reads up to len bytes, waiting until some data is available
+     * @param data  The destination
+     * @param len   The maximum amount of bytes to read
+     * @return the amount of bytes read, 0 on end of stream or -errno on error
+     */
+    inline Task<ssize_t>
+    read(byte_t* data, const std::size_t len);
+
+    /**
+     * @brief Writes up to len bytes, waiting until some can be written
+     * @param data  The data to write
+     * @param len   The amount of bytes to write
+     * @return the amount of bytes written or -errno on error
+     */
+    inline Task<ssize_t>
+    write(const byte_t* data, const std::size_t len);
+
+  private:
+    LocalExecutor& executor_;
+    int fd_;
+};
+
+
+
+#include <packet/coro_executor_impl.h>
+
+}
+
+#endif // PACKET_CORO_EXECUTOR_H_
@@ -0,0 +1,218 @@
+
+
+
+inline LocalExecutor::LocalExecutor() :
+  epoll_fd_(::epoll_create1(EPOLL_CLOEXEC))
+, waiting_count_(0)
+{
+  PKT_ASSERT(epoll_fd_ >= 0);
+  // both queues are swapped on each iteration, so both need the capacity
+  ready_.reserve(MAX_EVENTS);
+  running_.reserve(MAX_EVENTS);
+}
+
+inline LocalExecutor::~LocalExecutor()
+{
+  if (epoll_fd_ >= 0) {
+    ::close(epoll_fd_);
+  }
+}
+
+inline bool
+LocalExecutor::isValid(void) const
+{
+  return epoll_fd_ >= 0;
+}
+
+inline void
+LocalExecutor::spawn(Task<void> task)
+{
+  auto handle = task.release();
+  if (!handle) {
+    return;
+  }
+  handle.promise().detached = true;
+  post(handle);
+}
+
+inline void
+LocalExecutor::post(std::coroutine_handle<> handle)
+{
+  ready_.push_back(handle);
+}
+
+inline void
+LocalExecutor::run(void)
+{
+  while (runOnce()) {}
+}
+
+inline bool
+LocalExecutor::runOnce(const int timeout_ms)
+{
+  if (ready_.empty()) {
+    if (waiting_count_ == 0) {
+      return false;
+    }
+    waitEvents(timeout_ms);
+  }
+  // the coroutines resumed now may queue others for the next iteration
+  running_.swap(ready_);
+  for (std::coroutine_handle<> handle : running_) {
+    handle.resume();
+  }
+  running_.clear();
+  return !ready_.empty() || waiting_count_ > 0;
+}
+
+inline auto
+LocalExecutor::readable(const int fd)
+{
+  return FdAwaiter{*this, fd, false};
+}
+
+inline auto
+LocalExecutor::writable(const int fd)
+{
+  return FdAwaiter{*this, fd, true};
+}
+
+inline void
+LocalExecutor::forget(const int fd)
+{
+  if (fd < 0 || std::size_t(fd) >= fds_.size()) {
+    return;
+  }
+  FdWaiters& waiters = fds_[fd];
+  PKT_ASSERT(!waiters.reader && !waiters.writer);
+  if (waiters.registered) {
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    waiters.registered = false;
+  }
+}
+
+inline void
+LocalExecutor::wait(const int fd, const bool write, std::coroutine_handle<> handle)
+{
+  PKT_ASSERT(fd >= 0);
+  if (std::size_t(fd) >= fds_.size()) {
+    fds_.resize(std::size_t(fd) + 1);
+  }
+  std::coroutine_handle<>& slot = write ? fds_[fd].writer : fds_[fd].reader;
+  PKT_ASSERT(!slot && "only one coroutine can wait for each direction of a fd");
+  slot = handle;
+  ++waiting_count_;
+  updateRegistration(fd);
+}
+
+inline void
+LocalExecutor::updateRegistration(const int fd)
+{
+  FdWaiters& waiters = fds_[fd];
+  const std::uint32_t events = (waiters.reader ? std::uint32_t(EPOLLIN) : 0) |
+                               (waiters.writer ? std::uint32_t(EPOLLOUT) : 0);
+  if (events == 0) {
+    // the one shot registration is already disarmed
+    return;
+  }
+  epoll_event event = {};
+  event.events = events | EPOLLONESHOT;
+  event.data.fd = fd;
+  // the fd may have been closed and reused without forget(), try both operations
+  const int first = waiters.registered ? EPOLL_CTL_MOD : EPOLL_CTL_ADD;
+  if (::epoll_ctl(epoll_fd_, first, fd, &event) != 0) {
+    const int second = first == EPOLL_CTL_MOD ? EPOLL_CTL_ADD : EPOLL_CTL_MOD;
+    if (::epoll_ctl(epoll_fd_, second, fd, &event) != 0) {
+      PKT_LOG_ERROR("could not register fd " << fd << " on epoll: " << errno);
+      // resume the waiters, the operation will report the error
+      for (std::coroutine_handle<>* slot : {&waiters.reader, &waiters.writer}) {
+        if (*slot) {
+          post(*slot);
+          *slot = nullptr;
+          --waiting_count_;
+        }
+      }
+      return;
+    }
+  }
+  waiters.registered = true;
+}
+
+inline void
+LocalExecutor::waitEvents(const int timeout_ms)
+{
+  epoll_event events[MAX_EVENTS];
+  const int count = ::epoll_wait(epoll_fd_, events, int(MAX_EVENTS), timeout_ms);
+  for (int i = 0; i < count; ++i) {
+    const int fd = events[i].data.fd;
+    const std::uint32_t flags = events[i].events;
+    FdWaiters& waiters = fds_[fd];
+    const bool failed = (flags & (EPOLLERR | EPOLLHUP)) != 0;
+    if (waiters.reader && (failed || (flags & (EPOLLIN | EPOLLRDHUP)) != 0)) {
+      post(waiters.reader);
+      waiters.reader = nullptr;
+      --waiting_count_;
+    }
+    if (waiters.writer && (failed || (flags & EPOLLOUT) != 0)) {
+      post(waiters.writer);
+      waiters.writer = nullptr;
+      --waiting_count_;
+    }
+    // re arm the direction still waiting (if any)
+    updateRegistration(fd);
+  }
+}
+
+
+inline FdStream::FdStream(LocalExecutor& executor, const int fd) :
+  executor_(executor)
+, fd_(fd)
+{
+  const int flags = ::fcntl(fd_, F_GETFL);
+  if (flags >= 0 && (flags & O_NONBLOCK) == 0) {
+    ::fcntl(fd_, F_SETFL, flags | O_NONBLOCK);
+  }
+}
+
+inline FdStream::~FdStream()
+{
+  executor_.forget(fd_);
+}
+
+inline int
+FdStream::fd(void) const
+{
+  return fd_;
+}
+
+inline Task<ssize_t>
+FdStream::read(byte_t* data, const std::size_t len)
+{
+  while (true) {
+    const ssize_t result = ::read(fd_, data, len);
+    if (result >= 0) {
+      co_return result;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await executor_.readable(fd_);
+    } else if (errno != EINTR) {
+      co_return -errno;
+    }
+  }
+}
+
+inline Task<ssize_t>
+FdStream::write(const byte_t* data, const std::size_t len)
+{
+  while (true) {
+    const ssize_t result = ::write(fd_, data, len);
+    if (result >= 0) {
+      co_return result;
+    }
+    if (errno == EAGAIN || errno == EWOULDBLOCK) {
+      co_await executor_.writable(fd_);
+    } else if (errno != EINTR) {
+      co_return -errno;
+    }
+  }
+}
@@ -0,0 +1,168 @@
+#ifndef PACKET_CORO_PACKET_IO_H_
+#define PACKET_CORO_PACKET_IO_H_
+
+#if __cplusplus < 202002L
+#  error "the coroutine support of packet requires c++20"
+#endif
+
+#include <concepts>
+#include <optional>
+#include <vector>
+#include <cstdint>
+
+#include <sys/types.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/stream_framer.h>
+#include <packet/coro_task.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief An async byte source: source.read(data, len) is awaitable and returns the amount
+ *        of bytes read (ssize_t), 0 on end of stream or a negative value on error
+ */
+template<typename Source>
+concept AsyncByteSource = requires(Source& source, byte_t* data, std::size_t len) {
+  { source.read(data, len).operator co_await().await_resume() } -> std::convertible_to<ssize_t>;
+};
+
+/**
+ * @brief An async byte sink: sink.write(data, len) is awaitable and returns the amount of
+ *        bytes written (ssize_t, it can be less than len) or a negative value on error
+ */
+template<typename Sink>
+concept AsyncByteSink = requires(Sink& sink, const byte_t* data, std::size_t len) {
+  { sink.write(data, len).operator co_await().await_resume() } -> std::convertible_to<ssize_t>;
+};
+
+
+/**
+ * @brief The PacketReaderT class reads packets from an async byte source:
+ *
+ *          while (auto view = co_await reader.next()) { use(view->data, view->len); }
+ *
+ *        The chunks are read into an internal buffer and framed with a StreamFramerT, so
+ *        the packets fully contained in a chunk are not copied. Once warmed up the read
+ *        loop does not allocate (the coroutine frames come from the FramePool).
+ * @tparam Cfg     The configuration to be used on the packets
+ * @tparam Source  The async byte source
+ */
+template<typename Cfg, AsyncByteSource Source>
+class PacketReaderT {
+  public:
+
+    using FramerType = StreamFramerT<Cfg>;
+
+    /**
+     * @brief DEFAULT_READ_SIZE is the default size of the read buffer
+     */
+    static constexpr const std::size_t DEFAULT_READ_SIZE = 64 * 1024;
+
+  public:
+    /**
+     * @brief Construct the reader
+     * @param source      The source (it must outlive the reader)
+     * @param read_size   The size of the read buffer
+     */
+    inline explicit PacketReaderT(Source& source, const std::size_t read_size = DEFAULT_READ_SIZE);
+
+    /**
+     * @brief Waits for the next completed packet
+     * @return the view of the packet content (valid until the next call), or nothing at
+     *         the end of the stream, on a read error or on an invalid packet (check
+     *         status() / error())
+     */
+    inline Task<std::optional<PacketView>>
+    next(void);
+
+    /**
+     * @brief Returns the framer status: INVALID once a malformed packet was read
+     * @return the framer status
+     */
+    inline Status
+    status(void) const;
+
+    /**
+     * @brief Returns the last error returned by the source (0 if none)
+     * @return the last error returned by the source
+     */
+    inline ssize_t
+    error(void) const;
+
+    /**
+     * @brief Returns true once the source reached the end of the stream
+     * @return true once the source reached the end of the stream
+     */
+    inline bool
+    isAtEnd(void) const;
+
+  private:
+    Source& source_;
+    FramerType framer_;
+    std::vector<byte_t> read_buffer_;
+    ssize_t error_;
+    bool at_end_;
+};
+
+
+/**
+ * @brief The PacketWriterT class writes packets into an async byte sink:
+ *
+ *          co_await writer.send(data, len);
+ *
+ *        The packet is framed as PacketT::serialize() does (compression included) into
+ *        an internal buffer reused between calls, and written until it is fully sent.
+ *        Only one send() can be in flight at a time.
+ * @tparam Cfg   The configuration to be used on the packets
+ * @tparam Sink  The async byte sink
+ */
+template<typename Cfg, AsyncByteSink Sink>
+class PacketWriterT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using tracing = typename PacketType::tracing;
+    using message_type_t = typename PacketType::message_type_t;
+
+  public:
+    /**
+     * @brief Construct the writer
+     * @param sink  The sink (it must outlive the writer)
+     */
+    inline explicit PacketWriterT(Sink& sink);
+
+    /**
+     * @brief Frames and sends a packet
+     * @param data  The packet content
+     * @param len   The length of the content
+     * @param type  The message type (ignored if the configuration has none)
+     * @return true if the whole packet was written, false on error (check error())
+     */
+    inline Task<bool>
+    send(const byte_t* data, const std::size_t len, const message_type_t type = message_type_t());
+
+    /**
+     * @brief Returns the last error returned by the sink (0 if none)
+     * @return the last error returned by the sink
+     */
+    inline ssize_t
+    error(void) const;
+
+  private:
+    Sink& sink_;
+    std::vector<byte_t> frame_;
+    ssize_t error_;
+};
+
+
+
+#include <packet/coro_packet_io_impl.h>
+
+}
+
+#endif // PACKET_CORO_PACKET_IO_H_
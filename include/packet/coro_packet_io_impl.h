@@ -0,0 +1,96 @@
+
+
+
+template<typename Cfg, AsyncByteSource Source>
+inline PacketReaderT<Cfg, Source>::PacketReaderT(Source& source, const std::size_t read_size) :
+  source_(source)
+, read_buffer_(read_size)
+, error_(0)
+, at_end_(false)
+{
+  PKT_ASSERT(read_size > 0);
+}
+
+template<typename Cfg, AsyncByteSource Source>
+inline Task<std::optional<PacketView>>
+PacketReaderT<Cfg, Source>::next(void)
+{
+  PacketView view;
+  while (true) {
+    if (framer_.next(view)) {
+      co_return view;
+    }
+    // the input was fully consumed (the partial packet is kept by the framer)
+    if (framer_.status() == Status::INVALID || at_end_ || error_ != 0) {
+      co_return std::nullopt;
+    }
+    const ssize_t result = co_await source_.read(read_buffer_.data(), read_buffer_.size());
+    if (result <= 0) {
+      if (result == 0) {
+        at_end_ = true;
+      } else {
+        error_ = result;
+      }
+      co_return std::nullopt;
+    }
+    framer_.setInput(read_buffer_.data(), std::size_t(result));
+  }
+}
+
+template<typename Cfg, AsyncByteSource Source>
+inline Status
+PacketReaderT<Cfg, Source>::status(void) const
+{
+  return framer_.status();
+}
+
+template<typename Cfg, AsyncByteSource Source>
+inline ssize_t
+PacketReaderT<Cfg, Source>::error(void) const
+{
+  return error_;
+}
+
+template<typename Cfg, AsyncByteSource Source>
+inline bool
+PacketReaderT<Cfg, Source>::isAtEnd(void) const
+{
+  return at_end_;
+}
+
+
+template<typename Cfg, AsyncByteSink Sink>
+inline PacketWriterT<Cfg, Sink>::PacketWriterT(Sink& sink) :
+  sink_(sink)
+, error_(0)
+{
+}
+
+template<typename Cfg, AsyncByteSink Sink>
+inline Task<bool>
+PacketWriterT<Cfg, Sink>::send(const byte_t* data, const std::size_t len, const message_type_t type)
+{
+  const std::uint64_t start = tracing::now();
+  if (len > std::size_t(Cfg::MAX_DATA_LEN) ||
+      !PacketType::serialize(data, typename Cfg::data_len_t(len), frame_, type)) {
+    co_return false;
+  }
+  std::size_t offset = 0;
+  while (offset < frame_.size()) {
+    const ssize_t result = co_await sink_.write(frame_.data() + offset, frame_.size() - offset);
+    if (result < 0) {
+      error_ = result;
+      co_return false;
+    }
+    offset += std::size_t(result);
+  }
+  tracing::recordHandoff(tracing::now() - start);
+  co_return true;
+}
+
+template<typename Cfg, AsyncByteSink Sink>
+inline ssize_t
+PacketWriterT<Cfg, Sink>::error(void) const
+{
+  return error_;
+}
@@ -0,0 +1,293 @@
+#ifndef PACKET_CORO_TASK_H_
+#define PACKET_CORO_TASK_H_
+
+#if __cplusplus < 202002L
+#  error "the coroutine support of packet requires c++20"
+#endif
+
+#include <coroutine>
+#include <cstdint>
+#include <cstdlib>
+#include <exception>
+#include <new>
+#include <optional>
+#include <utility>
+#include <array>
+
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+/**
+ * @brief FramePool is the allocator of the coroutine frames: a per thread cache of free
+ *        blocks by size class, so once the frames of a loop were allocated they are
+ *        reused and the loop does not hit the global allocator anymore.
+ * @note the frames must be released on the thread they were allocated (the case of the
+ *       LocalExecutor)
+ */
+class FramePool {
+  public:
+
+    /**
+     * @brief GRANULARITY is the size step between classes, MAX_CACHED_SIZE is the biggest
+     *                    frame cached (bigger ones go straight to the global allocator)
+     */
+    static constexpr const std::size_t GRANULARITY = 64;
+    static constexpr const std::size_t MAX_CACHED_SIZE = 64 * GRANULARITY;
+
+  public:
+    FramePool() : allocations_count_(0) { free_lists_.fill(nullptr); }
+    ~FramePool() { clear(); }
+
+    // not copyable
+    FramePool(const FramePool&) = delete;
+    FramePool& operator=(const FramePool&) = delete;
+
+    /**
+     * @brief Returns a block of at least size bytes
+     * @param size the size of the block
+     * @return the block
+     */
+    inline void*
+    allocate(const std::size_t size)
+    {
+      const std::size_t index = sizeClass(size);
+      if (index < free_lists_.size() && free_lists_[index] != nullptr) {
+        FreeBlock* block = free_lists_[index];
+        free_lists_[index] = block->next;
+        return block;
+      }
+      ++allocations_count_;
+      return ::operator new(index < free_lists_.size() ? index * GRANULARITY : size);
+    }
+
+    /**
+     * @brief Gives back a block returned by allocate(size)
+     * @param ptr   The block
+     * @param size  The size used to allocate it
+     */
+    inline void
+    deallocate(void* ptr, const std::size_t size)
+    {
+      const std::size_t index = sizeClass(size);
+      if (index >= free_lists_.size()) {
+        ::operator delete(ptr);
+        return;
+      }
+      FreeBlock* block = static_cast<FreeBlock*>(ptr);
+      block->next = free_lists_[index];
+      free_lists_[index] = block;
+    }
+
+    /**
+     * @brief Returns the number of blocks requested to the global allocator so far
+     * @return the number of blocks requested to the global allocator so far
+     */
+    inline std::size_t
+    allocationsCount(void) const
+    {
+      return allocations_count_;
+    }
+
+    /**
+     * @brief Releases all the cached blocks
+     */
+    inline void
+    clear(void)
+    {
+      for (FreeBlock*& head : free_lists_) {
+        while (head != nullptr) {
+          FreeBlock* next = head->next;
+          ::operator delete(head);
+          head = next;
+        }
+      }
+    }
+
+    /**
+     * @brief Returns the pool of the current thread
+     * @return the pool of the current thread
+     */
+    static inline FramePool&
+    local(void)
+    {
+      static thread_local FramePool pool;
+      return pool;
+    }
+
+  private:
+    struct FreeBlock {
+      FreeBlock* next;
+    };
+
+    static inline std::size_t
+    sizeClass(const std::size_t size)
+    {
+      return (size + GRANULARITY - 1) / GRANULARITY;
+    }
+
+  private:
+    std::array<FreeBlock*, MAX_CACHED_SIZE / GRANULARITY + 1> free_lists_;
+    std::size_t allocations_count_;
+};
+
+
+template<typename T>
+class Task;
+
+namespace detail {
+
+/**
+ * @brief Common part of the task promises: the frames come from the FramePool and, when
+ *        the task finishes, the awaiting coroutine is resumed (symmetric transfer) or the
+ *        frame is destroyed if the task was detached
+ */
+struct TaskPromiseBase {
+    std::coroutine_handle<> continuation;
+    bool detached = false;
+
+    struct FinalAwaiter {
+        bool await_ready(void) const noexcept { return false; }
+
+        template<typename Promise>
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<Promise> handle) noexcept
+        {
+          TaskPromiseBase& promise = handle.promise();
+          if (promise.detached) {
+            handle.destroy();
+            return std::noop_coroutine();
+          }
+          return promise.continuation ? promise.continuation : std::noop_coroutine();
+        }
+
+        void await_resume(void) const noexcept {}
+    };
+
+    std::suspend_always initial_suspend(void) const noexcept { return {}; }
+    FinalAwaiter final_suspend(void) const noexcept { return {}; }
+    void unhandled_exception(void) const noexcept { std::terminate(); }
+
+    static void* operator new(const std::size_t size) { return FramePool::local().allocate(size); }
+    static void operator delete(void* ptr, const std::size_t size) { FramePool::local().deallocate(ptr, size); }
+};
+
+template<typename T>
+struct TaskPromise : TaskPromiseBase {
+    std::optional<T> value;
+
+    Task<T> get_return_object(void);
+    void return_value(T result) { value.emplace(std::move(result)); }
+    T result(void) { return std::move(*value); }
+};
+
+template<>
+struct TaskPromise<void> : TaskPromiseBase {
+    Task<void> get_return_object(void);
+    void return_void(void) const noexcept {}
+    void result(void) const noexcept {}
+};
+
+}
+
+/**
+ * @brief Task is a lazy coroutine returning a T: it starts when it is awaited (or
+ *        spawned on an executor) and resumes the awaiting coroutine when it finishes.
+ *        The frames are allocated from the FramePool
+ * @tparam T the result type
+ */
+template<typename T>
+class Task {
+  public:
+    using promise_type = detail::TaskPromise<T>;
+    using handle_type = std::coroutine_handle<promise_type>;
+
+  public:
+    Task(void) = default;
+    explicit Task(handle_type handle) : handle_(handle) {}
+    Task(Task&& other) noexcept : handle_(std::exchange(other.handle_, nullptr)) {}
+    Task& operator=(Task&& other) noexcept
+    {
+      if (this != &other) {
+        reset();
+        handle_ = std::exchange(other.handle_, nullptr);
+      }
+      return *this;
+    }
+    ~Task() { reset(); }
+
+    // not copyable
+    Task(const Task&) = delete;
+    Task& operator=(const Task&) = delete;
+
+    /**
+     * @brief Returns true if the task holds a coroutine
+     * @return true if the task holds a coroutine
+     */
+    bool isValid(void) const { return bool(handle_); }
+
+    /**
+     * @brief Returns true if the coroutine finished
+     * @return true if the coroutine finished
+     */
+    bool isDone(void) const { return handle_ && handle_.done(); }
+
+    /**
+     * @brief Releases the ownership of the coroutine (check LocalExecutor::spawn())
+     * @return the coroutine handle
+     */
+    handle_type release(void) { return std::exchange(handle_, nullptr); }
+
+    struct Awaiter {
+        handle_type handle;
+
+        bool await_ready(void) const noexcept { return !handle || handle.done(); }
+
+        std::coroutine_handle<>
+        await_suspend(std::coroutine_handle<> awaiting) noexcept
+        {
+          handle.promise().continuation = awaiting;
+          return handle;
+        }
+
+        T await_resume(void) { return handle.promise().result(); }
+    };
+
+    Awaiter operator co_await(void) && noexcept { return Awaiter{handle_}; }
+    Awaiter operator co_await(void) & noexcept { return Awaiter{handle_}; }
+
+  private:
+    void reset(void)
+    {
+      if (handle_) {
+        handle_.destroy();
+        handle_ = nullptr;
+      }
+    }
+
+  private:
+    handle_type handle_ = nullptr;
+};
+
+
+namespace detail {
+
+template<typename T>
+inline Task<T>
+TaskPromise<T>::get_return_object(void)
+{
+  return Task<T>(std::coroutine_handle<TaskPromise<T>>::from_promise(*this));
+}
+
+inline Task<void>
+TaskPromise<void>::get_return_object(void)
+{
+  return Task<void>(std::coroutine_handle<TaskPromise<void>>::from_promise(*this));
+}
+
+}
+
+}
+
+#endif // PACKET_CORO_TASK_H_
@@ -40,6 +40,100 @@ struct LengthCalculator {
 };
 
 
+/**
+ * @brief Describes a serialized packet found at the beginning of a contiguous buffer
+ */
+struct FrameInfo {
+    /**
+     * @brief frame_size The full size of the serialized packet (headers + data + tail). If
+     *                   the packet is not complete yet this is the minimum number of bytes
+     *                   needed to keep inspecting it
+     */
+    std::size_t frame_size;
+    /**
+     * @brief data_offset The offset of the packet content from the beginning of the frame
+     */
+    std::size_t data_offset;
+    /**
+     * @brief data_len The length of the packet content
+     */
+    std::size_t data_len;
+    /**
+     * @brief flags The flags field of the header (0 if the configuration has none)
+     */
+    byte_t flags;
+    /**
+     * @brief message_type The message type field of the header (0 if the configuration has
+     *                     none)
+     */
+    std::uint64_t message_type;
+};
+
+
+/**
+ * @brief Non owning view of the content of a packet
+ */
+struct PacketView {
+    /**
+     * @brief data Pointer to the packet content
+     */
+    const byte_t* data;
+    /**
+     * @brief len The length of the packet content
+     */
+    std::size_t len;
+    /**
+     * @brief in_place True if data points into the buffer provided by the caller, false if
+     *                 the content had to be copied (the packet was split between chunks)
+     */
+    bool in_place;
+    /**
+     * @brief message_type The message type of the packet (0 if the configuration has none)
+     */
+    std::uint64_t message_type;
+};
+
+
+/**
+ * @brief Byte order used to write values on the wire
+ */
+enum class Endian {
+  BIG,
+  LITTLE
+};
+
+// length codecs (check length_codec.h)
+template<typename T, Endian E, std::size_t WIDTH>
+struct FixedLengthCodec;
+
+// checksum policies (check checksum.h)
+struct NoChecksum;
+struct Crc32cChecksum;
+
+// compression policies (check compression.h)
+struct NoCompression;
+
+// buffer policies (check buffer_pool.h)
+struct HeapBufferPolicy;
+struct PooledBufferPolicy;
+
+// metrics policies (check metrics.h)
+struct NoMetrics;
+template<typename GroupTag>
+struct CountingMetrics;
+
+// message type policies (check message_type.h)
+struct NoMessageType;
+struct AnyMessageType;
+template<typename T, typename Limits>
+struct MessageTypeField;
+
+// latency tracing policies (check latency.h)
+struct NoTracing;
+template<typename GroupTag>
+struct LatencyTracing;
+
+
 /**
  * @brief The packet configuration and definitions. This struct will be used by the Packet
  *        to understand what data types should be used
@@ -60,14 +154,80 @@ struct ConfigT {
      */
     static constexpr const char* TAIL_PATTERN = TailPatternType::value;
     /**
-     * @brief data_len_t The data length type to be used, note that for now we use htonl and
-     *                   ntohl to serialize the size of the packets
+     * @brief data_len_t The data length type to be used
      */
     using data_len_t = DataLenT;
+    /**
+     * @brief length_codec How the data length is written on the wire, by default as a big
+     *                     endian value of sizeof(data_len_t) bytes. Can be replaced on a
+     *                     derived configuration (check length_codec.h), for example
+     *                     `using length_codec = VarintLengthCodec<data_len_t>;`
+     */
+    using length_codec = FixedLengthCodec<DataLenT, Endian::BIG, sizeof(DataLenT)>;
+    /**
+     * @brief checksum Optional integrity field written after the content (none by
+     *                 default). Can be replaced on a derived configuration (check
+     *                 checksum.h), for example `using checksum = Crc32cChecksum;`
+     */
+    using checksum = NoChecksum;
+    /**
+     * @brief compression Optional compression of the content (none by default). When
+     *                    enabled the header carries a flags field telling if the content
+     *                    of each packet is compressed. Can be replaced on a derived
+     *                    configuration (check compression.h), for example
+     *                    `using compression = Lz4Compression<>;`
+     */
+    using compression = NoCompression;
     /**
      * @brief MAX_DATA_LEN Maximum data we are allowed to send on the packets
      */
     static constexpr data_len_t MAX_DATA_LEN = MaxDataLen;
+    /**
+     * @brief buffer_policy Where the packet buffers come from and return to. Can be
+     *                      replaced on a derived configuration, for example
+     *                      `using buffer_policy = PooledBufferPolicy;` to recycle them on a
+     *                      per thread pool
+     */
+    using buffer_policy = HeapBufferPolicy;
+    /**
+     * @brief MAX_RESERVE_AHEAD Maximum number of bytes the packet reserves ahead of the data
+     *                          actually received. The buffer grows as the data arrives so
+     *                          a big declared length does not commit memory up front
+     */
+    static constexpr std::size_t MAX_RESERVE_AHEAD = 64 * 1024;
+    /**
+     * @brief INLINE_PACKET_MAX_SIZE Configurations whose packets (PACKET_MAX_SIZE) fit on
+     *                               this many bytes keep them on a fixed array inside the
+     *                               packet, the parser never allocates
+     */
+    static constexpr std::size_t INLINE_PACKET_MAX_SIZE = 1024;
+    /**
+     * @brief INLINE_BUFFER_SIZE Bigger configurations keep this many bytes inside the packet
+     *                           and only take a buffer from the buffer policy for the frames
+     *                           not fitting on them (0 always uses the buffer policy)
+     */
+    static constexpr std::size_t INLINE_BUFFER_SIZE = 256;
+    /**
+     * @brief metrics Counters of the parsers and serializers (none by default, the hooks
+     *                compile to nothing). Can be replaced on a derived configuration
+     *                (check metrics.h), for example `using metrics = CountingMetrics<MyGroup>;`
+     */
+    using metrics = NoMetrics;
+    /**
+     * @brief tracing Latency of the parsers (first head pattern byte to COMPLETE) and of
+     *                the senders (serialize to handoff), none by default. Can be replaced
+     *                on a derived configuration (check latency.h), for example
+     *                `using tracing = LatencyTracing<MyGroup>;`
+     */
+    using tracing = NoTracing;
+    /**
+     * @brief message_type Optional message type field written on the header after the data
+     *                     length (none by default), known by the parser before the content
+     *                     arrives. Can be replaced on a derived configuration (check
+     *                     message_type.h), for example
+     *                     `using message_type = MessageTypeField<std::uint16_t>;`
+     */
+    using message_type = NoMessageType;
 };
 
 struct DefaultStartPattern { static constexpr const char* value = "<"; };
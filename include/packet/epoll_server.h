@@ -0,0 +1,219 @@
+#ifndef PACKET_EPOLL_SERVER_H_
+#define PACKET_EPOLL_SERVER_H_
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cerrno>
+
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/stream_framer.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief Opens a non blocking listening socket bound with SO_REUSEPORT (so several
+ *        sockets can share the address and the kernel balances the connections)
+ * @param addr the address to listen on
+ * @return the socket or -1 on error (errno is kept)
+ */
+inline int
+openListenSocket(const sockaddr_in& addr);
+
+}
+
+
+/**
+ * @brief The EpollServerT class is an (optional, linux only) TCP server that reads packets
+ *        from many connections using several epoll reactor threads. Every reactor owns its
+ *        own listening socket bound with SO_REUSEPORT so the kernel shards the accepted
+ *        connections between them, and its own read buffer:
+ *        - the data is read into the reactor buffer and framed in place (complete
+ *          packets are given to the handler without copying them)
+ *        - once a partial packet is bigger than the reactor buffer it is moved into a
+ *          PacketT and the rest is read straight into PacketT::remainingBuffer()
+ *        Idle connections only keep their (empty) framer, so a reactor can hold a large
+ *        amount of them. Each connection is read at most MAX_READS_PER_EVENT times
+ *        before serving the others to keep the latency flat.
+ * @tparam Cfg  The configuration to be used on the packets
+ */
+template<typename Cfg>
+class EpollServerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using FramerType = StreamFramerT<Cfg>;
+
+    /**
+     * @brief Handler called (from the reactor thread owning the connection) once per
+     *        completed packet with its content and message type (0 if the configuration
+     *        has none). The content is only valid during the call
+     */
+    using Handler = std::function<void(int fd, const byte_t* data, std::size_t len, std::uint64_t message_type)>;
+
+    /**
+     * @brief READ_BUFFER_SIZE is the size of the read buffer of each reactor
+     */
+    static constexpr const std::size_t READ_BUFFER_SIZE = 64 * 1024;
+
+    /**
+     * @brief MAX_READS_PER_EVENT is the maximum number of reads done on a connection
+     *                            before serving the other ready connections
+     */
+    static constexpr const std::size_t MAX_READS_PER_EVENT = 16;
+
+  public:
+    /**
+     * @brief Construct the server
+     * @param handler       The handler for the completed packets
+     * @param threads_count The number of reactor threads (0 means one per core)
+     */
+    inline explicit EpollServerT(Handler handler, const std::size_t threads_count = 0);
+    inline ~EpollServerT();
+
+    // not copyable
+    EpollServerT(const EpollServerT&) = delete;
+    EpollServerT& operator=(const EpollServerT&) = delete;
+
+    /**
+     * @brief Starts listening and the reactor threads
+     * @param port    The port to listen on, 0 to pick any (check port())
+     * @param address The IPv4 address to listen on
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    start(const std::uint16_t port, const char* address = "0.0.0.0");
+
+    /**
+     * @brief Stops the reactor threads and closes all the connections
+     */
+    inline void
+    stop(void);
+
+    /**
+     * @brief Returns true if the server is running
+     * @return true if the server is running
+     */
+    inline bool
+    isRunning(void) const;
+
+    /**
+     * @brief Returns the port the server is listening on
+     * @return the port the server is listening on
+     */
+    inline std::uint16_t
+    port(void) const;
+
+    /**
+     * @brief Returns the number of reactor threads
+     * @return the number of reactor threads
+     */
+    inline std::size_t
+    threadsCount(void) const;
+
+    /**
+     * @brief Returns the number of open connections
+     * @return the number of open connections
+     */
+    inline std::size_t
+    connectionsCount(void) const;
+
+    /**
+     * @brief Returns the number of connections closed because of an invalid packet
+     * @return the number of connections closed because of an invalid packet
+     */
+    inline std::size_t
+    invalidCount(void) const;
+
+
+  private:
+
+    struct Connection {
+      int fd;
+      FramerType framer;
+      // only while reading a packet bigger than the read buffer
+      std::unique_ptr<PacketType> packet;
+    };
+
+    struct Reactor {
+      int epoll_fd = -1;
+      int listen_fd = -1;
+      int wake_fd = -1;
+      std::thread thread;
+      std::vector<byte_t> read_buffer;
+      std::unordered_map<int, std::unique_ptr<Connection>> connections;
+      // connections that were not fully drained on the last event
+      std::vector<int> backlog;
+    };
+
+    enum class ReadResult {
+      DRAINED,
+      PENDING,
+      CLOSE,
+    };
+
+  private:
+
+    inline bool
+    setupReactor(Reactor& reactor, const sockaddr_in& addr);
+
+    inline void
+    closeReactor(Reactor& reactor);
+
+    inline void
+    run(Reactor& reactor);
+
+    inline void
+    acceptConnections(Reactor& reactor);
+
+    inline void
+    serveConnection(Reactor& reactor, const int fd);
+
+    inline ReadResult
+    readConnection(Reactor& reactor, Connection& connection);
+
+    inline bool
+    handleData(Connection& connection, const byte_t* data, const std::size_t len);
+
+    inline void
+    closeConnection(Reactor& reactor, const int fd);
+
+  private:
+    Handler handler_;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::uint16_t port_;
+    std::size_t threads_count_;
+    std::atomic<bool> running_;
+    std::atomic<std::size_t> connections_count_;
+    std::atomic<std::size_t> invalid_count_;
+};
+
+
+
+#include <packet/epoll_server_impl.h>
+
+
+// Default definition of a server
+using DefaultEpollServer = EpollServerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_EPOLL_SERVER_H_
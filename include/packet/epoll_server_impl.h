@@ -0,0 +1,348 @@
+
+
+namespace detail {
+
+inline int
+openListenSocket(const sockaddr_in& addr)
+{
+  const int fd = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC, 0);
+  if (fd < 0) {
+    return -1;
+  }
+  const int one = 1;
+  if (::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one, sizeof(one)) != 0 ||
+      ::setsockopt(fd, SOL_SOCKET, SO_REUSEPORT, &one, sizeof(one)) != 0 ||
+      ::bind(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0 ||
+      ::listen(fd, SOMAXCONN) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    return -1;
+  }
+  return fd;
+}
+
+}
+
+
+
+template<typename Cfg>
+inline bool
+EpollServerT<Cfg>::setupReactor(Reactor& reactor, const sockaddr_in& addr)
+{
+  reactor.read_buffer.resize(READ_BUFFER_SIZE);
+  reactor.listen_fd = detail::openListenSocket(addr);
+  if (reactor.listen_fd < 0) {
+    return false;
+  }
+
+  reactor.epoll_fd = ::epoll_create1(EPOLL_CLOEXEC);
+  reactor.wake_fd = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+  if (reactor.epoll_fd < 0 || reactor.wake_fd < 0) {
+    return false;
+  }
+  for (const int fd : {reactor.listen_fd, reactor.wake_fd}) {
+    epoll_event event = {};
+    event.events = EPOLLIN;
+    event.data.fd = fd;
+    if (::epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::closeReactor(Reactor& reactor)
+{
+  for (auto& entry : reactor.connections) {
+    ::close(entry.first);
+  }
+  reactor.connections.clear();
+  reactor.backlog.clear();
+  for (int* fd : {&reactor.listen_fd, &reactor.wake_fd, &reactor.epoll_fd}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::run(Reactor& reactor)
+{
+  std::vector<epoll_event> events(256);
+  std::vector<int> backlog;
+  while (running_) {
+    // do not block if some connections still have data to read
+    const int timeout = reactor.backlog.empty() ? -1 : 0;
+    const int count = ::epoll_wait(reactor.epoll_fd, events.data(), int(events.size()), timeout);
+    if (count < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      PKT_LOG_ERROR("epoll_wait failed: " << errno);
+      break;
+    }
+
+    backlog.clear();
+    backlog.swap(reactor.backlog);
+    for (int i = 0; i < count; ++i) {
+      const int fd = events[i].data.fd;
+      if (fd == reactor.wake_fd) {
+        // stop() was called, running_ is checked on the loop
+        continue;
+      }
+      if (fd == reactor.listen_fd) {
+        acceptConnections(reactor);
+        continue;
+      }
+      serveConnection(reactor, fd);
+    }
+    // the connections not drained on the previous round go after the new ones
+    for (const int fd : backlog) {
+      serveConnection(reactor, fd);
+    }
+  }
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::acceptConnections(Reactor& reactor)
+{
+  while (true) {
+    const int fd = ::accept4(reactor.listen_fd, nullptr, nullptr, SOCK_NONBLOCK | SOCK_CLOEXEC);
+    if (fd < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        PKT_LOG_ERROR("accept failed: " << errno);
+      }
+      return;
+    }
+    const int one = 1;
+    ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+
+    // edge triggered: each readiness change is reported once, we read till EAGAIN
+    epoll_event event = {};
+    event.events = EPOLLIN | EPOLLRDHUP | EPOLLET;
+    event.data.fd = fd;
+    if (::epoll_ctl(reactor.epoll_fd, EPOLL_CTL_ADD, fd, &event) != 0) {
+      PKT_LOG_ERROR("epoll_ctl failed: " << errno);
+      ::close(fd);
+      continue;
+    }
+    std::unique_ptr<Connection> connection(new Connection());
+    connection->fd = fd;
+    reactor.connections[fd] = std::move(connection);
+    ++connections_count_;
+  }
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::serveConnection(Reactor& reactor, const int fd)
+{
+  const auto it = reactor.connections.find(fd);
+  if (it == reactor.connections.end()) {
+    // already closed
+    return;
+  }
+  switch (readConnection(reactor, *it->second)) {
+    case ReadResult::PENDING: reactor.backlog.push_back(fd); break;
+    case ReadResult::CLOSE: closeConnection(reactor, fd); break;
+    case ReadResult::DRAINED: break;
+  }
+}
+
+template<typename Cfg>
+inline typename EpollServerT<Cfg>::ReadResult
+EpollServerT<Cfg>::readConnection(Reactor& reactor, Connection& connection)
+{
+  for (std::size_t reads = 0; reads < MAX_READS_PER_EVENT; ++reads) {
+    PacketType* pkt = connection.packet.get();
+    byte_t* buffer = pkt != nullptr ? pkt->remainingBuffer() : reactor.read_buffer.data();
+    const std::size_t capacity = pkt != nullptr ? pkt->remainingBytes() : reactor.read_buffer.size();
+    const ssize_t result = ::read(connection.fd, buffer, capacity);
+    if (result < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return (errno == EAGAIN || errno == EWOULDBLOCK) ? ReadResult::DRAINED : ReadResult::CLOSE;
+    }
+    if (result == 0) {
+      // closed by the peer
+      return ReadResult::CLOSE;
+    }
+
+    if (pkt == nullptr) {
+      if (!handleData(connection, buffer, std::size_t(result))) {
+        ++invalid_count_;
+        return ReadResult::CLOSE;
+      }
+      continue;
+    }
+
+    pkt->updateDataOffset(std::size_t(result));
+    if (pkt->status() == Status::INVALID) {
+      ++invalid_count_;
+      return ReadResult::CLOSE;
+    }
+    if (pkt->status() == Status::COMPLETE) {
+      handler_(connection.fd, pkt->data(), pkt->dataLen(), pkt->messageType());
+      // the big buffer goes back to the buffer policy, idle connections keep nothing
+      connection.packet.reset();
+    }
+  }
+  return ReadResult::PENDING;
+}
+
+template<typename Cfg>
+inline bool
+EpollServerT<Cfg>::handleData(Connection& connection, const byte_t* data, const std::size_t len)
+{
+  connection.framer.setInput(data, len);
+  PacketView view;
+  while (connection.framer.next(view)) {
+    handler_(connection.fd, view.data, view.len, view.message_type);
+  }
+  if (connection.framer.status() == Status::INVALID) {
+    return false;
+  }
+  if (connection.framer.pendingFrameSize() > READ_BUFFER_SIZE) {
+    // the rest of a big packet is read straight into its final buffer
+    connection.packet.reset(new PacketType());
+    connection.framer.movePending(*connection.packet);
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::closeConnection(Reactor& reactor, const int fd)
+{
+  // closing the fd also removes it from the epoll set
+  ::close(fd);
+  reactor.connections.erase(fd);
+  --connections_count_;
+}
+
+
+template<typename Cfg>
+inline EpollServerT<Cfg>::EpollServerT(Handler handler, const std::size_t threads_count) :
+  handler_(std::move(handler))
+, port_(0)
+, threads_count_(threads_count > 0 ? threads_count : std::max(1u, std::thread::hardware_concurrency()))
+, running_(false)
+, connections_count_(0)
+, invalid_count_(0)
+{
+  PKT_ASSERT(bool(handler_));
+}
+
+template<typename Cfg>
+inline EpollServerT<Cfg>::~EpollServerT()
+{
+  stop();
+}
+
+template<typename Cfg>
+inline bool
+EpollServerT<Cfg>::start(const std::uint16_t port, const char* address)
+{
+  if (running_) {
+    return false;
+  }
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (::inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+    errno = EINVAL;
+    return false;
+  }
+
+  for (std::size_t i = 0; i < threads_count_; ++i) {
+    std::unique_ptr<Reactor> reactor(new Reactor());
+    const bool ok = setupReactor(*reactor, addr);
+    reactors_.push_back(std::move(reactor));
+    if (!ok) {
+      const int error = errno;
+      for (auto& r : reactors_) {
+        closeReactor(*r);
+      }
+      reactors_.clear();
+      errno = error;
+      return false;
+    }
+    if (i == 0 && port == 0) {
+      // the rest of the reactors share the port picked for the first one
+      socklen_t addr_len = sizeof(addr);
+      ::getsockname(reactors_.front()->listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    }
+  }
+  port_ = ntohs(addr.sin_port);
+
+  running_ = true;
+  for (auto& reactor : reactors_) {
+    reactor->thread = std::thread(&EpollServerT<Cfg>::run, this, std::ref(*reactor));
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+EpollServerT<Cfg>::stop(void)
+{
+  if (!running_.exchange(false)) {
+    return;
+  }
+  for (auto& reactor : reactors_) {
+    const std::uint64_t value = 1;
+    const ssize_t written = ::write(reactor->wake_fd, &value, sizeof(value));
+    (void) written;
+  }
+  for (auto& reactor : reactors_) {
+    reactor->thread.join();
+    closeReactor(*reactor);
+  }
+  reactors_.clear();
+  connections_count_ = 0;
+}
+
+template<typename Cfg>
+inline bool
+EpollServerT<Cfg>::isRunning(void) const
+{
+  return running_;
+}
+
+template<typename Cfg>
+inline std::uint16_t
+EpollServerT<Cfg>::port(void) const
+{
+  return port_;
+}
+
+template<typename Cfg>
+inline std::size_t
+EpollServerT<Cfg>::threadsCount(void) const
+{
+  return threads_count_;
+}
+
+template<typename Cfg>
+inline std::size_t
+EpollServerT<Cfg>::connectionsCount(void) const
+{
+  return connections_count_;
+}
+
+template<typename Cfg>
+inline std::size_t
+EpollServerT<Cfg>::invalidCount(void) const
+{
+  return invalid_count_;
+}
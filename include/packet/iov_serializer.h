@@ -0,0 +1,146 @@
+#ifndef PACKET_IOV_SERIALIZER_H_
+#define PACKET_IOV_SERIALIZER_H_
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cerrno>
+#include <climits>
+#include <algorithm>
+#include <sys/uio.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The IovSerializerT class serializes packets into an iovec array without copying
+ *        the packet contents: only the headers and trailers are written into small
+ *        internal buffers while the content entries point directly to the caller data. The result can be
+ *        sent with a single writev / sendmsg call.
+ *        Several packets can be added to build a batch.
+ * @tparam Cfg  The configuration to be used on the packets
+ * @note the caller data must be kept alive until the iovec array is written
+ * @note the contents are never compressed (they are not copied), any configured
+ *       compression only applies to PacketT::serialize()
+ */
+template<typename Cfg>
+class IovSerializerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using data_len_t = typename PacketType::data_len_t;
+    using message_type_t = typename PacketType::message_type_t;
+
+  public:
+    inline IovSerializerT(void);
+
+    /**
+     * @brief Remove all the packets added so far (keeping the allocated memory)
+     */
+    inline void
+    clear(void);
+
+    /**
+     * @brief Adds a new packet from a single content buffer
+     * @param packet_content  The packet content
+     * @param len             The length of the content
+     * @param type            The message type (ignored if the configuration has none)
+     * @return true on success | false otherwise (same rules than PacketT::serialize)
+     */
+    inline bool
+    add(const byte_t* packet_content,
+        const data_len_t len,
+        const message_type_t type = message_type_t());
+
+    /**
+     * @brief Adds a new packet whose content is the concatenation of several fragments
+     *        (for example an envelope and a body) without concatenating them
+     * @param fragments   The fragments of the content
+     * @param count       The number of fragments
+     * @param type        The message type (ignored if the configuration has none)
+     * @return true on success | false otherwise (same rules than PacketT::serialize)
+     */
+    inline bool
+    add(const struct iovec* fragments,
+        const std::size_t count,
+        const message_type_t type = message_type_t());
+
+    /**
+     * @brief Returns the number of packets added
+     * @return the number of packets added
+     */
+    inline std::size_t
+    packetsCount(void) const;
+
+    /**
+     * @brief Returns the iovec array describing all the packets added
+     * @return the iovec array (check iovCount())
+     */
+    inline const struct iovec*
+    iov(void);
+
+    /**
+     * @brief Returns the number of entries of the iovec array
+     * @return the number of entries of the iovec array
+     */
+    inline std::size_t
+    iovCount(void) const;
+
+    /**
+     * @brief Returns the total number of bytes described by the iovec array
+     * @return the total number of bytes described by the iovec array
+     */
+    inline std::size_t
+    totalBytes(void) const;
+
+    /**
+     * @brief Writes all the packets into a (blocking) file descriptor using writev, taking
+     *        care of partial writes. The serializer is cleared afterwards
+     * @param fd  The file descriptor
+     * @return true on success | false if the write failed
+     */
+    inline bool
+    writeAll(const int fd);
+
+
+  private:
+
+    struct FrameBuffers {
+      std::array<byte_t, PacketType::HEADER_MAX_SIZE> header;
+      std::array<byte_t, PacketType::TRAILER_SIZE> trailer;
+      std::size_t header_entry;
+      std::size_t trailer_entry;
+    };
+
+    inline void
+    addHeader(const data_len_t len, const message_type_t type);
+
+    inline void
+    addEntry(const void* data, const std::size_t len);
+
+    inline void
+    addTrailer(const typename PacketType::checksum_t checksum_value, const data_len_t len);
+
+  private:
+    std::vector<struct iovec> iov_;
+    std::vector<FrameBuffers> frames_;
+    std::size_t total_bytes_;
+};
+
+
+
+#include <packet/iov_serializer_impl.h>
+
+
+// Default definition of the iovec serializer
+using DefaultIovSerializer = IovSerializerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_IOV_SERIALIZER_H_
@@ -0,0 +1,172 @@
+
+
+template<typename Cfg>
+inline void
+IovSerializerT<Cfg>::addHeader(const data_len_t len, const message_type_t type)
+{
+  // the frame buffers may be reallocated, the pointers are resolved on iov()
+  frames_.emplace_back();
+  FrameBuffers& frame = frames_.back();
+  const std::size_t header_size = PacketType::writeHeader(len, frame.header.data(), 0, type);
+  frame.header_entry = iov_.size();
+  addEntry(nullptr, header_size);
+}
+
+template<typename Cfg>
+inline void
+IovSerializerT<Cfg>::addEntry(const void* data, const std::size_t len)
+{
+  struct iovec entry;
+  entry.iov_base = const_cast<void*>(data);
+  entry.iov_len = len;
+  iov_.push_back(entry);
+  total_bytes_ += len;
+}
+
+template<typename Cfg>
+inline void
+IovSerializerT<Cfg>::addTrailer(const typename PacketType::checksum_t checksum_value, const data_len_t len)
+{
+  FrameBuffers& frame = frames_.back();
+  PacketType::writeTrailer(checksum_value, frame.trailer.data());
+  frame.trailer_entry = iov_.size();
+  if (PacketType::TRAILER_SIZE > 0) {
+    addEntry(nullptr, PacketType::TRAILER_SIZE);
+  }
+  PacketType::metrics::onSerialized(PacketType::serializedSize(len));
+}
+
+
+template<typename Cfg>
+inline IovSerializerT<Cfg>::IovSerializerT(void) :
+  total_bytes_(0)
+{}
+
+template<typename Cfg>
+inline void
+IovSerializerT<Cfg>::clear(void)
+{
+  iov_.clear();
+  frames_.clear();
+  total_bytes_ = 0;
+}
+
+template<typename Cfg>
+inline bool
+IovSerializerT<Cfg>::add(const byte_t* packet_content,
+                         const data_len_t len,
+                         const message_type_t type)
+{
+  if (packet_content == nullptr || len == 0 || len > Cfg::MAX_DATA_LEN) {
+    return false;
+  }
+  using checksum = typename PacketType::checksum;
+  addHeader(len, type);
+  addEntry(packet_content, len);
+  addTrailer(checksum::finish(checksum::update(checksum::init(), packet_content, len)), len);
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+IovSerializerT<Cfg>::add(const struct iovec* fragments,
+                         const std::size_t count,
+                         const message_type_t type)
+{
+  if (fragments == nullptr) {
+    return false;
+  }
+  std::size_t len = 0;
+  for (std::size_t i = 0; i < count; ++i) {
+    if (fragments[i].iov_base == nullptr && fragments[i].iov_len > 0) {
+      return false;
+    }
+    len += fragments[i].iov_len;
+  }
+  if (len == 0 || len > Cfg::MAX_DATA_LEN) {
+    return false;
+  }
+
+  using checksum = typename PacketType::checksum;
+  typename PacketType::checksum_t checksum_state = checksum::init();
+  addHeader(data_len_t(len), type);
+  for (std::size_t i = 0; i < count; ++i) {
+    if (fragments[i].iov_len > 0) {
+      addEntry(fragments[i].iov_base, fragments[i].iov_len);
+      checksum_state = checksum::update(checksum_state,
+                                        static_cast<const byte_t*>(fragments[i].iov_base),
+                                        fragments[i].iov_len);
+    }
+  }
+  addTrailer(checksum::finish(checksum_state), data_len_t(len));
+  return true;
+}
+
+template<typename Cfg>
+inline std::size_t
+IovSerializerT<Cfg>::packetsCount(void) const
+{
+  return frames_.size();
+}
+
+template<typename Cfg>
+inline const struct iovec*
+IovSerializerT<Cfg>::iov(void)
+{
+  for (FrameBuffers& frame : frames_) {
+    iov_[frame.header_entry].iov_base = frame.header.data();
+    if (PacketType::TRAILER_SIZE > 0) {
+      iov_[frame.trailer_entry].iov_base = frame.trailer.data();
+    }
+  }
+  return iov_.data();
+}
+
+template<typename Cfg>
+inline std::size_t
+IovSerializerT<Cfg>::iovCount(void) const
+{
+  return iov_.size();
+}
+
+template<typename Cfg>
+inline std::size_t
+IovSerializerT<Cfg>::totalBytes(void) const
+{
+  return total_bytes_;
+}
+
+template<typename Cfg>
+inline bool
+IovSerializerT<Cfg>::writeAll(const int fd)
+{
+  struct iovec* current = const_cast<struct iovec*>(iov());
+  struct iovec* end = current + iov_.size();
+  bool result = true;
+
+  while (current < end) {
+    const int count = int(std::min<std::ptrdiff_t>(end - current, IOV_MAX));
+    const ssize_t written = ::writev(fd, current, count);
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      PKT_LOG_ERROR("writev failed: " << errno);
+      result = false;
+      break;
+    }
+    // skip the entries fully written and adjust the partially written one
+    std::size_t remaining = std::size_t(written);
+    while (current < end && remaining >= current->iov_len) {
+      remaining -= current->iov_len;
+      ++current;
+    }
+    if (current < end) {
+      current->iov_base = static_cast<byte_t*>(current->iov_base) + remaining;
+      current->iov_len -= remaining;
+    }
+  }
+
+  clear();
+  return result;
+}
@@ -0,0 +1,359 @@
+#ifndef PACKET_LATENCY_H_
+#define PACKET_LATENCY_H_
+
+#include <vector>
+#include <array>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <memory>
+#include <chrono>
+#include <cstdint>
+#include <algorithm>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#endif
+
+#include <packet/defs.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief The TscClock class reads the time stamp counter of the cpu (a few cycles, no
+ *        syscall) or the steady clock where there is none. Ticks are converted to
+ *        nanoseconds only when the results are read
+ */
+class TscClock {
+  public:
+
+    /**
+     * @brief Returns the current time in ticks
+     * @return the current time in ticks
+     */
+    static inline std::uint64_t
+    now(void);
+
+    /**
+     * @brief Returns the nanoseconds per tick (measured once against the steady clock)
+     * @return the nanoseconds per tick
+     */
+    static inline double
+    nanosPerTick(void);
+};
+
+/**
+ * @brief Keeps the time a packet started to arrive when the tracing is enabled and takes
+ *        no space (it fits on the padding of PacketT) otherwise
+ */
+template<bool Enabled>
+struct TraceStamp {
+    inline bool isSet(void) const { return true; }
+    inline void set(const std::uint64_t) {}
+    inline void clear(void) {}
+    inline std::uint64_t value(void) const { return 0; }
+};
+
+template<>
+struct TraceStamp<true> {
+    std::uint64_t ticks = 0;
+    inline bool isSet(void) const { return ticks != 0; }
+    inline void set(const std::uint64_t value) { ticks = value; }
+    inline void clear(void) { ticks = 0; }
+    inline std::uint64_t value(void) const { return ticks; }
+};
+
+}
+
+
+/**
+ * @brief The LatencyHistogram class is a lock-free HDR style histogram: the values are
+ *        counted on log-linear buckets (SUB_BUCKETS per power of two, so the error of a
+ *        value is below 1 / SUB_BUCKETS) covering the whole uint64 range. Any number of
+ *        threads can record at the same time
+ */
+class LatencyHistogram {
+  public:
+
+    /**
+     * @brief SUB_BUCKET_BITS defines the precision, 2^SUB_BUCKET_BITS linear buckets per
+     *        power of two
+     */
+    static constexpr const std::size_t SUB_BUCKET_BITS = 5;
+    static constexpr const std::size_t SUB_BUCKETS = std::size_t(1) << SUB_BUCKET_BITS;
+    static constexpr const std::size_t BUCKETS_COUNT = (64 - SUB_BUCKET_BITS + 1) * SUB_BUCKETS;
+
+  public:
+    inline LatencyHistogram();
+
+    // not copyable
+    LatencyHistogram(const LatencyHistogram&) = delete;
+    LatencyHistogram& operator=(const LatencyHistogram&) = delete;
+
+    /**
+     * @brief Counts a value
+     * @param value the value
+     */
+    inline void
+    record(const std::uint64_t value);
+
+    /**
+     * @brief Returns the number of values counted
+     * @return the number of values counted
+     */
+    inline std::uint64_t
+    count(void) const;
+
+    /**
+     * @brief Returns the biggest value counted
+     * @return the biggest value counted
+     */
+    inline std::uint64_t
+    max(void) const;
+
+    /**
+     * @brief Returns the mean of the values counted
+     * @return the mean of the values counted
+     */
+    inline double
+    mean(void) const;
+
+    /**
+     * @brief Returns the value below which a percentage of the values are (the highest
+     *        value of its bucket, never above max())
+     * @param percentile the percentage (0 - 100)
+     * @return the value at the percentile, 0 if nothing was counted
+     */
+    inline std::uint64_t
+    percentile(const double percentile) const;
+
+    /**
+     * @brief Drops all the values (the values recorded meanwhile may be kept)
+     */
+    inline void
+    reset(void);
+
+    /**
+     * @brief Returns the bucket of a value
+     * @param value the value
+     * @return the bucket of the value
+     */
+    static inline std::size_t
+    bucketOf(const std::uint64_t value);
+
+    /**
+     * @brief Returns the highest value of a bucket
+     * @param bucket the bucket
+     * @return the highest value of the bucket
+     */
+    static inline std::uint64_t
+    bucketMax(const std::size_t bucket);
+
+    /**
+     * @brief Adds the values of the histogram into another one
+     * @param total where the values are added
+     */
+    inline void
+    addTo(LatencyHistogram& total) const;
+
+  private:
+    std::array<std::atomic<std::uint64_t>, BUCKETS_COUNT> counts_;
+    std::atomic<std::uint64_t> count_;
+    std::atomic<std::uint64_t> sum_;
+    std::atomic<std::uint64_t> max_;
+};
+
+
+namespace detail {
+
+struct ThreadLatency;
+
+/**
+ * @brief The histograms of a tracing group (check LatencyTracing): the ones of the threads
+ *        recording on it and the totals of the threads that already finished
+ */
+struct LatencyGroup {
+    const char* name = nullptr;
+    std::mutex mutex;
+    std::vector<ThreadLatency*> threads;
+    LatencyHistogram assembly;
+    LatencyHistogram handoff;
+};
+
+/**
+ * @brief The histograms of one thread on a group. Only the owner thread records on them,
+ *        so the threads do not share cache lines on the hot path
+ */
+struct ThreadLatency {
+    // from the first byte of a packet to COMPLETE
+    LatencyHistogram assembly;
+    // from serializing a packet to handing it off (written / queued)
+    LatencyHistogram handoff;
+
+    inline explicit ThreadLatency(LatencyGroup& group);
+    inline ~ThreadLatency();
+
+    // not copyable, the group keeps its address
+    ThreadLatency(const ThreadLatency&) = delete;
+    ThreadLatency& operator=(const ThreadLatency&) = delete;
+
+  private:
+    LatencyGroup& group_;
+};
+
+}
+
+
+/**
+ * @brief The percentiles of one histogram of a group, in nanoseconds
+ */
+struct LatencyReport {
+    std::string group;
+    // "assembly" (first byte to COMPLETE) or "handoff" (serialize to handoff)
+    std::string kind;
+    std::uint64_t count;
+    double mean_ns;
+    double p50_ns;
+    double p90_ns;
+    double p99_ns;
+    double p999_ns;
+    double max_ns;
+};
+
+/**
+ * @brief The Latency class merges the histograms of all the tracing groups and threads
+ *        (check LatencyTracing): each thread records on its own histograms of the group
+ *        and report() adds them (plus the ones of the threads that already finished)
+ */
+class Latency {
+  public:
+
+    /**
+     * @brief Returns the percentiles of all the groups (the histograms without values are
+     *        skipped)
+     * @return the percentiles of all the groups
+     */
+    static inline std::vector<LatencyReport>
+    report(void);
+
+    /**
+     * @brief Drops the values of all the groups
+     */
+    static inline void
+    reset(void);
+
+    /**
+     * @brief Registers a group (done once per group by LatencyTracing)
+     * @param group the group
+     */
+    static inline void
+    add(detail::LatencyGroup& group);
+
+
+  private:
+
+    struct Registry {
+      std::mutex mutex;
+      std::vector<detail::LatencyGroup*> groups;
+    };
+
+    static inline Registry&
+    registry(void);
+
+    static inline void
+    addReport(std::vector<LatencyReport>& reports,
+              const char* group,
+              const char* kind,
+              const LatencyHistogram& histogram);
+};
+
+
+/**
+ * @brief The NoTracing is the default tracing policy: nothing is timed and the hooks
+ *        compile to nothing
+ */
+struct NoTracing {
+    static constexpr const bool ENABLED = false;
+
+    static inline std::uint64_t now(void) { return 0; }
+    static inline void recordAssembly(const std::uint64_t) {}
+    static inline void recordHandoff(const std::uint64_t) {}
+};
+
+/**
+ * @brief The LatencyTracing policy times the packets with the TscClock into the per
+ *        thread histograms of a group, so different parsers (for example one per kind of peer)
+ *        get their own percentiles. Enable it on a configuration with
+ *        `using tracing = LatencyTracing<MyGroup>;` where MyGroup has a
+ *        `static constexpr const char* NAME`. Check Latency::report()
+ * @tparam GroupTag The group
+ */
+template<typename GroupTag>
+struct LatencyTracing {
+    static constexpr const bool ENABLED = true;
+
+    static inline std::uint64_t
+    now(void)
+    {
+      return detail::TscClock::now();
+    }
+
+    /**
+     * @brief Counts the time (in ticks) a packet took to be assembled
+     */
+    static inline void
+    recordAssembly(const std::uint64_t ticks)
+    {
+      local().assembly.record(ticks);
+    }
+
+    /**
+     * @brief Counts the time (in ticks) from serializing a packet to handing it off
+     */
+    static inline void
+    recordHandoff(const std::uint64_t ticks)
+    {
+      local().handoff.record(ticks);
+    }
+
+    static inline detail::LatencyGroup&
+    group(void)
+    {
+      static detail::LatencyGroup& instance = create();
+      return instance;
+    }
+
+    /**
+     * @brief Returns the histograms of the current thread on the group
+     * @return the histograms of the current thread on the group
+     */
+    static inline detail::ThreadLatency&
+    local(void)
+    {
+      static thread_local detail::ThreadLatency latency(group());
+      return latency;
+    }
+
+  private:
+
+    static inline detail::LatencyGroup&
+    create(void)
+    {
+      // never destroyed, the histograms of the threads still running when the program
+      // exits unregister from it
+      detail::LatencyGroup* group = new detail::LatencyGroup();
+      group->name = GroupTag::NAME;
+      Latency::add(*group);
+      return *group;
+    }
+};
+
+
+#include <packet/latency_impl.h>
+}
+
+#endif // PACKET_LATENCY_H_
@@ -0,0 +1,252 @@
+
+
+
+namespace detail {
+
+inline std::uint64_t
+TscClock::now(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  return __rdtsc();
+#elif defined(__aarch64__)
+  std::uint64_t ticks;
+  asm volatile("mrs %0, cntvct_el0" : "=r"(ticks));
+  return ticks;
+#else
+  return std::uint64_t(std::chrono::duration_cast<std::chrono::nanoseconds>(
+      std::chrono::steady_clock::now().time_since_epoch()).count());
+#endif
+}
+
+inline double
+TscClock::nanosPerTick(void)
+{
+  static const double nanos_per_tick = []() {
+    using Clock = std::chrono::steady_clock;
+    const Clock::time_point start = Clock::now();
+    const std::uint64_t start_ticks = now();
+    while (Clock::now() - start < std::chrono::milliseconds(10)) {}
+    const std::uint64_t ticks = now() - start_ticks;
+    const double nanos = double(std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() - start).count());
+    return ticks > 0 ? nanos / double(ticks) : 1.0;
+  }();
+  return nanos_per_tick;
+}
+
+}
+
+
+inline LatencyHistogram::LatencyHistogram() :
+  count_(0)
+, sum_(0)
+, max_(0)
+{
+  for (std::atomic<std::uint64_t>& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+}
+
+inline void
+LatencyHistogram::record(const std::uint64_t value)
+{
+  counts_[bucketOf(value)].fetch_add(1, std::memory_order_relaxed);
+  count_.fetch_add(1, std::memory_order_relaxed);
+  sum_.fetch_add(value, std::memory_order_relaxed);
+  std::uint64_t current = max_.load(std::memory_order_relaxed);
+  while (value > current && !max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+inline std::uint64_t
+LatencyHistogram::count(void) const
+{
+  return count_.load(std::memory_order_relaxed);
+}
+
+inline std::uint64_t
+LatencyHistogram::max(void) const
+{
+  return max_.load(std::memory_order_relaxed);
+}
+
+inline double
+LatencyHistogram::mean(void) const
+{
+  const std::uint64_t values = count();
+  return values == 0 ? 0.0 : double(sum_.load(std::memory_order_relaxed)) / double(values);
+}
+
+inline std::uint64_t
+LatencyHistogram::percentile(const double percentile) const
+{
+  // the buckets are read once, the total is theirs so it is consistent with them
+  std::array<std::uint64_t, BUCKETS_COUNT> counts;
+  std::uint64_t total = 0;
+  for (std::size_t i = 0; i < BUCKETS_COUNT; ++i) {
+    counts[i] = counts_[i].load(std::memory_order_relaxed);
+    total += counts[i];
+  }
+  if (total == 0) {
+    return 0;
+  }
+  const double clamped = std::min(std::max(percentile, 0.0), 100.0);
+  const std::uint64_t rank = std::max(std::uint64_t(1), std::uint64_t(clamped / 100.0 * double(total) + 0.5));
+  std::uint64_t seen = 0;
+  for (std::size_t i = 0; i < BUCKETS_COUNT; ++i) {
+    seen += counts[i];
+    if (seen >= rank) {
+      return std::min(bucketMax(i), max());
+    }
+  }
+  return max();
+}
+
+inline void
+LatencyHistogram::reset(void)
+{
+  for (std::atomic<std::uint64_t>& count : counts_) {
+    count.store(0, std::memory_order_relaxed);
+  }
+  count_.store(0, std::memory_order_relaxed);
+  sum_.store(0, std::memory_order_relaxed);
+  max_.store(0, std::memory_order_relaxed);
+}
+
+inline std::size_t
+LatencyHistogram::bucketOf(const std::uint64_t value)
+{
+  // values below 2 * SUB_BUCKETS have their own bucket, then SUB_BUCKETS per power of two
+  if (value < 2 * SUB_BUCKETS) {
+    return std::size_t(value);
+  }
+  const std::size_t msb = 63 - std::size_t(__builtin_clzll(value));
+  const std::size_t shift = msb - SUB_BUCKET_BITS;
+  return shift * SUB_BUCKETS + std::size_t(value >> shift);
+}
+
+inline std::uint64_t
+LatencyHistogram::bucketMax(const std::size_t bucket)
+{
+  if (bucket < 2 * SUB_BUCKETS) {
+    return bucket;
+  }
+  const std::size_t shift = bucket / SUB_BUCKETS - 1;
+  const std::uint64_t top = std::uint64_t(bucket % SUB_BUCKETS + SUB_BUCKETS);
+  return ((top + 1) << shift) - 1;
+}
+
+inline void
+LatencyHistogram::addTo(LatencyHistogram& total) const
+{
+  for (std::size_t i = 0; i < BUCKETS_COUNT; ++i) {
+    const std::uint64_t bucket_count = counts_[i].load(std::memory_order_relaxed);
+    if (bucket_count > 0) {
+      total.counts_[i].fetch_add(bucket_count, std::memory_order_relaxed);
+    }
+  }
+  total.count_.fetch_add(count_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  total.sum_.fetch_add(sum_.load(std::memory_order_relaxed), std::memory_order_relaxed);
+  const std::uint64_t value = max_.load(std::memory_order_relaxed);
+  std::uint64_t current = total.max_.load(std::memory_order_relaxed);
+  while (value > current && !total.max_.compare_exchange_weak(current, value, std::memory_order_relaxed)) {}
+}
+
+
+namespace detail {
+
+inline ThreadLatency::ThreadLatency(LatencyGroup& group) :
+  group_(group)
+{
+  std::lock_guard<std::mutex> lock(group_.mutex);
+  group_.threads.push_back(this);
+}
+
+inline ThreadLatency::~ThreadLatency()
+{
+  // the values of the thread are kept on the totals of the group
+  std::lock_guard<std::mutex> lock(group_.mutex);
+  assembly.addTo(group_.assembly);
+  handoff.addTo(group_.handoff);
+  group_.threads.erase(std::find(group_.threads.begin(), group_.threads.end(), this));
+}
+
+}
+
+
+inline Latency::Registry&
+Latency::registry(void)
+{
+  static Registry registry;
+  return registry;
+}
+
+inline void
+Latency::addReport(std::vector<LatencyReport>& reports,
+                   const char* group,
+                   const char* kind,
+                   const LatencyHistogram& histogram)
+{
+  if (histogram.count() == 0) {
+    return;
+  }
+  const double nanos_per_tick = detail::TscClock::nanosPerTick();
+  LatencyReport report;
+  report.group = group;
+  report.kind = kind;
+  report.count = histogram.count();
+  report.mean_ns = histogram.mean() * nanos_per_tick;
+  report.p50_ns = double(histogram.percentile(50.0)) * nanos_per_tick;
+  report.p90_ns = double(histogram.percentile(90.0)) * nanos_per_tick;
+  report.p99_ns = double(histogram.percentile(99.0)) * nanos_per_tick;
+  report.p999_ns = double(histogram.percentile(99.9)) * nanos_per_tick;
+  report.max_ns = double(histogram.max()) * nanos_per_tick;
+  reports.push_back(report);
+}
+
+inline std::vector<LatencyReport>
+Latency::report(void)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::vector<LatencyReport> reports;
+  for (detail::LatencyGroup* group : reg.groups) {
+    // big enough to be kept off the stack
+    std::unique_ptr<LatencyHistogram> assembly(new LatencyHistogram());
+    std::unique_ptr<LatencyHistogram> handoff(new LatencyHistogram());
+    {
+      std::lock_guard<std::mutex> group_lock(group->mutex);
+      group->assembly.addTo(*assembly);
+      group->handoff.addTo(*handoff);
+      for (const detail::ThreadLatency* thread : group->threads) {
+        thread->assembly.addTo(*assembly);
+        thread->handoff.addTo(*handoff);
+      }
+    }
+    addReport(reports, group->name, "assembly", *assembly);
+    addReport(reports, group->name, "handoff", *handoff);
+  }
+  return reports;
+}
+
+inline void
+Latency::reset(void)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  for (detail::LatencyGroup* group : reg.groups) {
+    std::lock_guard<std::mutex> group_lock(group->mutex);
+    group->assembly.reset();
+    group->handoff.reset();
+    for (detail::ThreadLatency* thread : group->threads) {
+      thread->assembly.reset();
+      thread->handoff.reset();
+    }
+  }
+}
+
+inline void
+Latency::add(detail::LatencyGroup& group)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.groups.push_back(&group);
+}
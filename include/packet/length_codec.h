@@ -0,0 +1,168 @@
+#ifndef PACKET_LENGTH_CODEC_H_
+#define PACKET_LENGTH_CODEC_H_
+
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include <packet/defs.h>
+
+
+namespace packet {
+
+/**
+ * @brief Length codecs define how the data length field of a packet is written on the
+ *        wire. All of them provide the same static interface:
+ *        - value_type: the (unsigned) length type
+ *        - MIN_SIZE / MAX_SIZE: the min / max number of bytes of an encoded length
+ *        - MAX_VALUE: the maximum length that can be encoded
+ *        - encodedSize(value): the number of bytes needed to encode value
+ *        - encode(value, out): writes value into out (MAX_SIZE bytes available) and
+ *          returns the number of bytes written
+ *        - decode(data, len, value, size): reads a length from data returning COMPLETE
+ *          (value and size, the bytes used, are set), INCOMPLETE (size is the minimum
+ *          number of bytes needed) or INVALID
+ */
+
+
+/**
+ * @brief Fixed width length codec
+ * @tparam T      The length type
+ * @tparam E      The byte order on the wire
+ * @tparam WIDTH  The number of bytes on the wire (1, 2, 4 or 8)
+ */
+template<typename T, Endian E, std::size_t WIDTH>
+struct FixedLengthCodec {
+    static_assert(std::is_unsigned<T>::value, "The length type must be unsigned");
+    static_assert(WIDTH == 1 || WIDTH == 2 || WIDTH == 4 || WIDTH == 8, "Invalid length width");
+    static_assert(WIDTH <= sizeof(std::uint64_t), "Invalid length width");
+
+    using value_type = T;
+
+    static constexpr const std::size_t MIN_SIZE = WIDTH;
+    static constexpr const std::size_t MAX_SIZE = WIDTH;
+    static constexpr const std::uint64_t MAX_VALUE =
+        std::min<std::uint64_t>(std::numeric_limits<T>::max(),
+                                WIDTH == 8 ? std::numeric_limits<std::uint64_t>::max() :
+                                             (std::uint64_t(1) << (WIDTH * 8 % 64)) - 1);
+
+    static inline std::size_t
+    encodedSize(const T)
+    {
+      return WIDTH;
+    }
+
+    static inline std::size_t
+    encode(const T value, byte_t* out)
+    {
+      const std::uint64_t wide_value = value;
+      for (std::size_t i = 0; i < WIDTH; ++i) {
+        out[byteIndex(i)] = byte_t(wide_value >> (8 * i));
+      }
+      return WIDTH;
+    }
+
+    static inline Status
+    decode(const byte_t* data, const std::size_t len, T& value, std::size_t& size)
+    {
+      size = WIDTH;
+      if (len < WIDTH) {
+        return Status::INCOMPLETE;
+      }
+      std::uint64_t wide_value = 0;
+      for (std::size_t i = 0; i < WIDTH; ++i) {
+        wide_value |= std::uint64_t(data[byteIndex(i)]) << (8 * i);
+      }
+      if (wide_value > MAX_VALUE) {
+        return Status::INVALID;
+      }
+      value = T(wide_value);
+      return Status::COMPLETE;
+    }
+
+  private:
+    // index of the i-th least significant byte on the wire
+    static constexpr std::size_t
+    byteIndex(const std::size_t i)
+    {
+      return E == Endian::BIG ? WIDTH - 1 - i : i;
+    }
+};
+
+template<typename T, std::size_t WIDTH = sizeof(T)>
+using BigEndianLength = FixedLengthCodec<T, Endian::BIG, WIDTH>;
+
+template<typename T, std::size_t WIDTH = sizeof(T)>
+using LittleEndianLength = FixedLengthCodec<T, Endian::LITTLE, WIDTH>;
+
+
+/**
+ * @brief Variable width (LEB128 style) length codec: 7 bits per byte, least significant
+ *        group first, the high bit set on every byte but the last one. Small lengths use
+ *        a single byte
+ * @tparam T  The length type
+ */
+template<typename T>
+struct VarintLengthCodec {
+    static_assert(std::is_unsigned<T>::value, "The length type must be unsigned");
+
+    using value_type = T;
+
+    static constexpr const std::size_t MIN_SIZE = 1;
+    static constexpr const std::size_t MAX_SIZE = (sizeof(T) * 8 + 6) / 7;
+    static constexpr const std::uint64_t MAX_VALUE = std::numeric_limits<T>::max();
+
+    static inline std::size_t
+    encodedSize(T value)
+    {
+      std::size_t size = 1;
+      while (value >= 0x80) {
+        value >>= 7;
+        ++size;
+      }
+      return size;
+    }
+
+    static inline std::size_t
+    encode(T value, byte_t* out)
+    {
+      std::size_t size = 0;
+      while (value >= 0x80) {
+        out[size++] = byte_t(value | 0x80);
+        value >>= 7;
+      }
+      out[size++] = byte_t(value);
+      return size;
+    }
+
+    static inline Status
+    decode(const byte_t* data, const std::size_t len, T& value, std::size_t& size)
+    {
+      std::uint64_t wide_value = 0;
+      const std::size_t available = std::min(len, std::size_t(MAX_SIZE));
+      for (std::size_t i = 0; i < available; ++i) {
+        const std::uint64_t group = data[i] & 0x7f;
+        const std::size_t shift = 7 * i;
+        // the last group can not have more bits than what is left on the type
+        if (shift > 0 && (group >> (sizeof(T) * 8 - shift)) != 0) {
+          return Status::INVALID;
+        }
+        wide_value |= group << shift;
+        if ((data[i] & 0x80) == 0) {
+          value = T(wide_value);
+          size = i + 1;
+          return Status::COMPLETE;
+        }
+      }
+      if (available == MAX_SIZE) {
+        return Status::INVALID;
+      }
+      size = len + 1;
+      return Status::INCOMPLETE;
+    }
+};
+
+}
+
+#endif // PACKET_LENGTH_CODEC_H_
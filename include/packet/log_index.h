@@ -0,0 +1,247 @@
+#ifndef PACKET_LOG_INDEX_H_
+#define PACKET_LOG_INDEX_H_
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+/**
+ * @brief The header of an index file. It is followed by entries_count uint64 offsets (host
+ *        byte order): the offsets on the log of the packets 0, stride, 2 * stride, ...
+ */
+struct LogIndexHeader {
+    std::uint64_t magic;
+    std::uint32_t version;
+    std::uint32_t stride;
+    // the packets / bytes of the log covered by the index (the log can grow later)
+    std::uint64_t packets_count;
+    std::uint64_t covered_size;
+    std::uint64_t entries_count;
+    // identifies the framing configuration the log was written with
+    std::uint64_t fingerprint;
+    // identify the log itself (see fileId() / framesHash()), so the index of a log that
+    // was replaced by another one is not used
+    std::uint64_t file_id;
+    std::uint64_t frames_hash;
+    // the offset of the last packet covered
+    std::uint64_t last_offset;
+    std::uint64_t reserved[3];
+};
+
+static_assert(sizeof(LogIndexHeader) == 96, "the index header must be 96 bytes");
+
+
+/**
+ * @brief The LogIndex class is the offset index of a log of packets (a concatenation of
+ *        serialized packets), shared by the log readers and writers. Every stride packets
+ *        the offset of the packet is stored, so a packet is found with one lookup plus
+ *        at most stride - 1 frame skips (stride 1 gives O(1) access).
+ *        Loaded indexes are memory mapped (they are not read upfront) and copied only
+ *        if entries are added.
+ */
+class LogIndex {
+  public:
+
+    /**
+     * @brief MAGIC / VERSION identify the index file format
+     */
+    static constexpr const std::uint64_t MAGIC = 0x3130584449544B50ULL;  // "PKTIDX01"
+    static constexpr const std::uint32_t VERSION = 2;
+
+    /**
+     * @brief IDENTITY_BYTES is the number of bytes of the first and last covered packets
+     *                       hashed by framesHash()
+     */
+    static constexpr const std::size_t IDENTITY_BYTES = 32;
+
+  public:
+    inline LogIndex();
+    inline ~LogIndex();
+
+    // not copyable
+    LogIndex(const LogIndex&) = delete;
+    LogIndex& operator=(const LogIndex&) = delete;
+
+    /**
+     * @brief Drops all the entries and starts a new index
+     * @param stride      The distance (in packets) between entries
+     * @param fingerprint The fingerprint of the framing configuration (see fingerprint())
+     */
+    inline void
+    reset(const std::uint32_t stride, const std::uint64_t fingerprint);
+
+    /**
+     * @brief Loads an index file
+     * @param path        The index file
+     * @param fingerprint The expected fingerprint
+     * @return true on success | false if it does not exist or is not a valid index for
+     *         this configuration
+     */
+    inline bool
+    load(const std::string& path, const std::uint64_t fingerprint);
+
+    /**
+     * @brief Writes the index file (into a temporary file renamed over path, so a reader
+     *        never sees a partial index)
+     * @param path the index file
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    save(const std::string& path) const;
+
+    /**
+     * @brief Adds the entry of the next indexed packet (packet entriesCount() * stride)
+     * @param offset the offset of the packet on the log
+     */
+    inline void
+    addEntry(const std::uint64_t offset);
+
+    /**
+     * @brief Sets how much of the log is covered by the index
+     * @param packets_count The number of packets covered
+     * @param covered_size  The bytes of the log covered
+     * @param last_offset   The offset of the last packet covered (0 if there is none)
+     */
+    inline void
+    setCoverage(const std::uint64_t packets_count,
+                const std::uint64_t covered_size,
+                const std::uint64_t last_offset);
+
+    /**
+     * @brief Sets the identity of the log the index describes
+     * @param file_id     The id of the log file (see fileId())
+     * @param frames_hash The hash of its first and last covered packets (see framesHash())
+     */
+    inline void
+    setIdentity(const std::uint64_t file_id, const std::uint64_t frames_hash);
+
+    /**
+     * @brief Returns the distance (in packets) between entries
+     * @return the distance (in packets) between entries
+     */
+    inline std::uint32_t
+    stride(void) const;
+
+    /**
+     * @brief Returns the number of packets covered by the index
+     * @return the number of packets covered by the index
+     */
+    inline std::uint64_t
+    packetsCount(void) const;
+
+    /**
+     * @brief Returns the bytes of the log covered by the index
+     * @return the bytes of the log covered by the index
+     */
+    inline std::uint64_t
+    coveredSize(void) const;
+
+    /**
+     * @brief Returns the offset of the last packet covered by the index
+     * @return the offset of the last packet covered by the index
+     */
+    inline std::uint64_t
+    lastOffset(void) const;
+
+    /**
+     * @brief Returns the id of the log file the index was written for
+     * @return the id of the log file the index was written for
+     */
+    inline std::uint64_t
+    fileId(void) const;
+
+    /**
+     * @brief Returns the hash of the first and last packets covered by the index
+     * @return the hash of the first and last packets covered by the index
+     */
+    inline std::uint64_t
+    framesHash(void) const;
+
+    /**
+     * @brief Returns the number of entries
+     * @return the number of entries
+     */
+    inline std::size_t
+    entriesCount(void) const;
+
+    /**
+     * @brief Returns the offset of the packet index * stride
+     * @param index the entry
+     * @return the offset of the packet index * stride
+     */
+    inline std::uint64_t
+    entry(const std::size_t index) const;
+
+    /**
+     * @brief Returns the fingerprint of a framing configuration: logs written with a
+     *        different head / tail / length / flags / checksum layout get another one
+     * @return the fingerprint of the configuration
+     */
+    template<typename Cfg>
+    static inline std::uint64_t
+    fingerprint(void);
+
+    /**
+     * @brief Returns the id of a log file (its device and inode)
+     * @param file_stat the stat of the log file
+     * @return the id of the log file
+     */
+    static inline std::uint64_t
+    fileId(const struct stat& file_stat);
+
+    /**
+     * @brief Returns the hash of the first IDENTITY_BYTES (at most) of the first and last
+     *        packets covered by an index. Appending to a log keeps them, replacing its
+     *        content does not
+     * @param first     The first packet
+     * @param first_len The bytes of the first packet to hash (<= IDENTITY_BYTES)
+     * @param last      The last packet
+     * @param last_len  The bytes of the last packet to hash (<= IDENTITY_BYTES)
+     * @return the hash of the packets
+     */
+    static inline std::uint64_t
+    framesHash(const byte_t* first,
+               const std::size_t first_len,
+               const byte_t* last,
+               const std::size_t last_len);
+
+
+  private:
+
+    inline void
+    unmap(void);
+
+    // FNV-1a
+    static inline std::uint64_t
+    hashBytes(std::uint64_t hash, const void* data, const std::size_t len);
+
+  private:
+    LogIndexHeader header_;
+    std::vector<std::uint64_t> entries_;
+    // the entries of a loaded index, until one is added
+    const std::uint64_t* mapped_entries_;
+    void* mapping_;
+    std::size_t mapping_size_;
+};
+
+
+
+#include <packet/log_index_impl.h>
+
+}
+
+#endif // PACKET_LOG_INDEX_H_
@@ -0,0 +1,242 @@
+
+
+
+inline void
+LogIndex::unmap(void)
+{
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+    mapping_size_ = 0;
+  }
+  mapped_entries_ = nullptr;
+}
+
+inline std::uint64_t
+LogIndex::hashBytes(std::uint64_t hash, const void* data, const std::size_t len)
+{
+  const byte_t* bytes = static_cast<const byte_t*>(data);
+  for (std::size_t i = 0; i < len; ++i) {
+    hash = (hash ^ bytes[i]) * 0x100000001b3ULL;
+  }
+  return hash;
+}
+
+
+inline LogIndex::LogIndex() :
+  mapped_entries_(nullptr)
+, mapping_(nullptr)
+, mapping_size_(0)
+{
+  reset(1, 0);
+}
+
+inline LogIndex::~LogIndex()
+{
+  unmap();
+}
+
+inline void
+LogIndex::reset(const std::uint32_t stride, const std::uint64_t fingerprint)
+{
+  PKT_ASSERT(stride > 0);
+  unmap();
+  entries_.clear();
+  std::memset(&header_, 0, sizeof(header_));
+  header_.magic = MAGIC;
+  header_.version = VERSION;
+  header_.stride = stride;
+  header_.fingerprint = fingerprint;
+}
+
+inline bool
+LogIndex::load(const std::string& path, const std::uint64_t fingerprint)
+{
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  LogIndexHeader header;
+  struct stat file_stat;
+  const bool valid = ::pread(fd, &header, sizeof(header), 0) == ssize_t(sizeof(header)) &&
+                     header.magic == MAGIC &&
+                     header.version == VERSION &&
+                     header.stride > 0 &&
+                     header.fingerprint == fingerprint &&
+                     header.entries_count == (header.packets_count + header.stride - 1) / header.stride &&
+                     ::fstat(fd, &file_stat) == 0 &&
+                     std::uint64_t(file_stat.st_size) >= sizeof(header) + header.entries_count * sizeof(std::uint64_t);
+  if (!valid) {
+    ::close(fd);
+    return false;
+  }
+  reset(header.stride, fingerprint);
+  if (header.entries_count > 0) {
+    mapping_size_ = sizeof(header) + std::size_t(header.entries_count) * sizeof(std::uint64_t);
+    mapping_ = ::mmap(nullptr, mapping_size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping_ == MAP_FAILED) {
+      mapping_ = nullptr;
+      ::close(fd);
+      return false;
+    }
+    mapped_entries_ = reinterpret_cast<const std::uint64_t*>(static_cast<const byte_t*>(mapping_) + sizeof(header));
+  }
+  ::close(fd);
+  header_ = header;
+  return true;
+}
+
+inline bool
+LogIndex::save(const std::string& path) const
+{
+  const std::string tmp_path = path + ".tmp";
+  const int fd = ::open(tmp_path.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  const byte_t* entries = reinterpret_cast<const byte_t*>(mapped_entries_ != nullptr ? mapped_entries_ : entries_.data());
+  const std::size_t entries_size = entriesCount() * sizeof(std::uint64_t);
+  bool ok = ::write(fd, &header_, sizeof(header_)) == ssize_t(sizeof(header_));
+  for (std::size_t offset = 0; ok && offset < entries_size;) {
+    const ssize_t written = ::write(fd, entries + offset, entries_size - offset);
+    ok = written > 0;
+    offset += ok ? std::size_t(written) : 0;
+  }
+  ok = ::close(fd) == 0 && ok;
+  if (!ok || ::rename(tmp_path.c_str(), path.c_str()) != 0) {
+    const int error = errno;
+    ::unlink(tmp_path.c_str());
+    errno = error;
+    return false;
+  }
+  return true;
+}
+
+inline void
+LogIndex::addEntry(const std::uint64_t offset)
+{
+  if (mapped_entries_ != nullptr) {
+    // copy on write of the loaded entries
+    entries_.assign(mapped_entries_, mapped_entries_ + header_.entries_count);
+    unmap();
+  }
+  entries_.push_back(offset);
+  header_.entries_count = entries_.size();
+}
+
+inline void
+LogIndex::setCoverage(const std::uint64_t packets_count,
+                      const std::uint64_t covered_size,
+                      const std::uint64_t last_offset)
+{
+  PKT_ASSERT(header_.entries_count == (packets_count + header_.stride - 1) / header_.stride);
+  PKT_ASSERT(last_offset < covered_size || packets_count == 0);
+  header_.packets_count = packets_count;
+  header_.covered_size = covered_size;
+  header_.last_offset = last_offset;
+}
+
+inline void
+LogIndex::setIdentity(const std::uint64_t file_id, const std::uint64_t frames_hash)
+{
+  header_.file_id = file_id;
+  header_.frames_hash = frames_hash;
+}
+
+inline std::uint32_t
+LogIndex::stride(void) const
+{
+  return header_.stride;
+}
+
+inline std::uint64_t
+LogIndex::packetsCount(void) const
+{
+  return header_.packets_count;
+}
+
+inline std::uint64_t
+LogIndex::coveredSize(void) const
+{
+  return header_.covered_size;
+}
+
+inline std::uint64_t
+LogIndex::lastOffset(void) const
+{
+  return header_.last_offset;
+}
+
+inline std::uint64_t
+LogIndex::fileId(void) const
+{
+  return header_.file_id;
+}
+
+inline std::uint64_t
+LogIndex::framesHash(void) const
+{
+  return header_.frames_hash;
+}
+
+inline std::size_t
+LogIndex::entriesCount(void) const
+{
+  return std::size_t(header_.entries_count);
+}
+
+inline std::uint64_t
+LogIndex::entry(const std::size_t index) const
+{
+  PKT_ASSERT(index < entriesCount());
+  return mapped_entries_ != nullptr ? mapped_entries_[index] : entries_[index];
+}
+
+template<typename Cfg>
+inline std::uint64_t
+LogIndex::fingerprint(void)
+{
+  using PacketType = PacketT<Cfg>;
+  // FNV-1a of the patterns and the sizes of the variable parts of the layout
+  std::uint64_t hash = 0xcbf29ce484222325ULL;
+  const auto mix = [&hash](const void* data, const std::size_t len) {
+    hash = hashBytes(hash, data, len);
+  };
+  const std::uint64_t sizes[] = {
+    std::uint64_t(PacketType::HEAD_PATTERN_SIZE),
+    std::uint64_t(PacketType::TAIL_PATTERN_SIZE),
+    std::uint64_t(Cfg::length_codec::MIN_SIZE),
+    std::uint64_t(Cfg::length_codec::MAX_SIZE),
+    std::uint64_t(PacketType::FLAGS_SIZE),
+    std::uint64_t(PacketType::CHECKSUM_SIZE),
+  };
+  mix(sizes, sizeof(sizes));
+  if (PacketType::TYPE_SIZE > 0) {
+    // only mixed when present, so the fingerprints of untyped layouts do not change
+    const std::uint64_t type_size = PacketType::TYPE_SIZE;
+    mix(&type_size, sizeof(type_size));
+  }
+  mix(Cfg::HEAD_PATTERN, std::size_t(PacketType::HEAD_PATTERN_SIZE));
+  mix(Cfg::TAIL_PATTERN, std::size_t(PacketType::TAIL_PATTERN_SIZE));
+  return hash;
+}
+
+inline std::uint64_t
+LogIndex::fileId(const struct stat& file_stat)
+{
+  const std::uint64_t ids[] = {std::uint64_t(file_stat.st_dev), std::uint64_t(file_stat.st_ino)};
+  return hashBytes(0xcbf29ce484222325ULL, ids, sizeof(ids));
+}
+
+inline std::uint64_t
+LogIndex::framesHash(const byte_t* first,
+                     const std::size_t first_len,
+                     const byte_t* last,
+                     const std::size_t last_len)
+{
+  PKT_ASSERT(first_len <= IDENTITY_BYTES && last_len <= IDENTITY_BYTES);
+  const std::uint64_t lens[] = {std::uint64_t(first_len), std::uint64_t(last_len)};
+  std::uint64_t hash = hashBytes(0xcbf29ce484222325ULL, lens, sizeof(lens));
+  hash = hashBytes(hash, first, first_len);
+  return hashBytes(hash, last, last_len);
+}
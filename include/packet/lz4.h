@@ -0,0 +1,263 @@
+#ifndef PACKET_LZ4_H_
+#define PACKET_LZ4_H_
+
+#include <cstdint>
+#include <cstring>
+#include <array>
+
+#include <packet/defs.h>
+
+
+namespace packet {
+
+/**
+ * @brief Self contained implementation of the LZ4 block format (greedy compressor with a
+ *        small hash table and a bounds checked decompressor). The output is compatible
+ *        with any LZ4 block decoder.
+ */
+namespace lz4 {
+
+namespace detail {
+
+static constexpr const std::size_t MIN_MATCH = 4;
+// the last match must start at least MFLIMIT bytes before the end of the input
+static constexpr const std::size_t MFLIMIT = 12;
+// the last LAST_LITERALS bytes are always literals
+static constexpr const std::size_t LAST_LITERALS = 5;
+static constexpr const std::size_t MAX_OFFSET = 65535;
+static constexpr const std::size_t HASH_LOG = 12;
+static constexpr const unsigned SKIP_TRIGGER = 6;
+
+inline std::uint32_t
+read32(const byte_t* ptr)
+{
+  std::uint32_t value;
+  std::memcpy(&value, ptr, sizeof(value));
+  return value;
+}
+
+inline std::uint32_t
+hash(const std::uint32_t sequence)
+{
+  return (sequence * 2654435761u) >> (32 - HASH_LOG);
+}
+
+inline byte_t*
+writeLength(byte_t* op, std::size_t len)
+{
+  while (len >= 255) {
+    *op++ = 255;
+    len -= 255;
+  }
+  *op++ = byte_t(len);
+  return op;
+}
+
+// the worst case size of a sequence with the given literals (token, lengths, offset)
+inline std::size_t
+sequenceBound(const std::size_t literals)
+{
+  return 1 + literals + (literals / 255) + 1 + 2 + 1;
+}
+
+}
+
+/**
+ * @brief Returns the maximum compressed size of an input of len bytes
+ * @param len the length of the input
+ * @return the maximum compressed size
+ */
+inline std::size_t
+compressBound(const std::size_t len)
+{
+  return len + (len / 255) + 16;
+}
+
+/**
+ * @brief Returns the maximum decompressed size of a block of len bytes (every input byte
+ *        expands at most to 255 output bytes)
+ * @param len the length of the compressed block
+ * @return the maximum decompressed size
+ */
+inline std::size_t
+decompressBound(const std::size_t len)
+{
+  return len * 255;
+}
+
+/**
+ * @brief Compresses a buffer using the LZ4 block format
+ * @param src           The input
+ * @param len           The length of the input
+ * @param dst           The output buffer
+ * @param dst_capacity  The capacity of the output buffer
+ * @return the number of bytes written or 0 if the output does not fit in dst_capacity
+ */
+inline std::size_t
+compress(const byte_t* src, const std::size_t len, byte_t* dst, const std::size_t dst_capacity)
+{
+  using namespace detail;
+
+  std::array<std::uint32_t, std::size_t(1) << HASH_LOG> table;
+  table.fill(0);
+
+  const byte_t* ip = src;
+  const byte_t* anchor = src;
+  const byte_t* const iend = src + len;
+  byte_t* op = dst;
+  byte_t* const oend = dst + dst_capacity;
+
+  if (len > MFLIMIT) {
+    const byte_t* const mflimit = iend - MFLIMIT;
+    const byte_t* const matchlimit = iend - LAST_LITERALS;
+    unsigned searches = 1u << SKIP_TRIGGER;
+
+    while (ip < mflimit) {
+      const std::uint32_t sequence = read32(ip);
+      const std::uint32_t h = hash(sequence);
+      const byte_t* ref = src + table[h];
+      table[h] = std::uint32_t(ip - src);
+
+      if (ref >= ip || std::size_t(ip - ref) > MAX_OFFSET || read32(ref) != sequence) {
+        // accelerate on incompressible data
+        ip += (searches++ >> SKIP_TRIGGER);
+        continue;
+      }
+      searches = 1u << SKIP_TRIGGER;
+
+      // extend the match backwards and forwards
+      while (ip > anchor && ref > src && ip[-1] == ref[-1]) {
+        --ip;
+        --ref;
+      }
+      std::size_t match_len = MIN_MATCH;
+      while (ip + match_len < matchlimit && ip[match_len] == ref[match_len]) {
+        ++match_len;
+      }
+
+      const std::size_t literals = std::size_t(ip - anchor);
+      if (std::size_t(oend - op) < sequenceBound(literals) + (match_len / 255)) {
+        return 0;
+      }
+      byte_t* token = op++;
+      *token = byte_t((literals >= 15 ? 15 : literals) << 4);
+      if (literals >= 15) {
+        op = writeLength(op, literals - 15);
+      }
+      std::memcpy(op, anchor, literals);
+      op += literals;
+
+      const std::size_t offset = std::size_t(ip - ref);
+      *op++ = byte_t(offset);
+      *op++ = byte_t(offset >> 8);
+
+      const std::size_t match_code = match_len - MIN_MATCH;
+      *token |= byte_t(match_code >= 15 ? 15 : match_code);
+      if (match_code >= 15) {
+        op = writeLength(op, match_code - 15);
+      }
+
+      ip += match_len;
+      anchor = ip;
+    }
+  }
+
+  // last literals
+  const std::size_t literals = std::size_t(iend - anchor);
+  if (std::size_t(oend - op) < sequenceBound(literals)) {
+    return 0;
+  }
+  *op++ = byte_t((literals >= 15 ? 15 : literals) << 4);
+  if (literals >= 15) {
+    op = writeLength(op, literals - 15);
+  }
+  std::memcpy(op, anchor, literals);
+  op += literals;
+  return std::size_t(op - dst);
+}
+
+/**
+ * @brief Decompresses a LZ4 block whose decompressed size is known. Malformed inputs are
+ *        detected and never read or write out of bounds
+ * @param src     The compressed input
+ * @param len     The length of the compressed input
+ * @param dst     The output buffer
+ * @param dst_len The exact decompressed size
+ * @return true on success | false if the input is malformed
+ */
+inline bool
+decompress(const byte_t* src, const std::size_t len, byte_t* dst, const std::size_t dst_len)
+{
+  using namespace detail;
+
+  const byte_t* ip = src;
+  const byte_t* const iend = src + len;
+  byte_t* op = dst;
+  byte_t* const oend = dst + dst_len;
+
+  const auto readLength = [&ip, iend](std::size_t& value) {
+    byte_t extra;
+    do {
+      if (ip >= iend) {
+        return false;
+      }
+      extra = *ip++;
+      value += extra;
+    } while (extra == 255);
+    return true;
+  };
+
+  while (ip < iend) {
+    const byte_t token = *ip++;
+    std::size_t literals = token >> 4;
+    if (literals == 15 && !readLength(literals)) {
+      return false;
+    }
+    if (std::size_t(iend - ip) < literals || std::size_t(oend - op) < literals) {
+      return false;
+    }
+    std::memcpy(op, ip, literals);
+    ip += literals;
+    op += literals;
+
+    if (ip == iend) {
+      // the last sequence only has literals
+      break;
+    }
+
+    if (iend - ip < 2) {
+      return false;
+    }
+    const std::size_t offset = std::size_t(ip[0]) | (std::size_t(ip[1]) << 8);
+    ip += 2;
+    if (offset == 0 || offset > std::size_t(op - dst)) {
+      return false;
+    }
+    std::size_t match_len = token & 15;
+    if (match_len == 15 && !readLength(match_len)) {
+      return false;
+    }
+    match_len += MIN_MATCH;
+    if (std::size_t(oend - op) < match_len) {
+      return false;
+    }
+
+    const byte_t* match = op - offset;
+    if (offset >= match_len) {
+      std::memcpy(op, match, match_len);
+      op += match_len;
+    } else {
+      // overlapping copy (repeated patterns)
+      for (std::size_t i = 0; i < match_len; ++i) {
+        *op++ = *match++;
+      }
+    }
+  }
+  return op == oend;
+}
+
+}
+
+}
+
+#endif // PACKET_LZ4_H_
@@ -0,0 +1,198 @@
+#ifndef PACKET_MESSAGE_DISPATCHER_H_
+#define PACKET_MESSAGE_DISPATCHER_H_
+
+#include <array>
+#include <limits>
+#include <cstdint>
+#include <utility>
+#include <type_traits>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief Entry of the dispatch table: the handler of a message type (nullptr if the type
+ *        has no route) and the maximum content length accepted for it
+ */
+template<typename Context>
+struct DispatchEntry {
+    using Handler = void (*)(Context&, const PacketView&);
+
+    Handler handler;
+    std::size_t max_data_len;
+};
+
+/**
+ * @brief RouteMaxDataLen is the MAX_DATA_LEN of the route, or no limit if it has none
+ */
+template<typename Route, typename = void>
+struct RouteMaxDataLen {
+    static constexpr const std::size_t value = std::numeric_limits<std::size_t>::max();
+};
+
+template<typename Route>
+struct RouteMaxDataLen<Route, decltype(void(Route::MAX_DATA_LEN))> {
+    static constexpr const std::size_t value = std::size_t(Route::MAX_DATA_LEN);
+};
+
+/**
+ * @brief RouteEntry builds the entry of the given type from the first route with that TYPE
+ */
+template<typename Context, std::uint64_t TYPE, typename... Routes>
+struct RouteEntry {
+    static constexpr DispatchEntry<Context>
+    make(void)
+    {
+      return DispatchEntry<Context>{nullptr, 0};
+    }
+};
+
+template<typename Context, std::uint64_t TYPE, typename Route, typename... Rest>
+struct RouteEntry<Context, TYPE, Route, Rest...> {
+    static constexpr DispatchEntry<Context>
+    make(void)
+    {
+      return std::uint64_t(Route::TYPE) == TYPE ?
+          DispatchEntry<Context>{&Route::handle, RouteMaxDataLen<Route>::value} :
+          RouteEntry<Context, TYPE, Rest...>::make();
+    }
+};
+
+/**
+ * @brief DispatchTable holds the compile time helpers used to build the table of a
+ *        MessageDispatcher (they need the routes but not the dispatcher itself)
+ */
+template<typename Context, typename... Routes>
+struct DispatchTable {
+    static constexpr std::uint64_t
+    maxType(void)
+    {
+      const std::uint64_t types[] = {std::uint64_t(Routes::TYPE)...};
+      std::uint64_t result = 0;
+      for (const std::uint64_t type : types) {
+        result = type > result ? type : result;
+      }
+      return result;
+    }
+
+    static constexpr bool
+    uniqueTypes(void)
+    {
+      const std::uint64_t types[] = {std::uint64_t(Routes::TYPE)...};
+      for (std::size_t i = 0; i < sizeof...(Routes); ++i) {
+        for (std::size_t j = i + 1; j < sizeof...(Routes); ++j) {
+          if (types[i] == types[j]) {
+            return false;
+          }
+        }
+      }
+      return true;
+    }
+
+    template<std::size_t... TYPES>
+    static constexpr std::array<DispatchEntry<Context>, sizeof...(TYPES)>
+    make(std::index_sequence<TYPES...>)
+    {
+      return {{RouteEntry<Context, TYPES, Routes...>::make()...}};
+    }
+};
+
+}
+
+
+/**
+ * @brief The MessageDispatcher class routes the packets to a handler per message type
+ *        (check MessageTypeField) using a table built at compile time and indexed by the
+ *        type: no virtual calls nor map lookups. Each route is a struct like:
+ * @code
+ *        struct LoginRoute {
+ *          static constexpr std::uint16_t TYPE = 1;
+ *          // optional, the contents of this type can not be longer
+ *          static constexpr std::size_t MAX_DATA_LEN = 512;
+ *          static void handle(Session& session, const packet::PacketView& view);
+ *        };
+ * @endcode
+ *        The dispatcher can also be the Limits of the MessageTypeField, so the parser
+ *        rejects the types without route (and the contents over the route limit) as soon
+ *        as the header is read, before the content is received.
+ * @tparam Context  The object passed to the handlers
+ * @tparam Routes   The routes, each one with a different TYPE (< MAX_TABLE_SIZE)
+ */
+template<typename Context, typename... Routes>
+class MessageDispatcher {
+    using Table = detail::DispatchTable<Context, Routes...>;
+    using Entry = detail::DispatchEntry<Context>;
+
+  public:
+
+    /**
+     * @brief MAX_TABLE_SIZE is the maximum number of entries of the table (the types are
+     *                       used as indexes, so they are expected to be small and dense)
+     */
+    static constexpr const std::size_t MAX_TABLE_SIZE = 1024;
+
+    static_assert(sizeof...(Routes) > 0, "At least one route is required");
+    static_assert(Table::maxType() < MAX_TABLE_SIZE, "The message types must be lower than MAX_TABLE_SIZE");
+    static_assert(Table::uniqueTypes(), "Each message type can only have one route");
+
+    /**
+     * @brief TABLE_SIZE is the number of entries of the table (the highest type + 1)
+     */
+    static constexpr const std::size_t TABLE_SIZE = std::size_t(Table::maxType()) + 1;
+
+  public:
+
+    /**
+     * @brief Returns true if the message type has a route
+     * @param type the message type
+     * @return true if the message type has a route
+     */
+    static inline bool
+    has(const std::uint64_t type);
+
+    /**
+     * @brief Returns true if the message type has a route and data_len is within its
+     *        limit. This is the interface of the Limits of MessageTypeField
+     * @param type      the message type
+     * @param data_len  the length of the content
+     * @return true if the message of this type and length can be dispatched
+     */
+    static inline bool
+    accept(const std::uint64_t type, const std::size_t data_len);
+
+    /**
+     * @brief Calls the handler of the view message type
+     * @param context the context passed to the handler
+     * @param view    the packet content and message type
+     * @return true if it was handled | false if the type has no route or the content is
+     *         over its limit
+     */
+    static inline bool
+    dispatch(Context& context, const PacketView& view);
+
+    /**
+     * @brief Calls the handler of a completed packet message type
+     * @param context the context passed to the handler
+     * @param pkt     the packet (status == COMPLETE, not streamed)
+     * @return true if it was handled | false otherwise
+     */
+    template<typename Cfg>
+    static inline bool
+    dispatch(Context& context, const PacketT<Cfg>& pkt);
+
+  private:
+    static constexpr const std::array<Entry, TABLE_SIZE> TABLE =
+        Table::make(std::make_index_sequence<TABLE_SIZE>());
+};
+
+
+
+#include <packet/message_dispatcher_impl.h>
+}
+
+#endif // PACKET_MESSAGE_DISPATCHER_H_
@@ -0,0 +1,44 @@
+
+
+template<typename Context, typename... Routes>
+constexpr const std::array<detail::DispatchEntry<Context>,
+                           MessageDispatcher<Context, Routes...>::TABLE_SIZE>
+MessageDispatcher<Context, Routes...>::TABLE;
+
+
+template<typename Context, typename... Routes>
+inline bool
+MessageDispatcher<Context, Routes...>::has(const std::uint64_t type)
+{
+  return type < TABLE_SIZE && TABLE[std::size_t(type)].handler != nullptr;
+}
+
+template<typename Context, typename... Routes>
+inline bool
+MessageDispatcher<Context, Routes...>::accept(const std::uint64_t type, const std::size_t data_len)
+{
+  return has(type) && data_len <= TABLE[std::size_t(type)].max_data_len;
+}
+
+template<typename Context, typename... Routes>
+inline bool
+MessageDispatcher<Context, Routes...>::dispatch(Context& context, const PacketView& view)
+{
+  if (!accept(view.message_type, view.len)) {
+    return false;
+  }
+  TABLE[std::size_t(view.message_type)].handler(context, view);
+  return true;
+}
+
+template<typename Context, typename... Routes>
+template<typename Cfg>
+inline bool
+MessageDispatcher<Context, Routes...>::dispatch(Context& context, const PacketT<Cfg>& pkt)
+{
+  if (pkt.status() != Status::COMPLETE || pkt.data() == nullptr) {
+    return false;
+  }
+  const PacketView view{pkt.data(), std::size_t(pkt.dataLen()), false, std::uint64_t(pkt.messageType())};
+  return dispatch(context, view);
+}
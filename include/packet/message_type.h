@@ -0,0 +1,82 @@
+#ifndef PACKET_MESSAGE_TYPE_H_
+#define PACKET_MESSAGE_TYPE_H_
+
+#include <cstdint>
+#include <type_traits>
+
+#include <packet/defs.h>
+#include <packet/length_codec.h>
+
+
+namespace packet {
+
+/**
+ * @brief Message type policies define the optional type field written on the header, after
+ *        the data length (and flags), so the receiver knows the kind of content before it
+ *        arrives. All of them provide the same static interface:
+ *        - value_type: the type of the field
+ *        - SIZE: the number of bytes of the field on the wire (0 disables it)
+ *        - write(value, out) / read(in): wire representation of the value
+ *        - accept(value, data_len): called as soon as the field is read, false makes the
+ *          packet INVALID before its content is received (unknown types, per type limits)
+ */
+
+/**
+ * @brief NoMessageType is the default policy: the header has no type field
+ */
+struct NoMessageType {
+    using value_type = std::uint8_t;
+    static constexpr const std::size_t SIZE = 0;
+
+    static inline void write(const value_type, byte_t*) {}
+    static inline value_type read(const byte_t*) { return 0; }
+    static inline bool accept(const value_type, const std::size_t) { return true; }
+};
+
+/**
+ * @brief AnyMessageType accepts every message type with any length (up to the MAX_DATA_LEN
+ *        of the configuration)
+ */
+struct AnyMessageType {
+    static inline bool accept(const std::uint64_t, const std::size_t) { return true; }
+};
+
+/**
+ * @brief MessageTypeField writes the type as a big endian T. The Limits decide which types
+ *        (and lengths) are accepted, a MessageDispatcher can be used so only the routed
+ *        types are (check message_dispatcher.h)
+ * @tparam T      The type of the field (unsigned)
+ * @tparam Limits Provides `static bool accept(std::uint64_t type, std::size_t data_len)`
+ */
+template<typename T, typename Limits = AnyMessageType>
+struct MessageTypeField {
+    static_assert(std::is_unsigned<T>::value, "The message type must be unsigned");
+
+    using value_type = T;
+    static constexpr const std::size_t SIZE = sizeof(T);
+
+    static inline void
+    write(const value_type value, byte_t* out)
+    {
+      BigEndianLength<T>::encode(value, out);
+    }
+
+    static inline value_type
+    read(const byte_t* in)
+    {
+      T value = 0;
+      std::size_t size = 0;
+      BigEndianLength<T>::decode(in, SIZE, value, size);
+      return value;
+    }
+
+    static inline bool
+    accept(const value_type value, const std::size_t data_len)
+    {
+      return Limits::accept(std::uint64_t(value), data_len);
+    }
+};
+
+}
+
+#endif // PACKET_MESSAGE_TYPE_H_
@@ -0,0 +1,332 @@
+#ifndef PACKET_METRICS_H_
+#define PACKET_METRICS_H_
+
+#include <vector>
+#include <array>
+#include <string>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
+#include <algorithm>
+
+#include <packet/defs.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The totals of the parser / serializer counters (check CountingMetrics)
+ */
+struct MetricsSnapshot {
+    /**
+     * @brief STATES_COUNT is the number of parser states an invalid packet is counted on:
+     *        head pattern, data size, flags, data (or the data sink refused it), checksum,
+     *        tail pattern, message type and content (it could not be decompressed or the
+     *        message type refused its length)
+     */
+    static constexpr const std::size_t STATES_COUNT = 8;
+
+    /**
+     * @brief APPEND_BUCKETS is the number of buckets of append_calls_per_packet: bucket i
+     *        counts the packets completed with [2^i, 2^(i+1)) appendData() calls, the last
+     *        one everything above
+     */
+    static constexpr const std::size_t APPEND_BUCKETS = 8;
+
+    // bytes given to the parsers (PacketT::appendData() / updateDataOffset(), StreamFramerT
+    // inputs) and number of those calls
+    std::uint64_t bytes_parsed = 0;
+    std::uint64_t append_calls = 0;
+    // packets completed by the parsers
+    std::uint64_t packets_parsed = 0;
+    // invalid packets found by PacketT, per state (check STATES_COUNT)
+    std::array<std::uint64_t, STATES_COUNT> invalid_packets{};
+    // invalid frames skipped or stopping a StreamFramerT
+    std::uint64_t invalid_frames = 0;
+    std::array<std::uint64_t, APPEND_BUCKETS> append_calls_per_packet{};
+    // parser buffers moved to a bigger one and the biggest buffer seen
+    std::uint64_t reallocations = 0;
+    std::uint64_t peak_buffer_size = 0;
+    // packets serialized (PacketT::serialize() / writeFrame(), so the batch serializer and
+    // the log writer too, IovSerializerT::add() and ShmRingT::commit()) and their bytes
+    std::uint64_t packets_serialized = 0;
+    std::uint64_t bytes_serialized = 0;
+
+    /**
+     * @brief Returns the name of a state of invalid_packets
+     * @param state the state index (< STATES_COUNT)
+     * @return the name of the state
+     */
+    static inline const char*
+    stateName(const std::size_t state);
+};
+
+
+namespace detail {
+
+struct ThreadMetrics;
+
+/**
+ * @brief The counters of a group (check CountingMetrics): the blocks of the threads
+ *        counting on it and the totals of the ones that already finished
+ */
+struct MetricsGroup {
+    const char* name = nullptr;
+    std::mutex mutex;
+    std::vector<const ThreadMetrics*> threads;
+    MetricsSnapshot finished;
+};
+
+/**
+ * @brief The counters of one thread on a group. Only the owner thread writes them (a
+ *        relaxed load and store, no atomic read-modify-write) so they are cheap to update
+ *        and can be read at any time from the others
+ */
+struct ThreadMetrics {
+    using Counter = std::atomic<std::uint64_t>;
+
+    Counter bytes_parsed{0};
+    Counter append_calls{0};
+    Counter packets_parsed{0};
+    std::array<Counter, MetricsSnapshot::STATES_COUNT> invalid_packets{};
+    Counter invalid_frames{0};
+    std::array<Counter, MetricsSnapshot::APPEND_BUCKETS> append_calls_per_packet{};
+    Counter reallocations{0};
+    Counter peak_buffer_size{0};
+    Counter packets_serialized{0};
+    Counter bytes_serialized{0};
+
+    inline explicit ThreadMetrics(MetricsGroup& group);
+    inline ~ThreadMetrics();
+
+    // not copyable, the group keeps its address
+    ThreadMetrics(const ThreadMetrics&) = delete;
+    ThreadMetrics& operator=(const ThreadMetrics&) = delete;
+
+    static inline void
+    add(Counter& counter, const std::uint64_t value)
+    {
+      counter.store(counter.load(std::memory_order_relaxed) + value, std::memory_order_relaxed);
+    }
+
+    /**
+     * @brief Adds the counters into a snapshot
+     * @param snapshot where the counters are added
+     */
+    inline void
+    addTo(MetricsSnapshot& snapshot) const;
+
+  private:
+    MetricsGroup& group_;
+};
+
+/**
+ * @brief Counts the appendData() calls of a packet when the metrics are enabled and takes
+ *        no space (it fits on the padding of PacketT) otherwise
+ */
+template<bool Enabled>
+struct AppendCounter {
+    inline void increment(void) {}
+    inline void clear(void) {}
+    inline std::uint32_t value(void) const { return 0; }
+};
+
+template<>
+struct AppendCounter<true> {
+    std::uint32_t calls = 0;
+    inline void increment(void) { ++calls; }
+    inline void clear(void) { calls = 0; }
+    inline std::uint32_t value(void) const { return calls; }
+};
+
+}
+
+
+/**
+ * @brief The Metrics class aggregates the counters of all the groups and threads: each
+ *        thread updates its own block of the group of the configuration and snapshot()
+ *        adds them (plus the ones of the threads that already finished)
+ */
+class Metrics {
+  public:
+
+    /**
+     * @brief Returns the totals of all the groups and threads
+     * @return the totals of all the groups and threads
+     */
+    static inline MetricsSnapshot
+    snapshot(void);
+
+    /**
+     * @brief Returns the totals of the threads of one group
+     * @param group the name of the group
+     * @return the totals of the group (all zero if there is no such group yet)
+     */
+    static inline MetricsSnapshot
+    snapshot(const std::string& group);
+
+    /**
+     * @brief Returns the totals of the threads of one group
+     * @param group the group
+     * @return the totals of the group
+     */
+    static inline MetricsSnapshot
+    snapshot(detail::MetricsGroup& group);
+
+    /**
+     * @brief Returns the names of the groups counted so far
+     * @return the names of the groups counted so far
+     */
+    static inline std::vector<std::string>
+    groups(void);
+
+    /**
+     * @brief Registers a group (done once per group by CountingMetrics)
+     * @param group the group
+     */
+    static inline void
+    add(detail::MetricsGroup& group);
+
+
+  private:
+
+    struct Registry {
+      std::mutex mutex;
+      std::vector<detail::MetricsGroup*> groups;
+    };
+
+    static inline Registry&
+    registry(void);
+
+    static inline void
+    addGroup(detail::MetricsGroup& group, MetricsSnapshot& snapshot);
+};
+
+
+/**
+ * @brief The NoMetrics is the default metrics policy: nothing is counted and the hooks
+ *        compile to nothing
+ */
+struct NoMetrics {
+    static constexpr const bool ENABLED = false;
+
+    static inline void onAppend(const std::size_t) {}
+    static inline void onPacket(const std::uint32_t) {}
+    static inline void onInvalid(const std::size_t) {}
+    static inline void onInvalidFrame(void) {}
+    static inline void onReallocation(const std::size_t) {}
+    static inline void onSerialized(const std::size_t) {}
+};
+
+/**
+ * @brief The CountingMetrics policy counts on the per thread blocks of a group, so
+ *        different parsers (for example a control and a data channel) get their own
+ *        counters. Enable it on a configuration with
+ *        `using metrics = CountingMetrics<MyGroup>;` where MyGroup has a
+ *        `static constexpr const char* NAME`. Check Metrics::snapshot()
+ * @tparam GroupTag The group
+ */
+template<typename GroupTag>
+struct CountingMetrics {
+    static constexpr const bool ENABLED = true;
+
+    static inline void
+    onAppend(const std::size_t bytes)
+    {
+      detail::ThreadMetrics& counters = local();
+      detail::ThreadMetrics::add(counters.bytes_parsed, bytes);
+      detail::ThreadMetrics::add(counters.append_calls, 1);
+    }
+
+    static inline void
+    onPacket(const std::uint32_t append_calls)
+    {
+      detail::ThreadMetrics& counters = local();
+      detail::ThreadMetrics::add(counters.packets_parsed, 1);
+      std::size_t bucket = 0;
+      while (bucket + 1 < MetricsSnapshot::APPEND_BUCKETS && (std::uint64_t(2) << bucket) <= append_calls) {
+        ++bucket;
+      }
+      detail::ThreadMetrics::add(counters.append_calls_per_packet[bucket], 1);
+    }
+
+    static inline void
+    onInvalid(const std::size_t state)
+    {
+      PKT_ASSERT(state < MetricsSnapshot::STATES_COUNT);
+      detail::ThreadMetrics::add(local().invalid_packets[state], 1);
+    }
+
+    static inline void
+    onInvalidFrame(void)
+    {
+      detail::ThreadMetrics::add(local().invalid_frames, 1);
+    }
+
+    static inline void
+    onReallocation(const std::size_t capacity)
+    {
+      detail::ThreadMetrics& counters = local();
+      detail::ThreadMetrics::add(counters.reallocations, 1);
+      if (capacity > counters.peak_buffer_size.load(std::memory_order_relaxed)) {
+        counters.peak_buffer_size.store(capacity, std::memory_order_relaxed);
+      }
+    }
+
+    static inline void
+    onSerialized(const std::size_t bytes)
+    {
+      detail::ThreadMetrics& counters = local();
+      detail::ThreadMetrics::add(counters.packets_serialized, 1);
+      detail::ThreadMetrics::add(counters.bytes_serialized, bytes);
+    }
+
+    /**
+     * @brief Returns the totals of the group
+     * @return the totals of the group
+     */
+    static inline MetricsSnapshot
+    snapshot(void)
+    {
+      return Metrics::snapshot(group());
+    }
+
+    static inline detail::MetricsGroup&
+    group(void)
+    {
+      static detail::MetricsGroup& instance = create();
+      return instance;
+    }
+
+    /**
+     * @brief Returns the counters of the current thread on the group
+     * @return the counters of the current thread on the group
+     */
+    static inline detail::ThreadMetrics&
+    local(void)
+    {
+      static thread_local detail::ThreadMetrics metrics(group());
+      return metrics;
+    }
+
+  private:
+
+    static inline detail::MetricsGroup&
+    create(void)
+    {
+      // never destroyed, the blocks of the threads still running when the program exits
+      // unregister from it
+      detail::MetricsGroup* group = new detail::MetricsGroup();
+      group->name = GroupTag::NAME;
+      Metrics::add(*group);
+      return *group;
+    }
+};
+
+
+#include <packet/metrics_impl.h>
+}
+
+#endif // PACKET_METRICS_H_
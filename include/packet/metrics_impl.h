@@ -0,0 +1,137 @@
+
+
+inline const char*
+MetricsSnapshot::stateName(const std::size_t state)
+{
+  static const char* const NAMES[STATES_COUNT] = {
+    "head_pattern", "data_size", "flags", "data", "checksum", "tail_pattern",
+    "message_type", "content"
+  };
+  return state < STATES_COUNT ? NAMES[state] : "unknown";
+}
+
+
+namespace detail {
+
+inline ThreadMetrics::ThreadMetrics(MetricsGroup& group) :
+  group_(group)
+{
+  std::lock_guard<std::mutex> lock(group_.mutex);
+  group_.threads.push_back(this);
+}
+
+inline ThreadMetrics::~ThreadMetrics()
+{
+  // the counters of the thread are kept on the totals of the group
+  std::lock_guard<std::mutex> lock(group_.mutex);
+  addTo(group_.finished);
+  group_.threads.erase(std::find(group_.threads.begin(), group_.threads.end(), this));
+}
+
+inline void
+ThreadMetrics::addTo(MetricsSnapshot& snapshot) const
+{
+  const auto read = [](const Counter& counter) { return counter.load(std::memory_order_relaxed); };
+  snapshot.bytes_parsed += read(bytes_parsed);
+  snapshot.append_calls += read(append_calls);
+  snapshot.packets_parsed += read(packets_parsed);
+  for (std::size_t i = 0; i < MetricsSnapshot::STATES_COUNT; ++i) {
+    snapshot.invalid_packets[i] += read(invalid_packets[i]);
+  }
+  snapshot.invalid_frames += read(invalid_frames);
+  for (std::size_t i = 0; i < MetricsSnapshot::APPEND_BUCKETS; ++i) {
+    snapshot.append_calls_per_packet[i] += read(append_calls_per_packet[i]);
+  }
+  snapshot.reallocations += read(reallocations);
+  snapshot.peak_buffer_size = std::max(snapshot.peak_buffer_size, read(peak_buffer_size));
+  snapshot.packets_serialized += read(packets_serialized);
+  snapshot.bytes_serialized += read(bytes_serialized);
+}
+
+}
+
+
+inline Metrics::Registry&
+Metrics::registry(void)
+{
+  static Registry registry;
+  return registry;
+}
+
+inline void
+Metrics::addGroup(detail::MetricsGroup& group, MetricsSnapshot& snapshot)
+{
+  std::lock_guard<std::mutex> lock(group.mutex);
+  const MetricsSnapshot& finished = group.finished;
+  snapshot.bytes_parsed += finished.bytes_parsed;
+  snapshot.append_calls += finished.append_calls;
+  snapshot.packets_parsed += finished.packets_parsed;
+  for (std::size_t i = 0; i < MetricsSnapshot::STATES_COUNT; ++i) {
+    snapshot.invalid_packets[i] += finished.invalid_packets[i];
+  }
+  snapshot.invalid_frames += finished.invalid_frames;
+  for (std::size_t i = 0; i < MetricsSnapshot::APPEND_BUCKETS; ++i) {
+    snapshot.append_calls_per_packet[i] += finished.append_calls_per_packet[i];
+  }
+  snapshot.reallocations += finished.reallocations;
+  snapshot.peak_buffer_size = std::max(snapshot.peak_buffer_size, finished.peak_buffer_size);
+  snapshot.packets_serialized += finished.packets_serialized;
+  snapshot.bytes_serialized += finished.bytes_serialized;
+  for (const detail::ThreadMetrics* thread : group.threads) {
+    thread->addTo(snapshot);
+  }
+}
+
+inline MetricsSnapshot
+Metrics::snapshot(void)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  MetricsSnapshot result;
+  for (detail::MetricsGroup* group : reg.groups) {
+    addGroup(*group, result);
+  }
+  return result;
+}
+
+inline MetricsSnapshot
+Metrics::snapshot(const std::string& group)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  MetricsSnapshot result;
+  for (detail::MetricsGroup* candidate : reg.groups) {
+    if (group == candidate->name) {
+      addGroup(*candidate, result);
+    }
+  }
+  return result;
+}
+
+inline MetricsSnapshot
+Metrics::snapshot(detail::MetricsGroup& group)
+{
+  MetricsSnapshot result;
+  addGroup(group, result);
+  return result;
+}
+
+inline std::vector<std::string>
+Metrics::groups(void)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  std::vector<std::string> result;
+  for (const detail::MetricsGroup* group : reg.groups) {
+    result.emplace_back(group->name);
+  }
+  return result;
+}
+
+inline void
+Metrics::add(detail::MetricsGroup& group)
+{
+  Registry& reg = registry();
+  std::lock_guard<std::mutex> lock(reg.mutex);
+  reg.groups.push_back(&group);
+}
@@ -0,0 +1,108 @@
+#ifndef PACKET_MPMC_QUEUE_H_
+#define PACKET_MPMC_QUEUE_H_
+
+#include <vector>
+#include <atomic>
+#include <cstdint>
+#include <utility>
+
+#include <packet/defs.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The MpmcQueue class is a bounded lock-free multi producer / multi consumer queue
+ *        (a ring of cells with a sequence number each, as described by D. Vyukov). The
+ *        push / pop operations never block nor allocate, they fail if the queue is full /
+ *        empty so the caller decides how to wait.
+ * @tparam T  The type of the elements (default constructible and movable)
+ */
+template<typename T>
+class MpmcQueue {
+  public:
+    /**
+     * @brief Construct the queue
+     * @param capacity the maximum number of elements (rounded up to a power of two)
+     */
+    inline explicit MpmcQueue(const std::size_t capacity);
+
+    // not copyable
+    MpmcQueue(const MpmcQueue&) = delete;
+    MpmcQueue& operator=(const MpmcQueue&) = delete;
+
+    /**
+     * @brief Returns the capacity of the queue
+     * @return the capacity of the queue
+     */
+    inline std::size_t
+    capacity(void) const;
+
+    /**
+     * @brief Returns the approximate number of elements (exact if nobody is pushing /
+     *        popping at the same time)
+     * @return the approximate number of elements
+     */
+    inline std::size_t
+    sizeApprox(void) const;
+
+    /**
+     * @brief Pushes an element if there is room. fill(T& slot) is called once a slot was
+     *        reserved, so nothing is moved into the queue when it is full
+     * @param fill  Callable filling the reserved slot
+     * @return true if the element was pushed | false if the queue is full
+     */
+    template<typename Fill>
+    inline bool
+    tryPushWith(Fill&& fill);
+
+    /**
+     * @brief Pushes an element if there is room (value is only moved on success)
+     * @param value the element
+     * @return true if the element was pushed | false if the queue is full
+     */
+    inline bool
+    tryPush(T&& value);
+
+    /**
+     * @brief Pops the oldest element if any
+     * @param value where the element is moved into
+     * @return true if an element was popped | false if the queue is empty
+     */
+    inline bool
+    tryPop(T& value);
+
+
+  private:
+
+    // avoids the false sharing between the producers and the consumers positions
+    static constexpr const std::size_t CACHE_LINE_SIZE = 64;
+
+    struct Cell {
+      std::atomic<std::size_t> sequence;
+      T value;
+    };
+
+    static inline std::size_t
+    roundCapacity(const std::size_t capacity);
+
+  private:
+    std::vector<Cell> cells_;
+    std::size_t mask_;
+    // padding instead of alignas: over aligned types are not honored by new before c++17
+    byte_t pad0_[CACHE_LINE_SIZE];
+    std::atomic<std::size_t> push_pos_;
+    byte_t pad1_[CACHE_LINE_SIZE];
+    std::atomic<std::size_t> pop_pos_;
+    byte_t pad2_[CACHE_LINE_SIZE];
+};
+
+
+
+#include <packet/mpmc_queue_impl.h>
+
+}
+
+#endif // PACKET_MPMC_QUEUE_H_
@@ -0,0 +1,98 @@
+
+
+
+template<typename T>
+inline std::size_t
+MpmcQueue<T>::roundCapacity(const std::size_t capacity)
+{
+  std::size_t result = 2;
+  while (result < capacity) {
+    result <<= 1;
+  }
+  return result;
+}
+
+template<typename T>
+inline MpmcQueue<T>::MpmcQueue(const std::size_t capacity) :
+  cells_(roundCapacity(capacity))
+, mask_(cells_.size() - 1)
+, push_pos_(0)
+, pop_pos_(0)
+{
+  PKT_ASSERT(capacity > 0);
+  for (std::size_t i = 0; i < cells_.size(); ++i) {
+    cells_[i].sequence.store(i, std::memory_order_relaxed);
+  }
+}
+
+template<typename T>
+inline std::size_t
+MpmcQueue<T>::capacity(void) const
+{
+  return cells_.size();
+}
+
+template<typename T>
+inline std::size_t
+MpmcQueue<T>::sizeApprox(void) const
+{
+  const std::size_t push_pos = push_pos_.load(std::memory_order_relaxed);
+  const std::size_t pop_pos = pop_pos_.load(std::memory_order_relaxed);
+  return push_pos > pop_pos ? push_pos - pop_pos : 0;
+}
+
+template<typename T>
+template<typename Fill>
+inline bool
+MpmcQueue<T>::tryPushWith(Fill&& fill)
+{
+  std::size_t pos = push_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos & mask_];
+    const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    const std::intptr_t diff = std::intptr_t(sequence) - std::intptr_t(pos);
+    if (diff == 0) {
+      if (push_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        fill(cell.value);
+        cell.sequence.store(pos + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // the cell was not consumed yet: full
+      return false;
+    } else {
+      pos = push_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
+
+template<typename T>
+inline bool
+MpmcQueue<T>::tryPush(T&& value)
+{
+  return tryPushWith([&value](T& slot) { slot = std::move(value); });
+}
+
+template<typename T>
+inline bool
+MpmcQueue<T>::tryPop(T& value)
+{
+  std::size_t pos = pop_pos_.load(std::memory_order_relaxed);
+  while (true) {
+    Cell& cell = cells_[pos & mask_];
+    const std::size_t sequence = cell.sequence.load(std::memory_order_acquire);
+    const std::intptr_t diff = std::intptr_t(sequence) - std::intptr_t(pos + 1);
+    if (diff == 0) {
+      if (pop_pos_.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)) {
+        value = std::move(cell.value);
+        cell.sequence.store(pos + mask_ + 1, std::memory_order_release);
+        return true;
+      }
+    } else if (diff < 0) {
+      // the cell was not produced yet: empty
+      return false;
+    } else {
+      pos = pop_pos_.load(std::memory_order_relaxed);
+    }
+  }
+}
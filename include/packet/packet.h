@@ -8,15 +8,40 @@
 #include <array>
 #include <arpa/inet.h>
 #include <string>
+#include <functional>
 
 #include <packet/defs.h>
+#include <packet/buffer.h>
 #include <packet/buffer_part.h>
+#include <packet/buffer_pool.h>
+#include <packet/packet_storage.h>
+#include <packet/length_codec.h>
+#include <packet/checksum.h>
+#include <packet/compression.h>
+#include <packet/message_type.h>
+#include <packet/metrics.h>
+#include <packet/latency.h>
 
 
 namespace packet {
 
 
 
+/**
+ * @brief The content of a completed packet moved out of it (check PacketT::takePayload()),
+ *        the content is at [offset, offset + len) of the buffer
+ */
+struct PacketPayload {
+    Buffer buffer;
+    std::size_t offset = 0;
+    std::size_t len = 0;
+    // the message type of the packet (0 if the configuration has none)
+    std::uint64_t message_type = 0;
+
+    inline const byte_t* data(void) const { return buffer.data() + offset; }
+};
+
+
 /**
  * @brief The Packet class provides an interface for reading a packet and verify if it is
  *        valid or not, also for serializing a piece of data.
@@ -28,21 +53,96 @@ class PacketT {
 
     // Extraction of the configuration types here
     using data_len_t = typename Cfg::data_len_t;
+    using length_codec = typename Cfg::length_codec;
+    using checksum = typename Cfg::checksum;
+    using checksum_t = typename checksum::value_type;
+    using buffer_policy = typename Cfg::buffer_policy;
+    using compression = typename Cfg::compression;
+    using metrics = typename Cfg::metrics;
+    using tracing = typename Cfg::tracing;
+    using message_type = typename Cfg::message_type;
+    using message_type_t = typename message_type::value_type;
+
+    /**
+     * @brief DataSink receives the packet content as it arrives (check setDataSink()).
+     *        Returning false aborts the packet (it becomes INVALID)
+     */
+    using DataSink = std::function<bool(const byte_t* data, std::size_t len)>;
     static constexpr const int HEAD_PATTERN_SIZE = LengthCalculator<staticLength(Cfg::HEAD_PATTERN)>::value;
     static constexpr const int TAIL_PATTERN_SIZE = LengthCalculator<staticLength(Cfg::TAIL_PATTERN)>::value;
+    static constexpr const std::size_t CHECKSUM_SIZE = checksum::SIZE;
+
+    /**
+     * @brief FLAGS_SIZE is the size of the flags field written after the data length, it
+     *                   only exists if the configuration enables compression
+     */
+    static constexpr const std::size_t FLAGS_SIZE = compression::ENABLED ? 1 : 0;
+
+    /**
+     * @brief FLAG_COMPRESSED is set on the flags field when the content is compressed. A
+     *                        compressed content is the raw length (encoded with the
+     *                        length codec) followed by the compressed data
+     */
+    static constexpr const byte_t FLAG_COMPRESSED = 0x01;
+
+    /**
+     * @brief TYPE_SIZE is the size of the message type field written after the flags (0 if
+     *                  the configuration has none)
+     */
+    static constexpr const std::size_t TYPE_SIZE = message_type::SIZE;
+
+    /**
+     * @brief TRAILER_SIZE is the number of bytes written after the content (checksum and
+     *                     tail pattern)
+     */
+    static constexpr const std::size_t TRAILER_SIZE = CHECKSUM_SIZE + TAIL_PATTERN_SIZE;
 
     /**
      * @brief PACKET_MAX_SIZE is the maximum number of bytes a packet can occupy after
      *                        being serialized
      */
     static constexpr const std::size_t PACKET_MAX_SIZE = HEAD_PATTERN_SIZE +
-                                                         TAIL_PATTERN_SIZE +
-                                                         sizeof(data_len_t) +
+                                                         TRAILER_SIZE +
+                                                         length_codec::MAX_SIZE +
+                                                         FLAGS_SIZE +
+                                                         TYPE_SIZE +
                                                          Cfg::MAX_DATA_LEN;
 
+    /**
+     * @brief HEADER_MAX_SIZE is the maximum number of bytes the header (head pattern, data
+     *                        length, flags and message type) can occupy after being serialized
+     */
+    static constexpr const std::size_t HEADER_MAX_SIZE = HEAD_PATTERN_SIZE + length_codec::MAX_SIZE + FLAGS_SIZE + TYPE_SIZE;
+
+    /**
+     * @brief storage_t is the buffer the packets are parsed on, chosen from the
+     *                  configuration: a fixed array inside the packet when PACKET_MAX_SIZE
+     *                  is at most INLINE_PACKET_MAX_SIZE, otherwise INLINE_BUFFER_SIZE inline
+     *                  bytes backed by the buffer policy for bigger frames
+     */
+    using storage_t = typename std::conditional<(PACKET_MAX_SIZE <= Cfg::INLINE_PACKET_MAX_SIZE),
+                                                InlineBuffer<PACKET_MAX_SIZE, buffer_policy>,
+                                                SmallBuffer<Cfg::INLINE_BUFFER_SIZE, buffer_policy> >::type;
+
+    static_assert(std::is_same<typename length_codec::value_type, data_len_t>::value,
+                  "The length codec must use the configuration data_len_t");
+    static_assert(std::uint64_t(Cfg::MAX_DATA_LEN) <= length_codec::MAX_VALUE,
+                  "The length codec can not encode MAX_DATA_LEN");
+
 
   public:
     inline PacketT();
+    inline ~PacketT();
+
+    /**
+     * @brief Packets can be copied and moved at any point of the parsing. Moving takes the
+     *        buffer (O(1) unless the packet is kept inline, then only the bytes received are
+     *        copied) and leaves the other packet reset, without data sink
+     */
+    inline PacketT(const PacketT& other);
+    inline PacketT(PacketT&& other) noexcept;
+    inline PacketT& operator=(const PacketT& other);
+    inline PacketT& operator=(PacketT&& other) noexcept;
 
     /**
      * @brief Return the current status
@@ -57,6 +157,18 @@ class PacketT {
     inline void
     reset(void);
 
+    /**
+     * @brief Sets a sink that receives the content of the packets as it arrives instead of
+     *        storing it on the packet buffer, so the memory used is bounded by
+     *        Cfg::MAX_RESERVE_AHEAD no matter the size of the packet. The tail is still
+     *        validated at the end. While streaming, data() returns nullptr and dataLen()
+     *        is the full content length. The sink is kept after reset()
+     * @param sink the sink to use, an empty one goes back to buffer the content
+     * @note it takes effect on the next content (set it before the content starts)
+     */
+    inline void
+    setDataSink(DataSink sink);
+
     /**
      * @brief Interface for adding data to the packet
      * @param data the raw data to be added
@@ -67,14 +179,15 @@ class PacketT {
     appendData(const byte_t* data, const std::size_t len);
 
     /**
-     * @brief Returns the remaining buffer pointer
+     * @brief Returns the remaining buffer pointer where remainingBytes() can be written
      * @return the remaining buffer pointer
      */
     inline byte_t*
     remainingBuffer(void);
 
     /**
-     * @brief Returns the remaining bytes that can be added to the packet
+     * @brief Returns the remaining bytes that can be added to the packet right now. This is
+     *        limited by Cfg::MAX_RESERVE_AHEAD so the buffer only grows as data arrives
      * @return the remaining bytes that can be added to the packet
      */
     inline std::size_t
@@ -108,26 +221,176 @@ class PacketT {
     inline const byte_t*
     data(void) const;
 
+    /**
+     * @brief Returns true if the content was compressed on the wire. Compressed contents
+     *        are decompressed when the packet completes, so data() and dataLen() always
+     *        refer to the original content (except while streaming, where the sink receives
+     *        the content as it is on the wire)
+     * @return true if the content was compressed on the wire
+     */
+    inline bool
+    isCompressed(void) const;
+
+    /**
+     * @brief Returns true once the message type field was read (always false if the
+     *        configuration has none). It is known before the content arrives
+     * @return true once the message type field was read
+     */
+    inline bool
+    hasMessageType(void) const;
+
+    /**
+     * @brief Returns the message type of the packet (check hasMessageType())
+     * @return the message type of the packet, 0 if not known
+     */
+    inline message_type_t
+    messageType(void) const;
+
     /**
      * @brief Returns the full buffer with headers, size and data. Make sure status == Completed
      * @return the full buffer with headers, size and data
-     * @note take into account that status == Completed
+     * @note take into account that status == Completed. If the content was compressed the
+     *       buffer only holds the decompressed content (dataOffset() is 0)
      */
-    inline const std::vector<byte_t>&
+    inline const storage_t&
     allData(void) const;
 
+    /**
+     * @brief Returns the offset of the content on the full buffer (see allData())
+     * @return the offset of the content on the full buffer
+     */
+    inline std::size_t
+    dataOffset(void) const;
+
+    /**
+     * @brief Detaches the full buffer (headers, data and tail) so it can be handed to a
+     *        consumer without copying it, the content is at [dataOffset(), dataLen()) (check
+     *        them before detaching). The packet is reset and keeps parsing on its inline
+     *        storage (packets kept inline are copied to a buffer taken from the buffer
+     *        policy)
+     * @return the full buffer of the packet
+     * @note the buffer can be given back later through recycleBuffer()
+     */
+    inline Buffer
+    detachBuffer(void);
 
     /**
-     * @brief Generates a serialized packet from the packet data (content)
+     * @brief Moves the content of a completed packet out together with where it is on the
+     *        buffer (check detachBuffer()), so handing it to another component costs a
+     *        pointer swap instead of a copy. The packet is reset
+     * @return the payload, empty if the packet is not COMPLETE (or its content was
+     *         streamed to a data sink)
+     */
+    inline PacketPayload
+    takePayload(void);
+
+    /**
+     * @brief Gives back a buffer (for example one previously detached) to the buffer policy
+     * @param buffer the buffer to give back
+     */
+    static inline void
+    recycleBuffer(Buffer&& buffer);
+
+
+    /**
+     * @brief Generates a serialized packet from the packet data (content). If the
+     *        configuration enables compression and the content has at least
+     *        compression::MIN_SIZE bytes it is compressed (only if it gets smaller)
      * @param packet_content  The packet content we wanto to serialize
      * @param len             The len of the packet
      * @param out             The output buffer where we want to serialize it
+     * @param type            The message type (ignored if the configuration has none)
      * @return true on success | false otherwise
      */
     static inline bool
-    serialize(const byte_t* packet_content, const data_len_t len, std::ostream& out);
+    serialize(const byte_t* packet_content,
+              const data_len_t len,
+              std::ostream& out,
+              const message_type_t type = message_type_t());
+    static inline bool
+    serialize(const byte_t* packet_content,
+              const data_len_t len,
+              std::vector<byte_t>& out,
+              const message_type_t type = message_type_t());
+
+    /**
+     * @brief Returns the number of bytes a packet with a content of len bytes occupies
+     *        after being serialized without compression
+     * @param len the length of the packet content
+     * @return the serialized size of the packet
+     */
+    static inline std::size_t
+    serializedSize(const data_len_t len);
+
+    /**
+     * @brief Writes the header of a packet (head pattern, data length, flags and message
+     *        type) into out which must have at least HEADER_MAX_SIZE bytes available
+     * @param len   The length of the packet content (as written on the wire)
+     * @param out   Where to write the header
+     * @param flags The flags of the packet (ignored if the configuration has no flags)
+     * @param type  The message type (ignored if the configuration has none)
+     * @return the number of bytes written
+     */
+    static inline std::size_t
+    writeHeader(const data_len_t len,
+                byte_t* out,
+                const byte_t flags = 0,
+                const message_type_t type = message_type_t());
+
+    /**
+     * @brief Writes the trailer of a packet (checksum and tail pattern) into out which
+     *        must have at least TRAILER_SIZE bytes available
+     * @param checksum_value  The checksum of the content (ignored without checksum)
+     * @param out             Where to write the trailer
+     * @return the number of bytes written
+     */
+    static inline std::size_t
+    writeTrailer(const checksum_t checksum_value, byte_t* out);
+
+    /**
+     * @brief Writes a full serialized (uncompressed) packet into out which must have at
+     *        least serializedSize(len) bytes available. No checks are done on the content
+     * @param packet_content  The packet content
+     * @param len             The len of the packet content
+     * @param out             Where to write the packet
+     * @param type            The message type (ignored if the configuration has none)
+     * @return the number of bytes written
+     */
+    static inline std::size_t
+    writeFrame(const byte_t* packet_content,
+               const data_len_t len,
+               byte_t* out,
+               const message_type_t type = message_type_t());
+
+    /**
+     * @brief Inspects a contiguous buffer that should start with a serialized packet
+     *        without copying any data.
+     * @param buffer  The buffer to inspect
+     * @param len     The number of bytes available on the buffer
+     * @param info    The description of the frame. On COMPLETE all the fields are set, on
+     *                INCOMPLETE only frame_size is (the minimum bytes needed to continue)
+     * @return COMPLETE if the full packet is on the buffer, INCOMPLETE if more data is
+     *         needed, INVALID if the data is not a valid packet
+     */
+    static inline Status
+    peekFrame(const byte_t* buffer, const std::size_t len, FrameInfo& info);
+
+    /**
+     * @brief Decompresses the content of a packet flagged with FLAG_COMPRESSED (for example
+     *        one found with peekFrame())
+     * @param content The content as it is on the wire
+     * @param len     The length of the content
+     * @param out     Where the original content is written (resized to its length)
+     * @param type    The message type of the packet (FrameInfo::message_type), its limits
+     *                are checked on the original length before anything is allocated
+     * @return true on success | false if the content is malformed or the message type
+     *         refuses its original length
+     */
     static inline bool
-    serialize(const byte_t* packet_content, const data_len_t len, std::vector<byte_t>& out);
+    decompress(const byte_t* content,
+               const std::size_t len,
+               Buffer& out,
+               const message_type_t type = message_type_t());
 
 
   private:
@@ -135,16 +398,50 @@ class PacketT {
     enum class State {
       HEAD_PATTERN = 0,
       DATA_SIZE,
+      FLAGS,
       DATA,
+      CHECKSUM,
       TAIL_PATTERN,
+      // read after FLAGS, last here to keep the indexes of the metrics
+      MESSAGE_TYPE,
       NONE,
     };
 
+    static_assert(std::size_t(State::NONE) + 1 == MetricsSnapshot::STATES_COUNT,
+                  "the metrics count the invalid packets per state");
+
+    // the parts of the header / content being read, on the packet storage
+    using BufferPart = BufferPartT<storage_t>;
+
   private:
 
     inline void
     newDataAdded(void);
 
+    inline void
+    markInvalid(void);
+
+    inline bool
+    isStreamingData(void) const;
+
+    inline void
+    setupStreamingPart(void);
+
+    inline std::size_t
+    streamData(const byte_t* data, const std::size_t len);
+
+    inline void
+    updateChecksum(const byte_t* data, const std::size_t len);
+
+    inline bool
+    decompressContent(void);
+
+    static inline bool
+    serializeCompressed(const byte_t* packet_content,
+                        const data_len_t len,
+                        std::vector<byte_t>& out,
+                        const message_type_t type);
+
     inline bool
     canAddMoreData(void) const;
 
@@ -154,19 +451,40 @@ class PacketT {
     inline void
     setupState(const State state);
 
-    inline bool
-    verifyCurrentStateData(void) const;
+    inline Status
+    verifyCurrentStateData(void);
 
     inline std::size_t
     dataPtrIndex(void) const;
 
+    inline void
+    ensureCapacity(const std::size_t capacity);
+
+    inline void
+    growBuffer(const std::size_t len);
+
+    inline void
+    restart(void);
+
   private:
     State reading_state_;
     Status status_;
-    std::vector<byte_t> buffer_;
+    storage_t buffer_;
     BufferPart buffer_part_;
     data_len_t pkt_data_len_;
     std::size_t current_data_idx_;
+    std::size_t data_offset_;
+    DataSink data_sink_;
+    bool streaming_;
+    std::size_t streamed_len_;
+    checksum_t checksum_state_;
+    byte_t flags_;
+    message_type_t message_type_;
+    // appendData() calls of the current packet (only kept with metrics)
+    detail::AppendCounter<metrics::ENABLED> append_calls_;
+    // when the first byte of the current packet arrived (only kept with tracing)
+    detail::TraceStamp<tracing::ENABLED> first_byte_;
+    Buffer decompressed_;
 };
 
 
@@ -8,24 +8,141 @@ PacketT<Cfg>::newDataAdded(void)
   if (!canAddMoreData()) {
     return;
   }
-  if (!buffer_part_.isFull()) {
-    return;
-  }
-  current_data_idx_ += buffer_part_.dataSize();
+  // empty parts (for example a packet without content) are completed right away
+  while (reading_state_ != State::NONE && buffer_part_.isFull()) {
+    current_data_idx_ += buffer_part_.dataSize();
 
-  if (!verifyCurrentStateData()) {
-    PKT_LOG_ERROR("packet is not valid for state " << int(reading_state_));
-    reading_state_ = State::NONE;
-    status_ = Status::INVALID;
-  } else {
-    setupState(nextState());
-    if (reading_state_ == State::NONE) {
-      // we finish
-      status_ = Status::COMPLETE;
+    const Status state_status = verifyCurrentStateData();
+    if (state_status == Status::INVALID) {
+      markInvalid();
+    } else if (state_status == Status::INCOMPLETE) {
+      // the state needs more bytes (variable size fields)
+      setupState(reading_state_);
+    } else {
+      setupState(nextState());
+      if (reading_state_ == State::NONE) {
+        // we finish
+        if (isCompressed() && !streaming_ && !decompressContent()) {
+          markInvalid();
+        } else {
+          status_ = Status::COMPLETE;
+          metrics::onPacket(append_calls_.value());
+          tracing::recordAssembly(tracing::now() - first_byte_.value());
+        }
+      }
     }
   }
 }
 
+template<typename Cfg>
+inline void
+PacketT<Cfg>::markInvalid(void)
+{
+  PKT_LOG_ERROR("packet is not valid for state " << int(reading_state_));
+  metrics::onInvalid(std::size_t(reading_state_));
+  reading_state_ = State::NONE;
+  status_ = Status::INVALID;
+  buffer_part_ = BufferPart();
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::isStreamingData(void) const
+{
+  return streaming_ && reading_state_ == State::DATA;
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::setupStreamingPart(void)
+{
+  // the part is just a scratch window for direct writes, the content is not kept
+  const std::size_t remaining = std::size_t(pkt_data_len_) - streamed_len_;
+  buffer_part_ = BufferPart(&buffer_,
+                            data_offset_,
+                            std::min(remaining, std::size_t(Cfg::MAX_RESERVE_AHEAD)));
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::streamData(const byte_t* data, const std::size_t len)
+{
+  const std::size_t to_send = std::min(len, std::size_t(pkt_data_len_) - streamed_len_);
+  updateChecksum(data, to_send);
+  if (to_send > 0 && !data_sink_(data, to_send)) {
+    markInvalid();
+    return to_send;
+  }
+  streamed_len_ += to_send;
+  setupStreamingPart();
+  newDataAdded();
+  return to_send;
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::updateChecksum(const byte_t* data, const std::size_t len)
+{
+  if (CHECKSUM_SIZE > 0 && len > 0) {
+    checksum_state_ = checksum::update(checksum_state_, data, len);
+  }
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::decompressContent(void)
+{
+  if (!decompress(buffer_.data() + data_offset_, pkt_data_len_, decompressed_, message_type_)) {
+    return false;
+  }
+  // the content is all we keep, the old buffer is reused for the next packet
+  buffer_.exchange(decompressed_);
+  data_offset_ = 0;
+  pkt_data_len_ = data_len_t(buffer_.size());
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::serializeCompressed(const byte_t* packet_content,
+                                  const data_len_t len,
+                                  std::vector<byte_t>& out,
+                                  const message_type_t type)
+{
+  // the content is compressed straight into its final place assuming the biggest header,
+  // the header is written right after once we know the compressed size
+  const std::size_t raw_len_size = length_codec::encodedSize(len);
+  const std::size_t bound = compression::maxCompressedSize(len);
+  out.resize(HEADER_MAX_SIZE + raw_len_size + bound + TRAILER_SIZE);
+  byte_t* content = out.data() + HEADER_MAX_SIZE;
+  length_codec::encode(len, content);
+  const std::size_t compressed = compression::compress(packet_content,
+                                                       len,
+                                                       content + raw_len_size,
+                                                       bound);
+  const std::size_t wire_len = raw_len_size + compressed;
+  if (compressed == 0 || wire_len >= len) {
+    // not worth it
+    out.clear();
+    return false;
+  }
+
+  const std::size_t header_size = HEAD_PATTERN_SIZE +
+                                  length_codec::encodedSize(data_len_t(wire_len)) +
+                                  FLAGS_SIZE +
+                                  TYPE_SIZE;
+  if (header_size < HEADER_MAX_SIZE) {
+    // only variable size lengths can end up here
+    std::memmove(out.data() + header_size, content, wire_len);
+    content = out.data() + header_size;
+  }
+  writeHeader(data_len_t(wire_len), out.data(), FLAG_COMPRESSED, type);
+  const checksum_t checksum_value = checksum::finish(checksum::update(checksum::init(), content, wire_len));
+  const std::size_t trailer_size = writeTrailer(checksum_value, content + wire_len);
+  out.resize(header_size + wire_len + trailer_size);
+  return true;
+}
+
 template<typename Cfg>
 inline bool
 PacketT<Cfg>::canAddMoreData(void) const
@@ -39,8 +156,13 @@ PacketT<Cfg>::nextState(void) const
 {
   switch (reading_state_) {
     case State::HEAD_PATTERN: return State::DATA_SIZE;
-    case State::DATA_SIZE: return State::DATA;
-    case State::DATA: return (TAIL_PATTERN_SIZE > 0 ? State::TAIL_PATTERN : State::NONE);
+    case State::DATA_SIZE: return (FLAGS_SIZE > 0 ? State::FLAGS :
+                                   TYPE_SIZE > 0 ? State::MESSAGE_TYPE : State::DATA);
+    case State::FLAGS: return (TYPE_SIZE > 0 ? State::MESSAGE_TYPE : State::DATA);
+    case State::MESSAGE_TYPE: return State::DATA;
+    case State::DATA: return (CHECKSUM_SIZE > 0 ? State::CHECKSUM :
+                              TAIL_PATTERN_SIZE > 0 ? State::TAIL_PATTERN : State::NONE);
+    case State::CHECKSUM: return (TAIL_PATTERN_SIZE > 0 ? State::TAIL_PATTERN : State::NONE);
     case State::TAIL_PATTERN: return State::NONE;
     default:
       PKT_ASSERT(false && "invalid state");
@@ -59,14 +181,37 @@ PacketT<Cfg>::setupState(const State state)
       break;
     }
     case State::DATA_SIZE: {
-      buffer_part_ = BufferPart(&buffer_, current_data_idx_, sizeof(data_len_t));
+      // variable size lengths are read byte by byte after the minimum size
+      const std::size_t read = current_data_idx_ - HEAD_PATTERN_SIZE;
+      buffer_part_ = BufferPart(&buffer_, current_data_idx_, read == 0 ? length_codec::MIN_SIZE : 1);
+      break;
+    }
+    case State::FLAGS: {
+      buffer_part_ = BufferPart(&buffer_, current_data_idx_, FLAGS_SIZE);
+      break;
+    }
+    case State::MESSAGE_TYPE: {
+      buffer_part_ = BufferPart(&buffer_, current_data_idx_, TYPE_SIZE);
       break;
     }
     case State::DATA: {
-      pkt_data_len_ = ntohl((*buffer_part_.parseAs<data_len_t>()));
+      data_offset_ = current_data_idx_;
+      checksum_state_ = checksum::init();
+      streaming_ = bool(data_sink_);
+      if (streaming_) {
+        streamed_len_ = 0;
+        setupStreamingPart();
+        break;
+      }
+      ensureCapacity(current_data_idx_ + std::min(std::size_t(pkt_data_len_) + TRAILER_SIZE,
+                                                  std::size_t(Cfg::MAX_RESERVE_AHEAD)));
       buffer_part_ = BufferPart(&buffer_, current_data_idx_, pkt_data_len_);
       break;
     }
+    case State::CHECKSUM: {
+      buffer_part_ = BufferPart(&buffer_, current_data_idx_, CHECKSUM_SIZE);
+      break;
+    }
     case State::TAIL_PATTERN: {
       buffer_part_ = BufferPart(&buffer_, current_data_idx_, TAIL_PATTERN_SIZE);
       break;
@@ -79,28 +224,87 @@ PacketT<Cfg>::setupState(const State state)
 }
 
 template<typename Cfg>
-inline bool
-PacketT<Cfg>::verifyCurrentStateData(void) const
+inline Status
+PacketT<Cfg>::verifyCurrentStateData(void)
 {
+  const auto result = [](const bool valid) { return valid ? Status::COMPLETE : Status::INVALID; };
   switch (reading_state_) {
-    case State::HEAD_PATTERN: return std::memcmp(Cfg::HEAD_PATTERN, buffer_part_.buffer(), std::min(std::size_t(HEAD_PATTERN_SIZE), buffer_part_.dataSize())) == 0;
+    case State::HEAD_PATTERN: return result(std::memcmp(Cfg::HEAD_PATTERN, buffer_part_.buffer(), std::min(std::size_t(HEAD_PATTERN_SIZE), buffer_part_.dataSize())) == 0);
     case State::DATA_SIZE: {
-      const data_len_t len = ntohl(*buffer_part_.parseAs<data_len_t>());
-      return len <= Cfg::MAX_DATA_LEN;
+      std::size_t size = 0;
+      const Status len_status = length_codec::decode(buffer_.data() + HEAD_PATTERN_SIZE,
+                                                     current_data_idx_ - HEAD_PATTERN_SIZE,
+                                                     pkt_data_len_,
+                                                     size);
+      if (len_status != Status::COMPLETE) {
+        return len_status;
+      }
+      return result(pkt_data_len_ <= Cfg::MAX_DATA_LEN);
+    }
+    case State::FLAGS: {
+      flags_ = buffer_part_.buffer()[0];
+      return result((flags_ & ~FLAG_COMPRESSED) == 0);
+    }
+    case State::MESSAGE_TYPE: {
+      // the content is not here yet, unknown types and lengths over their limit stop now
+      message_type_ = message_type::read(buffer_part_.buffer());
+      return result(message_type::accept(message_type_, std::size_t(pkt_data_len_)));
     }
-    case State::DATA: return true;
-    case State::TAIL_PATTERN: return std::memcmp(Cfg::TAIL_PATTERN, buffer_part_.buffer(), std::min(std::size_t(TAIL_PATTERN_SIZE), buffer_part_.dataSize())) == 0;
+    case State::DATA: return Status::COMPLETE;
+    case State::CHECKSUM: return result(checksum::read(buffer_part_.buffer()) == checksum::finish(checksum_state_));
+    case State::TAIL_PATTERN: return result(std::memcmp(Cfg::TAIL_PATTERN, buffer_part_.buffer(), std::min(std::size_t(TAIL_PATTERN_SIZE), buffer_part_.dataSize())) == 0);
     default:
       PKT_ASSERT(false && "invalid state");
   }
-  return false;
+  return Status::INVALID;
 }
 
 template<typename Cfg>
 inline std::size_t
 PacketT<Cfg>::dataPtrIndex(void) const
 {
-  return HEAD_PATTERN_SIZE + sizeof(data_len_t);
+  return data_offset_;
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::ensureCapacity(const std::size_t capacity)
+{
+  if (buffer_.capacity() >= capacity) {
+    return;
+  }
+  // the storage moves what we have into a bigger buffer from the policy
+  buffer_.reserve(capacity);
+  metrics::onReallocation(buffer_.capacity());
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::growBuffer(const std::size_t len)
+{
+  const std::size_t needed = current_data_idx_ + buffer_part_.dataSize() + len;
+  if (buffer_.capacity() >= needed) {
+    return;
+  }
+  // grow geometrically but never beyond the end of the packet
+  std::size_t capacity = std::max(needed, 2 * buffer_.capacity());
+  if (reading_state_ == State::DATA ||
+      reading_state_ == State::CHECKSUM ||
+      reading_state_ == State::TAIL_PATTERN) {
+    capacity = std::min(capacity, dataPtrIndex() + std::size_t(pkt_data_len_) + TRAILER_SIZE);
+  }
+  ensureCapacity(capacity);
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::restart(void)
+{
+  // the storage was moved out: a policy buffer is only taken if the header does not fit
+  // inline
+  buffer_.clear();
+  buffer_.reserve(HEADER_MAX_SIZE);
+  reset();
 }
 
 
@@ -109,10 +313,128 @@ inline PacketT<Cfg>::PacketT() :
   status_(Status::INCOMPLETE)
 , pkt_data_len_(0)
 , current_data_idx_(0)
+, data_offset_(0)
+, streaming_(false)
+, streamed_len_(0)
+, checksum_state_(checksum::init())
+, flags_(0)
+, message_type_(0)
 {
+  buffer_.reserve(HEADER_MAX_SIZE);
   setupState(HEAD_PATTERN_SIZE > 0 ? State::HEAD_PATTERN : State::DATA_SIZE);
 }
 
+template<typename Cfg>
+inline PacketT<Cfg>::~PacketT()
+{
+  buffer_policy::release(std::move(decompressed_));
+}
+
+template<typename Cfg>
+inline PacketT<Cfg>::PacketT(const PacketT& other) :
+  reading_state_(other.reading_state_)
+, status_(other.status_)
+, buffer_(other.buffer_)
+, buffer_part_(other.buffer_part_)
+, pkt_data_len_(other.pkt_data_len_)
+, current_data_idx_(other.current_data_idx_)
+, data_offset_(other.data_offset_)
+, data_sink_(other.data_sink_)
+, streaming_(other.streaming_)
+, streamed_len_(other.streamed_len_)
+, checksum_state_(other.checksum_state_)
+, flags_(other.flags_)
+, message_type_(other.message_type_)
+, append_calls_(other.append_calls_)
+, first_byte_(other.first_byte_)
+, decompressed_(other.decompressed_)
+{
+  // the part only keeps indexes, it just has to point to our buffer
+  buffer_part_.rebind(&buffer_);
+}
+
+template<typename Cfg>
+inline PacketT<Cfg>::PacketT(PacketT&& other) noexcept :
+  reading_state_(other.reading_state_)
+, status_(other.status_)
+, buffer_(std::move(other.buffer_))
+, buffer_part_(other.buffer_part_)
+, pkt_data_len_(other.pkt_data_len_)
+, current_data_idx_(other.current_data_idx_)
+, data_offset_(other.data_offset_)
+, data_sink_(std::move(other.data_sink_))
+, streaming_(other.streaming_)
+, streamed_len_(other.streamed_len_)
+, checksum_state_(other.checksum_state_)
+, flags_(other.flags_)
+, message_type_(other.message_type_)
+, append_calls_(other.append_calls_)
+, first_byte_(other.first_byte_)
+, decompressed_(std::move(other.decompressed_))
+{
+  buffer_part_.rebind(&buffer_);
+  other.data_sink_ = DataSink();
+  // the storage was moved out, it is reserved again by the next appendData() /
+  // remainingBuffer() (nothing is allocated here)
+  other.reset();
+}
+
+template<typename Cfg>
+inline PacketT<Cfg>&
+PacketT<Cfg>::operator=(const PacketT& other)
+{
+  if (this != &other) {
+    reading_state_ = other.reading_state_;
+    status_ = other.status_;
+    buffer_ = other.buffer_;
+    buffer_part_ = other.buffer_part_;
+    buffer_part_.rebind(&buffer_);
+    pkt_data_len_ = other.pkt_data_len_;
+    current_data_idx_ = other.current_data_idx_;
+    data_offset_ = other.data_offset_;
+    data_sink_ = other.data_sink_;
+    streaming_ = other.streaming_;
+    streamed_len_ = other.streamed_len_;
+    checksum_state_ = other.checksum_state_;
+    flags_ = other.flags_;
+    message_type_ = other.message_type_;
+    append_calls_ = other.append_calls_;
+    first_byte_ = other.first_byte_;
+    decompressed_ = other.decompressed_;
+  }
+  return *this;
+}
+
+template<typename Cfg>
+inline PacketT<Cfg>&
+PacketT<Cfg>::operator=(PacketT&& other) noexcept
+{
+  if (this != &other) {
+    reading_state_ = other.reading_state_;
+    status_ = other.status_;
+    buffer_ = std::move(other.buffer_);
+    buffer_part_ = other.buffer_part_;
+    buffer_part_.rebind(&buffer_);
+    pkt_data_len_ = other.pkt_data_len_;
+    current_data_idx_ = other.current_data_idx_;
+    data_offset_ = other.data_offset_;
+    data_sink_ = std::move(other.data_sink_);
+    streaming_ = other.streaming_;
+    streamed_len_ = other.streamed_len_;
+    checksum_state_ = other.checksum_state_;
+    flags_ = other.flags_;
+    message_type_ = other.message_type_;
+    append_calls_ = other.append_calls_;
+    first_byte_ = other.first_byte_;
+    // the scratch buffers are swapped, giving one back to the policy could allocate
+    decompressed_.swap(other.decompressed_);
+    other.decompressed_.clear();
+    other.data_sink_ = DataSink();
+    other.reset();
+  }
+  return *this;
+}
+
 
 template<typename Cfg>
 inline Status
@@ -128,16 +450,46 @@ PacketT<Cfg>::reset(void)
   status_ = Status::INCOMPLETE;
   pkt_data_len_ = 0;
   current_data_idx_ = 0;
+  data_offset_ = 0;
+  streaming_ = false;
+  streamed_len_ = 0;
+  flags_ = 0;
+  message_type_ = 0;
+  append_calls_.clear();
+  first_byte_.clear();
   buffer_.clear();
   setupState(HEAD_PATTERN_SIZE > 0 ? State::HEAD_PATTERN : State::DATA_SIZE);
 }
 
+template<typename Cfg>
+inline void
+PacketT<Cfg>::setDataSink(DataSink sink)
+{
+  data_sink_ = std::move(sink);
+}
+
 template<typename Cfg>
 inline std::size_t
 PacketT<Cfg>::appendData(const byte_t* data, const std::size_t len)
 {
   PKT_ASSERT_PTR(data);
+  append_calls_.increment();
+  if (!first_byte_.isSet()) {
+    first_byte_.set(tracing::now());
+  }
+  if (isStreamingData()) {
+    // the content goes straight to the sink without copying it
+    const std::size_t streamed = streamData(data, len);
+    metrics::onAppend(streamed);
+    return streamed;
+  }
+  growBuffer(std::min(len, buffer_part_.remainingSize()));
   const std::size_t result = buffer_part_.append(data, len);
+  metrics::onAppend(result);
+  if (reading_state_ == State::DATA) {
+    // the source is still hot in cache
+    updateChecksum(data, result);
+  }
   newDataAdded();
   return result;
 }
@@ -146,6 +498,9 @@ template<typename Cfg>
 inline byte_t*
 PacketT<Cfg>::remainingBuffer(void)
 {
+  const std::size_t to_reserve = remainingBytes();
+  growBuffer(to_reserve);
+  buffer_part_.reserveAhead(to_reserve);
   return buffer_part_.remainingBuffer();
 }
 
@@ -153,14 +508,26 @@ template<typename Cfg>
 inline std::size_t
 PacketT<Cfg>::remainingBytes(void) const
 {
-  return buffer_part_.remainingSize();
+  return std::min(buffer_part_.remainingSize(), std::size_t(Cfg::MAX_RESERVE_AHEAD));
 }
 
 template<typename Cfg>
 inline std::size_t
 PacketT<Cfg>::updateDataOffset(const std::size_t data_len_added)
 {
+  const std::size_t previous_size = buffer_part_.dataSize();
   const std::size_t result = buffer_part_.updateDataOffset(data_len_added);
+  metrics::onAppend(result);
+  append_calls_.increment();
+  if (!first_byte_.isSet()) {
+    first_byte_.set(tracing::now());
+  }
+  if (isStreamingData()) {
+    return streamData(buffer_part_.buffer(), result);
+  }
+  if (reading_state_ == State::DATA) {
+    updateChecksum(buffer_part_.buffer() + previous_size, result);
+  }
   newDataAdded();
   return result;
 }
@@ -178,55 +545,295 @@ template<typename Cfg>
 inline const byte_t*
 PacketT<Cfg>::data(void) const
 {
-  return dataLen() == 0 ? nullptr : &(buffer_[dataPtrIndex()]);
+  return (dataLen() == 0 || streaming_) ? nullptr : &(buffer_[dataPtrIndex()]);
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::isCompressed(void) const
+{
+  return (flags_ & FLAG_COMPRESSED) != 0;
 }
 
 template<typename Cfg>
 inline bool
-PacketT<Cfg>::serialize(const byte_t* packet_content, const data_len_t len, std::ostream& out)
+PacketT<Cfg>::hasMessageType(void) const
+{
+  // the field is read right before the content
+  return TYPE_SIZE > 0 &&
+         (status_ == Status::COMPLETE ||
+          reading_state_ == State::DATA ||
+          reading_state_ == State::CHECKSUM ||
+          reading_state_ == State::TAIL_PATTERN);
+}
+
+template<typename Cfg>
+inline typename PacketT<Cfg>::message_type_t
+PacketT<Cfg>::messageType(void) const
+{
+  return message_type_;
+}
+
+template<typename Cfg>
+inline const typename PacketT<Cfg>::storage_t&
+PacketT<Cfg>::allData(void) const
+{
+  return buffer_;
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::dataOffset(void) const
+{
+  return dataPtrIndex();
+}
+
+template<typename Cfg>
+inline Buffer
+PacketT<Cfg>::detachBuffer(void)
+{
+  Buffer result = buffer_.detach();
+  restart();
+  return result;
+}
+
+template<typename Cfg>
+inline PacketPayload
+PacketT<Cfg>::takePayload(void)
+{
+  PacketPayload payload;
+  if (status_ != Status::COMPLETE || streaming_) {
+    return payload;
+  }
+  payload.offset = dataOffset();
+  payload.len = dataLen();
+  payload.message_type = message_type_;
+  payload.buffer = detachBuffer();
+  return payload;
+}
+
+template<typename Cfg>
+inline void
+PacketT<Cfg>::recycleBuffer(Buffer&& buffer)
+{
+  buffer_policy::release(std::move(buffer));
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::serialize(const byte_t* packet_content,
+                        const data_len_t len,
+                        std::ostream& out,
+                        const message_type_t type)
 {
   if (packet_content == nullptr || len == 0 || len > Cfg::MAX_DATA_LEN) {
       return false;
   }
-  if (HEAD_PATTERN_SIZE > 0) {
-    out.write(Cfg::HEAD_PATTERN, HEAD_PATTERN_SIZE);
+  if (compression::ENABLED && len >= compression::MIN_SIZE) {
+    static thread_local std::vector<byte_t> frame;
+    if (serializeCompressed(packet_content, len, frame, type)) {
+      out.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+      metrics::onSerialized(frame.size());
+      return true;
+    }
   }
-
-  const data_len_t wire_len = htonl(len);
-  out.write(reinterpret_cast<const char*>(&wire_len), sizeof(data_len_t));
+  byte_t header[HEADER_MAX_SIZE];
+  const std::size_t header_size = writeHeader(len, header, 0, type);
+  out.write(reinterpret_cast<const char*>(header), header_size);
   out.write(reinterpret_cast<const char*>(packet_content), len);
 
-  if (TAIL_PATTERN_SIZE > 0) {
-    out.write(Cfg::TAIL_PATTERN, HEAD_PATTERN_SIZE);
+  if (TRAILER_SIZE > 0) {
+    byte_t trailer[TRAILER_SIZE > 0 ? TRAILER_SIZE : 1];
+    const checksum_t checksum_value = checksum::finish(checksum::update(checksum::init(), packet_content, len));
+    out.write(reinterpret_cast<const char*>(trailer), writeTrailer(checksum_value, trailer));
   }
+  metrics::onSerialized(serializedSize(len));
   return true;
 }
 
 template<typename Cfg>
 inline bool
-PacketT<Cfg>::serialize(const byte_t* packet_content, const data_len_t len, std::vector<byte_t>& out)
+PacketT<Cfg>::serialize(const byte_t* packet_content,
+                        const data_len_t len,
+                        std::vector<byte_t>& out,
+                        const message_type_t type)
 {
     out.clear();
     if (packet_content == nullptr || len == 0 || len > Cfg::MAX_DATA_LEN) {
         return false;
     }
-    const std::size_t total_size = HEAD_PATTERN_SIZE + TAIL_PATTERN_SIZE + sizeof(data_len_t) + len;
-    out.resize(total_size);
-    BufferPart buffer(&out, 0, total_size, true);
-
-    if (HEAD_PATTERN_SIZE > 0) {
-      buffer.append(reinterpret_cast<const byte_t*>(Cfg::HEAD_PATTERN), HEAD_PATTERN_SIZE);
+    if (compression::ENABLED && len >= compression::MIN_SIZE &&
+        serializeCompressed(packet_content, len, out, type)) {
+      metrics::onSerialized(out.size());
+      return true;
     }
+    out.resize(serializedSize(len));
+    writeFrame(packet_content, len, out.data(), type);
+    return true;
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::serializedSize(const data_len_t len)
+{
+  return HEAD_PATTERN_SIZE + length_codec::encodedSize(len) + FLAGS_SIZE + TYPE_SIZE + std::size_t(len) + TRAILER_SIZE;
+}
 
-    const data_len_t wire_len = htonl(len);
-    buffer.append(reinterpret_cast<const byte_t*>(&wire_len), sizeof(data_len_t));
-    buffer.append(packet_content, len);
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::writeHeader(const data_len_t len,
+                          byte_t* out,
+                          const byte_t flags,
+                          const message_type_t type)
+{
+  PKT_ASSERT_PTR(out);
+  if (HEAD_PATTERN_SIZE > 0) {
+    std::memcpy(out, Cfg::HEAD_PATTERN, HEAD_PATTERN_SIZE);
+  }
+  const std::size_t size = HEAD_PATTERN_SIZE + length_codec::encode(len, out + HEAD_PATTERN_SIZE);
+  if (FLAGS_SIZE > 0) {
+    out[size] = flags;
+  }
+  if (TYPE_SIZE > 0) {
+    message_type::write(type, out + size + FLAGS_SIZE);
+  }
+  return size + FLAGS_SIZE + TYPE_SIZE;
+}
 
-    if (TAIL_PATTERN_SIZE > 0) {
-      buffer.append(reinterpret_cast<const byte_t*>(Cfg::TAIL_PATTERN), HEAD_PATTERN_SIZE);
-    }
-    return true;
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::writeTrailer(const checksum_t checksum_value, byte_t* out)
+{
+  if (CHECKSUM_SIZE > 0) {
+    checksum::write(checksum_value, out);
+  }
+  if (TAIL_PATTERN_SIZE > 0) {
+    std::memcpy(out + CHECKSUM_SIZE, Cfg::TAIL_PATTERN, TAIL_PATTERN_SIZE);
+  }
+  return TRAILER_SIZE;
 }
 
+template<typename Cfg>
+inline std::size_t
+PacketT<Cfg>::writeFrame(const byte_t* packet_content,
+                         const data_len_t len,
+                         byte_t* out,
+                         const message_type_t type)
+{
+  std::size_t offset = writeHeader(len, out, 0, type);
+  metrics::onSerialized(serializedSize(len));
+  if (CHECKSUM_SIZE == 0) {
+    std::memcpy(out + offset, packet_content, len);
+    offset += len;
+    return offset + writeTrailer(checksum_t(), out + offset);
+  }
 
+  // copy and checksum block by block so the data is read from memory only once
+  static constexpr std::size_t BLOCK_SIZE = 16 * 1024;
+  checksum_t checksum_state = checksum::init();
+  for (std::size_t copied = 0; copied < len; copied += BLOCK_SIZE) {
+    const std::size_t block = std::min(BLOCK_SIZE, std::size_t(len) - copied);
+    std::memcpy(out + offset, packet_content + copied, block);
+    checksum_state = checksum::update(checksum_state, out + offset, block);
+    offset += block;
+  }
+  return offset + writeTrailer(checksum::finish(checksum_state), out + offset);
+}
 
+template<typename Cfg>
+inline Status
+PacketT<Cfg>::peekFrame(const byte_t* buffer, const std::size_t len, FrameInfo& info)
+{
+  PKT_ASSERT_PTR(buffer);
+  if (std::memcmp(Cfg::HEAD_PATTERN, buffer, std::min(std::size_t(HEAD_PATTERN_SIZE), len)) != 0) {
+    return Status::INVALID;
+  }
+  if (len < HEAD_PATTERN_SIZE + length_codec::MIN_SIZE) {
+    info.frame_size = HEAD_PATTERN_SIZE + length_codec::MIN_SIZE;
+    return Status::INCOMPLETE;
+  }
+
+  data_len_t data_len = 0;
+  std::size_t len_size = 0;
+  const Status len_status = length_codec::decode(buffer + HEAD_PATTERN_SIZE,
+                                                 len - HEAD_PATTERN_SIZE,
+                                                 data_len,
+                                                 len_size);
+  if (len_status == Status::INCOMPLETE) {
+    info.frame_size = HEAD_PATTERN_SIZE + len_size;
+    return Status::INCOMPLETE;
+  }
+  if (len_status == Status::INVALID || data_len > Cfg::MAX_DATA_LEN) {
+    return Status::INVALID;
+  }
+
+  info.flags = 0;
+  info.message_type = 0;
+  if (FLAGS_SIZE > 0) {
+    if (len < HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE) {
+      info.frame_size = HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE;
+      return Status::INCOMPLETE;
+    }
+    info.flags = buffer[HEAD_PATTERN_SIZE + len_size];
+    if ((info.flags & ~FLAG_COMPRESSED) != 0) {
+      return Status::INVALID;
+    }
+  }
+  if (TYPE_SIZE > 0) {
+    if (len < HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE + TYPE_SIZE) {
+      info.frame_size = HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE + TYPE_SIZE;
+      return Status::INCOMPLETE;
+    }
+    const message_type_t type = message_type::read(buffer + HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE);
+    if (!message_type::accept(type, std::size_t(data_len))) {
+      return Status::INVALID;
+    }
+    info.message_type = type;
+  }
+
+  const std::size_t header_size = HEAD_PATTERN_SIZE + len_size + FLAGS_SIZE + TYPE_SIZE;
+  info.data_offset = header_size;
+  info.data_len = data_len;
+  info.frame_size = header_size + std::size_t(data_len) + TRAILER_SIZE;
+  if (len < info.frame_size) {
+    return Status::INCOMPLETE;
+  }
+
+  const byte_t* trailer = buffer + header_size + data_len;
+  if (std::memcmp(Cfg::TAIL_PATTERN, trailer + CHECKSUM_SIZE, TAIL_PATTERN_SIZE) != 0) {
+    return Status::INVALID;
+  }
+  if (CHECKSUM_SIZE > 0 &&
+      checksum::read(trailer) != checksum::finish(checksum::update(checksum::init(), buffer + header_size, data_len))) {
+    return Status::INVALID;
+  }
+  return Status::COMPLETE;
+}
+
+template<typename Cfg>
+inline bool
+PacketT<Cfg>::decompress(const byte_t* content,
+                         const std::size_t len,
+                         Buffer& out,
+                         const message_type_t type)
+{
+  PKT_ASSERT(content != nullptr || len == 0);
+  data_len_t raw_len = 0;
+  std::size_t len_size = 0;
+  if (length_codec::decode(content, len, raw_len, len_size) != Status::COMPLETE ||
+      raw_len == 0 ||
+      raw_len > Cfg::MAX_DATA_LEN) {
+    return false;
+  }
+  // a corrupted raw length should not make us allocate more than the data can expand to
+  const std::size_t compressed_len = len - len_size;
+  if (std::size_t(raw_len) > compression::maxExpandedSize(compressed_len)) {
+    return false;
+  }
+  // the type limits were checked on the wire length, now on the original one
+  if (!message_type::accept(type, std::size_t(raw_len))) {
+    return false;
+  }
+  out.resize(raw_len);
+  return compression::decompress(content + len_size, compressed_len, out.data(), raw_len);
+}
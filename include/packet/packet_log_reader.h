@@ -0,0 +1,164 @@
+#ifndef PACKET_PACKET_LOG_READER_H_
+#define PACKET_PACKET_LOG_READER_H_
+
+#include <string>
+#include <cstdint>
+#include <cerrno>
+#include <algorithm>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/packet.h>
+#include <packet/log_index.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The PacketLogReaderT class gives random access to a log of packets (a file with
+ *        the concatenation of serialize() outputs, for example a traffic capture):
+ *        - the log is memory mapped and the packets are returned as views into it
+ *        - the first open walks the frames once to build the offset index (see LogIndex)
+ *          and persists it next to the log (path + ".idx"), later opens map the index
+ *          and only walk the bytes appended to the log since then
+ *        - view(n) is a lookup on the index (plus stride - 1 frame skips for sparse
+ *          indexes, like the ones written by the recorders)
+ *        A log ending with a partial packet (a recorder that was killed) is read up to the
+ *        last complete one. If corrupted data is found the packets before it are kept.
+ * @tparam Cfg  The configuration the log was written with
+ */
+template<typename Cfg>
+class PacketLogReaderT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+
+    /**
+     * @brief INDEX_SUFFIX is appended to the log path to get its index path
+     */
+    static constexpr const char* INDEX_SUFFIX = ".idx";
+
+  public:
+    inline PacketLogReaderT();
+    inline ~PacketLogReaderT();
+
+    // not copyable
+    PacketLogReaderT(const PacketLogReaderT&) = delete;
+    PacketLogReaderT& operator=(const PacketLogReaderT&) = delete;
+
+    /**
+     * @brief Opens a log, loading (and completing) or building its index
+     * @param path          The log file
+     * @param persist_index If true the index is written next to the log when it changes
+     * @param stride        The distance between index entries when the index is built
+     *                      (a loaded index keeps its own), 1 gives O(1) access
+     * @return true on success | false if the log can not be opened (errno is kept)
+     */
+    inline bool
+    open(const std::string& path, const bool persist_index = true, const std::uint32_t stride = 1);
+
+    /**
+     * @brief Unmaps the log
+     */
+    inline void
+    close(void);
+
+    /**
+     * @brief Returns true if a log is open
+     * @return true if a log is open
+     */
+    inline bool
+    isOpen(void) const;
+
+    /**
+     * @brief Returns the number of complete packets of the log
+     * @return the number of complete packets of the log
+     */
+    inline std::size_t
+    count(void) const;
+
+    /**
+     * @brief Returns the packet number index
+     * @param index The packet number (< count())
+     * @param view  The view of the content, pointing into the mapped log (or into an
+     *              internal buffer if the content was compressed, valid until the next
+     *              call). Mapped views are valid until close()
+     * @return true on success | false if index is out of range or the data is invalid
+     */
+    inline bool
+    view(const std::size_t index, PacketView& view);
+
+    /**
+     * @brief Returns the state of the end of the log: COMPLETE if it ends with a complete
+     *        packet, INCOMPLETE if it ends with a partial one, INVALID if corrupted data
+     *        was found (check indexedSize() for where)
+     * @return the state of the end of the log
+     */
+    inline Status
+    status(void) const;
+
+    /**
+     * @brief Returns the bytes of the log holding complete packets
+     * @return the bytes of the log holding complete packets
+     */
+    inline std::size_t
+    indexedSize(void) const;
+
+    /**
+     * @brief Returns true if the index was loaded from disk (possibly completed with the
+     *        packets appended since it was written)
+     * @return true if the index was loaded from disk
+     */
+    inline bool
+    indexLoaded(void) const;
+
+    /**
+     * @brief Returns the index path of a log
+     * @param path the log file
+     * @return the index path of the log
+     */
+    static inline std::string
+    indexPath(const std::string& path);
+
+
+  private:
+
+    inline bool
+    indexFrom(std::uint64_t offset, std::uint64_t packets_count);
+
+    // the hash of the first and last packets covered by the index (see LogIndex::framesHash())
+    inline std::uint64_t
+    coveredFramesHash(void) const;
+
+    // true if the loaded index describes this log
+    inline bool
+    indexMatches(const struct stat& file_stat) const;
+
+  private:
+    const byte_t* data_;
+    std::size_t size_;
+    LogIndex index_;
+    Status status_;
+    bool open_;
+    bool index_loaded_;
+    Buffer decompressed_;
+};
+
+
+
+#include <packet/packet_log_reader_impl.h>
+
+
+// Default definition of a log reader
+using DefaultPacketLogReader = PacketLogReaderT<DefaultConfig>;
+
+}
+
+#endif // PACKET_PACKET_LOG_READER_H_
@@ -0,0 +1,231 @@
+
+
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::indexFrom(std::uint64_t offset, std::uint64_t packets_count)
+{
+  const std::uint64_t start = offset;
+  const std::uint32_t stride = index_.stride();
+  std::uint64_t last_offset = index_.lastOffset();
+  status_ = Status::COMPLETE;
+  while (offset < size_) {
+    FrameInfo info;
+    const Status status = PacketType::peekFrame(data_ + offset, size_ - std::size_t(offset), info);
+    if (status != Status::COMPLETE) {
+      if (status == Status::INVALID) {
+        PKT_LOG_ERROR("invalid packet found on the log at offset " << offset);
+      }
+      status_ = status;
+      break;
+    }
+    if (packets_count % stride == 0) {
+      index_.addEntry(offset);
+    }
+    ++packets_count;
+    last_offset = offset;
+    offset += info.frame_size;
+  }
+  index_.setCoverage(packets_count, offset, last_offset);
+  return offset != start;
+}
+
+template<typename Cfg>
+inline std::uint64_t
+PacketLogReaderT<Cfg>::coveredFramesHash(void) const
+{
+  const std::size_t covered = std::size_t(index_.coveredSize());
+  if (index_.packetsCount() == 0) {
+    return LogIndex::framesHash(nullptr, 0, nullptr, 0);
+  }
+  FrameInfo first;
+  const std::size_t first_size = PacketType::peekFrame(data_, covered, first) == Status::COMPLETE ?
+      first.frame_size : covered;
+  const std::size_t last_offset = std::size_t(index_.lastOffset());
+  return LogIndex::framesHash(data_,
+                              std::min(first_size, std::size_t(LogIndex::IDENTITY_BYTES)),
+                              data_ + last_offset,
+                              std::min(covered - last_offset, std::size_t(LogIndex::IDENTITY_BYTES)));
+}
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::indexMatches(const struct stat& file_stat) const
+{
+  const std::uint64_t covered = index_.coveredSize();
+  if (covered > size_ || index_.fileId() != LogIndex::fileId(file_stat)) {
+    return false;
+  }
+  if (index_.packetsCount() == 0) {
+    return covered == 0;
+  }
+  // the last packet covered must still end where the index says, and the first and last
+  // ones be the same packets
+  const std::uint64_t last_offset = index_.lastOffset();
+  FrameInfo info;
+  return last_offset < covered &&
+         PacketType::peekFrame(data_ + last_offset, std::size_t(covered - last_offset), info) == Status::COMPLETE &&
+         last_offset + info.frame_size == covered &&
+         index_.framesHash() == coveredFramesHash();
+}
+
+
+template<typename Cfg>
+inline PacketLogReaderT<Cfg>::PacketLogReaderT() :
+  data_(nullptr)
+, size_(0)
+, status_(Status::COMPLETE)
+, open_(false)
+, index_loaded_(false)
+{}
+
+template<typename Cfg>
+inline PacketLogReaderT<Cfg>::~PacketLogReaderT()
+{
+  close();
+}
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::open(const std::string& path, const bool persist_index, const std::uint32_t stride)
+{
+  close();
+  const int fd = ::open(path.c_str(), O_RDONLY | O_CLOEXEC);
+  if (fd < 0) {
+    return false;
+  }
+  struct stat file_stat;
+  if (::fstat(fd, &file_stat) != 0) {
+    const int error = errno;
+    ::close(fd);
+    errno = error;
+    return false;
+  }
+  size_ = std::size_t(file_stat.st_size);
+  if (size_ > 0) {
+    void* mapping = ::mmap(nullptr, size_, PROT_READ, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+      const int error = errno;
+      ::close(fd);
+      size_ = 0;
+      errno = error;
+      return false;
+    }
+    data_ = static_cast<const byte_t*>(mapping);
+  }
+  ::close(fd);
+
+  const std::uint64_t fingerprint = LogIndex::fingerprint<Cfg>();
+  const std::string index_path = indexPath(path);
+  index_loaded_ = index_.load(index_path, fingerprint) && indexMatches(file_stat);
+  if (!index_loaded_) {
+    index_.reset(stride, fingerprint);
+  }
+  if (data_ != nullptr) {
+    // the walk is sequential, the later accesses random
+    ::madvise(const_cast<byte_t*>(data_), size_, MADV_SEQUENTIAL);
+  }
+  const bool changed = indexFrom(index_.coveredSize(), index_.packetsCount()) || !index_loaded_;
+  index_.setIdentity(LogIndex::fileId(file_stat), coveredFramesHash());
+  if (data_ != nullptr) {
+    ::madvise(const_cast<byte_t*>(data_), size_, MADV_RANDOM);
+  }
+  if (persist_index && changed && !index_.save(index_path)) {
+    // not fatal, the index is built again next time
+    PKT_LOG_ERROR("could not write the index " << index_path << ": " << errno);
+  }
+  open_ = true;
+  return true;
+}
+
+template<typename Cfg>
+inline void
+PacketLogReaderT<Cfg>::close(void)
+{
+  if (data_ != nullptr) {
+    ::munmap(const_cast<byte_t*>(data_), size_);
+    data_ = nullptr;
+  }
+  size_ = 0;
+  index_.reset(1, 0);
+  status_ = Status::COMPLETE;
+  open_ = false;
+  index_loaded_ = false;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::isOpen(void) const
+{
+  return open_;
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketLogReaderT<Cfg>::count(void) const
+{
+  return std::size_t(index_.packetsCount());
+}
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::view(const std::size_t index, PacketView& view)
+{
+  if (index >= count()) {
+    return false;
+  }
+  const std::uint32_t stride = index_.stride();
+  std::size_t offset = std::size_t(index_.entry(index / stride));
+  FrameInfo info;
+  for (std::size_t skip = index % stride; ; --skip) {
+    if (offset >= size_ || PacketType::peekFrame(data_ + offset, size_ - offset, info) != Status::COMPLETE) {
+      return false;
+    }
+    if (skip == 0) {
+      break;
+    }
+    offset += info.frame_size;
+  }
+  view.data = data_ + offset + info.data_offset;
+  view.len = info.data_len;
+  view.in_place = true;
+  view.message_type = info.message_type;
+  if ((info.flags & PacketType::FLAG_COMPRESSED) != 0) {
+    if (!PacketType::decompress(view.data, view.len, decompressed_,
+                                typename PacketType::message_type_t(info.message_type))) {
+      return false;
+    }
+    view.data = decompressed_.data();
+    view.len = decompressed_.size();
+    view.in_place = false;
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline Status
+PacketLogReaderT<Cfg>::status(void) const
+{
+  return status_;
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketLogReaderT<Cfg>::indexedSize(void) const
+{
+  return std::size_t(index_.coveredSize());
+}
+
+template<typename Cfg>
+inline bool
+PacketLogReaderT<Cfg>::indexLoaded(void) const
+{
+  return index_loaded_;
+}
+
+template<typename Cfg>
+inline std::string
+PacketLogReaderT<Cfg>::indexPath(const std::string& path)
+{
+  return path + INDEX_SUFFIX;
+}
@@ -0,0 +1,215 @@
+#ifndef PACKET_PACKET_LOG_WRITER_H_
+#define PACKET_PACKET_LOG_WRITER_H_
+
+#include <array>
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/log_index.h>
+#include <packet/packet_log_reader.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief When a PacketLogWriterT forces the written data to the disk (fdatasync)
+ */
+enum class SyncPolicy {
+  // left to the kernel
+  NONE,
+  // when the log is closed
+  ON_CLOSE,
+  // every time LogWriterOptions::sync_bytes were written since the last sync (and on close)
+  EVERY_BYTES,
+  // after every batch written
+  EVERY_BATCH
+};
+
+/**
+ * @brief The options of a PacketLogWriterT
+ */
+struct LogWriterOptions {
+    // the bytes gathered before writing them to the file (rounded up to DIRECT_ALIGNMENT)
+    std::size_t batch_size = 1024 * 1024;
+    // bypass the page cache (O_DIRECT), if the file system does not support it the log
+    // is written through the page cache (check PacketLogWriterT::isDirect())
+    bool direct = false;
+    SyncPolicy sync = SyncPolicy::ON_CLOSE;
+    std::size_t sync_bytes = 64 * 1024 * 1024;
+    // one index entry every index_stride packets, 0 to not write the index
+    std::uint32_t index_stride = 64;
+    // the index file is rewritten every index_interval packets (and on close), 0 for
+    // only on close
+    std::uint64_t index_interval = 1024 * 1024;
+};
+
+
+/**
+ * @brief The PacketLogWriterT class records packets into a log file (the concatenation of
+ *        the serialized packets, the same bytes than on the network):
+ *        - the packets are framed straight into a big aligned batch buffer which is
+ *          written with a single syscall once full, instead of the small writes per
+ *          packet of serialize(std::ostream&)
+ *        - optionally the file is opened with O_DIRECT: the batches are written as whole
+ *          blocks and the partial last block is rewritten by the next batch, the file
+ *          size is always the size of the log
+ *        - a sparse LogIndex is written next to the log (path + ".idx", the same one
+ *          PacketLogReaderT uses) so readers can seek without walking the log
+ *        The file only holds complete packets once flush() or close() return.
+ * @tparam Cfg  The configuration to be used on the packets
+ * @note not thread safe, one writer per log
+ */
+template<typename Cfg>
+class PacketLogWriterT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using data_len_t = typename PacketType::data_len_t;
+
+    /**
+     * @brief DIRECT_ALIGNMENT is the alignment of the batch buffer and of the O_DIRECT
+     *        writes (offsets and sizes)
+     */
+    static constexpr const std::size_t DIRECT_ALIGNMENT = 4096;
+
+  public:
+    inline PacketLogWriterT();
+    inline ~PacketLogWriterT();
+
+    // not copyable
+    PacketLogWriterT(const PacketLogWriterT&) = delete;
+    PacketLogWriterT& operator=(const PacketLogWriterT&) = delete;
+
+    /**
+     * @brief Creates (or truncates) a log
+     * @param path    The log file
+     * @param options The options of the writer
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    open(const std::string& path, const LogWriterOptions& options = LogWriterOptions());
+
+    /**
+     * @brief Writes the pending packets and the index, syncs (depending on the policy)
+     *        and closes the log
+     * @return true on success | false if some data could not be written
+     */
+    inline bool
+    close(void);
+
+    /**
+     * @brief Returns true if a log is open
+     * @return true if a log is open
+     */
+    inline bool
+    isOpen(void) const;
+
+    /**
+     * @brief Returns true if the log is written with O_DIRECT
+     * @return true if the log is written with O_DIRECT
+     */
+    inline bool
+    isDirect(void) const;
+
+    /**
+     * @brief Appends a packet to the log (same rules than PacketT::serialize)
+     * @param packet_content  The packet content
+     * @param len             The length of the content
+     * @param type            The message type (ignored if the configuration has none)
+     * @return true on success | false if the content is not valid or the batch could
+     *         not be written (errno is kept)
+     */
+    inline bool
+    append(const byte_t* packet_content,
+           const data_len_t len,
+           const typename PacketType::message_type_t type = typename PacketType::message_type_t());
+
+    /**
+     * @brief Writes the pending packets to the file (and syncs if the policy says so)
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    flush(void);
+
+    /**
+     * @brief Returns the number of packets appended
+     * @return the number of packets appended
+     */
+    inline std::uint64_t
+    packetsCount(void) const;
+
+    /**
+     * @brief Returns the size of the log (including the packets not written yet)
+     * @return the size of the log
+     */
+    inline std::uint64_t
+    size(void) const;
+
+
+  private:
+
+    inline bool
+    appendBytes(const byte_t* data, std::size_t len);
+
+    inline void
+    addPacket(const std::uint64_t offset, const byte_t* frame, const std::size_t frame_size);
+
+    inline bool
+    writeBatch(void);
+
+    inline bool
+    sync(void);
+
+    inline bool
+    saveIndex(void);
+
+  private:
+    int fd_;
+    std::string index_path_;
+    LogWriterOptions options_;
+    bool direct_;
+    // the batch buffer (DIRECT_ALIGNMENT aligned) and the file offset of its first byte
+    byte_t* batch_;
+    std::size_t batch_capacity_;
+    std::size_t batch_used_;
+    std::uint64_t batch_offset_;
+    // the bytes at the start of the batch already written (the partial O_DIRECT block)
+    std::size_t batch_written_;
+    std::uint64_t packets_count_;
+    std::uint64_t unsynced_bytes_;
+    std::uint64_t last_index_save_;
+    LogIndex index_;
+    // the identity of the log on the index (see LogIndex::setIdentity())
+    std::uint64_t file_id_;
+    std::uint64_t last_offset_;
+    std::array<byte_t, LogIndex::IDENTITY_BYTES> first_head_;
+    std::size_t first_head_size_;
+    std::array<byte_t, LogIndex::IDENTITY_BYTES> last_head_;
+    std::size_t last_head_size_;
+    std::vector<byte_t> frame_;
+};
+
+
+
+#include <packet/packet_log_writer_impl.h>
+
+
+// Default definition of a log writer
+using DefaultPacketLogWriter = PacketLogWriterT<DefaultConfig>;
+
+}
+
+#endif // PACKET_PACKET_LOG_WRITER_H_
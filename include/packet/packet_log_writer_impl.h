@@ -0,0 +1,304 @@
+
+
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::appendBytes(const byte_t* data, std::size_t len)
+{
+  while (len > 0) {
+    const std::size_t chunk = std::min(len, batch_capacity_ - batch_used_);
+    std::memcpy(batch_ + batch_used_, data, chunk);
+    batch_used_ += chunk;
+    data += chunk;
+    len -= chunk;
+    if (batch_used_ == batch_capacity_ && !writeBatch()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+PacketLogWriterT<Cfg>::addPacket(const std::uint64_t offset, const byte_t* frame, const std::size_t frame_size)
+{
+  const std::uint32_t stride = options_.index_stride;
+  if (stride > 0 && packets_count_ % stride == 0) {
+    index_.addEntry(offset);
+  }
+  if (stride > 0) {
+    // the heads of the first and last packets identify the log on the index
+    last_head_size_ = std::min(frame_size, std::size_t(LogIndex::IDENTITY_BYTES));
+    std::memcpy(last_head_.data(), frame, last_head_size_);
+    if (packets_count_ == 0) {
+      first_head_ = last_head_;
+      first_head_size_ = last_head_size_;
+    }
+    last_offset_ = offset;
+  }
+  ++packets_count_;
+  if (stride > 0 && options_.index_interval > 0 &&
+      packets_count_ - last_index_save_ >= options_.index_interval) {
+    saveIndex();
+  }
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::writeBatch(void)
+{
+  if (batch_used_ == batch_written_) {
+    return true;
+  }
+  // O_DIRECT writes whole blocks from the (aligned) start of the batch, the padding of
+  // the last block is cut by the ftruncate below
+  std::size_t done = direct_ ? 0 : batch_written_;
+  std::size_t write_len = batch_used_;
+  if (direct_) {
+    write_len = (batch_used_ + DIRECT_ALIGNMENT - 1) & ~(DIRECT_ALIGNMENT - 1);
+    std::memset(batch_ + batch_used_, 0, write_len - batch_used_);
+  }
+  while (done < write_len) {
+    const ssize_t written = ::pwrite(fd_, batch_ + done, write_len - done, off_t(batch_offset_ + done));
+    if (written < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      return false;
+    }
+    done += std::size_t(written);
+  }
+  if (direct_ && write_len != batch_used_ &&
+      ::ftruncate(fd_, off_t(batch_offset_ + batch_used_)) != 0) {
+    return false;
+  }
+  unsynced_bytes_ += batch_used_ - batch_written_;
+
+  // the partial last block stays on the batch to be completed and written again
+  const std::size_t kept = direct_ ? (batch_used_ & (DIRECT_ALIGNMENT - 1)) : 0;
+  if (kept > 0) {
+    std::memmove(batch_, batch_ + batch_used_ - kept, kept);
+  }
+  batch_offset_ += batch_used_ - kept;
+  batch_used_ = kept;
+  batch_written_ = kept;
+
+  if (options_.sync == SyncPolicy::EVERY_BATCH ||
+      (options_.sync == SyncPolicy::EVERY_BYTES && unsynced_bytes_ >= options_.sync_bytes)) {
+    return sync();
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::sync(void)
+{
+  if (::fdatasync(fd_) != 0) {
+    return false;
+  }
+  unsynced_bytes_ = 0;
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::saveIndex(void)
+{
+  // the index can only cover data already on the file
+  if (!writeBatch()) {
+    return false;
+  }
+  index_.setCoverage(packets_count_, size(), last_offset_);
+  index_.setIdentity(file_id_, LogIndex::framesHash(first_head_.data(),
+                                                    first_head_size_,
+                                                    last_head_.data(),
+                                                    last_head_size_));
+  last_index_save_ = packets_count_;
+  if (!index_.save(index_path_)) {
+    // not fatal, the readers build the index
+    PKT_LOG_ERROR("could not write the index " << index_path_ << ": " << errno);
+    return false;
+  }
+  return true;
+}
+
+
+template<typename Cfg>
+inline PacketLogWriterT<Cfg>::PacketLogWriterT() :
+  fd_(-1)
+, direct_(false)
+, batch_(nullptr)
+, batch_capacity_(0)
+, batch_used_(0)
+, batch_offset_(0)
+, batch_written_(0)
+, packets_count_(0)
+, unsynced_bytes_(0)
+, last_index_save_(0)
+, file_id_(0)
+, last_offset_(0)
+, first_head_size_(0)
+, last_head_size_(0)
+{}
+
+template<typename Cfg>
+inline PacketLogWriterT<Cfg>::~PacketLogWriterT()
+{
+  close();
+  std::free(batch_);
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::open(const std::string& path, const LogWriterOptions& options)
+{
+  close();
+  const int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+  direct_ = false;
+  if (options.direct) {
+    fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+    direct_ = fd_ >= 0;
+  }
+  if (fd_ < 0) {
+    fd_ = ::open(path.c_str(), flags, 0644);
+    if (fd_ < 0) {
+      return false;
+    }
+  }
+
+  const std::size_t capacity = (std::max(options.batch_size, std::size_t(DIRECT_ALIGNMENT)) +
+                                DIRECT_ALIGNMENT - 1) & ~(DIRECT_ALIGNMENT - 1);
+  if (capacity != batch_capacity_) {
+    std::free(batch_);
+    batch_ = nullptr;
+    batch_capacity_ = 0;
+    void* memory = nullptr;
+    if (::posix_memalign(&memory, DIRECT_ALIGNMENT, capacity) != 0) {
+      ::close(fd_);
+      fd_ = -1;
+      errno = ENOMEM;
+      return false;
+    }
+    batch_ = static_cast<byte_t*>(memory);
+    batch_capacity_ = capacity;
+  }
+  options_ = options;
+  batch_used_ = 0;
+  batch_offset_ = 0;
+  batch_written_ = 0;
+  packets_count_ = 0;
+  unsynced_bytes_ = 0;
+  last_index_save_ = 0;
+  last_offset_ = 0;
+  first_head_size_ = 0;
+  last_head_size_ = 0;
+  struct stat file_stat;
+  file_id_ = ::fstat(fd_, &file_stat) == 0 ? LogIndex::fileId(file_stat) : 0;
+
+  // an index left by a previous log on this path does not describe this one
+  index_path_ = PacketLogReaderT<Cfg>::indexPath(path);
+  ::unlink(index_path_.c_str());
+  index_.reset(std::max(options.index_stride, std::uint32_t(1)), LogIndex::fingerprint<Cfg>());
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::close(void)
+{
+  if (fd_ < 0) {
+    return true;
+  }
+  bool ok = writeBatch();
+  if (ok && options_.sync != SyncPolicy::NONE && unsynced_bytes_ > 0) {
+    ok = sync();
+  }
+  if (ok && options_.index_stride > 0) {
+    saveIndex();
+  }
+  const int error = errno;
+  ok = ::close(fd_) == 0 && ok;
+  fd_ = -1;
+  if (!ok) {
+    errno = error;
+  }
+  return ok;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::isOpen(void) const
+{
+  return fd_ >= 0;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::isDirect(void) const
+{
+  return direct_;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::append(const byte_t* packet_content,
+                              const data_len_t len,
+                              const typename PacketType::message_type_t type)
+{
+  PKT_ASSERT(isOpen());
+  if (!isOpen() || packet_content == nullptr || len == 0 || len > Cfg::MAX_DATA_LEN) {
+    return false;
+  }
+  const std::uint64_t offset = size();
+  if (PacketType::compression::ENABLED && len >= PacketType::compression::MIN_SIZE) {
+    // the compressed size is only known once compressed
+    if (!PacketType::serialize(packet_content, len, frame_, type) || !appendBytes(frame_.data(), frame_.size())) {
+      return false;
+    }
+    addPacket(offset, frame_.data(), frame_.size());
+    return true;
+  }
+
+  const std::size_t frame_size = PacketType::serializedSize(len);
+  if (frame_size > batch_capacity_ - batch_used_ && !writeBatch()) {
+    return false;
+  }
+  if (frame_size <= batch_capacity_ - batch_used_) {
+    // common case, framed in place
+    const byte_t* frame = batch_ + batch_used_;
+    batch_used_ += PacketType::writeFrame(packet_content, len, batch_ + batch_used_, type);
+    addPacket(offset, frame, frame_size);
+  } else {
+    // bigger than the batch
+    frame_.resize(frame_size);
+    PacketType::writeFrame(packet_content, len, frame_.data(), type);
+    if (!appendBytes(frame_.data(), frame_size)) {
+      return false;
+    }
+    addPacket(offset, frame_.data(), frame_size);
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketLogWriterT<Cfg>::flush(void)
+{
+  PKT_ASSERT(isOpen());
+  return isOpen() && writeBatch();
+}
+
+template<typename Cfg>
+inline std::uint64_t
+PacketLogWriterT<Cfg>::packetsCount(void) const
+{
+  return packets_count_;
+}
+
+template<typename Cfg>
+inline std::uint64_t
+PacketLogWriterT<Cfg>::size(void) const
+{
+  return batch_offset_ + batch_used_;
+}
@@ -0,0 +1,224 @@
+#ifndef PACKET_PACKET_PIPELINE_H_
+#define PACKET_PACKET_PIPELINE_H_
+
+#include <vector>
+#include <cstdint>
+#include <atomic>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/packet.h>
+#include <packet/mpmc_queue.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief The WaitPoint class parks threads until a condition holds. The notifying side
+ *        only takes the lock when somebody is parked, so the hand-off stays lock-free
+ *        while the threads keep up with each other
+ */
+class WaitPoint {
+  public:
+    WaitPoint() : waiters_(0) {}
+
+    /**
+     * @brief Blocks until ready() returns true
+     * @param ready the condition (checked under the lock)
+     */
+    template<typename Ready>
+    inline void
+    wait(Ready&& ready)
+    {
+      waiters_.fetch_add(1);
+      // pairs with the fence of notify(): either the notifier sees us parked or we see
+      // what it published on ready()
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      {
+        std::unique_lock<std::mutex> lock(mutex_);
+        cond_.wait(lock, ready);
+      }
+      waiters_.fetch_sub(1);
+    }
+
+    /**
+     * @brief Wakes up the parked threads (if any) so they check their condition again
+     */
+    inline void
+    notify(void)
+    {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (waiters_.load(std::memory_order_relaxed) > 0) {
+        std::lock_guard<std::mutex> lock(mutex_);
+        cond_.notify_all();
+      }
+    }
+
+  private:
+    std::atomic<std::size_t> waiters_;
+    std::mutex mutex_;
+    std::condition_variable cond_;
+};
+
+}
+
+
+/**
+ * @brief The PacketPipelineT class hands the completed packets parsed on the I/O threads
+ *        to a pool of worker threads without copying them:
+ *        - push(pkt) takes the packet payload (see PacketT::takePayload()) into a
+ *          bounded lock-free queue and the packet is ready to parse the next one
+ *        - a worker pops it, calls the handler with the content and sends the empty
+ *          buffer back through a second queue
+ *        - the I/O thread gives the returned buffers to the packet buffer policy on the
+ *          next push, so with PooledBufferPolicy the buffers circulate without allocating
+ *        When the workers fall behind the work queue fills up: tryPush() fails and push()
+ *        waits for room (backpressure), so the I/O thread stops reading instead of
+ *        buffering without limit.
+ * @tparam Cfg  The configuration to be used on the packets
+ */
+template<typename Cfg>
+class PacketPipelineT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+
+    /**
+     * @brief Handler called from a worker thread once per packet with its content and
+     *        message type (0 if the configuration has none). The content is only valid
+     *        during the call
+     */
+    using Handler = std::function<void(const byte_t* data, std::size_t len, std::uint64_t message_type)>;
+
+    /**
+     * @brief DEFAULT_CAPACITY is the default number of packets queued for the workers
+     */
+    static constexpr const std::size_t DEFAULT_CAPACITY = 1024;
+
+    /**
+     * @brief SPIN_COUNT is the number of empty polls before a thread parks
+     */
+    static constexpr const std::size_t SPIN_COUNT = 64;
+
+  public:
+    /**
+     * @brief Construct the pipeline and start the workers
+     * @param handler       The handler for the packets
+     * @param workers_count The number of worker threads (0 means one per core)
+     * @param capacity      The maximum number of packets queued for the workers
+     */
+    inline explicit PacketPipelineT(Handler handler,
+                                    const std::size_t workers_count = 0,
+                                    const std::size_t capacity = DEFAULT_CAPACITY);
+    inline ~PacketPipelineT();
+
+    // not copyable
+    PacketPipelineT(const PacketPipelineT&) = delete;
+    PacketPipelineT& operator=(const PacketPipelineT&) = delete;
+
+    /**
+     * @brief Hands a completed packet to the workers if there is room. On success the
+     *        packet is reset (with a new buffer) and can be used for the next one
+     * @param pkt the completed packet
+     * @return true if the packet was queued | false if the queue is full or the pipeline
+     *         is stopped (the packet is left untouched)
+     */
+    inline bool
+    tryPush(PacketType& pkt);
+
+    /**
+     * @brief Hands a completed packet to the workers, waiting for room if the queue is
+     *        full. On success the packet is reset (with a new buffer)
+     * @param pkt the completed packet
+     * @return true if the packet was queued | false if the pipeline is stopped
+     */
+    inline bool
+    push(PacketType& pkt);
+
+    /**
+     * @brief Gives the buffers returned by the workers to the packet buffer policy of the
+     *        calling thread (push() does it already)
+     * @return the number of buffers reclaimed
+     */
+    inline std::size_t
+    reclaimBuffers(void);
+
+    /**
+     * @brief Waits until all the packets pushed so far were handled
+     */
+    inline void
+    flush(void);
+
+    /**
+     * @brief Handles the packets still queued and stops the workers. Nobody must be
+     *        pushing while it is called
+     */
+    inline void
+    stop(void);
+
+    /**
+     * @brief Returns the number of worker threads
+     * @return the number of worker threads
+     */
+    inline std::size_t
+    workersCount(void) const;
+
+    /**
+     * @brief Returns the number of packets handled so far
+     * @return the number of packets handled so far
+     */
+    inline std::size_t
+    processedCount(void) const;
+
+    /**
+     * @brief Returns the number of times push() had to wait for the workers
+     * @return the number of times push() had to wait for the workers
+     */
+    inline std::size_t
+    backpressureCount(void) const;
+
+
+  private:
+
+    // the payload taken from the pushed packet
+    using Item = PacketPayload;
+
+  private:
+
+    inline void
+    workerLoop(void);
+
+    inline void
+    process(Item& item);
+
+  private:
+    Handler handler_;
+    MpmcQueue<Item> work_;
+    MpmcQueue<Buffer> free_;
+    std::vector<std::thread> workers_;
+    detail::WaitPoint work_ready_;
+    detail::WaitPoint room_ready_;
+    std::atomic<bool> running_;
+    std::atomic<std::size_t> pushed_count_;
+    std::atomic<std::size_t> processed_count_;
+    std::atomic<std::size_t> backpressure_count_;
+};
+
+
+
+#include <packet/packet_pipeline_impl.h>
+
+
+// Default definition of a pipeline
+using DefaultPacketPipeline = PacketPipelineT<DefaultConfig>;
+
+}
+
+#endif // PACKET_PACKET_PIPELINE_H_
@@ -0,0 +1,167 @@
+
+
+
+template<typename Cfg>
+inline void
+PacketPipelineT<Cfg>::workerLoop(void)
+{
+  Item item;
+  std::size_t empty_polls = 0;
+  while (true) {
+    if (work_.tryPop(item)) {
+      process(item);
+      empty_polls = 0;
+      continue;
+    }
+    if (!running_) {
+      // stop() was called and the queue is drained
+      break;
+    }
+    if (++empty_polls < SPIN_COUNT) {
+      std::this_thread::yield();
+      continue;
+    }
+    work_ready_.wait([this]() {
+      return work_.sizeApprox() > 0 || !running_;
+    });
+    empty_polls = 0;
+  }
+}
+
+template<typename Cfg>
+inline void
+PacketPipelineT<Cfg>::process(Item& item)
+{
+  handler_(item.data(), item.len, item.message_type);
+  // if the I/O thread does not reclaim them fast enough the extra buffers are dropped
+  free_.tryPush(std::move(item.buffer));
+  item.buffer = Buffer();
+  processed_count_.fetch_add(1, std::memory_order_release);
+  room_ready_.notify();
+}
+
+
+template<typename Cfg>
+inline PacketPipelineT<Cfg>::PacketPipelineT(Handler handler,
+                                             const std::size_t workers_count,
+                                             const std::size_t capacity) :
+  handler_(std::move(handler))
+, work_(capacity)
+, free_(capacity)
+, running_(true)
+, pushed_count_(0)
+, processed_count_(0)
+, backpressure_count_(0)
+{
+  PKT_ASSERT(bool(handler_));
+  const std::size_t count = workers_count > 0 ?
+      workers_count : std::max(1u, std::thread::hardware_concurrency());
+  for (std::size_t i = 0; i < count; ++i) {
+    workers_.emplace_back(&PacketPipelineT<Cfg>::workerLoop, this);
+  }
+}
+
+template<typename Cfg>
+inline PacketPipelineT<Cfg>::~PacketPipelineT()
+{
+  stop();
+}
+
+template<typename Cfg>
+inline bool
+PacketPipelineT<Cfg>::tryPush(PacketType& pkt)
+{
+  PKT_ASSERT(pkt.status() == Status::COMPLETE);
+  if (!running_) {
+    return false;
+  }
+  reclaimBuffers();
+  const bool pushed = work_.tryPushWith([&pkt](Item& item) {
+    item = pkt.takePayload();
+  });
+  if (!pushed) {
+    return false;
+  }
+  pushed_count_.fetch_add(1, std::memory_order_relaxed);
+  work_ready_.notify();
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+PacketPipelineT<Cfg>::push(PacketType& pkt)
+{
+  if (tryPush(pkt)) {
+    return true;
+  }
+  backpressure_count_.fetch_add(1, std::memory_order_relaxed);
+  while (running_) {
+    room_ready_.wait([this]() {
+      return work_.sizeApprox() < work_.capacity() || !running_;
+    });
+    if (tryPush(pkt)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketPipelineT<Cfg>::reclaimBuffers(void)
+{
+  std::size_t count = 0;
+  Buffer buffer;
+  while (free_.tryPop(buffer)) {
+    PacketType::recycleBuffer(std::move(buffer));
+    buffer = Buffer();
+    ++count;
+  }
+  return count;
+}
+
+template<typename Cfg>
+inline void
+PacketPipelineT<Cfg>::flush(void)
+{
+  room_ready_.wait([this]() {
+    return processed_count_.load(std::memory_order_acquire) >= pushed_count_.load(std::memory_order_relaxed);
+  });
+}
+
+template<typename Cfg>
+inline void
+PacketPipelineT<Cfg>::stop(void)
+{
+  if (!running_.exchange(false)) {
+    return;
+  }
+  work_ready_.notify();
+  room_ready_.notify();
+  for (std::thread& worker : workers_) {
+    worker.join();
+  }
+  workers_.clear();
+  reclaimBuffers();
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketPipelineT<Cfg>::workersCount(void) const
+{
+  return workers_.size();
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketPipelineT<Cfg>::processedCount(void) const
+{
+  return processed_count_.load(std::memory_order_acquire);
+}
+
+template<typename Cfg>
+inline std::size_t
+PacketPipelineT<Cfg>::backpressureCount(void) const
+{
+  return backpressure_count_.load(std::memory_order_relaxed);
+}
@@ -0,0 +1,186 @@
+#ifndef PACKET_PACKET_STORAGE_H_
+#define PACKET_PACKET_STORAGE_H_
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <utility>
+#include <algorithm>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+/**
+ * @brief The InlineBuffer class is the storage of the packets whose configuration bounds
+ *        them to a few bytes: a fixed array kept inside the packet, so parsing never goes
+ *        to the allocator. It provides the subset of the Buffer interface the parser uses
+ * @tparam N      The capacity (PACKET_MAX_SIZE of the configuration)
+ * @tparam Policy The buffer policy, only used to hand the content out (detach())
+ */
+template<std::size_t N, typename Policy>
+class InlineBuffer {
+  public:
+    inline InlineBuffer(void);
+
+    inline InlineBuffer(const InlineBuffer& other);
+    inline InlineBuffer& operator=(const InlineBuffer& other);
+
+    // moving copies the bytes in use, the other one is left empty
+    inline InlineBuffer(InlineBuffer&& other) noexcept;
+    inline InlineBuffer& operator=(InlineBuffer&& other) noexcept;
+
+    inline const byte_t*
+    data(void) const;
+    inline byte_t*
+    data(void);
+
+    inline std::size_t
+    size(void) const;
+
+    inline std::size_t
+    capacity(void) const;
+
+    inline bool
+    empty(void) const;
+
+    inline const byte_t&
+    operator[](const std::size_t idx) const;
+
+    /**
+     * @brief Resizes the content, the new bytes are not initialized
+     * @param size the new size (<= N)
+     */
+    inline void
+    resize(const std::size_t size);
+
+    /**
+     * @brief Does nothing, the capacity is always N
+     */
+    inline void
+    reserve(const std::size_t capacity);
+
+    inline void
+    clear(void);
+
+    /**
+     * @brief Replaces the content with the one of a heap buffer (it must fit), the heap
+     *        buffer is cleared but keeps its memory
+     * @param heap the heap buffer
+     */
+    inline void
+    exchange(Buffer& heap);
+
+    /**
+     * @brief Moves the content out to a buffer taken from the policy, leaving this one empty
+     * @return the content
+     */
+    inline Buffer
+    detach(void);
+
+  private:
+    std::size_t size_;
+    std::array<byte_t, N> bytes_;
+};
+
+
+/**
+ * @brief The SmallBuffer class is the storage of the packets of the bigger configurations:
+ *        the first N bytes are kept inside the packet and a buffer is only taken from the
+ *        policy once a frame does not fit on them. Once taken the buffer is kept (as a
+ *        std::vector keeps its capacity) until it is detached or the storage destroyed
+ * @tparam N      The inline capacity (0 always uses the policy buffers)
+ * @tparam Policy The buffer policy
+ */
+template<std::size_t N, typename Policy>
+class SmallBuffer {
+  public:
+    inline SmallBuffer(void);
+    inline ~SmallBuffer(void);
+
+    inline SmallBuffer(const SmallBuffer& other);
+    inline SmallBuffer& operator=(const SmallBuffer& other);
+
+    // moving takes the policy buffer (inline contents are copied), the other one is left
+    // empty and inline
+    inline SmallBuffer(SmallBuffer&& other) noexcept;
+    inline SmallBuffer& operator=(SmallBuffer&& other) noexcept;
+
+    inline const byte_t*
+    data(void) const;
+    inline byte_t*
+    data(void);
+
+    inline std::size_t
+    size(void) const;
+
+    inline std::size_t
+    capacity(void) const;
+
+    inline bool
+    empty(void) const;
+
+    /**
+     * @brief Returns true while the content is kept inline
+     * @return true while the content is kept inline
+     */
+    inline bool
+    isInline(void) const;
+
+    inline const byte_t&
+    operator[](const std::size_t idx) const;
+
+    /**
+     * @brief Resizes the content (growing geometrically), the new bytes are not
+     *        initialized
+     * @param size the new size
+     */
+    inline void
+    resize(const std::size_t size);
+
+    /**
+     * @brief Makes sure the storage can hold capacity bytes, moving the content to a bigger
+     *        buffer from the policy if needed (the old one is given back)
+     * @param capacity the capacity required
+     */
+    inline void
+    reserve(const std::size_t capacity);
+
+    inline void
+    clear(void);
+
+    /**
+     * @brief Takes the content (and memory) of a heap buffer, the heap buffer gets the
+     *        memory previously used by this one (cleared). Contents fitting inline are
+     *        copied instead
+     * @param heap the heap buffer
+     */
+    inline void
+    exchange(Buffer& heap);
+
+    /**
+     * @brief Moves the content out (the policy buffer itself if there is one, so no bytes
+     *        are copied), leaving this one empty and inline
+     * @return the content
+     */
+    inline Buffer
+    detach(void);
+
+  private:
+    std::size_t size_;
+    // the policy buffer, resized to its whole capacity (default initialized bytes), empty
+    // while the content is inline
+    Buffer heap_;
+    std::array<byte_t, N> bytes_;
+};
+
+
+
+#include <packet/packet_storage_impl.h>
+}
+
+#endif // PACKET_PACKET_STORAGE_H_
@@ -0,0 +1,310 @@
+
+
+
+template<std::size_t N, typename Policy>
+inline InlineBuffer<N, Policy>::InlineBuffer(void) :
+  size_(0)
+{}
+
+template<std::size_t N, typename Policy>
+inline InlineBuffer<N, Policy>::InlineBuffer(const InlineBuffer& other) :
+  size_(other.size_)
+{
+  // only the bytes in use
+  std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+}
+
+template<std::size_t N, typename Policy>
+inline InlineBuffer<N, Policy>&
+InlineBuffer<N, Policy>::operator=(const InlineBuffer& other)
+{
+  if (this != &other) {
+    size_ = other.size_;
+    std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+  }
+  return *this;
+}
+
+template<std::size_t N, typename Policy>
+inline InlineBuffer<N, Policy>::InlineBuffer(InlineBuffer&& other) noexcept :
+  size_(other.size_)
+{
+  std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+  other.size_ = 0;
+}
+
+template<std::size_t N, typename Policy>
+inline InlineBuffer<N, Policy>&
+InlineBuffer<N, Policy>::operator=(InlineBuffer&& other) noexcept
+{
+  if (this != &other) {
+    size_ = other.size_;
+    std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+template<std::size_t N, typename Policy>
+inline const byte_t*
+InlineBuffer<N, Policy>::data(void) const
+{
+  return bytes_.data();
+}
+
+template<std::size_t N, typename Policy>
+inline byte_t*
+InlineBuffer<N, Policy>::data(void)
+{
+  return bytes_.data();
+}
+
+template<std::size_t N, typename Policy>
+inline std::size_t
+InlineBuffer<N, Policy>::size(void) const
+{
+  return size_;
+}
+
+template<std::size_t N, typename Policy>
+inline std::size_t
+InlineBuffer<N, Policy>::capacity(void) const
+{
+  return N;
+}
+
+template<std::size_t N, typename Policy>
+inline bool
+InlineBuffer<N, Policy>::empty(void) const
+{
+  return size_ == 0;
+}
+
+template<std::size_t N, typename Policy>
+inline const byte_t&
+InlineBuffer<N, Policy>::operator[](const std::size_t idx) const
+{
+  PKT_ASSERT(idx < size_);
+  return bytes_[idx];
+}
+
+template<std::size_t N, typename Policy>
+inline void
+InlineBuffer<N, Policy>::resize(const std::size_t size)
+{
+  PKT_ASSERT(size <= N);
+  size_ = std::min(size, N);
+}
+
+template<std::size_t N, typename Policy>
+inline void
+InlineBuffer<N, Policy>::reserve(const std::size_t)
+{}
+
+template<std::size_t N, typename Policy>
+inline void
+InlineBuffer<N, Policy>::clear(void)
+{
+  size_ = 0;
+}
+
+template<std::size_t N, typename Policy>
+inline void
+InlineBuffer<N, Policy>::exchange(Buffer& heap)
+{
+  PKT_ASSERT(heap.size() <= N);
+  size_ = std::min(heap.size(), N);
+  std::memcpy(bytes_.data(), heap.data(), size_);
+  heap.clear();
+}
+
+template<std::size_t N, typename Policy>
+inline Buffer
+InlineBuffer<N, Policy>::detach(void)
+{
+  Buffer result = Policy::acquire(size_);
+  result.assign(bytes_.data(), bytes_.data() + size_);
+  size_ = 0;
+  return result;
+}
+
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>::SmallBuffer(void) :
+  size_(0)
+{}
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>::~SmallBuffer(void)
+{
+  if (!heap_.empty()) {
+    Policy::release(std::move(heap_));
+  }
+}
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>::SmallBuffer(const SmallBuffer& other) :
+  size_(0)
+{
+  *this = other;
+}
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>&
+SmallBuffer<N, Policy>::operator=(const SmallBuffer& other)
+{
+  if (this != &other) {
+    clear();
+    reserve(other.size_);
+    size_ = other.size_;
+    std::memcpy(data(), other.data(), size_);
+  }
+  return *this;
+}
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>::SmallBuffer(SmallBuffer&& other) noexcept :
+  size_(other.size_)
+{
+  heap_.swap(other.heap_);
+  if (heap_.empty()) {
+    std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+  }
+  other.size_ = 0;
+}
+
+template<std::size_t N, typename Policy>
+inline SmallBuffer<N, Policy>&
+SmallBuffer<N, Policy>::operator=(SmallBuffer&& other) noexcept
+{
+  if (this != &other) {
+    // the old heap buffer goes to other (released later), giving it back to the policy
+    // here could allocate
+    size_ = other.size_;
+    heap_.swap(other.heap_);
+    if (heap_.empty()) {
+      std::memcpy(bytes_.data(), other.bytes_.data(), size_);
+    }
+    other.size_ = 0;
+  }
+  return *this;
+}
+
+template<std::size_t N, typename Policy>
+inline const byte_t*
+SmallBuffer<N, Policy>::data(void) const
+{
+  return heap_.empty() ? bytes_.data() : heap_.data();
+}
+
+template<std::size_t N, typename Policy>
+inline byte_t*
+SmallBuffer<N, Policy>::data(void)
+{
+  return heap_.empty() ? bytes_.data() : heap_.data();
+}
+
+template<std::size_t N, typename Policy>
+inline std::size_t
+SmallBuffer<N, Policy>::size(void) const
+{
+  return size_;
+}
+
+template<std::size_t N, typename Policy>
+inline std::size_t
+SmallBuffer<N, Policy>::capacity(void) const
+{
+  return heap_.empty() ? N : heap_.size();
+}
+
+template<std::size_t N, typename Policy>
+inline bool
+SmallBuffer<N, Policy>::empty(void) const
+{
+  return size_ == 0;
+}
+
+template<std::size_t N, typename Policy>
+inline bool
+SmallBuffer<N, Policy>::isInline(void) const
+{
+  return heap_.empty();
+}
+
+template<std::size_t N, typename Policy>
+inline const byte_t&
+SmallBuffer<N, Policy>::operator[](const std::size_t idx) const
+{
+  PKT_ASSERT(idx < size_);
+  return data()[idx];
+}
+
+template<std::size_t N, typename Policy>
+inline void
+SmallBuffer<N, Policy>::resize(const std::size_t size)
+{
+  if (size > capacity()) {
+    reserve(std::max(size, 2 * capacity()));
+  }
+  size_ = size;
+}
+
+template<std::size_t N, typename Policy>
+inline void
+SmallBuffer<N, Policy>::reserve(const std::size_t capacity)
+{
+  if (capacity <= this->capacity()) {
+    return;
+  }
+  Buffer bigger = Policy::acquire(capacity);
+  // the whole capacity is usable, resize() on a default-init buffer does not touch it
+  bigger.resize(std::max(bigger.capacity(), capacity));
+  if (size_ > 0) {
+    // data() is null without inline storage nor heap buffer
+    std::memcpy(bigger.data(), data(), size_);
+  }
+  heap_.swap(bigger);
+  if (!bigger.empty()) {
+    Policy::release(std::move(bigger));
+  }
+}
+
+template<std::size_t N, typename Policy>
+inline void
+SmallBuffer<N, Policy>::clear(void)
+{
+  size_ = 0;
+}
+
+template<std::size_t N, typename Policy>
+inline void
+SmallBuffer<N, Policy>::exchange(Buffer& heap)
+{
+  size_ = heap.size();
+  if (heap_.empty() && size_ <= N) {
+    // small enough to stay inline, the heap buffer keeps its memory
+    std::memcpy(bytes_.data(), heap.data(), size_);
+    heap.clear();
+    return;
+  }
+  heap.resize(heap.capacity());
+  heap_.swap(heap);
+  heap.clear();
+}
+
+template<std::size_t N, typename Policy>
+inline Buffer
+SmallBuffer<N, Policy>::detach(void)
+{
+  Buffer result;
+  if (heap_.empty()) {
+    result = Policy::acquire(size_);
+    result.assign(bytes_.data(), bytes_.data() + size_);
+  } else {
+    result.swap(heap_);
+    result.resize(size_);
+  }
+  size_ = 0;
+  return result;
+}
@@ -0,0 +1,81 @@
+#ifndef PACKET_PATTERN_SEARCH_H_
+#define PACKET_PATTERN_SEARCH_H_
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+#include <packet/defs.h>
+
+
+namespace packet {
+
+/**
+ * @brief Finds the first occurrence of a pattern on a buffer. The search is driven by
+ *        memchr on the first byte of the pattern (vectorized by the libc) so the cost
+ *        stays linear on the buffer size.
+ * @param data          The buffer where to search
+ * @param len           The length of the buffer
+ * @param pattern       The pattern to search for
+ * @param pattern_len   The length of the pattern (must be > 0)
+ * @return the offset of the first occurrence or len if not found
+ */
+inline std::size_t
+findPattern(const byte_t* data,
+            const std::size_t len,
+            const byte_t* pattern,
+            const std::size_t pattern_len)
+{
+  if (pattern_len == 0 || pattern_len > len) {
+    return len;
+  }
+  const byte_t* current = data;
+  const byte_t* last = data + (len - pattern_len);
+  while (current <= last) {
+    const void* found = std::memchr(current, pattern[0], std::size_t(last - current) + 1);
+    if (found == nullptr) {
+      return len;
+    }
+    current = static_cast<const byte_t*>(found);
+    if (std::memcmp(current + 1, pattern + 1, pattern_len - 1) == 0) {
+      return std::size_t(current - data);
+    }
+    ++current;
+  }
+  return len;
+}
+
+/**
+ * @brief Finds the first position of a buffer where a pattern could begin: the first full
+ *        occurrence or, if there is none, the longest suffix of the buffer that is a
+ *        prefix of the pattern (it could be completed with more data).
+ * @param data          The buffer where to search
+ * @param len           The length of the buffer
+ * @param pattern       The pattern to search for
+ * @param pattern_len   The length of the pattern (must be > 0)
+ * @return the offset of the candidate position or len if there is none
+ */
+inline std::size_t
+findPatternCandidate(const byte_t* data,
+                     const std::size_t len,
+                     const byte_t* pattern,
+                     const std::size_t pattern_len)
+{
+  if (pattern_len == 0) {
+    return len;
+  }
+  const std::size_t found = findPattern(data, len, pattern, pattern_len);
+  if (found < len) {
+    return found;
+  }
+  for (std::size_t suffix = std::min(len, pattern_len - 1); suffix > 0; --suffix) {
+    if (std::memcmp(data + len - suffix, pattern, suffix) == 0) {
+      return len - suffix;
+    }
+  }
+  return len;
+}
+
+}
+
+#endif // PACKET_PATTERN_SEARCH_H_
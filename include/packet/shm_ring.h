@@ -0,0 +1,294 @@
+#ifndef PACKET_SHM_RING_H_
+#define PACKET_SHM_RING_H_
+
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstring>
+#include <cerrno>
+#include <climits>
+#include <new>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/buffer.h>
+#include <packet/packet.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief Blocks while *word == expected (at most timeout_ms, -1 forever). The word can be
+ *        on memory shared between processes
+ * @return false on timeout
+ */
+inline bool
+futexWait(std::atomic<std::uint32_t>* word, const std::uint32_t expected, const int timeout_ms);
+
+/**
+ * @brief Wakes up all the threads / processes blocked on word
+ */
+inline void
+futexWake(std::atomic<std::uint32_t>* word);
+
+/**
+ * @brief Hints the cpu that we are busy waiting
+ */
+inline void
+cpuRelax(void);
+
+
+/**
+ * @brief The control block at the beginning of the shared memory. The producer and the
+ *        consumer fields are on different cache lines, each waiting flag on the line of
+ *        the side checking it per packet (it is only written by the other side when it
+ *        goes to sleep)
+ */
+struct ShmRingHeader {
+    std::uint32_t magic;
+    std::uint32_t version;
+    std::uint64_t capacity;
+    byte_t pad0[48];
+    // producer
+    std::atomic<std::uint64_t> write_pos;
+    std::atomic<std::uint32_t> write_seq;
+    std::atomic<std::uint32_t> reader_waiting;
+    byte_t pad1[48];
+    // consumer
+    std::atomic<std::uint64_t> read_pos;
+    std::atomic<std::uint32_t> read_seq;
+    std::atomic<std::uint32_t> writer_waiting;
+    byte_t pad2[48];
+};
+
+static_assert(ATOMIC_LLONG_LOCK_FREE == 2 && ATOMIC_INT_LOCK_FREE == 2,
+              "the shared ring requires lock free atomics");
+
+}
+
+
+/**
+ * @brief The ShmRingT class is a single producer / single consumer ring of packets on
+ *        shared memory, to exchange packets between processes of the same host without
+ *        syscalls nor copies on the hot path:
+ *        - the memory is a memfd (or any shared file, like one on /dev/shm) that the
+ *          other process attaches to (inherited on fork, sent with SCM_RIGHTS, ...)
+ *        - the data area is mapped twice back to back, so a frame crossing the end of
+ *          the ring is still contiguous: the producer serializes the frames (same layout
+ *          as PacketT::serialize() without compression) straight into the ring and the
+ *          consumer gets views pointing into it
+ *        - the waiting side spins shortly and then sleeps on a futex, the other side only
+ *          makes the wake up syscall when somebody is sleeping
+ *        One process (thread) must only produce and the other only consume.
+ * @tparam Cfg  The configuration to be used on the packets
+ */
+template<typename Cfg>
+class ShmRingT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using tracing = typename PacketType::tracing;
+
+    /**
+     * @brief MAGIC / VERSION identify the shared memory layout
+     */
+    static constexpr const std::uint32_t MAGIC = 0x524B5450;  // "PTKR"
+    static constexpr const std::uint32_t VERSION = 2;
+
+    /**
+     * @brief SPIN_COUNT is the number of polls before sleeping on the futex
+     */
+    static constexpr const std::size_t SPIN_COUNT = 2048;
+
+  public:
+    inline ShmRingT();
+    inline ~ShmRingT();
+
+    // not copyable
+    ShmRingT(const ShmRingT&) = delete;
+    ShmRingT& operator=(const ShmRingT&) = delete;
+
+    /**
+     * @brief Creates a new (empty) ring
+     * @param capacity  The size of the data area, rounded up to a power of two multiple of
+     *                  the page size. It bounds the biggest frame that can be sent
+     * @param fd        The shared file to use (it is duplicated, for example a file on
+     *                  /dev/shm), -1 creates an anonymous memfd
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    create(const std::size_t capacity, const int fd = -1);
+
+    /**
+     * @brief Attaches to a ring created by another ShmRingT
+     * @param fd the file of the ring (it is duplicated)
+     * @return true on success | false if the file is not a valid ring
+     */
+    inline bool
+    attach(const int fd);
+
+    /**
+     * @brief Unmaps the ring and closes its file
+     */
+    inline void
+    close(void);
+
+    /**
+     * @brief Returns true if the ring is created / attached
+     * @return true if the ring is created / attached
+     */
+    inline bool
+    isValid(void) const;
+
+    /**
+     * @brief Returns the file of the ring, to share it with the other process
+     * @return the file of the ring
+     */
+    inline int
+    fd(void) const;
+
+    /**
+     * @brief Returns the size of the data area
+     * @return the size of the data area
+     */
+    inline std::size_t
+    capacity(void) const;
+
+    ////////////////////////////////////////////////////////////////////////////////////
+    // producer side
+    //
+
+    /**
+     * @brief Reserves a frame for a content of len bytes on the ring
+     * @param len  the length of the content
+     * @param type the message type (ignored if the configuration has none)
+     * @return where the content has to be written, or nullptr if there is no room now
+     *         (or the frame can never fit)
+     */
+    inline byte_t*
+    reserve(const std::size_t len,
+            const typename PacketType::message_type_t type = typename PacketType::message_type_t());
+
+    /**
+     * @brief Finishes the reserved frame (checksum and tail) and makes it visible to the
+     *        consumer
+     */
+    inline void
+    commit(void);
+
+    /**
+     * @brief Sends a packet if there is room on the ring
+     * @param data  The content
+     * @param len   The length of the content
+     * @param type  The message type (ignored if the configuration has none)
+     * @return true if the packet was sent | false if there is no room now
+     */
+    inline bool
+    tryWrite(const byte_t* data,
+             const std::size_t len,
+             const typename PacketType::message_type_t type = typename PacketType::message_type_t());
+
+    /**
+     * @brief Sends a packet, waiting for room
+     * @param data        The content
+     * @param len         The length of the content
+     * @param timeout_ms  The maximum time to wait (-1 forever)
+     * @param type        The message type (ignored if the configuration has none)
+     * @return true if the packet was sent | false on timeout or if it can never fit
+     */
+    inline bool
+    write(const byte_t* data,
+          const std::size_t len,
+          const int timeout_ms = -1,
+          const typename PacketType::message_type_t type = typename PacketType::message_type_t());
+
+    ////////////////////////////////////////////////////////////////////////////////////
+    // consumer side
+    //
+
+    /**
+     * @brief Releases the previous packet and reads the next one if any
+     * @param view  The view of the content pointing into the ring (or to an internal
+     *              buffer if the content was compressed), valid until the next read or
+     *              release()
+     * @return true if a packet was read | false if there is none now or the ring data is
+     *         invalid (check status())
+     */
+    inline bool
+    tryRead(PacketView& view);
+
+    /**
+     * @brief Releases the previous packet and reads the next one, waiting for it
+     * @param view        The view of the content (see tryRead())
+     * @param timeout_ms  The maximum time to wait (-1 forever)
+     * @return true if a packet was read | false on timeout or invalid data
+     */
+    inline bool
+    read(PacketView& view, const int timeout_ms = -1);
+
+    /**
+     * @brief Gives back to the producer the space of the last packet read
+     */
+    inline void
+    release(void);
+
+    /**
+     * @brief Returns INVALID once the consumer found malformed data, INCOMPLETE otherwise
+     * @return the status of the consumer
+     */
+    inline Status
+    status(void) const;
+
+
+  private:
+
+    inline bool
+    map(const int fd, const std::size_t capacity);
+
+    inline std::size_t
+    freeSpace(const std::size_t needed);
+
+    static inline int
+    remainingMs(const std::chrono::steady_clock::time_point& deadline, const int timeout_ms);
+
+  private:
+    int fd_;
+    void* mapping_;
+    std::size_t mapping_size_;
+    detail::ShmRingHeader* header_;
+    byte_t* data_;
+    std::size_t mask_;
+    // producer state (the consumer position is only reloaded when the cached one has not
+    // enough room, so the producer does not touch the consumer cache line per packet)
+    std::uint64_t write_pos_;
+    std::uint64_t cached_read_pos_;
+    std::size_t reserved_len_;
+    // consumer state
+    std::uint64_t read_pos_;
+    std::uint64_t cached_write_pos_;
+    std::size_t held_size_;
+    Status status_;
+    Buffer decompressed_;
+};
+
+
+
+#include <packet/shm_ring_impl.h>
+
+
+// Default definition of a shared memory ring
+using DefaultShmRing = ShmRingT<DefaultConfig>;
+
+}
+
+#endif // PACKET_SHM_RING_H_
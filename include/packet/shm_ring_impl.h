@@ -0,0 +1,422 @@
+
+
+
+namespace detail {
+
+inline bool
+futexWait(std::atomic<std::uint32_t>* word, const std::uint32_t expected, const int timeout_ms)
+{
+  timespec timeout;
+  timespec* timeout_ptr = nullptr;
+  if (timeout_ms >= 0) {
+    timeout.tv_sec = timeout_ms / 1000;
+    timeout.tv_nsec = long(timeout_ms % 1000) * 1000000L;
+    timeout_ptr = &timeout;
+  }
+  // not FUTEX_PRIVATE: the word can be shared with other processes
+  const long result = ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAIT,
+                                expected, timeout_ptr, nullptr, 0);
+  return result == 0 || errno != ETIMEDOUT;
+}
+
+inline void
+futexWake(std::atomic<std::uint32_t>* word)
+{
+  ::syscall(SYS_futex, reinterpret_cast<std::uint32_t*>(word), FUTEX_WAKE, INT_MAX, nullptr, nullptr, 0);
+}
+
+inline void
+cpuRelax(void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  asm volatile("yield");
+#endif
+}
+
+}
+
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::map(const int fd, const std::size_t capacity)
+{
+  const std::size_t page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+  const std::size_t header_size = std::max(page_size, sizeof(detail::ShmRingHeader));
+  // reserve the address space for the header and the two views of the data
+  mapping_size_ = header_size + 2 * capacity;
+  mapping_ = ::mmap(nullptr, mapping_size_, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (mapping_ == MAP_FAILED) {
+    mapping_ = nullptr;
+    return false;
+  }
+  byte_t* base = static_cast<byte_t*>(mapping_);
+  if (::mmap(base, header_size + capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, 0) == MAP_FAILED ||
+      ::mmap(base + header_size + capacity, capacity, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_FIXED, fd, off_t(header_size)) == MAP_FAILED) {
+    const int error = errno;
+    ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+    errno = error;
+    return false;
+  }
+  header_ = reinterpret_cast<detail::ShmRingHeader*>(base);
+  data_ = base + header_size;
+  mask_ = capacity - 1;
+  return true;
+}
+
+template<typename Cfg>
+inline std::size_t
+ShmRingT<Cfg>::freeSpace(const std::size_t needed)
+{
+  std::size_t free_space = capacity() - std::size_t(write_pos_ - cached_read_pos_);
+  if (free_space < needed) {
+    cached_read_pos_ = header_->read_pos.load(std::memory_order_acquire);
+    free_space = capacity() - std::size_t(write_pos_ - cached_read_pos_);
+  }
+  return free_space;
+}
+
+template<typename Cfg>
+inline int
+ShmRingT<Cfg>::remainingMs(const std::chrono::steady_clock::time_point& deadline, const int timeout_ms)
+{
+  if (timeout_ms < 0) {
+    return -1;
+  }
+  const auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now());
+  return remaining.count() > 0 ? int(remaining.count()) : 0;
+}
+
+
+template<typename Cfg>
+inline ShmRingT<Cfg>::ShmRingT() :
+  fd_(-1)
+, mapping_(nullptr)
+, mapping_size_(0)
+, header_(nullptr)
+, data_(nullptr)
+, mask_(0)
+, write_pos_(0)
+, cached_read_pos_(0)
+, reserved_len_(0)
+, read_pos_(0)
+, cached_write_pos_(0)
+, held_size_(0)
+, status_(Status::INCOMPLETE)
+{}
+
+template<typename Cfg>
+inline ShmRingT<Cfg>::~ShmRingT()
+{
+  close();
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::create(const std::size_t capacity, const int fd)
+{
+  close();
+  const std::size_t page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+  std::size_t rounded = page_size;
+  while (rounded < capacity) {
+    rounded <<= 1;
+  }
+  const std::size_t header_size = std::max(page_size, sizeof(detail::ShmRingHeader));
+
+  fd_ = fd >= 0 ? ::fcntl(fd, F_DUPFD_CLOEXEC, 0) : ::memfd_create("packet_shm_ring", MFD_CLOEXEC);
+  if (fd_ < 0 || ::ftruncate(fd_, off_t(header_size + rounded)) != 0 || !map(fd_, rounded)) {
+    const int error = errno;
+    close();
+    errno = error;
+    return false;
+  }
+  detail::ShmRingHeader* header = new (header_) detail::ShmRingHeader();
+  header->capacity = rounded;
+  header->write_pos.store(0, std::memory_order_relaxed);
+  header->write_seq.store(0, std::memory_order_relaxed);
+  header->reader_waiting.store(0, std::memory_order_relaxed);
+  header->read_pos.store(0, std::memory_order_relaxed);
+  header->read_seq.store(0, std::memory_order_relaxed);
+  header->writer_waiting.store(0, std::memory_order_relaxed);
+  header->version = VERSION;
+  // the magic goes last: a ring is only attachable once initialized
+  __atomic_store_n(&header->magic, MAGIC, __ATOMIC_RELEASE);
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::attach(const int fd)
+{
+  close();
+  fd_ = ::fcntl(fd, F_DUPFD_CLOEXEC, 0);
+  if (fd_ < 0) {
+    return false;
+  }
+  // read the header first to know the capacity
+  detail::ShmRingHeader header;
+  if (::pread(fd_, &header, sizeof(header), 0) != ssize_t(sizeof(header)) ||
+      header.magic != MAGIC || header.version != VERSION ||
+      header.capacity == 0 || (header.capacity & (header.capacity - 1)) != 0) {
+    PKT_LOG_ERROR("the file is not a valid shared memory ring");
+    close();
+    errno = EINVAL;
+    return false;
+  }
+  struct stat file_stat;
+  const std::size_t page_size = std::size_t(::sysconf(_SC_PAGESIZE));
+  if (::fstat(fd_, &file_stat) != 0 ||
+      std::uint64_t(file_stat.st_size) < std::max(page_size, sizeof(header)) + header.capacity ||
+      !map(fd_, std::size_t(header.capacity))) {
+    const int error = errno;
+    close();
+    errno = error;
+    return false;
+  }
+  write_pos_ = cached_write_pos_ = header_->write_pos.load(std::memory_order_acquire);
+  read_pos_ = cached_read_pos_ = header_->read_pos.load(std::memory_order_acquire);
+  return true;
+}
+
+template<typename Cfg>
+inline void
+ShmRingT<Cfg>::close(void)
+{
+  if (mapping_ != nullptr) {
+    ::munmap(mapping_, mapping_size_);
+    mapping_ = nullptr;
+  }
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  header_ = nullptr;
+  data_ = nullptr;
+  mask_ = 0;
+  write_pos_ = 0;
+  cached_read_pos_ = 0;
+  reserved_len_ = 0;
+  read_pos_ = 0;
+  cached_write_pos_ = 0;
+  held_size_ = 0;
+  status_ = Status::INCOMPLETE;
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::isValid(void) const
+{
+  return header_ != nullptr;
+}
+
+template<typename Cfg>
+inline int
+ShmRingT<Cfg>::fd(void) const
+{
+  return fd_;
+}
+
+template<typename Cfg>
+inline std::size_t
+ShmRingT<Cfg>::capacity(void) const
+{
+  return mask_ + 1;
+}
+
+template<typename Cfg>
+inline byte_t*
+ShmRingT<Cfg>::reserve(const std::size_t len, const typename PacketType::message_type_t type)
+{
+  PKT_ASSERT(isValid());
+  PKT_ASSERT(reserved_len_ == 0 && "the previous frame was not committed");
+  if (len == 0 || len > std::size_t(Cfg::MAX_DATA_LEN)) {
+    return nullptr;
+  }
+  const std::size_t frame_size = PacketType::serializedSize(typename Cfg::data_len_t(len));
+  if (frame_size > freeSpace(frame_size)) {
+    return nullptr;
+  }
+  byte_t* frame = data_ + (write_pos_ & mask_);
+  const std::size_t header_size = PacketType::writeHeader(typename Cfg::data_len_t(len), frame, 0, type);
+  reserved_len_ = len;
+  return frame + header_size;
+}
+
+template<typename Cfg>
+inline void
+ShmRingT<Cfg>::commit(void)
+{
+  PKT_ASSERT(reserved_len_ > 0);
+  const typename Cfg::data_len_t len = typename Cfg::data_len_t(reserved_len_);
+  byte_t* frame = data_ + (write_pos_ & mask_);
+  const std::size_t frame_size = PacketType::serializedSize(len);
+  byte_t* content = frame + frame_size - PacketType::TRAILER_SIZE - reserved_len_;
+  typename PacketType::checksum_t checksum_value = typename PacketType::checksum_t();
+  if (PacketType::CHECKSUM_SIZE > 0) {
+    using checksum = typename Cfg::checksum;
+    checksum_value = checksum::finish(checksum::update(checksum::init(), content, reserved_len_));
+  }
+  PacketType::writeTrailer(checksum_value, content + reserved_len_);
+  reserved_len_ = 0;
+  PacketType::metrics::onSerialized(frame_size);
+
+  write_pos_ += frame_size;
+  header_->write_pos.store(write_pos_, std::memory_order_release);
+  // only the producer writes the sequence (no read-modify-write needed), the seq_cst
+  // store orders it before the load of the flag against the fence of a sleeping reader
+  header_->write_seq.store(header_->write_seq.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+  if (header_->reader_waiting.load(std::memory_order_seq_cst) != 0) {
+    detail::futexWake(&header_->write_seq);
+  }
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::tryWrite(const byte_t* data,
+                        const std::size_t len,
+                        const typename PacketType::message_type_t type)
+{
+  PKT_ASSERT_PTR(data);
+  byte_t* content = reserve(len, type);
+  if (content == nullptr) {
+    return false;
+  }
+  std::memcpy(content, data, len);
+  commit();
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::write(const byte_t* data,
+                     const std::size_t len,
+                     const int timeout_ms,
+                     const typename PacketType::message_type_t type)
+{
+  if (len == 0 || len > std::size_t(Cfg::MAX_DATA_LEN) ||
+      PacketType::serializedSize(typename Cfg::data_len_t(len)) > capacity()) {
+    return false;
+  }
+  // the handoff latency includes the time waiting for the reader
+  const std::uint64_t start = tracing::now();
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+  std::size_t spins = 0;
+  while (!tryWrite(data, len, type)) {
+    if (++spins < SPIN_COUNT) {
+      detail::cpuRelax();
+      continue;
+    }
+    const std::uint32_t seq = header_->read_seq.load(std::memory_order_acquire);
+    header_->writer_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    const std::size_t frame_size = PacketType::serializedSize(typename Cfg::data_len_t(len));
+    if (frame_size > freeSpace(frame_size)) {
+      const int remaining = remainingMs(deadline, timeout_ms);
+      if (remaining == 0) {
+        header_->writer_waiting.store(0, std::memory_order_relaxed);
+        return false;
+      }
+      detail::futexWait(&header_->read_seq, seq, remaining);
+    }
+    header_->writer_waiting.store(0, std::memory_order_relaxed);
+  }
+  tracing::recordHandoff(tracing::now() - start);
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::tryRead(PacketView& view)
+{
+  PKT_ASSERT(isValid());
+  release();
+  if (status_ == Status::INVALID) {
+    return false;
+  }
+  if (cached_write_pos_ == read_pos_) {
+    cached_write_pos_ = header_->write_pos.load(std::memory_order_acquire);
+    if (cached_write_pos_ == read_pos_) {
+      return false;
+    }
+  }
+  const byte_t* frame = data_ + (read_pos_ & mask_);
+  FrameInfo info;
+  // the producer only publishes whole frames
+  if (PacketType::peekFrame(frame, std::size_t(cached_write_pos_ - read_pos_), info) != Status::COMPLETE) {
+    PKT_LOG_ERROR("invalid frame found on the shared memory ring");
+    status_ = Status::INVALID;
+    return false;
+  }
+  held_size_ = info.frame_size;
+  view.data = frame + info.data_offset;
+  view.len = info.data_len;
+  view.in_place = true;
+  view.message_type = info.message_type;
+  if ((info.flags & PacketType::FLAG_COMPRESSED) != 0) {
+    if (!PacketType::decompress(view.data, view.len, decompressed_,
+                                typename PacketType::message_type_t(info.message_type))) {
+      status_ = Status::INVALID;
+      return false;
+    }
+    view.data = decompressed_.data();
+    view.len = decompressed_.size();
+    view.in_place = false;
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+ShmRingT<Cfg>::read(PacketView& view, const int timeout_ms)
+{
+  const auto deadline = std::chrono::steady_clock::now() + std::chrono::milliseconds(std::max(timeout_ms, 0));
+  std::size_t spins = 0;
+  while (!tryRead(view)) {
+    if (status_ == Status::INVALID) {
+      return false;
+    }
+    if (++spins < SPIN_COUNT) {
+      detail::cpuRelax();
+      continue;
+    }
+    const std::uint32_t seq = header_->write_seq.load(std::memory_order_acquire);
+    header_->reader_waiting.store(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (header_->write_pos.load(std::memory_order_acquire) == read_pos_) {
+      const int remaining = remainingMs(deadline, timeout_ms);
+      if (remaining == 0) {
+        header_->reader_waiting.store(0, std::memory_order_relaxed);
+        return false;
+      }
+      detail::futexWait(&header_->write_seq, seq, remaining);
+    }
+    header_->reader_waiting.store(0, std::memory_order_relaxed);
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+ShmRingT<Cfg>::release(void)
+{
+  if (held_size_ == 0) {
+    return;
+  }
+  read_pos_ += held_size_;
+  held_size_ = 0;
+  header_->read_pos.store(read_pos_, std::memory_order_release);
+  // same as commit(), only the consumer writes the sequence
+  header_->read_seq.store(header_->read_seq.load(std::memory_order_relaxed) + 1, std::memory_order_seq_cst);
+  if (header_->writer_waiting.load(std::memory_order_seq_cst) != 0) {
+    detail::futexWake(&header_->read_seq);
+  }
+}
+
+template<typename Cfg>
+inline Status
+ShmRingT<Cfg>::status(void) const
+{
+  return status_;
+}
@@ -0,0 +1,180 @@
+#ifndef PACKET_STREAM_FRAMER_H_
+#define PACKET_STREAM_FRAMER_H_
+
+#include <vector>
+#include <cstdint>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/pattern_search.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The StreamFramerT class splits an arbitrary stream of bytes (for example the
+ *        chunks returned by a socket read) into packets. Every complete packet contained
+ *        in a chunk is emitted in a single pass and only the trailing partial packet (if
+ *        any) is kept internally until the next chunk arrives.
+ *        Packets fully contained in a chunk are returned as views pointing into the
+ *        caller buffer, only packets split between chunks are copied (and compressed
+ *        ones, which are decompressed into an internal buffer).
+ *        Optionally the framer can resynchronize the stream after an invalid packet,
+ *        skipping bytes until the next plausible packet (requires a head pattern).
+ * @tparam Cfg  The configuration to be used on the packets
+ */
+template<typename Cfg>
+class StreamFramerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using metrics = typename PacketType::metrics;
+    using tracing = typename PacketType::tracing;
+
+  public:
+    /**
+     * @brief Construct the framer
+     * @param resync  If true, instead of becoming INVALID when a malformed packet is
+     *                found the framer skips bytes until the next head pattern that starts
+     *                a plausible packet (valid length and tail) and continues from there
+     */
+    inline explicit StreamFramerT(const bool resync = false);
+
+    /**
+     * @brief Return the current status. The framer is INCOMPLETE while it is able to
+     *        keep reading packets and INVALID once a malformed packet was found
+     * @return the current status
+     */
+    inline Status
+    status(void) const;
+
+    /**
+     * @brief Reset the framer dropping any partial packet
+     */
+    inline void
+    reset(void);
+
+    /**
+     * @brief Returns the number of bytes of the trailing partial packet being held
+     * @return the number of bytes of the trailing partial packet being held
+     */
+    inline std::size_t
+    pendingBytes(void) const;
+
+    /**
+     * @brief Returns the size of the trailing partial packet as known so far: its full
+     *        frame size once the header was received, a smaller lower bound before
+     * @return the known size of the trailing partial packet, 0 if there is none
+     */
+    inline std::size_t
+    pendingFrameSize(void) const;
+
+    /**
+     * @brief Moves the trailing partial packet into pkt (which should be empty), so the
+     *        rest of it can be read straight into pkt.remainingBuffer(). Useful for big
+     *        packets that would otherwise be accumulated by the framer
+     * @param pkt the packet to continue reading the partial packet
+     */
+    inline void
+    movePending(PacketType& pkt);
+
+    /**
+     * @brief Returns the number of bytes discarded while resynchronizing the stream
+     * @return the number of bytes discarded while resynchronizing the stream
+     */
+    inline std::size_t
+    skippedBytes(void) const;
+
+    /**
+     * @brief Sets the chunk of data that will be read by next(). The chunk is not copied
+     *        so it must be kept alive while the views returned by next() are used
+     * @param data  The chunk of data
+     * @param len   The length of the chunk
+     */
+    inline void
+    setInput(const byte_t* data, const std::size_t len);
+
+    /**
+     * @brief Returns the amount of bytes of the current input consumed so far
+     * @return the amount of bytes of the current input consumed so far
+     */
+    inline std::size_t
+    inputConsumed(void) const;
+
+    /**
+     * @brief Reads the next completed packet from the current input
+     * @param view  The view of the packet content. It is valid until the next call to
+     *              next() / setInput() / reset() (or while the input is alive if in_place)
+     * @return true if a packet was read, false if the input has no more complete packets
+     *         (the trailing partial packet is kept) or an invalid packet was found
+     */
+    inline bool
+    next(PacketView& view);
+
+    /**
+     * @brief Feeds a chunk of data into the framer and emits all the completed packets
+     * @param data      The chunk of data
+     * @param len       The length of the chunk
+     * @param handler   Callable as handler(const byte_t* content, std::size_t content_len)
+     *                  called once per completed packet. The content pointer is only valid
+     *                  during the call
+     * @return the amount of bytes consumed, this is len unless an invalid packet is found
+     */
+    template<typename Handler>
+    inline std::size_t
+    feed(const byte_t* data, const std::size_t len, Handler&& handler);
+
+
+  private:
+
+    inline bool
+    completePending(FrameInfo& info);
+
+    inline void
+    dropPending(const std::size_t len);
+
+    inline void
+    releaseEmittedPending(void);
+
+    inline bool
+    makeView(const byte_t* frame, const FrameInfo& info, const bool in_place, PacketView& view);
+
+    inline bool
+    canResync(void) const;
+
+    inline void
+    markInvalid(void);
+
+    static inline std::size_t
+    findResyncPoint(const byte_t* data, const std::size_t len);
+
+  private:
+    bool resync_;
+    std::size_t skipped_bytes_;
+    Status status_;
+    std::vector<byte_t> pending_;
+    Buffer decompressed_;
+    bool pending_emitted_;
+    // inputs the pending packet was taken from (only kept with metrics)
+    detail::AppendCounter<metrics::ENABLED> pending_inputs_;
+    // when the first bytes of the pending packet arrived (only kept with tracing)
+    detail::TraceStamp<tracing::ENABLED> pending_start_;
+    std::size_t pending_frame_size_;
+    const byte_t* input_;
+    std::size_t input_len_;
+    std::size_t input_idx_;
+};
+
+
+
+#include <packet/stream_framer_impl.h>
+
+
+// Default definition of a framer
+using DefaultStreamFramer = StreamFramerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_STREAM_FRAMER_H_
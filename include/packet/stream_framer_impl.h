@@ -0,0 +1,309 @@
+
+
+template<typename Cfg>
+inline bool
+StreamFramerT<Cfg>::completePending(FrameInfo& info)
+{
+  // the skipped bytes are only dropped from pending_ (a copy of what is left) once, when
+  // leaving, or before appending if they are most of it, so resync stays linear
+  std::size_t start = 0;
+  while (true) {
+    const Status frame_status = PacketType::peekFrame(pending_.data() + start, pending_.size() - start, info);
+    if (frame_status == Status::COMPLETE) {
+      dropPending(start);
+      return true;
+    }
+    if (frame_status == Status::INVALID) {
+      if (!canResync()) {
+        dropPending(start);
+        markInvalid();
+        return false;
+      }
+      metrics::onInvalidFrame();
+      // skip the bytes till the next candidate and keep going with what is left
+      const std::size_t skip = findResyncPoint(pending_.data() + start, pending_.size() - start);
+      start += skip;
+      skipped_bytes_ += skip;
+      if (start == pending_.size()) {
+        pending_.clear();
+        pending_frame_size_ = 0;
+        return false;
+      }
+      continue;
+    }
+    if (input_idx_ == input_len_) {
+      dropPending(start);
+      pending_frame_size_ = info.frame_size;
+      return false;
+    }
+    if (start >= pending_.size() - start) {
+      dropPending(start);
+      start = 0;
+    }
+    // we only take the bytes we know belong to this packet
+    const std::size_t to_copy = std::min(info.frame_size - (pending_.size() - start), input_len_ - input_idx_);
+    const std::size_t capacity = pending_.capacity();
+    pending_.insert(pending_.end(), input_ + input_idx_, input_ + input_idx_ + to_copy);
+    input_idx_ += to_copy;
+    if (metrics::ENABLED && pending_.capacity() != capacity) {
+      metrics::onReallocation(pending_.capacity());
+    }
+  }
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::dropPending(const std::size_t len)
+{
+  if (len > 0) {
+    pending_.erase(pending_.begin(), pending_.begin() + len);
+  }
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::releaseEmittedPending(void)
+{
+  if (pending_emitted_) {
+    pending_.clear();
+    pending_emitted_ = false;
+    pending_frame_size_ = 0;
+  }
+}
+
+template<typename Cfg>
+inline bool
+StreamFramerT<Cfg>::makeView(const byte_t* frame,
+                             const FrameInfo& info,
+                             const bool in_place,
+                             PacketView& view)
+{
+  view.message_type = info.message_type;
+  if ((info.flags & PacketType::FLAG_COMPRESSED) == 0) {
+    view.data = frame + info.data_offset;
+    view.len = info.data_len;
+    view.in_place = in_place;
+    return true;
+  }
+  if (!PacketType::decompress(frame + info.data_offset, info.data_len, decompressed_,
+                              typename PacketType::message_type_t(info.message_type))) {
+    return false;
+  }
+  view.data = decompressed_.data();
+  view.len = decompressed_.size();
+  view.in_place = false;
+  return true;
+}
+
+template<typename Cfg>
+inline bool
+StreamFramerT<Cfg>::canResync(void) const
+{
+  return resync_ && PacketType::HEAD_PATTERN_SIZE > 0;
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::markInvalid(void)
+{
+  PKT_LOG_ERROR("invalid packet found on the stream");
+  metrics::onInvalidFrame();
+  status_ = Status::INVALID;
+}
+
+template<typename Cfg>
+inline std::size_t
+StreamFramerT<Cfg>::findResyncPoint(const byte_t* data, const std::size_t len)
+{
+  // the current position is known to be invalid so we start from the next byte
+  PKT_ASSERT(len > 0);
+  return 1 + findPatternCandidate(data + 1,
+                                  len - 1,
+                                  reinterpret_cast<const byte_t*>(Cfg::HEAD_PATTERN),
+                                  PacketType::HEAD_PATTERN_SIZE);
+}
+
+
+template<typename Cfg>
+inline StreamFramerT<Cfg>::StreamFramerT(const bool resync) :
+  resync_(resync)
+, skipped_bytes_(0)
+, status_(Status::INCOMPLETE)
+, pending_emitted_(false)
+, pending_frame_size_(0)
+, input_(nullptr)
+, input_len_(0)
+, input_idx_(0)
+{}
+
+template<typename Cfg>
+inline Status
+StreamFramerT<Cfg>::status(void) const
+{
+  return status_;
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::reset(void)
+{
+  status_ = Status::INCOMPLETE;
+  skipped_bytes_ = 0;
+  pending_.clear();
+  pending_emitted_ = false;
+  pending_frame_size_ = 0;
+  input_ = nullptr;
+  input_len_ = 0;
+  input_idx_ = 0;
+}
+
+template<typename Cfg>
+inline std::size_t
+StreamFramerT<Cfg>::pendingBytes(void) const
+{
+  return pending_emitted_ ? 0 : pending_.size();
+}
+
+template<typename Cfg>
+inline std::size_t
+StreamFramerT<Cfg>::pendingFrameSize(void) const
+{
+  return pendingBytes() == 0 ? 0 : pending_frame_size_;
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::movePending(PacketType& pkt)
+{
+  releaseEmittedPending();
+  std::size_t offset = 0;
+  while (offset < pending_.size() && pkt.status() == Status::INCOMPLETE) {
+    offset += pkt.appendData(pending_.data() + offset, pending_.size() - offset);
+  }
+  pending_.clear();
+  pending_frame_size_ = 0;
+}
+
+template<typename Cfg>
+inline std::size_t
+StreamFramerT<Cfg>::skippedBytes(void) const
+{
+  return skipped_bytes_;
+}
+
+template<typename Cfg>
+inline void
+StreamFramerT<Cfg>::setInput(const byte_t* data, const std::size_t len)
+{
+  PKT_ASSERT(data != nullptr || len == 0);
+  releaseEmittedPending();
+  input_ = data;
+  input_len_ = len;
+  input_idx_ = 0;
+  metrics::onAppend(len);
+  if (!pending_.empty()) {
+    pending_inputs_.increment();
+  }
+}
+
+template<typename Cfg>
+inline std::size_t
+StreamFramerT<Cfg>::inputConsumed(void) const
+{
+  return input_idx_;
+}
+
+template<typename Cfg>
+inline bool
+StreamFramerT<Cfg>::next(PacketView& view)
+{
+  releaseEmittedPending();
+  if (status_ == Status::INVALID) {
+    return false;
+  }
+
+  FrameInfo info;
+  if (!pending_.empty()) {
+    if (completePending(info)) {
+      pending_emitted_ = true;
+      if (makeView(pending_.data(), info, false, view)) {
+        metrics::onPacket(pending_inputs_.value());
+        tracing::recordAssembly(tracing::now() - pending_start_.value());
+        return true;
+      }
+      // the frame is well formed but its content can not be decompressed
+      if (!canResync()) {
+        markInvalid();
+        return false;
+      }
+      metrics::onInvalidFrame();
+      skipped_bytes_ += pending_.size();
+      releaseEmittedPending();
+    } else if (!pending_.empty() || status_ == Status::INVALID) {
+      return false;
+    }
+  }
+
+  // fast path: whole packets contained in the input are returned in place
+  while (input_idx_ < input_len_) {
+    const byte_t* frame = input_ + input_idx_;
+    const std::size_t available = input_len_ - input_idx_;
+    const Status frame_status = PacketType::peekFrame(frame, available, info);
+    if (frame_status == Status::COMPLETE) {
+      if (!makeView(frame, info, true, view)) {
+        // the frame is well formed but its content can not be decompressed
+        if (!canResync()) {
+          markInvalid();
+          return false;
+        }
+        metrics::onInvalidFrame();
+        skipped_bytes_ += info.frame_size;
+        input_idx_ += info.frame_size;
+        continue;
+      }
+      input_idx_ += info.frame_size;
+      metrics::onPacket(1);
+      // the whole packet came in a single input
+      tracing::recordAssembly(0);
+      return true;
+    }
+    if (frame_status == Status::INVALID) {
+      if (!canResync()) {
+        markInvalid();
+        return false;
+      }
+      metrics::onInvalidFrame();
+      const std::size_t skip = findResyncPoint(frame, available);
+      input_idx_ += skip;
+      skipped_bytes_ += skip;
+      continue;
+    }
+
+    // keep the trailing partial packet
+    const std::size_t capacity = pending_.capacity();
+    pending_.assign(frame, input_ + input_len_);
+    pending_inputs_.clear();
+    pending_inputs_.increment();
+    pending_start_.set(tracing::now());
+    if (metrics::ENABLED && pending_.capacity() != capacity) {
+      metrics::onReallocation(pending_.capacity());
+    }
+    pending_frame_size_ = info.frame_size;
+    input_idx_ = input_len_;
+  }
+  return false;
+}
+
+template<typename Cfg>
+template<typename Handler>
+inline std::size_t
+StreamFramerT<Cfg>::feed(const byte_t* data, const std::size_t len, Handler&& handler)
+{
+  setInput(data, len);
+  PacketView view;
+  while (next(view)) {
+    handler(view.data, view.len);
+  }
+  releaseEmittedPending();
+  return inputConsumed();
+}
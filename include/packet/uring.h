@@ -0,0 +1,153 @@
+#ifndef PACKET_URING_H_
+#define PACKET_URING_H_
+
+#include <cstdint>
+#include <algorithm>
+#include <cstring>
+#include <cerrno>
+
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+namespace detail {
+
+/**
+ * @brief Minimal io_uring wrapper on top of the raw system calls (no liburing needed): the
+ *        submission / completion rings and, optionally, one provided buffer ring from
+ *        where the kernel picks the buffers of the operations using IOSQE_BUFFER_SELECT.
+ *        It is meant to be used from a single thread.
+ */
+class Uring {
+  public:
+    inline Uring();
+    inline ~Uring();
+
+    // not copyable
+    Uring(const Uring&) = delete;
+    Uring& operator=(const Uring&) = delete;
+
+    /**
+     * @brief Creates the ring
+     * @param sq_entries  The number of submission entries
+     * @param cq_entries  The number of completion entries
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    init(const unsigned sq_entries, const unsigned cq_entries);
+
+    /**
+     * @brief Releases the ring (pending operations are cancelled) and the buffer ring
+     */
+    inline void
+    release(void);
+
+    /**
+     * @brief Returns true if the ring was created
+     * @return true if the ring was created
+     */
+    inline bool
+    isValid(void) const;
+
+    /**
+     * @brief Registers a provided buffer ring. The buffers are added with provideBuffer()
+     *        and become visible to the kernel after commitBuffers()
+     * @param group   The buffer group id used on the operations
+     * @param entries The number of entries of the ring (power of two)
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    registerBufferRing(const std::uint16_t group, const unsigned entries);
+
+    /**
+     * @brief Adds a buffer to the provided buffer ring
+     * @param data  The buffer
+     * @param len   The length of the buffer
+     * @param id    The id reported on the completions using the buffer
+     */
+    inline void
+    provideBuffer(byte_t* data, const unsigned len, const std::uint16_t id);
+
+    /**
+     * @brief Publishes the buffers added with provideBuffer() to the kernel
+     */
+    inline void
+    commitBuffers(void);
+
+    /**
+     * @brief Returns a cleared submission entry, submitting the queued ones if the
+     *        submission ring is full
+     * @return the submission entry or nullptr on error
+     */
+    inline io_uring_sqe*
+    getSqe(void);
+
+    /**
+     * @brief Submits the queued entries and waits for at least wait_count completions
+     * @param wait_count the number of completions to wait for
+     * @return the number of entries submitted, or -errno
+     */
+    inline int
+    submitAndWait(const unsigned wait_count);
+
+    /**
+     * @brief Calls fn(const io_uring_cqe&) for every available completion
+     * @param fn the function to call
+     * @return the number of completions processed
+     */
+    template<typename Fn>
+    inline unsigned
+    forEachCompletion(Fn&& fn);
+
+    /**
+     * @brief Probes if io_uring with provided buffer rings is usable on this system
+     * @return true if it is usable
+     */
+    static inline bool
+    isSupported(void);
+
+  private:
+    int fd_;
+    void* sq_ring_;
+    std::size_t sq_ring_size_;
+    void* cq_ring_;
+    std::size_t cq_ring_size_;
+    io_uring_sqe* sqes_;
+    std::size_t sqes_size_;
+
+    unsigned* sq_head_;
+    unsigned* sq_tail_;
+    unsigned sq_mask_;
+    unsigned sq_entries_;
+    unsigned* sq_array_;
+    unsigned sq_local_tail_;
+    unsigned sq_submitted_tail_;
+
+    unsigned* cq_head_;
+    unsigned* cq_tail_;
+    unsigned cq_mask_;
+    io_uring_cqe* cqes_;
+
+    // the ring is used as a plain io_uring_buf array (the tail overlays bufs[0].resv),
+    // io_uring_buf_ring can not be used from c++ since its flexible array is misplaced
+    io_uring_buf* buf_ring_;
+    std::size_t buf_ring_size_;
+    unsigned buf_ring_mask_;
+    std::uint16_t buf_ring_tail_;
+};
+
+
+#include <packet/uring_impl.h>
+
+}
+
+}
+
+#endif // PACKET_URING_H_
@@ -0,0 +1,220 @@
+
+
+
+inline Uring::Uring() :
+  fd_(-1)
+, sq_ring_(MAP_FAILED)
+, sq_ring_size_(0)
+, cq_ring_(MAP_FAILED)
+, cq_ring_size_(0)
+, sqes_(nullptr)
+, sqes_size_(0)
+, sq_head_(nullptr)
+, sq_tail_(nullptr)
+, sq_mask_(0)
+, sq_entries_(0)
+, sq_array_(nullptr)
+, sq_local_tail_(0)
+, sq_submitted_tail_(0)
+, cq_head_(nullptr)
+, cq_tail_(nullptr)
+, cq_mask_(0)
+, cqes_(nullptr)
+, buf_ring_(nullptr)
+, buf_ring_size_(0)
+, buf_ring_mask_(0)
+, buf_ring_tail_(0)
+{}
+
+inline Uring::~Uring()
+{
+  release();
+}
+
+inline bool
+Uring::init(const unsigned sq_entries, const unsigned cq_entries)
+{
+  release();
+  io_uring_params params;
+  std::memset(&params, 0, sizeof(params));
+  params.flags = IORING_SETUP_CQSIZE | IORING_SETUP_CLAMP;
+  params.cq_entries = cq_entries;
+  fd_ = int(::syscall(__NR_io_uring_setup, sq_entries, &params));
+  if (fd_ < 0) {
+    fd_ = -1;
+    return false;
+  }
+
+  sq_ring_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+  cq_ring_size_ = params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+  const bool single_mmap = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+  if (single_mmap) {
+    sq_ring_size_ = cq_ring_size_ = std::max(sq_ring_size_, cq_ring_size_);
+  }
+  sq_ring_ = ::mmap(nullptr, sq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQ_RING);
+  if (sq_ring_ == MAP_FAILED) {
+    release();
+    return false;
+  }
+  if (!single_mmap) {
+    cq_ring_ = ::mmap(nullptr, cq_ring_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_CQ_RING);
+    if (cq_ring_ == MAP_FAILED) {
+      release();
+      return false;
+    }
+  }
+  sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+  void* sqes = ::mmap(nullptr, sqes_size_, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, fd_, IORING_OFF_SQES);
+  if (sqes == MAP_FAILED) {
+    release();
+    return false;
+  }
+  sqes_ = static_cast<io_uring_sqe*>(sqes);
+
+  byte_t* sq = static_cast<byte_t*>(sq_ring_);
+  byte_t* cq = static_cast<byte_t*>(single_mmap ? sq_ring_ : cq_ring_);
+  sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+  sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+  sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+  sq_entries_ = params.sq_entries;
+  sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+  sq_local_tail_ = sq_submitted_tail_ = *sq_tail_;
+  cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+  cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+  cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+  cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+  return true;
+}
+
+inline void
+Uring::release(void)
+{
+  if (fd_ >= 0) {
+    ::close(fd_);
+    fd_ = -1;
+  }
+  if (buf_ring_ != nullptr) {
+    ::munmap(buf_ring_, buf_ring_size_);
+    buf_ring_ = nullptr;
+  }
+  if (sqes_ != nullptr) {
+    ::munmap(sqes_, sqes_size_);
+    sqes_ = nullptr;
+  }
+  if (cq_ring_ != MAP_FAILED) {
+    ::munmap(cq_ring_, cq_ring_size_);
+    cq_ring_ = MAP_FAILED;
+  }
+  if (sq_ring_ != MAP_FAILED) {
+    ::munmap(sq_ring_, sq_ring_size_);
+    sq_ring_ = MAP_FAILED;
+  }
+}
+
+inline bool
+Uring::isValid(void) const
+{
+  return fd_ >= 0;
+}
+
+inline bool
+Uring::registerBufferRing(const std::uint16_t group, const unsigned entries)
+{
+  PKT_ASSERT(isValid() && buf_ring_ == nullptr);
+  PKT_ASSERT(entries > 0 && (entries & (entries - 1)) == 0);
+  buf_ring_size_ = entries * sizeof(io_uring_buf);
+  void* ring = ::mmap(nullptr, buf_ring_size_, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+  if (ring == MAP_FAILED) {
+    return false;
+  }
+  io_uring_buf_reg reg;
+  std::memset(&reg, 0, sizeof(reg));
+  reg.ring_addr = reinterpret_cast<std::uint64_t>(ring);
+  reg.ring_entries = entries;
+  reg.bgid = group;
+  if (::syscall(__NR_io_uring_register, fd_, IORING_REGISTER_PBUF_RING, &reg, 1) != 0) {
+    const int error = errno;
+    ::munmap(ring, buf_ring_size_);
+    errno = error;
+    return false;
+  }
+  buf_ring_ = static_cast<io_uring_buf*>(ring);
+  buf_ring_mask_ = entries - 1;
+  buf_ring_tail_ = 0;
+  return true;
+}
+
+inline void
+Uring::provideBuffer(byte_t* data, const unsigned len, const std::uint16_t id)
+{
+  PKT_ASSERT_PTR(buf_ring_);
+  io_uring_buf& buf = buf_ring_[buf_ring_tail_ & buf_ring_mask_];
+  buf.addr = reinterpret_cast<std::uint64_t>(data);
+  buf.len = len;
+  buf.bid = id;
+  ++buf_ring_tail_;
+}
+
+inline void
+Uring::commitBuffers(void)
+{
+  PKT_ASSERT_PTR(buf_ring_);
+  __atomic_store_n(&buf_ring_[0].resv, buf_ring_tail_, __ATOMIC_RELEASE);
+}
+
+inline io_uring_sqe*
+Uring::getSqe(void)
+{
+  if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_ &&
+      submitAndWait(0) < 0) {
+    return nullptr;
+  }
+  if (sq_local_tail_ - __atomic_load_n(sq_head_, __ATOMIC_ACQUIRE) >= sq_entries_) {
+    return nullptr;
+  }
+  const unsigned index = sq_local_tail_ & sq_mask_;
+  io_uring_sqe* sqe = &sqes_[index];
+  std::memset(sqe, 0, sizeof(*sqe));
+  sq_array_[index] = index;
+  ++sq_local_tail_;
+  return sqe;
+}
+
+inline int
+Uring::submitAndWait(const unsigned wait_count)
+{
+  const unsigned to_submit = sq_local_tail_ - sq_submitted_tail_;
+  __atomic_store_n(sq_tail_, sq_local_tail_, __ATOMIC_RELEASE);
+  sq_submitted_tail_ = sq_local_tail_;
+  const unsigned flags = wait_count > 0 ? IORING_ENTER_GETEVENTS : 0;
+  while (true) {
+    const int result = int(::syscall(__NR_io_uring_enter, fd_, to_submit, wait_count, flags, nullptr, 0));
+    if (result >= 0) {
+      return result;
+    }
+    if (errno != EINTR) {
+      return -errno;
+    }
+  }
+}
+
+template<typename Fn>
+inline unsigned
+Uring::forEachCompletion(Fn&& fn)
+{
+  unsigned head = *cq_head_;
+  const unsigned tail = __atomic_load_n(cq_tail_, __ATOMIC_ACQUIRE);
+  const unsigned count = tail - head;
+  for (; head != tail; ++head) {
+    fn(static_cast<const io_uring_cqe&>(cqes_[head & cq_mask_]));
+  }
+  __atomic_store_n(cq_head_, head, __ATOMIC_RELEASE);
+  return count;
+}
+
+inline bool
+Uring::isSupported(void)
+{
+  Uring ring;
+  return ring.init(2, 4) && ring.registerBufferRing(0, 1);
+}
@@ -0,0 +1,256 @@
+#ifndef PACKET_URING_SERVER_H_
+#define PACKET_URING_SERVER_H_
+
+#include <vector>
+#include <cstdint>
+#include <memory>
+#include <thread>
+#include <atomic>
+#include <functional>
+#include <unordered_map>
+#include <cerrno>
+
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <arpa/inet.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/stream_framer.h>
+#include <packet/epoll_server.h>
+#include <packet/uring.h>
+#include <packet/debug_helper.h>
+
+
+namespace packet {
+
+
+/**
+ * @brief The backends a UringServerT can run on
+ */
+enum class ServerBackend {
+  // io_uring if it is available, epoll otherwise
+  AUTO,
+  IO_URING,
+  EPOLL
+};
+
+
+/**
+ * @brief The UringServerT class is an (optional, linux only) TCP server with the same
+ *        interface than EpollServerT but reading the connections with io_uring:
+ *        - every reactor thread has its own ring, SO_REUSEPORT listening socket (with a
+ *          multishot accept) and a provided buffer ring shared by all its connections
+ *        - each connection has a multishot recv, the kernel picks a buffer from the ring
+ *          and the completion is framed in place, after that the buffer goes back to
+ *          the ring. There is no read syscall per chunk and idle connections do not
+ *          own any buffer
+ *        If io_uring (with provided buffer rings) is not available the server falls back
+ *        to an EpollServerT (check backend()).
+ * @tparam Cfg  The configuration to be used on the packets
+ */
+template<typename Cfg>
+class UringServerT {
+  public:
+
+    using PacketType = PacketT<Cfg>;
+    using FramerType = StreamFramerT<Cfg>;
+    using Handler = typename EpollServerT<Cfg>::Handler;
+
+    /**
+     * @brief BUFFER_SIZE is the size of each provided buffer
+     */
+    static constexpr const std::size_t BUFFER_SIZE = 16 * 1024;
+
+    /**
+     * @brief BUFFERS_COUNT is the number of provided buffers of each reactor
+     */
+    static constexpr const std::size_t BUFFERS_COUNT = 256;
+
+    static_assert((BUFFERS_COUNT & (BUFFERS_COUNT - 1)) == 0, "the buffer ring size must be a power of two");
+
+    /**
+     * @brief ACCEPT_RETRY_MS is the time before accepting again after a persistent accept
+     *        error (out of file descriptors or memory), unless a connection closes before
+     */
+    static constexpr const long ACCEPT_RETRY_MS = 100;
+
+  public:
+    /**
+     * @brief Construct the server
+     * @param handler       The handler for the completed packets (called from the reactor
+     *                      threads, the content is only valid during the call)
+     * @param threads_count The number of reactor threads (0 means one per core)
+     * @param backend       The backend to use
+     */
+    inline explicit UringServerT(Handler handler,
+                                 const std::size_t threads_count = 0,
+                                 const ServerBackend backend = ServerBackend::AUTO);
+    inline ~UringServerT();
+
+    // not copyable
+    UringServerT(const UringServerT&) = delete;
+    UringServerT& operator=(const UringServerT&) = delete;
+
+    /**
+     * @brief Starts listening and the reactor threads
+     * @param port    The port to listen on, 0 to pick any (check port())
+     * @param address The IPv4 address to listen on
+     * @return true on success | false otherwise (errno is kept)
+     */
+    inline bool
+    start(const std::uint16_t port, const char* address = "0.0.0.0");
+
+    /**
+     * @brief Stops the reactor threads and closes all the connections
+     */
+    inline void
+    stop(void);
+
+    /**
+     * @brief Returns the backend actually used (IO_URING or EPOLL) once started
+     * @return the backend actually used
+     */
+    inline ServerBackend
+    backend(void) const;
+
+    /**
+     * @brief Returns true if the server is running
+     * @return true if the server is running
+     */
+    inline bool
+    isRunning(void) const;
+
+    /**
+     * @brief Returns the port the server is listening on
+     * @return the port the server is listening on
+     */
+    inline std::uint16_t
+    port(void) const;
+
+    /**
+     * @brief Returns the number of reactor threads
+     * @return the number of reactor threads
+     */
+    inline std::size_t
+    threadsCount(void) const;
+
+    /**
+     * @brief Returns the number of open connections
+     * @return the number of open connections
+     */
+    inline std::size_t
+    connectionsCount(void) const;
+
+    /**
+     * @brief Returns the number of connections closed because of an invalid packet
+     * @return the number of connections closed because of an invalid packet
+     */
+    inline std::size_t
+    invalidCount(void) const;
+
+    /**
+     * @brief Returns true if io_uring can be used on this system
+     * @return true if io_uring can be used on this system
+     */
+    static inline bool
+    isSupported(void);
+
+
+  private:
+
+    enum class Operation : std::uint32_t {
+      ACCEPT = 1,
+      RECV,
+      WAKE,
+      ACCEPT_RETRY,
+    };
+
+    struct Connection {
+      int fd;
+      FramerType framer;
+      // waiting for the last completion to close it
+      bool closing;
+    };
+
+    struct Reactor {
+      detail::Uring ring;
+      int listen_fd = -1;
+      int wake_fd = -1;
+      std::uint64_t wake_value = 0;
+      // the multishot accept is running / the retry timer after a persistent error is
+      bool accept_armed = false;
+      bool accept_retry_armed = false;
+      struct __kernel_timespec accept_retry_timeout = {};
+      std::thread thread;
+      std::vector<byte_t> buffers;
+      std::unordered_map<int, std::unique_ptr<Connection>> connections;
+    };
+
+  private:
+
+    static inline std::uint64_t
+    userData(const Operation operation, const int fd);
+
+    inline bool
+    setupReactor(Reactor& reactor, const sockaddr_in& addr);
+
+    inline void
+    closeReactor(Reactor& reactor);
+
+    inline void
+    run(Reactor& reactor);
+
+    inline void
+    handleCompletion(Reactor& reactor, const io_uring_cqe& cqe);
+
+    inline void
+    handleRecv(Reactor& reactor, const int fd, const io_uring_cqe& cqe);
+
+    inline bool
+    armAccept(Reactor& reactor);
+
+    inline void
+    armAcceptRetry(Reactor& reactor);
+
+    static inline bool
+    isTransientAcceptError(const int error);
+
+    inline bool
+    armRecv(Reactor& reactor, const int fd);
+
+    inline void
+    addConnection(Reactor& reactor, const int fd);
+
+    inline void
+    closeConnection(Reactor& reactor, const int fd);
+
+    inline void
+    recycleBuffer(Reactor& reactor, const std::uint16_t id);
+
+  private:
+    Handler handler_;
+    ServerBackend backend_;
+    std::unique_ptr<EpollServerT<Cfg>> fallback_;
+    std::vector<std::unique_ptr<Reactor>> reactors_;
+    std::uint16_t port_;
+    std::size_t threads_count_;
+    std::atomic<bool> running_;
+    std::atomic<std::size_t> connections_count_;
+    std::atomic<std::size_t> invalid_count_;
+};
+
+
+
+#include <packet/uring_server_impl.h>
+
+
+// Default definition of a server
+using DefaultUringServer = UringServerT<DefaultConfig>;
+
+}
+
+#endif // PACKET_URING_SERVER_H_
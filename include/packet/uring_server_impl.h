@@ -0,0 +1,418 @@
+
+
+
+template<typename Cfg>
+inline std::uint64_t
+UringServerT<Cfg>::userData(const Operation operation, const int fd)
+{
+  return (std::uint64_t(operation) << 32) | std::uint32_t(fd);
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::setupReactor(Reactor& reactor, const sockaddr_in& addr)
+{
+  reactor.listen_fd = detail::openListenSocket(addr);
+  reactor.wake_fd = ::eventfd(0, EFD_CLOEXEC);
+  if (reactor.listen_fd < 0 || reactor.wake_fd < 0) {
+    return false;
+  }
+  if (!reactor.ring.init(256, 4096) ||
+      !reactor.ring.registerBufferRing(0, BUFFERS_COUNT)) {
+    return false;
+  }
+  reactor.buffers.resize(BUFFERS_COUNT * BUFFER_SIZE);
+  for (std::size_t i = 0; i < BUFFERS_COUNT; ++i) {
+    reactor.ring.provideBuffer(reactor.buffers.data() + i * BUFFER_SIZE, BUFFER_SIZE, std::uint16_t(i));
+  }
+  reactor.ring.commitBuffers();
+
+  if (!armAccept(reactor)) {
+    return false;
+  }
+  io_uring_sqe* sqe = reactor.ring.getSqe();
+  if (sqe == nullptr) {
+    return false;
+  }
+  sqe->opcode = IORING_OP_READ;
+  sqe->fd = reactor.wake_fd;
+  sqe->addr = reinterpret_cast<std::uint64_t>(&reactor.wake_value);
+  sqe->len = sizeof(reactor.wake_value);
+  sqe->user_data = userData(Operation::WAKE, reactor.wake_fd);
+  return reactor.ring.submitAndWait(0) >= 0;
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::closeReactor(Reactor& reactor)
+{
+  // releasing the ring cancels all the pending operations
+  reactor.ring.release();
+  for (auto& entry : reactor.connections) {
+    ::close(entry.first);
+  }
+  reactor.connections.clear();
+  for (int* fd : {&reactor.listen_fd, &reactor.wake_fd}) {
+    if (*fd >= 0) {
+      ::close(*fd);
+      *fd = -1;
+    }
+  }
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::run(Reactor& reactor)
+{
+  while (running_) {
+    const int result = reactor.ring.submitAndWait(1);
+    if (result < 0 && result != -EBUSY) {
+      PKT_LOG_ERROR("io_uring_enter failed: " << -result);
+      break;
+    }
+    reactor.ring.forEachCompletion([this, &reactor](const io_uring_cqe& cqe) {
+      handleCompletion(reactor, cqe);
+    });
+    // the buffers recycled while handling the completions
+    reactor.ring.commitBuffers();
+  }
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::handleCompletion(Reactor& reactor, const io_uring_cqe& cqe)
+{
+  const Operation operation = Operation(cqe.user_data >> 32);
+  const int fd = int(std::uint32_t(cqe.user_data));
+  switch (operation) {
+    case Operation::ACCEPT: {
+      if (cqe.res >= 0) {
+        addConnection(reactor, cqe.res);
+      }
+      if ((cqe.flags & IORING_CQE_F_MORE) != 0) {
+        break;
+      }
+      reactor.accept_armed = false;
+      if (!running_) {
+        break;
+      }
+      if (cqe.res >= 0 || isTransientAcceptError(-cqe.res)) {
+        armAccept(reactor);
+      } else {
+        // accepting again right away would fail again (and spin), it is retried once a
+        // connection closes or after ACCEPT_RETRY_MS
+        PKT_LOG_ERROR("accept failed: " << -cqe.res);
+        armAcceptRetry(reactor);
+      }
+      break;
+    }
+    case Operation::ACCEPT_RETRY: {
+      reactor.accept_retry_armed = false;
+      if (!reactor.accept_armed && running_) {
+        armAccept(reactor);
+      }
+      break;
+    }
+    case Operation::RECV: {
+      handleRecv(reactor, fd, cqe);
+      break;
+    }
+    case Operation::WAKE: {
+      // stop() was called, running_ is checked on the loop
+      break;
+    }
+  }
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::handleRecv(Reactor& reactor, const int fd, const io_uring_cqe& cqe)
+{
+  const bool has_buffer = (cqe.flags & IORING_CQE_F_BUFFER) != 0;
+  const std::uint16_t buffer_id = std::uint16_t(cqe.flags >> IORING_CQE_BUFFER_SHIFT);
+  const auto it = reactor.connections.find(fd);
+  if (it == reactor.connections.end()) {
+    if (has_buffer) {
+      recycleBuffer(reactor, buffer_id);
+    }
+    return;
+  }
+
+  Connection& connection = *it->second;
+  if (cqe.res > 0 && has_buffer && !connection.closing) {
+    // the data is framed in place on the buffer picked by the kernel
+    const byte_t* data = reactor.buffers.data() + std::size_t(buffer_id) * BUFFER_SIZE;
+    connection.framer.setInput(data, std::size_t(cqe.res));
+    PacketView view;
+    while (connection.framer.next(view)) {
+      handler_(fd, view.data, view.len, view.message_type);
+    }
+    if (connection.framer.status() == Status::INVALID) {
+      ++invalid_count_;
+      // the fd is closed once the recv is over so it can not be reused before
+      connection.closing = true;
+      ::shutdown(fd, SHUT_RDWR);
+    }
+  }
+  if (has_buffer) {
+    recycleBuffer(reactor, buffer_id);
+  }
+
+  if ((cqe.flags & IORING_CQE_F_MORE) != 0) {
+    return;
+  }
+  // the multishot recv is over: it ran out of buffers or the connection is done
+  if (!connection.closing && (cqe.res > 0 || cqe.res == -ENOBUFS) && armRecv(reactor, fd)) {
+    return;
+  }
+  closeConnection(reactor, fd);
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::armAccept(Reactor& reactor)
+{
+  io_uring_sqe* sqe = reactor.ring.getSqe();
+  if (sqe == nullptr) {
+    PKT_LOG_ERROR("no submission entry available for accept");
+    return false;
+  }
+  sqe->opcode = IORING_OP_ACCEPT;
+  sqe->fd = reactor.listen_fd;
+  sqe->ioprio = IORING_ACCEPT_MULTISHOT;
+  sqe->accept_flags = SOCK_NONBLOCK | SOCK_CLOEXEC;
+  sqe->user_data = userData(Operation::ACCEPT, reactor.listen_fd);
+  reactor.accept_armed = true;
+  return true;
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::armAcceptRetry(Reactor& reactor)
+{
+  if (reactor.accept_retry_armed) {
+    return;
+  }
+  io_uring_sqe* sqe = reactor.ring.getSqe();
+  if (sqe == nullptr) {
+    PKT_LOG_ERROR("no submission entry available for the accept retry");
+    return;
+  }
+  reactor.accept_retry_timeout.tv_sec = ACCEPT_RETRY_MS / 1000;
+  reactor.accept_retry_timeout.tv_nsec = (ACCEPT_RETRY_MS % 1000) * 1000000;
+  sqe->opcode = IORING_OP_TIMEOUT;
+  sqe->fd = -1;
+  sqe->addr = reinterpret_cast<std::uint64_t>(&reactor.accept_retry_timeout);
+  sqe->len = 1;
+  sqe->user_data = userData(Operation::ACCEPT_RETRY, reactor.listen_fd);
+  reactor.accept_retry_armed = true;
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::isTransientAcceptError(const int error)
+{
+  // the connection went away before being accepted, the next one can be
+  return error == EINTR || error == EAGAIN || error == ECONNABORTED || error == EPROTO;
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::armRecv(Reactor& reactor, const int fd)
+{
+  io_uring_sqe* sqe = reactor.ring.getSqe();
+  if (sqe == nullptr) {
+    PKT_LOG_ERROR("no submission entry available for recv");
+    return false;
+  }
+  sqe->opcode = IORING_OP_RECV;
+  sqe->fd = fd;
+  sqe->ioprio = IORING_RECV_MULTISHOT;
+  sqe->flags = IOSQE_BUFFER_SELECT;
+  sqe->buf_group = 0;
+  sqe->user_data = userData(Operation::RECV, fd);
+  return true;
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::addConnection(Reactor& reactor, const int fd)
+{
+  const int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  if (!armRecv(reactor, fd)) {
+    ::close(fd);
+    return;
+  }
+  std::unique_ptr<Connection> connection(new Connection());
+  connection->fd = fd;
+  connection->closing = false;
+  reactor.connections[fd] = std::move(connection);
+  ++connections_count_;
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::closeConnection(Reactor& reactor, const int fd)
+{
+  ::close(fd);
+  reactor.connections.erase(fd);
+  --connections_count_;
+  if (!reactor.accept_armed && running_) {
+    // a descriptor is free again, accepting stopped on a persistent error
+    armAccept(reactor);
+  }
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::recycleBuffer(Reactor& reactor, const std::uint16_t id)
+{
+  reactor.ring.provideBuffer(reactor.buffers.data() + std::size_t(id) * BUFFER_SIZE, BUFFER_SIZE, id);
+}
+
+
+template<typename Cfg>
+inline UringServerT<Cfg>::UringServerT(Handler handler,
+                                       const std::size_t threads_count,
+                                       const ServerBackend backend) :
+  handler_(std::move(handler))
+, backend_(backend)
+, port_(0)
+, threads_count_(threads_count > 0 ? threads_count : std::max(1u, std::thread::hardware_concurrency()))
+, running_(false)
+, connections_count_(0)
+, invalid_count_(0)
+{
+  PKT_ASSERT(bool(handler_));
+}
+
+template<typename Cfg>
+inline UringServerT<Cfg>::~UringServerT()
+{
+  stop();
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::start(const std::uint16_t port, const char* address)
+{
+  if (isRunning()) {
+    return false;
+  }
+  if (backend_ == ServerBackend::EPOLL ||
+      (backend_ == ServerBackend::AUTO && !isSupported())) {
+    backend_ = ServerBackend::EPOLL;
+    fallback_.reset(new EpollServerT<Cfg>(handler_, threads_count_));
+    return fallback_->start(port, address);
+  }
+  backend_ = ServerBackend::IO_URING;
+
+  sockaddr_in addr = {};
+  addr.sin_family = AF_INET;
+  addr.sin_port = htons(port);
+  if (::inet_pton(AF_INET, address, &addr.sin_addr) != 1) {
+    errno = EINVAL;
+    return false;
+  }
+
+  for (std::size_t i = 0; i < threads_count_; ++i) {
+    std::unique_ptr<Reactor> reactor(new Reactor());
+    if (!setupReactor(*reactor, addr)) {
+      const int error = errno;
+      closeReactor(*reactor);
+      for (auto& r : reactors_) {
+        closeReactor(*r);
+      }
+      reactors_.clear();
+      errno = error;
+      return false;
+    }
+    if (i == 0 && port == 0) {
+      // the rest of the reactors share the port picked for the first one
+      socklen_t addr_len = sizeof(addr);
+      ::getsockname(reactor->listen_fd, reinterpret_cast<sockaddr*>(&addr), &addr_len);
+    }
+    reactors_.push_back(std::move(reactor));
+  }
+  port_ = ntohs(addr.sin_port);
+
+  running_ = true;
+  for (auto& reactor : reactors_) {
+    reactor->thread = std::thread(&UringServerT<Cfg>::run, this, std::ref(*reactor));
+  }
+  return true;
+}
+
+template<typename Cfg>
+inline void
+UringServerT<Cfg>::stop(void)
+{
+  if (fallback_) {
+    fallback_->stop();
+    return;
+  }
+  if (!running_.exchange(false)) {
+    return;
+  }
+  for (auto& reactor : reactors_) {
+    const std::uint64_t value = 1;
+    const ssize_t written = ::write(reactor->wake_fd, &value, sizeof(value));
+    (void) written;
+  }
+  for (auto& reactor : reactors_) {
+    reactor->thread.join();
+    closeReactor(*reactor);
+  }
+  reactors_.clear();
+  connections_count_ = 0;
+}
+
+template<typename Cfg>
+inline ServerBackend
+UringServerT<Cfg>::backend(void) const
+{
+  return backend_;
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::isRunning(void) const
+{
+  return fallback_ ? fallback_->isRunning() : bool(running_);
+}
+
+template<typename Cfg>
+inline std::uint16_t
+UringServerT<Cfg>::port(void) const
+{
+  return fallback_ ? fallback_->port() : port_;
+}
+
+template<typename Cfg>
+inline std::size_t
+UringServerT<Cfg>::threadsCount(void) const
+{
+  return threads_count_;
+}
+
+template<typename Cfg>
+inline std::size_t
+UringServerT<Cfg>::connectionsCount(void) const
+{
+  return fallback_ ? fallback_->connectionsCount() : std::size_t(connections_count_);
+}
+
+template<typename Cfg>
+inline std::size_t
+UringServerT<Cfg>::invalidCount(void) const
+{
+  return fallback_ ? fallback_->invalidCount() : std::size_t(invalid_count_);
+}
+
+template<typename Cfg>
+inline bool
+UringServerT<Cfg>::isSupported(void)
+{
+  return detail::Uring::isSupported();
+}
@@ -0,0 +1,444 @@
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <atomic>
+#include <thread>
+#include <fstream>
+
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <unistd.h>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/uring_server.h>
+#include <packet/shm_ring.h>
+#include <packet/packet_log_writer.h>
+#include <packet/capture_scanner.h>
+
+
+/**
+ * Microbenchmarks of the parse / serialize hot paths. Each case is printed as a JSON
+ * object per line so the results of different builds can be compared with any tool:
+ *
+ *   packet_bench [min_seconds_per_case] [filter]
+ *
+ * filter only runs the cases whose name contains it (parse / serialize_ostream /
+ * serialize_vector / server_epoll / server_io_uring / shm_ring / log_ostream /
+ * log_writer / capture_scan).
+ */
+
+
+struct NoPattern { static constexpr const char* value = ""; };
+struct StartPattern4 { static constexpr const char* value = "<PK>"; };
+struct EndPattern4 { static constexpr const char* value = "</P>"; };
+struct StartPattern16 { static constexpr const char* value = "<PACKET-START-16"; };
+struct EndPattern16 { static constexpr const char* value = "PACKET-END-16-->"; };
+
+struct Pattern0Config : packet::ConfigT<NoPattern, NoPattern, std::uint32_t, std::numeric_limits<std::uint32_t>::max()> {};
+struct Pattern4Config : packet::ConfigT<StartPattern4, EndPattern4, std::uint32_t, std::numeric_limits<std::uint32_t>::max()> {};
+struct Pattern16Config : packet::ConfigT<StartPattern16, EndPattern16, std::uint32_t, std::numeric_limits<std::uint32_t>::max()> {};
+
+using Clock = std::chrono::steady_clock;
+
+static const std::vector<std::size_t> PAYLOAD_SIZES = {
+    8, 64, 512, 4 * 1024, 64 * 1024, 1024 * 1024, 16 * 1024 * 1024
+};
+// 0 means the whole frame in a single call
+static const std::vector<std::size_t> CHUNK_SIZES = {1, 16, 1500, 64 * 1024, 0};
+// feeding byte by byte is only measured up to this payload size
+static const std::size_t MAX_PAYLOAD_BYTE_BY_BYTE = 64 * 1024;
+
+// prevents the compiler from dropping the benchmarked work
+static volatile std::size_t g_sink = 0;
+
+
+/**
+ * @brief Options of the benchmark run
+ */
+struct Options {
+    double min_seconds = 0.2;
+    std::string filter;
+};
+
+/**
+ * @brief Result of a benchmark case
+ */
+struct Result {
+    std::size_t iterations = 0;
+    double seconds = 0;
+};
+
+/**
+ * @brief Runs fn (processing one message per call) until min_seconds have elapsed
+ * @param options The run options
+ * @param fn      The work to measure
+ * @return the amount of iterations and the time spent
+ */
+template<typename Fn>
+static Result
+runFor(const Options& options, Fn&& fn)
+{
+    // warm up (caches, buffers, pools)
+    fn();
+
+    Result result;
+    const Clock::time_point start = Clock::now();
+    std::size_t batch = 1;
+    do {
+        for (std::size_t i = 0; i < batch; ++i) {
+            fn();
+        }
+        result.iterations += batch;
+        result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+        batch *= 2;
+    } while (result.seconds < options.min_seconds);
+    return result;
+}
+
+static void
+printResult(const char* bench,
+            const char* config,
+            const std::size_t payload,
+            const std::size_t chunk,
+            const std::size_t frame_size,
+            const Result& result)
+{
+    const double msgs_per_s = double(result.iterations) / result.seconds;
+    std::cout << "{\"bench\":\"" << bench << "\""
+              << ",\"config\":\"" << config << "\""
+              << ",\"payload_bytes\":" << payload
+              << ",\"chunk_bytes\":" << chunk
+              << ",\"frame_bytes\":" << frame_size
+              << ",\"iterations\":" << result.iterations
+              << ",\"seconds\":" << result.seconds
+              << ",\"msgs_per_s\":" << msgs_per_s
+              << ",\"mb_per_s\":" << msgs_per_s * double(frame_size) / (1024.0 * 1024.0)
+              << "}" << std::endl;
+}
+
+static bool
+matchesFilter(const Options& options, const std::string& name)
+{
+    return options.filter.empty() || name.find(options.filter) != std::string::npos;
+}
+
+static std::string
+makePayload(const std::size_t len)
+{
+    std::string payload(len, '\0');
+    for (std::size_t i = 0; i < len; ++i) {
+        payload[i] = char('a' + (i % 26));
+    }
+    return payload;
+}
+
+template<typename Cfg>
+static void
+benchParse(const Options& options, const char* config, const std::string& payload)
+{
+    using Packet = packet::PacketT<Cfg>;
+    std::vector<packet::byte_t> frame;
+    Packet::serialize(reinterpret_cast<const packet::byte_t*>(payload.data()), payload.size(), frame);
+
+    Packet pkt;
+    for (const std::size_t chunk_size : CHUNK_SIZES) {
+        if (chunk_size == 1 && payload.size() > MAX_PAYLOAD_BYTE_BY_BYTE) {
+            continue;
+        }
+        if (chunk_size >= frame.size()) {
+            // the same as the whole frame
+            continue;
+        }
+        const std::size_t chunk = chunk_size == 0 ? frame.size() : chunk_size;
+        const Result result = runFor(options, [&pkt, &frame, chunk]() {
+            pkt.reset();
+            std::size_t offset = 0;
+            while (pkt.status() == packet::Status::INCOMPLETE && offset < frame.size()) {
+                const std::size_t to_add = std::min(chunk, frame.size() - offset);
+                offset += pkt.appendData(frame.data() + offset, to_add);
+            }
+            g_sink += pkt.dataLen();
+        });
+        if (pkt.status() != packet::Status::COMPLETE) {
+            std::cerr << "parse failed for config " << config << "\n";
+            std::exit(1);
+        }
+        printResult("parse", config, payload.size(), chunk, frame.size(), result);
+    }
+}
+
+template<typename Cfg>
+static void
+benchSerialize(const Options& options, const char* config, const std::string& payload)
+{
+    using Packet = packet::PacketT<Cfg>;
+    const packet::byte_t* content = reinterpret_cast<const packet::byte_t*>(payload.data());
+    const std::size_t frame_size = Packet::serializedSize(payload.size());
+
+    if (matchesFilter(options, "serialize_ostream")) {
+        std::stringstream stream;
+        const Result result = runFor(options, [&stream, content, &payload]() {
+            stream.seekp(0);
+            Packet::serialize(content, payload.size(), stream);
+            g_sink += std::size_t(stream.tellp());
+        });
+        printResult("serialize_ostream", config, payload.size(), 0, frame_size, result);
+    }
+
+    if (matchesFilter(options, "serialize_vector")) {
+        std::vector<packet::byte_t> buffer;
+        const Result result = runFor(options, [&buffer, content, &payload]() {
+            Packet::serialize(content, payload.size(), buffer);
+            g_sink += buffer.size();
+        });
+        printResult("serialize_vector", config, payload.size(), 0, frame_size, result);
+    }
+}
+
+template<typename Cfg>
+static void
+benchConfig(const Options& options, const char* config)
+{
+    for (const std::size_t payload_size : PAYLOAD_SIZES) {
+        const std::string payload = makePayload(payload_size);
+        if (matchesFilter(options, "parse")) {
+            benchParse<Cfg>(options, config, payload);
+        }
+        benchSerialize<Cfg>(options, config, payload);
+    }
+}
+
+/**
+ * @brief Sends the same stream of packets over several loopback connections to a server
+ *        and measures the time until all of them are handled
+ */
+static void
+benchServer(const Options& options, const packet::ServerBackend backend, const std::size_t payload_size)
+{
+    using Server = packet::DefaultUringServer;
+    const char* name = backend == packet::ServerBackend::EPOLL ? "server_epoll" : "server_io_uring";
+    if (!matchesFilter(options, name)) {
+        return;
+    }
+    if (backend == packet::ServerBackend::IO_URING && !Server::isSupported()) {
+        std::cerr << "io_uring is not available, skipping " << name << "\n";
+        return;
+    }
+    static const std::size_t CONNECTIONS = 4;
+    static const std::size_t BYTES_PER_CONNECTION = 16 * 1024 * 1024;
+    static const std::size_t WRITE_SIZE = 256 * 1024;
+
+    std::atomic<std::size_t> received(0);
+    Server server([&received](int, const packet::byte_t*, std::size_t, std::uint64_t) {
+        received.fetch_add(1, std::memory_order_relaxed);
+    }, 1, backend);
+    if (!server.start(0, "127.0.0.1")) {
+        std::cerr << "could not start " << name << "\n";
+        std::exit(1);
+    }
+
+    const std::string payload = makePayload(payload_size);
+    std::vector<packet::byte_t> frame;
+    packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(payload.data()), payload.size(), frame);
+    const std::size_t frames_per_connection = std::max(std::size_t(1), BYTES_PER_CONNECTION / frame.size());
+    std::string stream;
+    for (std::size_t i = 0; i < frames_per_connection; ++i) {
+        stream.append(frame.begin(), frame.end());
+    }
+
+    std::vector<int> sockets;
+    for (std::size_t i = 0; i < CONNECTIONS; ++i) {
+        const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+        sockaddr_in addr = {};
+        addr.sin_family = AF_INET;
+        addr.sin_port = htons(server.port());
+        addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+        if (::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) != 0) {
+            std::cerr << "could not connect to " << name << "\n";
+            std::exit(1);
+        }
+        sockets.push_back(fd);
+    }
+
+    const std::size_t expected = CONNECTIONS * frames_per_connection;
+    Result result;
+    const Clock::time_point start = Clock::now();
+    std::vector<std::thread> writers;
+    for (const int fd : sockets) {
+        writers.emplace_back([fd, &stream]() {
+            for (std::size_t offset = 0; offset < stream.size();) {
+                const ssize_t sent = ::write(fd, stream.data() + offset, std::min(WRITE_SIZE, stream.size() - offset));
+                if (sent <= 0) {
+                    return;
+                }
+                offset += std::size_t(sent);
+            }
+        });
+    }
+    while (received.load(std::memory_order_relaxed) < expected) {
+        std::this_thread::yield();
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.iterations = expected;
+    for (std::thread& writer : writers) {
+        writer.join();
+    }
+    for (const int fd : sockets) {
+        ::close(fd);
+    }
+    server.stop();
+    printResult(name, "pattern_1", payload_size, WRITE_SIZE, frame.size(), result);
+}
+
+/**
+ * @brief Streams packets through a shared memory ring from a producer thread to the
+ *        consumer (the same code works between processes)
+ */
+static void
+benchShmRing(const Options& options, const std::size_t payload_size)
+{
+    if (!matchesFilter(options, "shm_ring")) {
+        return;
+    }
+    static const std::size_t MESSAGES = 1000000;
+    packet::DefaultShmRing consumer;
+    packet::DefaultShmRing producer;
+    if (!consumer.create(4 * 1024 * 1024) || !producer.attach(consumer.fd())) {
+        std::cerr << "could not create the shared memory ring\n";
+        std::exit(1);
+    }
+    const std::string payload = makePayload(payload_size);
+    const std::size_t count = std::max(std::size_t(1000), std::min(MESSAGES, (std::size_t(1) << 30) / payload_size));
+
+    Result result;
+    const Clock::time_point start = Clock::now();
+    std::thread writer([&producer, &payload, count]() {
+        for (std::size_t i = 0; i < count; ++i) {
+            producer.write(reinterpret_cast<const packet::byte_t*>(payload.data()), payload.size());
+        }
+    });
+    packet::PacketView view;
+    for (std::size_t i = 0; i < count && consumer.read(view); ++i) {
+        g_sink += view.len;
+    }
+    result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+    result.iterations = count;
+    writer.join();
+    printResult("shm_ring", "pattern_1", payload_size, 0, packet::DefaultPacket::serializedSize(payload_size), result);
+}
+
+/**
+ * @brief Recording packets to a file: serialize() into an std::ofstream against the
+ *        batched PacketLogWriterT (the file is restarted every LOG_MAX_SIZE bytes)
+ */
+static void
+benchLogWriter(const Options& options, const std::size_t payload_size)
+{
+    static const std::size_t LOG_MAX_SIZE = 256 * 1024 * 1024;
+    const std::string path = "/tmp/packet_bench_" + std::to_string(::getpid()) + ".log";
+    const std::string payload = makePayload(payload_size);
+    const packet::byte_t* content = reinterpret_cast<const packet::byte_t*>(payload.data());
+    const std::size_t frame_size = packet::DefaultPacket::serializedSize(payload_size);
+
+    if (matchesFilter(options, "log_ostream")) {
+        std::ofstream log(path, std::ios::binary | std::ios::trunc);
+        const Result result = runFor(options, [&log, content, payload_size]() {
+            if (std::size_t(log.tellp()) >= LOG_MAX_SIZE) {
+                log.seekp(0);
+            }
+            packet::DefaultPacket::serialize(content, payload_size, log);
+        });
+        printResult("log_ostream", "pattern_1", payload_size, 0, frame_size, result);
+    }
+
+    if (matchesFilter(options, "log_writer")) {
+        packet::DefaultPacketLogWriter writer;
+        packet::LogWriterOptions writer_options;
+        writer_options.sync = packet::SyncPolicy::NONE;
+        if (!writer.open(path, writer_options)) {
+            std::cerr << "could not open " << path << "\n";
+            std::exit(1);
+        }
+        const Result result = runFor(options, [&writer, &path, &writer_options, content, payload_size]() {
+            if (writer.size() >= LOG_MAX_SIZE) {
+                writer.open(path, writer_options);
+            }
+            writer.append(content, payload_size);
+        });
+        writer.close();
+        printResult("log_writer", "pattern_1", payload_size, 0, frame_size, result);
+    }
+    ::unlink(path.c_str());
+    ::unlink(packet::DefaultPacketLogReader::indexPath(path).c_str());
+}
+
+/**
+ * @brief Validation of a capture in memory with one thread and with one per core
+ */
+static void
+benchCaptureScan(const Options& options, const std::size_t payload_size)
+{
+    if (!matchesFilter(options, "capture_scan")) {
+        return;
+    }
+    static const std::size_t CAPTURE_SIZE = 256 * 1024 * 1024;
+    const std::string payload = makePayload(payload_size);
+    std::vector<packet::byte_t> frame;
+    packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(payload.data()), payload.size(), frame);
+    std::vector<packet::byte_t> capture;
+    capture.reserve(CAPTURE_SIZE + frame.size());
+    while (capture.size() < CAPTURE_SIZE) {
+        capture.insert(capture.end(), frame.begin(), frame.end());
+    }
+    const std::size_t packets = capture.size() / frame.size();
+
+    for (const std::size_t threads : {std::size_t(1), std::size_t(0)}) {
+        packet::DefaultCaptureScanner scanner(threads);
+        packet::ScanReport report;
+        Result result = runFor(options, [&scanner, &capture, &report]() {
+            scanner.scan(capture.data(), capture.size(), report);
+            g_sink += report.packets_count;
+        });
+        // one iteration is the whole capture
+        result.iterations *= packets;
+        const std::string config = "pattern_1_threads_" + std::to_string(scanner.threadsCount());
+        printResult("capture_scan", config.c_str(), payload_size, 0, frame.size(), result);
+    }
+}
+
+int
+main(int argc, char* argv[])
+{
+    Options options;
+    if (argc > 1) {
+        options.min_seconds = std::atof(argv[1]);
+    }
+    if (argc > 2) {
+        options.filter = argv[2];
+    }
+
+    benchConfig<Pattern0Config>(options, "pattern_0");
+    benchConfig<packet::DefaultConfig>(options, "pattern_1");
+    benchConfig<Pattern4Config>(options, "pattern_4");
+    benchConfig<Pattern16Config>(options, "pattern_16");
+
+    for (const std::size_t payload_size : {std::size_t(64), std::size_t(4096), std::size_t(64 * 1024)}) {
+        benchServer(options, packet::ServerBackend::EPOLL, payload_size);
+        benchServer(options, packet::ServerBackend::IO_URING, payload_size);
+    }
+    for (const std::size_t payload_size : {std::size_t(64), std::size_t(4096), std::size_t(64 * 1024)}) {
+        benchShmRing(options, payload_size);
+    }
+    for (const std::size_t payload_size : {std::size_t(64), std::size_t(4096)}) {
+        benchLogWriter(options, payload_size);
+    }
+    for (const std::size_t payload_size : {std::size_t(64), std::size_t(4096)}) {
+        benchCaptureScan(options, payload_size);
+    }
+    return 0;
+}
@@ -0,0 +1,240 @@
+#include <iostream>
+#include <sstream>
+#include <cassert>
+#include <vector>
+#include <string>
+#include <cstdlib>
+#include <new>
+
+#include <packet/defs.h>
+#include <packet/packet.h>
+#include <packet/coro_task.h>
+#include <packet/coro_executor.h>
+#include <packet/coro_packet_io.h>
+
+#include <unistd.h>
+#include <sys/socket.h>
+
+// test
+#include "test_helpers.hpp"
+
+
+// counts the global allocations to check the steady state loops do not allocate
+static std::size_t g_allocations = 0;
+
+void*
+operator new(std::size_t size)
+{
+    ++g_allocations;
+    void* ptr = std::malloc(size == 0 ? 1 : size);
+    if (ptr == nullptr) {
+        throw std::bad_alloc();
+    }
+    return ptr;
+}
+
+void
+operator delete(void* ptr) noexcept
+{
+    std::free(ptr);
+}
+
+void
+operator delete(void* ptr, std::size_t) noexcept
+{
+    std::free(ptr);
+}
+
+
+using Reader = packet::PacketReaderT<packet::DefaultConfig, packet::FdStream>;
+using Writer = packet::PacketWriterT<packet::DefaultConfig, packet::FdStream>;
+
+
+static std::string
+makeContent(const std::size_t index, const std::size_t len)
+{
+    std::string content(len, '\0');
+    for (std::size_t i = 0; i < len; ++i) {
+        content[i] = char('a' + ((i + index) % 26));
+    }
+    return content;
+}
+
+static packet::Task<int>
+addLater(packet::Task<int> a, packet::Task<int> b)
+{
+    const int first = co_await a;
+    const int second = co_await b;
+    co_return first + second;
+}
+
+static packet::Task<int>
+value(const int v)
+{
+    co_return v;
+}
+
+static packet::Task<void>
+storeSum(int& out)
+{
+    out = co_await addLater(value(2), value(40));
+}
+
+void
+testTasksAreLazyAndChained()
+{
+    packet::LocalExecutor executor;
+    TEST_ASSERT(executor.isValid());
+    int result = 0;
+    packet::Task<void> task = storeSum(result);
+    // nothing runs until the task is started
+    TEST_ASSERT(result == 0);
+    executor.spawn(std::move(task));
+    TEST_ASSERT(!task.isValid());
+    executor.run();
+    TEST_ASSERT(result == 42);
+
+    // the frames are reused once released
+    const std::size_t frames = packet::FramePool::local().allocationsCount();
+    for (int i = 0; i < 100; ++i) {
+        executor.spawn(storeSum(result));
+        executor.run();
+    }
+    TEST_ASSERT(packet::FramePool::local().allocationsCount() == frames);
+}
+
+static packet::Task<void>
+writePackets(Writer& writer, const std::vector<std::string>& contents, const int fd, bool& ok)
+{
+    ok = true;
+    for (const std::string& content : contents) {
+        ok = ok && co_await writer.send(reinterpret_cast<const packet::byte_t*>(content.data()), content.size());
+    }
+    // the reader sees the end of the stream
+    ::shutdown(fd, SHUT_WR);
+}
+
+static packet::Task<void>
+readPackets(Reader& reader, const std::vector<std::string>& contents, std::size_t& matched)
+{
+    while (auto view = co_await reader.next()) {
+        if (matched < contents.size() &&
+            std::string(reinterpret_cast<const char*>(view->data), view->len) == contents[matched]) {
+            ++matched;
+        }
+    }
+}
+
+void
+testReaderAndWriterOverSocketPair()
+{
+    int fds[2];
+    TEST_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+
+    // small ones (many per read) and big ones (split between reads and writes)
+    std::vector<std::string> contents;
+    for (std::size_t i = 0; i < 200; ++i) {
+        contents.push_back(makeContent(i, i % 50 == 0 ? 1024 * 1024 + i : 1 + i * 7));
+    }
+
+    {
+        packet::LocalExecutor executor;
+        packet::FdStream out(executor, fds[0]);
+        packet::FdStream in(executor, fds[1]);
+        Writer writer(out);
+        Reader reader(in, 4096);
+        bool ok = false;
+        std::size_t matched = 0;
+        executor.spawn(readPackets(reader, contents, matched));
+        executor.spawn(writePackets(writer, contents, fds[0], ok));
+        executor.run();
+        TEST_ASSERT(ok);
+        TEST_ASSERT(matched == contents.size());
+        TEST_ASSERT(reader.isAtEnd());
+        TEST_ASSERT(reader.status() != packet::Status::INVALID);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+void
+testReaderStopsOnInvalidData()
+{
+    int fds[2];
+    TEST_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    const std::string garbage = "this is not a packet at all";
+    TEST_ASSERT(::write(fds[0], garbage.data(), garbage.size()) == ssize_t(garbage.size()));
+
+    {
+        packet::LocalExecutor executor;
+        packet::FdStream in(executor, fds[1]);
+        Reader reader(in);
+        std::size_t matched = 0;
+        const std::vector<std::string> contents;
+        executor.spawn(readPackets(reader, contents, matched));
+        executor.run();
+        TEST_ASSERT(matched == 0);
+        TEST_ASSERT(reader.status() == packet::Status::INVALID);
+        TEST_ASSERT(!reader.isAtEnd());
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+static packet::Task<void>
+pingPong(Writer& writer, Reader& reader, const std::string& content, const std::size_t rounds, std::size_t& received)
+{
+    const packet::byte_t* data = reinterpret_cast<const packet::byte_t*>(content.data());
+    for (std::size_t i = 0; i < rounds; ++i) {
+        if (!co_await writer.send(data, content.size())) {
+            co_return;
+        }
+        auto view = co_await reader.next();
+        if (!view || view->len != content.size()) {
+            co_return;
+        }
+        ++received;
+    }
+}
+
+void
+testSteadyStateLoopDoesNotAllocate()
+{
+    int fds[2];
+    TEST_ASSERT(::socketpair(AF_UNIX, SOCK_STREAM, 0, fds) == 0);
+    const std::string content = makeContent(0, 512);
+
+    {
+        packet::LocalExecutor executor;
+        packet::FdStream out(executor, fds[0]);
+        packet::FdStream in(executor, fds[1]);
+        Writer writer(out);
+        Reader reader(in);
+        std::size_t received = 0;
+
+        // warm up: frames, buffers and queues get their capacity
+        executor.spawn(pingPong(writer, reader, content, 100, received));
+        executor.run();
+        TEST_ASSERT(received == 100);
+
+        std::size_t steady_received = 0;
+        packet::Task<void> loop = pingPong(writer, reader, content, 1000, steady_received);
+        const std::size_t allocations = g_allocations;
+        executor.spawn(std::move(loop));
+        executor.run();
+        TEST_ASSERT(steady_received == 1000);
+        TEST_ASSERT(g_allocations == allocations);
+    }
+    ::close(fds[0]);
+    ::close(fds[1]);
+}
+
+int
+main(void)
+{
+    testTasksAreLazyAndChained();
+    testReaderAndWriterOverSocketPair();
+    testReaderStopsOnInvalidData();
+    testSteadyStateLoopDoesNotAllocate();
+    return 0;
+}
@@ -5,6 +5,37 @@
 
 #include <packet/defs.h>
 #include <packet/packet.h>
+#include <packet/stream_framer.h>
+#include <packet/pattern_search.h>
+#include <packet/iov_serializer.h>
+#include <packet/batch_serializer.h>
+#include <packet/lz4.h>
+#include <packet/epoll_server.h>
+#include <packet/uring_server.h>
+#include <packet/mpmc_queue.h>
+#include <packet/packet_pipeline.h>
+#include <packet/shm_ring.h>
+#include <packet/packet_log_reader.h>
+#include <packet/packet_log_writer.h>
+#include <packet/capture_scanner.h>
+#include <packet/metrics.h>
+#include <packet/latency.h>
+#include <packet/message_dispatcher.h>
+
+#include <unistd.h>
+#include <cstring>
+#include <cstddef>
+#include <arpa/inet.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <mutex>
+#include <chrono>
+#include <thread>
+#include <atomic>
+#include <sys/wait.h>
+#include <sys/resource.h>
+#include <fstream>
+#include <algorithm>
 
 // test
 #include "test_helpers.hpp"
@@ -135,6 +166,2296 @@ testInvalidPacketAreDetected()
     }
 }
 
+void
+testStreamFramerSplitsChunks()
+{
+    const std::vector<std::string> contents {
+        "first",
+        "x",
+        std::string(300, 'a'),
+        "\n\t<>\n",
+        std::string(5000, 'b'),
+        "last one",
+    };
+    std::string stream;
+    for (const std::string& content : contents) {
+        stream += serializePacketFromData<packet::DefaultPacket>(content);
+    }
+
+    for (const unsigned int chunk_size : {1u, 2u, 3u, 7u, 64u, 1000u, unsigned(stream.size())}) {
+        packet::DefaultStreamFramer framer;
+        std::vector<std::string> received;
+        for (const std::string& chunk : splitStr(stream, chunk_size)) {
+            const std::size_t consumed = framer.feed(
+                reinterpret_cast<const packet::byte_t*>(chunk.data()),
+                chunk.size(),
+                [&received](const packet::byte_t* data, std::size_t len) {
+                    received.emplace_back(reinterpret_cast<const char*>(data), len);
+                });
+            TEST_ASSERT(consumed == chunk.size());
+        }
+        TEST_ASSERT(framer.status() == packet::Status::INCOMPLETE);
+        TEST_ASSERT(framer.pendingBytes() == 0);
+        TEST_ASSERT(received == contents);
+    }
+}
+
+void
+testStreamFramerKeepsPartialAndDetectsInvalid()
+{
+    const std::string serialized = serializePacketFromData<packet::DefaultPacket>("message");
+    std::size_t count = 0;
+    auto handler = [&count](const packet::byte_t*, std::size_t) { ++count; };
+
+    packet::DefaultStreamFramer framer;
+    const std::string stream = serialized + serialized.substr(0, 3);
+    framer.feed(reinterpret_cast<const packet::byte_t*>(stream.data()), stream.size(), handler);
+    TEST_ASSERT(count == 1);
+    TEST_ASSERT(framer.pendingBytes() == 3);
+
+    // corrupt the tail of the pending packet
+    std::string rest = serialized.substr(3);
+    rest[rest.size() - 1] = packet::DefaultEndPattern::value[0] + 1;
+    framer.feed(reinterpret_cast<const packet::byte_t*>(rest.data()), rest.size(), handler);
+    TEST_ASSERT(count == 1);
+    TEST_ASSERT(framer.status() == packet::Status::INVALID);
+
+    framer.reset();
+    framer.feed(reinterpret_cast<const packet::byte_t*>(serialized.data()), serialized.size(), handler);
+    TEST_ASSERT(count == 2);
+    TEST_ASSERT(framer.status() == packet::Status::INCOMPLETE);
+}
+
+void
+testStreamFramerViewsAreInPlace()
+{
+    const std::string first = serializePacketFromData<packet::DefaultPacket>("first message");
+    const std::string second = serializePacketFromData<packet::DefaultPacket>("second message");
+    const std::string stream = first + second + first;
+    const std::size_t split = first.size() + second.size() + 4;
+    const std::string chunk_a = stream.substr(0, split);
+    const std::string chunk_b = stream.substr(split);
+    const packet::byte_t* begin_a = reinterpret_cast<const packet::byte_t*>(chunk_a.data());
+
+    packet::DefaultStreamFramer framer;
+    packet::PacketView view;
+    framer.setInput(begin_a, chunk_a.size());
+    for (const char* expected : {"first message", "second message"}) {
+        TEST_ASSERT(framer.next(view));
+        TEST_ASSERT(view.in_place);
+        TEST_ASSERT(view.data >= begin_a && view.data + view.len <= begin_a + chunk_a.size());
+        TEST_ASSERT(std::string(reinterpret_cast<const char*>(view.data), view.len) == expected);
+    }
+    TEST_ASSERT(!framer.next(view));
+    TEST_ASSERT(framer.inputConsumed() == chunk_a.size());
+    TEST_ASSERT(framer.pendingBytes() == 4);
+
+    // the packet split between chunks is the only one copied
+    framer.setInput(reinterpret_cast<const packet::byte_t*>(chunk_b.data()), chunk_b.size());
+    TEST_ASSERT(framer.next(view));
+    TEST_ASSERT(!view.in_place);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(view.data), view.len) == "first message");
+    TEST_ASSERT(!framer.next(view));
+    TEST_ASSERT(framer.pendingBytes() == 0);
+    TEST_ASSERT(framer.status() == packet::Status::INCOMPLETE);
+}
+
+void
+testPatternSearch()
+{
+    const std::string buffer = "abcabdab";
+    const packet::byte_t* data = reinterpret_cast<const packet::byte_t*>(buffer.data());
+    const packet::byte_t* pattern = reinterpret_cast<const packet::byte_t*>("abd");
+    TEST_ASSERT(packet::findPattern(data, buffer.size(), pattern, 3) == 3);
+    TEST_ASSERT(packet::findPattern(data, 5, pattern, 3) == 5);
+    // "ab" at the end could be the beginning of the pattern
+    TEST_ASSERT(packet::findPatternCandidate(data + 4, 4, pattern, 3) == 2);
+    TEST_ASSERT(packet::findPatternCandidate(data, 2, reinterpret_cast<const packet::byte_t*>("xy"), 2) == 2);
+}
+
+void
+testStreamFramerResync()
+{
+    const std::string garbage = "garbage!";
+    std::string corrupted = serializePacketFromData<packet::DefaultPacket>("corrupted");
+    corrupted[corrupted.size() - 1] = 'X';
+    const std::string stream = garbage +
+                               serializePacketFromData<packet::DefaultPacket>("first") +
+                               corrupted +
+                               serializePacketFromData<packet::DefaultPacket>("second") +
+                               garbage +
+                               serializePacketFromData<packet::DefaultPacket>("third");
+    const std::vector<std::string> expected {"first", "second", "third"};
+
+    for (const unsigned int chunk_size : {1u, 2u, 5u, 11u, unsigned(stream.size())}) {
+        packet::DefaultStreamFramer framer(true);
+        std::vector<std::string> received;
+        for (const std::string& chunk : splitStr(stream, chunk_size)) {
+            framer.feed(reinterpret_cast<const packet::byte_t*>(chunk.data()),
+                        chunk.size(),
+                        [&received](const packet::byte_t* data, std::size_t len) {
+                            received.emplace_back(reinterpret_cast<const char*>(data), len);
+                        });
+        }
+        TEST_ASSERT(framer.status() == packet::Status::INCOMPLETE);
+        TEST_ASSERT(received == expected);
+        TEST_ASSERT(framer.skippedBytes() == 2 * garbage.size() + corrupted.size());
+    }
+
+    // without resync the framer stops on the first invalid byte
+    packet::DefaultStreamFramer framer;
+    const std::size_t consumed = framer.feed(reinterpret_cast<const packet::byte_t*>(stream.data()),
+                                             stream.size(),
+                                             [](const packet::byte_t*, std::size_t) {});
+    TEST_ASSERT(consumed == 0);
+    TEST_ASSERT(framer.status() == packet::Status::INVALID);
+
+    // a pending packet hiding a few MB of bogus candidates is resynced in linear time
+    const std::size_t candidates = 500000;
+    const std::uint32_t bogus_len = std::uint32_t(5 * candidates - 3);
+    std::string bogus = "<";
+    for (int shift = 24; shift >= 0; shift -= 8) {
+        bogus.push_back(char((bogus_len >> shift) & 0xFF));
+    }
+    for (std::size_t i = 0; i < candidates; ++i) {
+        bogus.append("<\0\0\0\0", 5);
+    }
+    packet::DefaultStreamFramer bogus_framer(true);
+    const auto start = std::chrono::steady_clock::now();
+    const std::size_t half = bogus.size() / 2;
+    std::size_t emitted = 0;
+    const auto handler = [&emitted](const packet::byte_t*, std::size_t) { ++emitted; };
+    bogus_framer.feed(reinterpret_cast<const packet::byte_t*>(bogus.data()), half, handler);
+    bogus_framer.feed(reinterpret_cast<const packet::byte_t*>(bogus.data() + half), bogus.size() - half, handler);
+    const double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    TEST_ASSERT(emitted == 0 && bogus_framer.status() == packet::Status::INCOMPLETE);
+    // only the last candidate is kept, waiting for its tail
+    TEST_ASSERT(bogus_framer.skippedBytes() == bogus.size() - 5);
+    TEST_ASSERT(elapsed < 2.0);
+}
+
+void
+testIovSerializerWritesPackets()
+{
+    const std::string first = "first packet";
+    const std::string envelope = "envelope|";
+    const std::string body = "body of the message";
+
+    packet::DefaultIovSerializer serializer;
+    TEST_ASSERT(serializer.add(reinterpret_cast<const packet::byte_t*>(first.data()), first.size()));
+    const struct iovec fragments[] = {
+        {const_cast<char*>(envelope.data()), envelope.size()},
+        {const_cast<char*>(body.data()), body.size()},
+    };
+    TEST_ASSERT(serializer.add(fragments, 2));
+    TEST_ASSERT(!serializer.add(static_cast<const packet::byte_t*>(nullptr), 1));
+    TEST_ASSERT(serializer.packetsCount() == 2);
+
+    const std::string expected = serializePacketFromData<packet::DefaultPacket>(first) +
+                                 serializePacketFromData<packet::DefaultPacket>(envelope + body);
+    TEST_ASSERT(serializer.totalBytes() == expected.size());
+
+    // the content is not copied
+    const struct iovec* iov = serializer.iov();
+    TEST_ASSERT(serializer.iovCount() == 7);
+    TEST_ASSERT(iov[1].iov_base == first.data());
+    TEST_ASSERT(iov[5].iov_base == body.data());
+
+    int fds[2];
+    TEST_ASSERT(::pipe(fds) == 0);
+    TEST_ASSERT(serializer.writeAll(fds[1]));
+    TEST_ASSERT(serializer.iovCount() == 0);
+    std::string written(expected.size(), '\0');
+    TEST_ASSERT(::read(fds[0], &written[0], written.size()) == ssize_t(expected.size()));
+    ::close(fds[0]);
+    ::close(fds[1]);
+    TEST_ASSERT(written == expected);
+}
+
+void
+testBatchSerializer()
+{
+    const std::vector<std::string> contents {
+        "a",
+        "second packet",
+        std::string(1000, 'x'),
+        "fan-out event",
+    };
+    packet::DefaultBatchSerializer batch;
+    std::string expected;
+    for (const std::string& content : contents) {
+        TEST_ASSERT(batch.add(reinterpret_cast<const packet::byte_t*>(content.data()), content.size()));
+        expected += serializePacketFromData<packet::DefaultPacket>(content);
+    }
+    TEST_ASSERT(!batch.add(nullptr, 1));
+    TEST_ASSERT(batch.packetsCount() == contents.size());
+    TEST_ASSERT(batch.totalBytes() == expected.size());
+    TEST_ASSERT(batch.packetOffset(1) == packet::DefaultPacket::serializedSize(1));
+
+    packet::Buffer out;
+    TEST_ASSERT(batch.serialize(out) == expected.size());
+    TEST_ASSERT(std::string(out.begin(), out.end()) == expected);
+
+    // a big fan-out batch written by several threads must match the single threaded one
+    const std::string event(64 * 1024, 'e');
+    batch.clear();
+    for (int i = 0; i < 100; ++i) {
+        batch.add(reinterpret_cast<const packet::byte_t*>(event.data()), event.size());
+    }
+    packet::Buffer single;
+    packet::Buffer parallel;
+    batch.serialize(single, 1);
+    batch.serialize(parallel, 4);
+    TEST_ASSERT(single.size() == 100 * packet::DefaultPacket::serializedSize(event.size()));
+    TEST_ASSERT(single == parallel);
+}
+
+void
+testBufferPoolRecyclesBuffers()
+{
+    packet::BufferPool pool(2);
+    packet::Buffer buffer = pool.acquire(100);
+    TEST_ASSERT(buffer.empty() && buffer.capacity() >= 100);
+    TEST_ASSERT(pool.allocationsCount() == 1);
+    buffer.assign(50, 'x');
+    const packet::byte_t* memory = buffer.data();
+    pool.release(std::move(buffer));
+    TEST_ASSERT(pool.cachedCount() == 1);
+
+    // same size class reuses the memory, a different one allocates
+    packet::Buffer reused = pool.acquire(128);
+    TEST_ASSERT(reused.data() == memory && reused.empty());
+    packet::Buffer bigger = pool.acquire(129);
+    TEST_ASSERT(bigger.capacity() >= 129);
+    TEST_ASSERT(pool.allocationsCount() == 2);
+}
+
+void
+testPooledPacketsDoNotAllocate()
+{
+    struct PooledConfig : packet::DefaultConfig {
+        using buffer_policy = packet::PooledBufferPolicy;
+    };
+    using Packet = packet::PacketT<PooledConfig>;
+    packet::BufferPool& pool = packet::BufferPool::local();
+
+    const std::string small_msg = "small message";
+    const std::string big_msg(10000, 'b');
+    const std::string small = serializePacketFromData<Packet>(small_msg);
+    const std::string big = serializePacketFromData<Packet>(big_msg);
+
+    // warm up the pool
+    {
+        Packet pkt;
+        readPacketPart(big, pkt);
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    }
+    const std::size_t allocations = pool.allocationsCount();
+    for (int i = 0; i < 100; ++i) {
+        Packet pkt;
+        readPacketPart((i % 2) ? small : big, pkt);
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+        pkt.reset();
+        readPacketPart(small, pkt);
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    }
+    TEST_ASSERT(pool.allocationsCount() == allocations);
+
+    // hand the buffer to a consumer and give it back
+    Packet pkt;
+    readPacketPart(big, pkt);
+    const std::size_t offset = pkt.dataOffset();
+    const std::size_t len = pkt.dataLen();
+    packet::Buffer detached = pkt.detachBuffer();
+    TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(detached.data() + offset), len) == big_msg);
+    Packet::recycleBuffer(std::move(detached));
+    readPacketPart(big, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(pool.allocationsCount() == allocations);
+}
+
+void
+testPacketBufferGrowsWithReceivedData()
+{
+    using Packet = packet::DefaultPacket;
+    static constexpr std::size_t RESERVE_AHEAD = packet::DefaultConfig::MAX_RESERVE_AHEAD;
+
+    // a peer declaring a 1 GiB packet must not make us commit the memory up front
+    const std::uint32_t declared_len = 1024 * 1024 * 1024;
+    std::string header = packet::DefaultStartPattern::value;
+    const std::uint32_t wire_len = htonl(declared_len);
+    header.append(reinterpret_cast<const char*>(&wire_len), sizeof(wire_len));
+
+    Packet pkt;
+    readPacketPart(header, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE);
+    TEST_ASSERT(pkt.remainingBytes() == RESERVE_AHEAD);
+    TEST_ASSERT(pkt.allData().capacity() <= header.size() + RESERVE_AHEAD);
+
+    const std::string some_data(100, 'd');
+    readPacketPart(some_data, pkt);
+    TEST_ASSERT(pkt.allData().size() == header.size() + some_data.size());
+    TEST_ASSERT(pkt.allData().capacity() <= header.size() + RESERVE_AHEAD);
+
+    // writing directly on the buffer only exposes the reserve ahead window
+    packet::byte_t* direct = pkt.remainingBuffer();
+    TEST_ASSERT(direct != nullptr);
+    std::memset(direct, 'e', pkt.remainingBytes());
+    TEST_ASSERT(pkt.updateDataOffset(pkt.remainingBytes()) == RESERVE_AHEAD);
+    TEST_ASSERT(pkt.allData().size() == header.size() + some_data.size() + RESERVE_AHEAD);
+    TEST_ASSERT(pkt.allData().capacity() < 4 * RESERVE_AHEAD);
+
+    // big packets still work when arriving on several reads
+    const std::string big_msg(5 * RESERVE_AHEAD + 3, 'b');
+    Packet big_pkt;
+    readPacketPart(serializePacketFromData<Packet>(big_msg), big_pkt);
+    TEST_ASSERT(big_pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(big_pkt.data()), big_pkt.dataLen()) == big_msg);
+}
+
+void
+testLengthCodecs()
+{
+    packet::byte_t out[16];
+    std::uint16_t value16 = 0;
+    std::uint64_t value64 = 0;
+    std::uint32_t value32 = 0;
+    std::size_t size = 0;
+
+    using BigEndian16 = packet::BigEndianLength<std::uint16_t>;
+    TEST_ASSERT(BigEndian16::encode(0x0102, out) == 2);
+    TEST_ASSERT(out[0] == 0x01 && out[1] == 0x02);
+    TEST_ASSERT(BigEndian16::decode(out, 1, value16, size) == packet::Status::INCOMPLETE && size == 2);
+    TEST_ASSERT(BigEndian16::decode(out, 2, value16, size) == packet::Status::COMPLETE && value16 == 0x0102);
+
+    using LittleEndian64 = packet::LittleEndianLength<std::uint64_t>;
+    TEST_ASSERT(LittleEndian64::encode(0x0102030405060708ULL, out) == 8);
+    TEST_ASSERT(out[0] == 0x08 && out[7] == 0x01);
+    TEST_ASSERT(LittleEndian64::decode(out, 8, value64, size) == packet::Status::COMPLETE);
+    TEST_ASSERT(value64 == 0x0102030405060708ULL);
+
+    // narrower wire width than the length type
+    using BigEndian32On16 = packet::BigEndianLength<std::uint32_t, 2>;
+    TEST_ASSERT(BigEndian32On16::MAX_VALUE == 0xffff);
+
+    using Varint = packet::VarintLengthCodec<std::uint32_t>;
+    TEST_ASSERT(Varint::encode(20, out) == 1 && out[0] == 20);
+    TEST_ASSERT(Varint::encodedSize(300) == 2);
+    TEST_ASSERT(Varint::encode(300, out) == 2);
+    TEST_ASSERT(out[0] == 0xac && out[1] == 0x02);
+    TEST_ASSERT(Varint::decode(out, 1, value32, size) == packet::Status::INCOMPLETE && size == 2);
+    TEST_ASSERT(Varint::decode(out, 2, value32, size) == packet::Status::COMPLETE);
+    TEST_ASSERT(value32 == 300 && size == 2);
+    TEST_ASSERT(Varint::encode(0xffffffff, out) == Varint::MAX_SIZE);
+    TEST_ASSERT(Varint::decode(out, Varint::MAX_SIZE, value32, size) == packet::Status::COMPLETE);
+    TEST_ASSERT(value32 == 0xffffffff);
+    // too long or overflowing encodings are rejected
+    const packet::byte_t overflow[] = {0xff, 0xff, 0xff, 0xff, 0x1f};
+    TEST_ASSERT(Varint::decode(overflow, 5, value32, size) == packet::Status::INVALID);
+    const packet::byte_t too_long[] = {0x80, 0x80, 0x80, 0x80, 0x80, 0x00};
+    TEST_ASSERT(Varint::decode(too_long, 6, value32, size) == packet::Status::INVALID);
+}
+
+struct Config64 : packet::ConfigT<packet::DefaultStartPattern,
+                                  packet::DefaultEndPattern,
+                                  std::uint64_t,
+                                  100000> {
+    using length_codec = packet::LittleEndianLength<std::uint64_t>;
+};
+
+struct SmallConfig64 : packet::ConfigT<packet::DefaultStartPattern,
+                                       packet::DefaultEndPattern,
+                                       std::uint64_t,
+                                       1000> {
+    using length_codec = packet::LittleEndianLength<std::uint64_t>;
+};
+
+void
+testPacketsWithDifferentLengthCodecs()
+{
+    struct Config16 : packet::ConfigT<packet::DefaultStartPattern,
+                                      packet::DefaultEndPattern,
+                                      std::uint16_t,
+                                      1000> {};
+    struct VarintConfig : packet::DefaultConfig {
+        using length_codec = packet::VarintLengthCodec<data_len_t>;
+    };
+
+    const std::string content(300, 'c');
+    TEST_ASSERT(checkSerializeAndUnserialize<packet::PacketT<Config16>>(content));
+    TEST_ASSERT(checkSerializeAndUnserialize<packet::PacketT<Config64>>(content));
+    TEST_ASSERT(checkSerializeAndUnserialize<packet::PacketT<VarintConfig>>(content));
+    TEST_ASSERT(checkSerializeAndUnserialize<packet::PacketT<VarintConfig>>("tiny"));
+
+    // the 16 bits length is written with 2 bytes in network order
+    const std::string serialized16 = serializePacketFromData<packet::PacketT<Config16>>(content);
+    TEST_ASSERT(serialized16.size() == 1 + 2 + content.size() + 1);
+    TEST_ASSERT(serialized16[1] == 0x01 && serialized16[2] == 0x2c);
+
+    // small packets only pay a single byte for the length
+    using VarintPacket = packet::PacketT<VarintConfig>;
+    TEST_ASSERT(VarintPacket::serializedSize(20) == 1 + 1 + 20 + 1);
+    TEST_ASSERT(serializePacketFromData<VarintPacket>("tiny").size() == 7);
+
+    // byte by byte reading of the variable size header works
+    packet::StreamFramerT<VarintConfig> framer;
+    std::vector<std::string> received;
+    const std::string stream = serializePacketFromData<VarintPacket>(content) +
+                               serializePacketFromData<VarintPacket>("tiny");
+    for (const std::string& chunk : splitStr(stream, 1)) {
+        framer.feed(reinterpret_cast<const packet::byte_t*>(chunk.data()),
+                    chunk.size(),
+                    [&received](const packet::byte_t* data, std::size_t len) {
+                        received.emplace_back(reinterpret_cast<const char*>(data), len);
+                    });
+    }
+    TEST_ASSERT(received == std::vector<std::string>({content, "tiny"}));
+
+    // lengths over MAX_DATA_LEN are detected
+    const std::string too_big = serializePacketFromData<packet::PacketT<Config64>>(std::string(2000, 'x'));
+    TEST_ASSERT(readPacket<packet::PacketT<SmallConfig64>>(too_big).status() == packet::Status::INVALID);
+}
+
+void
+testStreamingContentToSink()
+{
+    using Packet = packet::DefaultPacket;
+    static constexpr std::size_t RESERVE_AHEAD = packet::DefaultConfig::MAX_RESERVE_AHEAD;
+
+    std::string content(10 * RESERVE_AHEAD + 17, '\0');
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        content[i] = char(i % 251);
+    }
+    const std::string serialized = serializePacketFromData<Packet>(content);
+
+    std::string received;
+    Packet pkt;
+    pkt.setDataSink([&received](const packet::byte_t* data, std::size_t len) {
+        received.append(reinterpret_cast<const char*>(data), len);
+        return true;
+    });
+
+    // appending data
+    for (const std::string& chunk : splitStr(serialized, 4096)) {
+        readPacketPart(chunk, pkt);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(pkt.dataLen() == content.size());
+    TEST_ASSERT(pkt.data() == nullptr);
+    TEST_ASSERT(received == content);
+    TEST_ASSERT(pkt.allData().capacity() <= RESERVE_AHEAD);
+
+    // writing directly into the packet buffer
+    received.clear();
+    pkt.reset();
+    std::size_t offset = 0;
+    while (pkt.status() == packet::Status::INCOMPLETE) {
+        const std::size_t to_write = std::min(pkt.remainingBytes(), serialized.size() - offset);
+        std::memcpy(pkt.remainingBuffer(), serialized.data() + offset, to_write);
+        offset += pkt.updateDataOffset(to_write);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(offset == serialized.size());
+    TEST_ASSERT(received == content);
+    TEST_ASSERT(pkt.allData().capacity() <= 2 * RESERVE_AHEAD);
+
+    // the tail is still validated
+    std::string corrupted = serialized;
+    corrupted[corrupted.size() - 1] = 'X';
+    pkt.reset();
+    readPacketPart(corrupted, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+
+    // the sink can abort the packet
+    pkt.setDataSink([](const packet::byte_t*, std::size_t) { return false; });
+    pkt.reset();
+    readPacketPart(serialized, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+
+    // and without sink the content is buffered again
+    pkt.setDataSink(nullptr);
+    pkt.reset();
+    readPacketPart(serialized, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(pkt.data()), pkt.dataLen()) == content);
+}
+
+struct Crc32cConfig : packet::DefaultConfig {
+    using checksum = packet::Crc32cChecksum;
+};
+
+void
+testCrc32c()
+{
+    const std::string check = "123456789";
+    const packet::byte_t* data = reinterpret_cast<const packet::byte_t*>(check.data());
+    TEST_ASSERT(packet::crc32c(data, check.size()) == 0xE3069283u);
+    TEST_ASSERT(packet::detail::crc32cSoftware(0xFFFFFFFFu, data, check.size()) == ~0xE3069283u);
+
+    // incremental updates and both implementations must match
+    std::string content(10007, '\0');
+    for (std::size_t i = 0; i < content.size(); ++i) {
+        content[i] = char((i * 31) % 256);
+    }
+    const packet::byte_t* bytes = reinterpret_cast<const packet::byte_t*>(content.data());
+    std::uint32_t state = 0xFFFFFFFFu;
+    state = packet::crc32cUpdate(state, bytes, 13);
+    state = packet::crc32cUpdate(state, bytes + 13, content.size() - 13);
+    TEST_ASSERT(~state == packet::crc32c(bytes, content.size()));
+    TEST_ASSERT(packet::detail::crc32cSoftware(0xFFFFFFFFu, bytes, content.size()) ==
+                packet::crc32cUpdate(0xFFFFFFFFu, bytes, content.size()));
+}
+
+void
+testPacketsWithChecksum()
+{
+    using Packet = packet::PacketT<Crc32cConfig>;
+    const std::string content(70000, 'z');
+    TEST_ASSERT(checkSerializeAndUnserialize<Packet>(content));
+    TEST_ASSERT(checkSerializeAndUnserialize<Packet>("small"));
+
+    // layout: head | len | content | crc32c | tail
+    const std::string serialized = serializePacketFromData<Packet>("small");
+    TEST_ASSERT(serialized.size() == 1 + 4 + 5 + 4 + 1);
+    const std::uint32_t crc = packet::crc32c(reinterpret_cast<const packet::byte_t*>("small"), 5);
+    TEST_ASSERT(packet::Crc32cChecksum::read(reinterpret_cast<const packet::byte_t*>(serialized.data() + 10)) == crc);
+
+    // all the serializers agree
+    std::vector<packet::byte_t> buffer;
+    Packet::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), buffer);
+    const std::string serialized_big = serializePacketFromData<Packet>(content);
+    TEST_ASSERT(std::string(buffer.begin(), buffer.end()) == serialized_big);
+    packet::IovSerializerT<Crc32cConfig> iov_serializer;
+    const struct iovec fragments[] = {
+        {const_cast<char*>(content.data()), 100},
+        {const_cast<char*>(content.data() + 100), content.size() - 100},
+    };
+    iov_serializer.add(fragments, 2);
+    const struct iovec* iov = iov_serializer.iov();
+    std::string from_iov;
+    for (std::size_t i = 0; i < iov_serializer.iovCount(); ++i) {
+        from_iov.append(static_cast<const char*>(iov[i].iov_base), iov[i].iov_len);
+    }
+    TEST_ASSERT(from_iov == serialized_big);
+
+    // corrupted content is detected by the parser and the framer
+    std::string corrupted = serialized_big;
+    corrupted[100] = 'y';
+    TEST_ASSERT(readPacket<Packet>(corrupted).status() == packet::Status::INVALID);
+    packet::StreamFramerT<Crc32cConfig> framer;
+    framer.feed(reinterpret_cast<const packet::byte_t*>(corrupted.data()),
+                corrupted.size(),
+                [](const packet::byte_t*, std::size_t) { TEST_ASSERT(false); });
+    TEST_ASSERT(framer.status() == packet::Status::INVALID);
+
+    // also when writing directly into the packet buffer
+    Packet pkt;
+    std::size_t offset = 0;
+    while (pkt.status() == packet::Status::INCOMPLETE) {
+        const std::size_t to_write = std::min(pkt.remainingBytes(), serialized_big.size() - offset);
+        std::memcpy(pkt.remainingBuffer(), serialized_big.data() + offset, to_write);
+        offset += pkt.updateDataOffset(to_write);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+
+    // and when streaming the content
+    std::size_t streamed = 0;
+    pkt.setDataSink([&streamed](const packet::byte_t*, std::size_t len) { streamed += len; return true; });
+    pkt.reset();
+    readPacketPart(serialized_big, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && streamed == content.size());
+    pkt.reset();
+    readPacketPart(corrupted, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+}
+
+struct Lz4Config : packet::DefaultConfig {
+    using compression = packet::Lz4Compression<64>;
+};
+
+struct Lz4VarintConfig : packet::DefaultConfig {
+    using length_codec = packet::VarintLengthCodec<data_len_t>;
+    using checksum = packet::Crc32cChecksum;
+    using compression = packet::Lz4Compression<64>;
+};
+
+static std::string
+compressibleContent(const std::size_t len)
+{
+    std::string content;
+    while (content.size() < len) {
+        content += "message " + std::to_string(content.size() % 97) + " repeated; ";
+    }
+    content.resize(len);
+    return content;
+}
+
+void
+testLz4Codec()
+{
+    std::string random(5000, '\0');
+    std::uint32_t seed = 12345;
+    for (char& c : random) {
+        seed = seed * 1103515245u + 12345u;
+        c = char(seed >> 24);
+    }
+    const std::vector<std::string> inputs = {
+        "a", "short input", std::string(1000, 'x'), compressibleContent(100000), random,
+        compressibleContent(300) + random.substr(0, 300) + compressibleContent(300),
+    };
+    for (const std::string& input : inputs) {
+        const packet::byte_t* src = reinterpret_cast<const packet::byte_t*>(input.data());
+        std::vector<packet::byte_t> compressed(packet::lz4::compressBound(input.size()));
+        const std::size_t compressed_len = packet::lz4::compress(src, input.size(), compressed.data(), compressed.size());
+        TEST_ASSERT(compressed_len > 0);
+        std::vector<packet::byte_t> output(input.size());
+        TEST_ASSERT(packet::lz4::decompress(compressed.data(), compressed_len, output.data(), output.size()));
+        TEST_ASSERT(std::string(output.begin(), output.end()) == input);
+
+        // the exact size is required
+        std::vector<packet::byte_t> bigger(input.size() + 1);
+        TEST_ASSERT(!packet::lz4::decompress(compressed.data(), compressed_len, bigger.data(), bigger.size()));
+        // truncated blocks are detected
+        TEST_ASSERT(!packet::lz4::decompress(compressed.data(), compressed_len - 1, output.data(), output.size()));
+        // and output that does not fit is reported
+        TEST_ASSERT(packet::lz4::compress(src, input.size(), compressed.data(), compressed_len - 1) == 0);
+    }
+    const std::string big = compressibleContent(100000);
+    std::vector<packet::byte_t> compressed(packet::lz4::compressBound(big.size()));
+    TEST_ASSERT(packet::lz4::compress(reinterpret_cast<const packet::byte_t*>(big.data()), big.size(), compressed.data(), compressed.size()) < big.size() / 4);
+
+    // offsets pointing before the output are rejected
+    const packet::byte_t bad_offset[] = {0x10, 'a', 0x05, 0x00, 0x00};
+    std::vector<packet::byte_t> output(10);
+    TEST_ASSERT(!packet::lz4::decompress(bad_offset, sizeof(bad_offset), output.data(), 5));
+}
+
+template<typename Cfg>
+static void
+checkCompressedPackets(void)
+{
+    using Packet = packet::PacketT<Cfg>;
+    const std::string content = compressibleContent(200000);
+    const packet::byte_t* data = reinterpret_cast<const packet::byte_t*>(content.data());
+
+    std::vector<packet::byte_t> buffer;
+    TEST_ASSERT(Packet::serialize(data, content.size(), buffer));
+    TEST_ASSERT(buffer.size() < content.size() / 4);
+    const std::string serialized = serializePacketFromData<Packet>(content);
+    TEST_ASSERT(serialized == std::string(buffer.begin(), buffer.end()));
+
+    packet::FrameInfo info;
+    TEST_ASSERT(Packet::peekFrame(buffer.data(), buffer.size(), info) == packet::Status::COMPLETE);
+    TEST_ASSERT(info.frame_size == buffer.size() && (info.flags & Packet::FLAG_COMPRESSED) != 0);
+    packet::Buffer decompressed;
+    TEST_ASSERT(Packet::decompress(buffer.data() + info.data_offset, info.data_len, decompressed));
+    TEST_ASSERT(std::string(decompressed.begin(), decompressed.end()) == content);
+
+    // the parser gives back the original content, no matter how the data arrives
+    for (const std::size_t chunk : {std::size_t(1), std::size_t(7), serialized.size()}) {
+        Packet pkt;
+        for (const std::string& part : splitStr(serialized, chunk)) {
+            readPacketPart(part, pkt);
+        }
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && pkt.isCompressed());
+        TEST_ASSERT(std::string(reinterpret_cast<const char*>(pkt.data()), pkt.dataLen()) == content);
+        TEST_ASSERT(pkt.dataOffset() == 0 && pkt.allData().size() == content.size());
+
+        // the packet can be reused for an uncompressed one
+        pkt.reset();
+        readPacketPart(serializePacketFromData<Packet>("tiny"), pkt);
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && !pkt.isCompressed());
+        TEST_ASSERT(std::string(reinterpret_cast<const char*>(pkt.data()), pkt.dataLen()) == "tiny");
+    }
+
+    // small and incompressible contents are sent raw
+    std::string random(1000, '\0');
+    std::uint32_t seed = 7;
+    for (char& c : random) {
+        seed = seed * 1103515245u + 12345u;
+        c = char(seed >> 24);
+    }
+    for (const std::string& raw : {std::string("under the threshold"), random}) {
+        TEST_ASSERT(Packet::serialize(reinterpret_cast<const packet::byte_t*>(raw.data()), raw.size(), buffer));
+        TEST_ASSERT(buffer.size() == Packet::serializedSize(raw.size()));
+        TEST_ASSERT(Packet::peekFrame(buffer.data(), buffer.size(), info) == packet::Status::COMPLETE);
+        TEST_ASSERT(info.flags == 0);
+        TEST_ASSERT(checkSerializeAndUnserialize<Packet>(raw));
+    }
+
+    // the framer decompresses the packets, also the ones split between chunks
+    std::string stream;
+    for (int i = 0; i < 3; ++i) {
+        stream += serialized + serializePacketFromData<Packet>("raw");
+    }
+    for (const std::size_t chunk : {std::size_t(100), stream.size()}) {
+        packet::StreamFramerT<Cfg> framer;
+        std::vector<std::string> contents;
+        for (const std::string& part : splitStr(stream, chunk)) {
+            framer.feed(reinterpret_cast<const packet::byte_t*>(part.data()),
+                        part.size(),
+                        [&contents](const packet::byte_t* c, std::size_t len) {
+                            contents.emplace_back(reinterpret_cast<const char*>(c), len);
+                        });
+        }
+        TEST_ASSERT(contents.size() == 6 && framer.status() == packet::Status::INCOMPLETE);
+        for (std::size_t i = 0; i < contents.size(); ++i) {
+            TEST_ASSERT(contents[i] == (i % 2 == 0 ? content : "raw"));
+        }
+    }
+
+    // unknown flags are invalid
+    std::string bad_flags = serializePacketFromData<Packet>("raw");
+    bad_flags[bad_flags.size() - Packet::TRAILER_SIZE - 4] = char(0x80);
+    TEST_ASSERT(readPacket<Packet>(bad_flags).status() == packet::Status::INVALID);
+    TEST_ASSERT(Packet::peekFrame(reinterpret_cast<const packet::byte_t*>(bad_flags.data()), bad_flags.size(), info) == packet::Status::INVALID);
+}
+
+void
+testCompressedPackets()
+{
+    checkCompressedPackets<Lz4Config>();
+    checkCompressedPackets<Lz4VarintConfig>();
+
+    // a compressed content that can not be decompressed is invalid (without checksum the
+    // framing itself is fine)
+    using Packet = packet::PacketT<Lz4Config>;
+    const std::string content = compressibleContent(1000);
+    std::string serialized = serializePacketFromData<Packet>(content);
+    serialized[Packet::HEADER_MAX_SIZE + 4] = char(0xF0);
+    TEST_ASSERT(readPacket<Packet>(serialized).status() == packet::Status::INVALID);
+    packet::StreamFramerT<Lz4Config> framer;
+    framer.feed(reinterpret_cast<const packet::byte_t*>(serialized.data()),
+                serialized.size(),
+                [](const packet::byte_t*, std::size_t) { TEST_ASSERT(false); });
+    TEST_ASSERT(framer.status() == packet::Status::INVALID);
+    packet::StreamFramerT<Lz4Config> resync_framer(true);
+    serialized += serializePacketFromData<Packet>(content);
+    std::size_t packets = 0;
+    resync_framer.feed(reinterpret_cast<const packet::byte_t*>(serialized.data()),
+                       serialized.size(),
+                       [&packets](const packet::byte_t*, std::size_t) { ++packets; });
+    TEST_ASSERT(packets == 1 && resync_framer.skippedBytes() > 0);
+}
+
+void
+testStreamFramerMovesPendingPacket()
+{
+    using Packet = packet::DefaultPacket;
+    const std::string content(100000, 'm');
+    const std::string serialized = serializePacketFromData<Packet>(content);
+
+    packet::DefaultStreamFramer framer;
+    framer.feed(reinterpret_cast<const packet::byte_t*>(serialized.data()),
+                3,
+                [](const packet::byte_t*, std::size_t) { TEST_ASSERT(false); });
+    TEST_ASSERT(framer.pendingBytes() == 3 && framer.pendingFrameSize() <= Packet::HEADER_MAX_SIZE);
+    framer.feed(reinterpret_cast<const packet::byte_t*>(serialized.data() + 3),
+                1000,
+                [](const packet::byte_t*, std::size_t) { TEST_ASSERT(false); });
+    TEST_ASSERT(framer.pendingFrameSize() == serialized.size());
+
+    // the rest of the packet continues on a PacketT
+    Packet pkt;
+    framer.movePending(pkt);
+    TEST_ASSERT(framer.pendingBytes() == 0 && framer.pendingFrameSize() == 0);
+    TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE);
+    readPacketPart(serialized.substr(1003), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(pkt.data()), pkt.dataLen()) == content);
+}
+
+static int
+connectLoopback(const std::uint16_t port)
+{
+    const int fd = ::socket(AF_INET, SOCK_STREAM, 0);
+    sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    TEST_ASSERT(::connect(fd, reinterpret_cast<const sockaddr*>(&addr), sizeof(addr)) == 0);
+    return fd;
+}
+
+static void
+sendAll(const int fd, const std::string& data, const std::size_t chunk)
+{
+    for (std::size_t offset = 0; offset < data.size();) {
+        const ssize_t sent = ::write(fd, data.data() + offset, std::min(chunk, data.size() - offset));
+        TEST_ASSERT(sent > 0);
+        offset += std::size_t(sent);
+    }
+}
+
+template<typename Fn>
+static bool
+waitFor(Fn&& condition)
+{
+    for (int i = 0; i < 500 && !condition(); ++i) {
+        std::this_thread::sleep_for(std::chrono::milliseconds(10));
+    }
+    return condition();
+}
+
+template<typename Server, typename... Args>
+static void
+checkServerReadsConnections(Args... args)
+{
+    using Packet = packet::DefaultPacket;
+    std::mutex mutex;
+    std::vector<std::string> received;
+    Server server([&mutex, &received](int, const packet::byte_t* data, std::size_t len, std::uint64_t) {
+        std::lock_guard<std::mutex> lock(mutex);
+        received.emplace_back(reinterpret_cast<const char*>(data), len);
+    }, 2, args...);
+    TEST_ASSERT(server.start(0, "127.0.0.1"));
+    TEST_ASSERT(server.port() != 0 && server.threadsCount() == 2);
+    const auto receivedCount = [&mutex, &received]() {
+        std::lock_guard<std::mutex> lock(mutex);
+        return received.size();
+    };
+
+    // many small packets sent at once and split in odd chunks
+    std::string small_packets;
+    for (int i = 0; i < 100; ++i) {
+        small_packets += serializePacketFromData<Packet>("packet " + std::to_string(i));
+    }
+    const int small_fd = connectLoopback(server.port());
+    sendAll(small_fd, small_packets, small_packets.size());
+    sendAll(small_fd, small_packets, 7);
+    TEST_ASSERT(waitFor([&receivedCount]() { return receivedCount() == 200; }));
+
+    // a packet bigger than the read buffer
+    const std::string big_content(3 * packet::DefaultEpollServer::READ_BUFFER_SIZE + 123, 'b');
+    const int big_fd = connectLoopback(server.port());
+    sendAll(big_fd, serializePacketFromData<Packet>(big_content) + serializePacketFromData<Packet>("after"), 10000);
+    TEST_ASSERT(waitFor([&receivedCount]() { return receivedCount() == 202; }));
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        TEST_ASSERT(received[0] == "packet 0" && received[199] == "packet 99");
+        TEST_ASSERT(received[200] == big_content && received[201] == "after");
+    }
+
+    // idle connections are kept and invalid ones closed
+    std::vector<int> idle;
+    for (int i = 0; i < 50; ++i) {
+        idle.push_back(connectLoopback(server.port()));
+    }
+    TEST_ASSERT(waitFor([&server]() { return server.connectionsCount() == 52; }));
+    const int invalid_fd = connectLoopback(server.port());
+    sendAll(invalid_fd, "not a packet", 100);
+    TEST_ASSERT(waitFor([&server]() { return server.invalidCount() == 1 && server.connectionsCount() == 52; }));
+    char byte;
+    TEST_ASSERT(::read(invalid_fd, &byte, 1) == 0);
+
+    for (const int fd : idle) {
+        ::close(fd);
+    }
+    TEST_ASSERT(waitFor([&server]() { return server.connectionsCount() == 2; }));
+    server.stop();
+    TEST_ASSERT(!server.isRunning() && server.connectionsCount() == 0);
+    ::close(small_fd);
+    ::close(big_fd);
+    ::close(invalid_fd);
+}
+
+void
+testEpollServerReadsConnections()
+{
+    checkServerReadsConnections<packet::DefaultEpollServer>();
+}
+
+void
+testUringServerReadsConnections()
+{
+    using Server = packet::DefaultUringServer;
+    checkServerReadsConnections<Server>(packet::ServerBackend::AUTO);
+    checkServerReadsConnections<Server>(packet::ServerBackend::EPOLL);
+
+    Server server([](int, const packet::byte_t*, std::size_t, std::uint64_t) {}, 1);
+    TEST_ASSERT(server.start(0, "127.0.0.1"));
+    TEST_ASSERT(server.backend() == (Server::isSupported() ? packet::ServerBackend::IO_URING :
+                                                             packet::ServerBackend::EPOLL));
+    server.stop();
+    TEST_ASSERT(!server.isRunning());
+}
+
+static double
+processCpuSeconds()
+{
+    timespec now;
+    ::clock_gettime(CLOCK_PROCESS_CPUTIME_ID, &now);
+    return double(now.tv_sec) + double(now.tv_nsec) / 1e9;
+}
+
+void
+testUringServerBacksOffOnAcceptErrors()
+{
+    using Server = packet::DefaultUringServer;
+    if (!Server::isSupported()) {
+        return;
+    }
+    // on a child process, so the descriptors limit does not affect the other tests
+    const pid_t pid = ::fork();
+    TEST_ASSERT(pid >= 0);
+    if (pid == 0) {
+        // io_uring takes the descriptors limit when the accept is submitted, so it is
+        // lowered before starting: a few free descriptors for the server, then all of them
+        // but one are taken, and the client takes the last one
+        rlimit limit;
+        ::getrlimit(RLIMIT_NOFILE, &limit);
+        const rlimit original = limit;
+        std::vector<int> fillers;
+        for (int i = 0; i < 16; ++i) {
+            fillers.push_back(::open("/dev/null", O_RDONLY));
+        }
+        limit.rlim_cur = rlim_t(fillers.back()) + 1;
+        ::setrlimit(RLIMIT_NOFILE, &limit);
+        for (const int filler : fillers) {
+            ::close(filler);
+        }
+        fillers.clear();
+        Server server([](int, const packet::byte_t*, std::size_t, std::uint64_t) {}, 1);
+        if (!server.start(0, "127.0.0.1")) {
+            ::_exit(1);
+        }
+        for (int fd = ::open("/dev/null", O_RDONLY); fd >= 0; fd = ::open("/dev/null", O_RDONLY)) {
+            fillers.push_back(fd);
+        }
+        ::close(fillers.back());
+        const int client = connectLoopback(server.port());
+
+        // the reactor does not spin on the failed accepts
+        const double cpu_start = processCpuSeconds();
+        std::this_thread::sleep_for(std::chrono::milliseconds(300));
+        if (processCpuSeconds() - cpu_start > 0.1 || server.connectionsCount() != 0) {
+            ::_exit(2);
+        }
+        // and accepts again once there are descriptors
+        ::setrlimit(RLIMIT_NOFILE, &original);
+        if (!waitFor([&server]() { return server.connectionsCount() == 1; })) {
+            ::_exit(3);
+        }
+        ::close(client);
+        server.stop();
+        ::_exit(0);
+    }
+    int status = 0;
+    TEST_ASSERT(::waitpid(pid, &status, 0) == pid);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+}
+
+void
+testMpmcQueue()
+{
+    packet::MpmcQueue<int> queue(3);
+    TEST_ASSERT(queue.capacity() == 4);
+    int value = 0;
+    TEST_ASSERT(!queue.tryPop(value));
+    for (int i = 0; i < 4; ++i) {
+        TEST_ASSERT(queue.tryPush(int(i)));
+    }
+    TEST_ASSERT(!queue.tryPush(4));
+    TEST_ASSERT(queue.sizeApprox() == 4);
+    for (int i = 0; i < 4; ++i) {
+        TEST_ASSERT(queue.tryPop(value) && value == i);
+    }
+    TEST_ASSERT(!queue.tryPop(value));
+
+    // several producers and consumers: every element is popped exactly once
+    static const int PER_PRODUCER = 50000;
+    static const int THREADS = 4;
+    packet::MpmcQueue<int> shared(64);
+    std::atomic<long long> sum(0);
+    std::atomic<int> popped(0);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < THREADS; ++t) {
+        threads.emplace_back([&shared, t]() {
+            for (int i = 1; i <= PER_PRODUCER; ++i) {
+                while (!shared.tryPush(int(t * PER_PRODUCER + i))) {
+                    std::this_thread::yield();
+                }
+            }
+        });
+        threads.emplace_back([&shared, &sum, &popped]() {
+            int v = 0;
+            while (popped.load() < THREADS * PER_PRODUCER) {
+                if (shared.tryPop(v)) {
+                    sum += v;
+                    ++popped;
+                } else {
+                    std::this_thread::yield();
+                }
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    const long long n = THREADS * PER_PRODUCER;
+    TEST_ASSERT(popped.load() == n);
+    TEST_ASSERT(sum.load() == n * (n + 1) / 2);
+}
+
+struct PipelineConfig : packet::DefaultConfig {
+    using buffer_policy = packet::PooledBufferPolicy;
+};
+
+void
+testPacketPipelineHandsPacketsToWorkers()
+{
+    using Packet = packet::PacketT<PipelineConfig>;
+    std::vector<std::string> frames;
+    for (std::size_t i = 0; i < 64; ++i) {
+        frames.push_back(serializePacketFromData<Packet>(std::string(1 + i * 31, char('a' + i % 26))));
+    }
+
+    std::atomic<std::size_t> bytes(0);
+    std::atomic<std::size_t> wrong(0);
+    packet::PacketPipelineT<PipelineConfig> pipeline([&bytes, &wrong](const packet::byte_t* data, std::size_t len, std::uint64_t) {
+        for (std::size_t i = 1; i < len; ++i) {
+            if (data[i] != data[0]) {
+                ++wrong;
+            }
+        }
+        bytes += len;
+    }, 4, 16);
+    TEST_ASSERT(pipeline.workersCount() == 4);
+
+    // the same packet object parses all of them, the buffers come back from the workers
+    Packet pkt;
+    std::size_t expected_bytes = 0;
+    static const std::size_t ROUNDS = 200;
+    for (std::size_t round = 0; round < ROUNDS; ++round) {
+        for (std::size_t i = 0; i < frames.size(); ++i) {
+            readPacketPart(frames[i], pkt);
+            TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+            expected_bytes += pkt.dataLen();
+            TEST_ASSERT(pipeline.push(pkt));
+            TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE);
+        }
+    }
+    pipeline.flush();
+    TEST_ASSERT(pipeline.processedCount() == ROUNDS * frames.size());
+    TEST_ASSERT(bytes.load() == expected_bytes);
+    TEST_ASSERT(wrong.load() == 0);
+
+    // once warmed up the buffers circulate without allocating
+    packet::BufferPool& pool = packet::BufferPool::local();
+    pipeline.reclaimBuffers();
+    const std::size_t allocations = pool.allocationsCount();
+    for (std::size_t i = 0; i < frames.size(); ++i) {
+        readPacketPart(frames[i], pkt);
+        TEST_ASSERT(pipeline.push(pkt));
+        pipeline.flush();
+    }
+    TEST_ASSERT(pool.allocationsCount() == allocations);
+
+    pipeline.stop();
+    readPacketPart(frames[0], pkt);
+    TEST_ASSERT(!pipeline.tryPush(pkt));
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+}
+
+void
+testPacketPipelineBackpressure()
+{
+    using Packet = packet::PacketT<PipelineConfig>;
+    const std::string frame = serializePacketFromData<Packet>("slow message");
+
+    std::atomic<bool> blocked(true);
+    std::atomic<std::size_t> handled(0);
+    packet::PacketPipelineT<PipelineConfig> pipeline([&blocked, &handled](const packet::byte_t*, std::size_t, std::uint64_t) {
+        while (blocked.load()) {
+            std::this_thread::yield();
+        }
+        ++handled;
+    }, 1, 4);
+
+    // one packet held by the worker plus the 4 queued ones
+    Packet pkt;
+    std::size_t queued = 0;
+    for (std::size_t i = 0; i < 10; ++i) {
+        readPacketPart(frame, pkt);
+        if (!pipeline.tryPush(pkt)) {
+            break;
+        }
+        ++queued;
+    }
+    TEST_ASSERT(queued >= 4 && queued <= 5);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+
+    // push() waits until the worker makes room
+    std::thread release([&blocked]() {
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+        blocked = false;
+    });
+    TEST_ASSERT(pipeline.push(pkt));
+    TEST_ASSERT(pipeline.backpressureCount() == 1);
+    release.join();
+    pipeline.stop();
+    TEST_ASSERT(handled.load() == queued + 1);
+}
+
+void
+testShmRingWrapsAround()
+{
+    // each side checks the flag of the other one on its own cache line
+    using Header = packet::detail::ShmRingHeader;
+    static_assert(offsetof(Header, reader_waiting) / 64 == offsetof(Header, write_pos) / 64 &&
+                  offsetof(Header, writer_waiting) / 64 == offsetof(Header, read_pos) / 64 &&
+                  offsetof(Header, read_pos) / 64 != offsetof(Header, write_pos) / 64,
+                  "the waiting flags are on the line of the side polling them");
+    packet::DefaultShmRing ring;
+    TEST_ASSERT(ring.create(1));
+    const std::size_t capacity = ring.capacity();
+    TEST_ASSERT(capacity >= 4096 && (capacity & (capacity - 1)) == 0);
+
+    // frames of sizes not dividing the capacity end up crossing the end of the ring
+    packet::PacketView view;
+    for (std::size_t i = 0; i < 1000; ++i) {
+        const std::string content(1 + (i * 97) % 1500, char('a' + i % 26));
+        TEST_ASSERT(ring.tryWrite(reinterpret_cast<const packet::byte_t*>(content.data()), content.size()));
+        TEST_ASSERT(ring.tryRead(view));
+        TEST_ASSERT(view.in_place);
+        TEST_ASSERT(std::string(reinterpret_cast<const char*>(view.data), view.len) == content);
+    }
+    TEST_ASSERT(!ring.tryRead(view));
+
+    // full ring: the producer has to wait for the consumer
+    const std::string chunk(1000, 'x');
+    std::size_t written = 0;
+    while (ring.tryWrite(reinterpret_cast<const packet::byte_t*>(chunk.data()), chunk.size())) {
+        ++written;
+    }
+    TEST_ASSERT(written > 0 && written * chunk.size() <= capacity);
+    TEST_ASSERT(!ring.write(reinterpret_cast<const packet::byte_t*>(chunk.data()), chunk.size(), 10));
+    // a frame bigger than the ring never fits
+    const std::string huge(capacity, 'h');
+    TEST_ASSERT(!ring.write(reinterpret_cast<const packet::byte_t*>(huge.data()), huge.size()));
+    TEST_ASSERT(ring.tryRead(view));
+    ring.release();
+    TEST_ASSERT(ring.tryWrite(reinterpret_cast<const packet::byte_t*>(chunk.data()), chunk.size()));
+
+    // zero copy producer side
+    for (std::size_t i = 0; i < written; ++i) {
+        TEST_ASSERT(ring.tryRead(view));
+    }
+    ring.release();
+    packet::byte_t* content = ring.reserve(5);
+    TEST_ASSERT(content != nullptr);
+    std::memcpy(content, "hello", 5);
+    ring.commit();
+    TEST_ASSERT(ring.tryRead(view));
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(view.data), view.len) == "hello");
+    TEST_ASSERT(ring.status() != packet::Status::INVALID);
+
+    // a non ring file can not be attached
+    packet::DefaultShmRing other;
+    const int fd = ::memfd_create("not_a_ring", 0);
+    TEST_ASSERT(fd >= 0 && ::ftruncate(fd, 8192) == 0);
+    TEST_ASSERT(!other.attach(fd));
+    ::close(fd);
+}
+
+void
+testShmRingBetweenProcesses()
+{
+    packet::DefaultShmRing ring;
+    TEST_ASSERT(ring.create(64 * 1024));
+    static const std::size_t COUNT = 20000;
+
+    const pid_t pid = ::fork();
+    TEST_ASSERT(pid >= 0);
+    if (pid == 0) {
+        // producer process, attaching from the inherited fd
+        packet::DefaultShmRing producer;
+        if (!producer.attach(ring.fd())) {
+            ::_exit(1);
+        }
+        std::string content;
+        for (std::size_t i = 0; i < COUNT; ++i) {
+            content.assign(1 + (i * 131) % 5000, char('a' + i % 26));
+            if (!producer.write(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), 5000)) {
+                ::_exit(2);
+            }
+        }
+        ::_exit(0);
+    }
+
+    std::size_t matched = 0;
+    packet::PacketView view;
+    for (std::size_t i = 0; i < COUNT; ++i) {
+        if (!ring.read(view, 5000)) {
+            break;
+        }
+        const std::size_t len = 1 + (i * 131) % 5000;
+        if (view.len == len && view.data[0] == char('a' + i % 26) && view.data[len - 1] == view.data[0]) {
+            ++matched;
+        }
+    }
+    int status = 0;
+    TEST_ASSERT(::waitpid(pid, &status, 0) == pid);
+    TEST_ASSERT(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+    TEST_ASSERT(matched == COUNT);
+}
+
+static std::string
+logContent(const std::size_t i)
+{
+    return std::string(1 + (i * 37) % 700, char('a' + i % 26));
+}
+
+template<typename Cfg>
+static void
+appendToLog(const std::string& path, const std::size_t from, const std::size_t to)
+{
+    std::ofstream log(path, std::ios::binary | std::ios::app);
+    std::vector<packet::byte_t> frame;
+    for (std::size_t i = from; i < to; ++i) {
+        const std::string content = logContent(i);
+        TEST_ASSERT(packet::PacketT<Cfg>::serialize(
+            reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame));
+        log.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+    }
+}
+
+template<typename Cfg>
+static bool
+logMatches(packet::PacketLogReaderT<Cfg>& reader, const std::size_t count)
+{
+    packet::PacketView view;
+    for (std::size_t i = 0; i < count; ++i) {
+        if (!reader.view(i, view) || std::string(reinterpret_cast<const char*>(view.data), view.len) != logContent(i)) {
+            return false;
+        }
+    }
+    return !reader.view(count, view);
+}
+
+void
+testPacketLogReader()
+{
+    char path_template[] = "/tmp/packet_log_XXXXXX";
+    const int fd = ::mkstemp(path_template);
+    TEST_ASSERT(fd >= 0);
+    ::close(fd);
+    const std::string path(path_template);
+    const std::string index_path = packet::DefaultPacketLogReader::indexPath(path);
+
+    // empty log
+    packet::DefaultPacketLogReader reader;
+    TEST_ASSERT(reader.open(path, false));
+    TEST_ASSERT(reader.isOpen() && reader.count() == 0 && reader.status() == packet::Status::COMPLETE);
+
+    // the first open builds and persists the index, the next one loads it
+    appendToLog<packet::DefaultConfig>(path, 0, 500);
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(!reader.indexLoaded());
+    TEST_ASSERT(reader.count() == 500);
+    TEST_ASSERT(::access(index_path.c_str(), F_OK) == 0);
+    TEST_ASSERT(logMatches(reader, 500));
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(reader.indexLoaded() && reader.count() == 500);
+    TEST_ASSERT(logMatches(reader, 500));
+
+    // packets appended to the log are indexed on the next open, a partial one is skipped
+    appendToLog<packet::DefaultConfig>(path, 500, 800);
+    std::vector<packet::byte_t> frame;
+    const std::string partial = logContent(800);
+    packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(partial.data()), partial.size(), frame);
+    {
+        std::ofstream log(path, std::ios::binary | std::ios::app);
+        log.write(reinterpret_cast<const char*>(frame.data()), frame.size() / 2);
+    }
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(reader.indexLoaded() && reader.count() == 800);
+    TEST_ASSERT(reader.status() == packet::Status::INCOMPLETE);
+    TEST_ASSERT(logMatches(reader, 800));
+    const std::size_t indexed_size = reader.indexedSize();
+    reader.close();
+    TEST_ASSERT(!reader.isOpen());
+
+    // sparse index
+    ::unlink(index_path.c_str());
+    TEST_ASSERT(reader.open(path, true, 16));
+    TEST_ASSERT(reader.count() == 800 && reader.indexedSize() == indexed_size);
+    TEST_ASSERT(logMatches(reader, 800));
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(reader.indexLoaded() && logMatches(reader, 800));
+
+    // a log rewritten in place (same file, same first packets, bigger) gets a new index
+    reader.close();
+    {
+        std::ofstream log(path, std::ios::binary | std::ios::trunc);
+        for (std::size_t i = 0; i < 900; ++i) {
+            const std::string content = logContent(i < 100 ? i : i + 7);
+            packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame);
+            log.write(reinterpret_cast<const char*>(frame.data()), frame.size());
+        }
+    }
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(!reader.indexLoaded() && reader.count() == 900);
+    packet::PacketView rewritten;
+    TEST_ASSERT(reader.view(899, rewritten) &&
+                std::string(reinterpret_cast<const char*>(rewritten.data), rewritten.len) == logContent(906));
+    TEST_ASSERT(reader.open(path));
+    TEST_ASSERT(reader.indexLoaded() && reader.count() == 900);
+    reader.close();
+    TEST_ASSERT(::truncate(path.c_str(), 0) == 0);
+    appendToLog<packet::DefaultConfig>(path, 0, 800);
+
+    // an index of another configuration is not used
+    packet::PacketLogReaderT<Crc32cConfig> other;
+    TEST_ASSERT(other.open(path, false));
+    TEST_ASSERT(!other.indexLoaded());
+    TEST_ASSERT(other.count() == 0 && other.status() == packet::Status::INVALID);
+    other.close();
+
+    // compressed content is returned decompressed
+    reader.close();
+    TEST_ASSERT(::truncate(path.c_str(), 0) == 0);
+    appendToLog<Lz4Config>(path, 0, 100);
+    packet::PacketLogReaderT<Lz4Config> compressed;
+    TEST_ASSERT(compressed.open(path));
+    TEST_ASSERT(!compressed.indexLoaded() && compressed.count() == 100);
+    TEST_ASSERT(logMatches(compressed, 100));
+    compressed.close();
+
+    ::unlink(index_path.c_str());
+    ::unlink(path.c_str());
+}
+
+template<typename Cfg>
+static void
+checkPacketLogWriter(const std::string& path, const bool direct)
+{
+    packet::LogWriterOptions options;
+    options.batch_size = 4096;
+    options.direct = direct;
+    options.sync = packet::SyncPolicy::EVERY_BYTES;
+    options.sync_bytes = 64 * 1024;
+    options.index_stride = 16;
+    options.index_interval = 1000;
+
+    packet::PacketLogWriterT<Cfg> writer;
+    TEST_ASSERT(writer.open(path, options));
+    for (std::size_t i = 0; i < 5000; ++i) {
+        const std::string content = logContent(i);
+        TEST_ASSERT(writer.append(reinterpret_cast<const packet::byte_t*>(content.data()), content.size()));
+    }
+    TEST_ASSERT(writer.packetsCount() == 5000);
+    TEST_ASSERT(!writer.append(nullptr, 10));
+
+    // once flushed the file holds exactly the packets, even with O_DIRECT
+    TEST_ASSERT(writer.flush());
+    struct stat file_stat;
+    TEST_ASSERT(::stat(path.c_str(), &file_stat) == 0 && std::uint64_t(file_stat.st_size) == writer.size());
+    packet::PacketLogReaderT<Cfg> reader;
+    TEST_ASSERT(reader.open(path, false));
+    TEST_ASSERT(reader.indexLoaded() && reader.count() == 5000);
+    TEST_ASSERT(reader.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(logMatches(reader, 5000));
+
+    TEST_ASSERT(writer.close());
+    TEST_ASSERT(!writer.isOpen());
+    TEST_ASSERT(reader.open(path, false));
+    TEST_ASSERT(reader.indexLoaded() && reader.count() == 5000);
+    TEST_ASSERT(logMatches(reader, 5000));
+
+    // packets bigger than the batch
+    TEST_ASSERT(writer.open(path, options));
+    const std::string big(10000, 'B');
+    const std::string small = logContent(1);
+    TEST_ASSERT(writer.append(reinterpret_cast<const packet::byte_t*>(small.data()), small.size()));
+    TEST_ASSERT(writer.append(reinterpret_cast<const packet::byte_t*>(big.data()), big.size()));
+    TEST_ASSERT(writer.append(reinterpret_cast<const packet::byte_t*>(small.data()), small.size()));
+    TEST_ASSERT(writer.close());
+    TEST_ASSERT(reader.open(path, false));
+    TEST_ASSERT(reader.count() == 3);
+    packet::PacketView view;
+    TEST_ASSERT(reader.view(1, view) && std::string(reinterpret_cast<const char*>(view.data), view.len) == big);
+    TEST_ASSERT(reader.view(2, view) && std::string(reinterpret_cast<const char*>(view.data), view.len) == small);
+}
+
+void
+testPacketLogWriter()
+{
+    char path_template[] = "/tmp/packet_log_XXXXXX";
+    const int fd = ::mkstemp(path_template);
+    TEST_ASSERT(fd >= 0);
+    ::close(fd);
+    const std::string path(path_template);
+
+    checkPacketLogWriter<packet::DefaultConfig>(path, false);
+    checkPacketLogWriter<packet::DefaultConfig>(path, true);
+    checkPacketLogWriter<Lz4Config>(path, false);
+    checkPacketLogWriter<Lz4Config>(path, true);
+
+    ::unlink(packet::DefaultPacketLogReader::indexPath(path).c_str());
+    ::unlink(path.c_str());
+}
+
+static bool
+sameReport(const packet::ScanReport& a, const packet::ScanReport& b)
+{
+    if (a.packets_count != b.packets_count || a.packets_bytes != b.packets_bytes ||
+        a.invalid_count != b.invalid_count || a.invalid_bytes != b.invalid_bytes ||
+        a.trailing_bytes != b.trailing_bytes || a.invalid_regions.size() != b.invalid_regions.size()) {
+        return false;
+    }
+    for (std::size_t i = 0; i < a.invalid_regions.size(); ++i) {
+        if (a.invalid_regions[i].offset != b.invalid_regions[i].offset ||
+            a.invalid_regions[i].len != b.invalid_regions[i].len) {
+            return false;
+        }
+    }
+    return true;
+}
+
+static std::vector<std::uint64_t>
+scanOffsets(packet::DefaultCaptureScanner& scanner, const std::vector<packet::byte_t>& capture, packet::ScanReport& report)
+{
+    std::mutex mutex;
+    std::vector<std::uint64_t> offsets;
+    scanner.scan(capture.data(), capture.size(), report, [&](std::uint64_t offset, const packet::PacketView& view) {
+        TEST_ASSERT(view.in_place && view.data == capture.data() + offset + packet::DefaultPacket::HEAD_PATTERN_SIZE + 4);
+        std::lock_guard<std::mutex> lock(mutex);
+        offsets.push_back(offset);
+    });
+    std::sort(offsets.begin(), offsets.end());
+    return offsets;
+}
+
+void
+testCaptureScanner()
+{
+    // every third content ends with a serialized packet, so the threads can synchronize
+    // on packets that are not really there
+    std::vector<packet::byte_t> capture;
+    std::vector<packet::byte_t> frame;
+    std::vector<packet::byte_t> nested;
+    std::vector<std::uint64_t> expected_offsets;
+    for (std::size_t i = 0; i < 3000; ++i) {
+        std::string content = logContent(i);
+        if (i % 3 == 0) {
+            packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), nested);
+            content.append(nested.begin(), nested.end());
+        }
+        packet::DefaultPacket::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame);
+        expected_offsets.push_back(capture.size());
+        capture.insert(capture.end(), frame.begin(), frame.end());
+    }
+
+    packet::DefaultCaptureScanner sequential(1);
+    packet::ScanReport expected;
+    TEST_ASSERT(scanOffsets(sequential, capture, expected) == expected_offsets);
+    TEST_ASSERT(expected.packets_count == 3000 && expected.packets_bytes == capture.size());
+    TEST_ASSERT(expected.status() == packet::Status::COMPLETE);
+
+    for (const std::size_t threads : {2, 3, 8, 61}) {
+        packet::DefaultCaptureScanner scanner(threads, 1000);
+        packet::ScanReport report;
+        TEST_ASSERT(scanOffsets(scanner, capture, report) == expected_offsets);
+        TEST_ASSERT(sameReport(report, expected));
+    }
+
+    // corrupted packets (not nested ones, the scan would resynchronize on them) and a
+    // partial one at the end
+    for (const std::size_t corrupted : {10, 700, 1501, 1502}) {
+        capture[std::size_t(expected_offsets[corrupted]) + 2] ^= 0xff;
+    }
+    capture.resize(capture.size() - 3);
+    sequential.scan(capture.data(), capture.size(), expected);
+    TEST_ASSERT(expected.invalid_count == 3 && expected.invalid_regions.size() == 3);
+    TEST_ASSERT(expected.invalid_regions[0].offset == expected_offsets[10]);
+    TEST_ASSERT(expected.invalid_regions[2].offset == expected_offsets[1501]);
+    TEST_ASSERT(expected.invalid_regions[2].len == expected_offsets[1503] - expected_offsets[1501]);
+    TEST_ASSERT(expected.trailing_bytes == capture.size() - expected_offsets[2999]);
+    TEST_ASSERT(expected.packets_count == 3000 - 5);
+    TEST_ASSERT(expected.status() == packet::Status::INVALID);
+    for (const std::size_t threads : {2, 5, 16, 97}) {
+        packet::DefaultCaptureScanner scanner(threads, 500);
+        packet::ScanReport report;
+        std::atomic<std::size_t> delivered(0);
+        scanner.scan(capture.data(), capture.size(), report, [&delivered](std::uint64_t, const packet::PacketView&) {
+            ++delivered;
+        });
+        TEST_ASSERT(sameReport(report, expected));
+        TEST_ASSERT(delivered.load() == report.packets_count);
+    }
+}
+
+struct DataChannel { static constexpr const char* NAME = "data"; };
+struct MetricsConfig : packet::DefaultConfig {
+    using metrics = packet::CountingMetrics<DataChannel>;
+};
+
+struct ControlChannel { static constexpr const char* NAME = "control"; };
+struct ControlMetricsConfig : packet::DefaultConfig {
+    using metrics = packet::CountingMetrics<ControlChannel>;
+};
+
+void
+testMetricsCountParsersAndSerializers()
+{
+    using Packet = packet::PacketT<MetricsConfig>;
+    const packet::MetricsSnapshot before = packet::Metrics::snapshot("data");
+    const packet::MetricsSnapshot all_before = packet::Metrics::snapshot();
+
+    // serialized and then parsed byte by byte
+    const std::string content(100000, 'm');
+    std::vector<packet::byte_t> frame;
+    TEST_ASSERT(Packet::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame));
+    Packet pkt;
+    for (const packet::byte_t byte : frame) {
+        pkt.appendData(&byte, 1);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+
+    // the zero copy serializers are counted too
+    const std::string small = "zero copy";
+    const packet::byte_t* small_data = reinterpret_cast<const packet::byte_t*>(small.data());
+    const std::size_t small_size = Packet::serializedSize(Packet::data_len_t(small.size()));
+    packet::IovSerializerT<MetricsConfig> iov_serializer;
+    TEST_ASSERT(iov_serializer.add(small_data, Packet::data_len_t(small.size())));
+    struct iovec fragments[] = {{const_cast<char*>(small.data()), small.size()}};
+    TEST_ASSERT(iov_serializer.add(fragments, 1));
+    TEST_ASSERT(iov_serializer.totalBytes() == 2 * small_size);
+    packet::ShmRingT<MetricsConfig> ring;
+    TEST_ASSERT(ring.create(1) && ring.tryWrite(small_data, small.size()));
+
+    // invalid head and tail
+    pkt.reset();
+    pkt.appendData(reinterpret_cast<const packet::byte_t*>("X"), 1);
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+    pkt.reset();
+    std::vector<packet::byte_t> bad_tail = frame;
+    bad_tail.back() = 'X';
+    std::size_t bad_tail_calls = 0;
+    for (std::size_t offset = 0; pkt.status() == packet::Status::INCOMPLETE; ++bad_tail_calls) {
+        offset += pkt.appendData(bad_tail.data() + offset, bad_tail.size() - offset);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+
+    // counted from another thread, the counters stay once it is gone
+    std::thread thread([&frame]() {
+        packet::StreamFramerT<MetricsConfig> framer;
+        std::vector<packet::byte_t> input = frame;
+        input.insert(input.end(), frame.begin(), frame.end());
+        std::size_t emitted = 0;
+        const auto handler = [&emitted](const packet::byte_t*, std::size_t) { ++emitted; };
+        framer.feed(input.data(), input.size(), handler);
+        // one more split in 3 inputs
+        const std::size_t third = frame.size() / 3;
+        framer.feed(frame.data(), third, handler);
+        framer.feed(frame.data() + third, third, handler);
+        framer.feed(frame.data() + 2 * third, frame.size() - 2 * third, handler);
+        TEST_ASSERT(emitted == 2 + 1);
+    });
+    thread.join();
+
+    // another group is counted apart
+    packet::PacketT<ControlMetricsConfig> control;
+    control.appendData(reinterpret_cast<const packet::byte_t*>("X"), 1);
+    TEST_ASSERT(control.status() == packet::Status::INVALID);
+    const packet::MetricsSnapshot control_after = packet::CountingMetrics<ControlChannel>::snapshot();
+    TEST_ASSERT(control_after.invalid_packets[0] == 1 && control_after.packets_parsed == 0);
+    const std::vector<std::string> groups = packet::Metrics::groups();
+    TEST_ASSERT(std::count(groups.begin(), groups.end(), "data") == 1 &&
+                std::count(groups.begin(), groups.end(), "control") == 1);
+
+    const packet::MetricsSnapshot after = MetricsConfig::metrics::snapshot();
+    const packet::MetricsSnapshot all_after = packet::Metrics::snapshot();
+    TEST_ASSERT(all_after.invalid_packets[0] - all_before.invalid_packets[0] == 2);
+    TEST_ASSERT(after.packets_serialized - before.packets_serialized == 1 + 3);
+    TEST_ASSERT(after.bytes_serialized - before.bytes_serialized == frame.size() + 3 * small_size);
+    TEST_ASSERT(after.packets_parsed - before.packets_parsed == 1 + 3);
+    TEST_ASSERT(after.append_calls - before.append_calls == frame.size() + 1 + bad_tail_calls + 4);
+    TEST_ASSERT(after.bytes_parsed - before.bytes_parsed == 1 + 5 * frame.size());
+    TEST_ASSERT(after.invalid_packets[0] - before.invalid_packets[0] == 1);
+    TEST_ASSERT(std::string(packet::MetricsSnapshot::stateName(0)) == "head_pattern");
+    TEST_ASSERT(after.invalid_packets[5] - before.invalid_packets[5] == 1);
+    TEST_ASSERT(after.invalid_frames == before.invalid_frames);
+    // the packet fed byte by byte, the framer packets from a single input and from 3 inputs
+    TEST_ASSERT(after.append_calls_per_packet[packet::MetricsSnapshot::APPEND_BUCKETS - 1] -
+                before.append_calls_per_packet[packet::MetricsSnapshot::APPEND_BUCKETS - 1] == 1);
+    TEST_ASSERT(after.append_calls_per_packet[0] - before.append_calls_per_packet[0] == 2);
+    TEST_ASSERT(after.append_calls_per_packet[1] - before.append_calls_per_packet[1] == 1);
+    TEST_ASSERT(after.reallocations > before.reallocations);
+    TEST_ASSERT(after.peak_buffer_size >= frame.size());
+}
+
+struct TracedGroup { static constexpr const char* NAME = "traced"; };
+struct TracingConfig : packet::DefaultConfig {
+    using tracing = packet::LatencyTracing<TracedGroup>;
+};
+
+static const packet::LatencyReport*
+findLatency(const std::vector<packet::LatencyReport>& reports, const std::string& kind)
+{
+    for (const packet::LatencyReport& report : reports) {
+        if (report.group == TracedGroup::NAME && report.kind == kind) {
+            return &report;
+        }
+    }
+    return nullptr;
+}
+
+void
+testLatencyTracing()
+{
+    // the buckets keep the values with an error below 1 / SUB_BUCKETS
+    using Histogram = packet::LatencyHistogram;
+    for (std::uint64_t value : {0ull, 1ull, 63ull, 64ull, 65ull, 1000ull, 123456789ull, ~0ull}) {
+        const std::size_t bucket = Histogram::bucketOf(value);
+        TEST_ASSERT(bucket < Histogram::BUCKETS_COUNT);
+        TEST_ASSERT(Histogram::bucketMax(bucket) >= value);
+        TEST_ASSERT(Histogram::bucketMax(bucket) - value <= value / Histogram::SUB_BUCKETS);
+        TEST_ASSERT(bucket == 0 || Histogram::bucketMax(bucket - 1) < value);
+    }
+    Histogram histogram;
+    TEST_ASSERT(histogram.percentile(50) == 0);
+    std::vector<std::thread> threads;
+    for (std::size_t t = 0; t < 4; ++t) {
+        threads.emplace_back([&histogram]() {
+            for (std::uint64_t value = 1; value <= 10000; ++value) {
+                histogram.record(value);
+            }
+        });
+    }
+    for (std::thread& thread : threads) {
+        thread.join();
+    }
+    TEST_ASSERT(histogram.count() == 40000);
+    TEST_ASSERT(histogram.max() == 10000);
+    TEST_ASSERT(histogram.mean() > 5000 && histogram.mean() < 5001);
+    const std::uint64_t p50 = histogram.percentile(50);
+    const std::uint64_t p99 = histogram.percentile(99);
+    TEST_ASSERT(p50 >= 5000 && p50 <= 5000 + 5000 / Histogram::SUB_BUCKETS);
+    TEST_ASSERT(p99 >= 9900 && p99 <= 10000);
+    TEST_ASSERT(histogram.percentile(100) == 10000);
+    histogram.reset();
+    TEST_ASSERT(histogram.count() == 0 && histogram.percentile(99) == 0);
+
+    // a packet arriving in two halves 5 ms apart
+    using Packet = packet::PacketT<TracingConfig>;
+    packet::Latency::reset();
+    const std::string content(1000, 't');
+    std::vector<packet::byte_t> frame;
+    TEST_ASSERT(Packet::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame));
+    Packet pkt;
+    const std::size_t half = frame.size() / 2;
+    std::size_t offset = 0;
+    while (offset < frame.size()) {
+        if (offset == half) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(5));
+        }
+        const std::size_t end = offset < half ? half : frame.size();
+        offset += pkt.appendData(frame.data() + offset, end - offset);
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+
+    // the framer: a packet in a single input and another one split on two inputs
+    packet::StreamFramerT<TracingConfig> framer;
+    std::vector<packet::byte_t> stream(frame);
+    stream.insert(stream.end(), frame.begin(), frame.begin() + half);
+    std::size_t packets = 0;
+    framer.feed(stream.data(), stream.size(), [&packets](const packet::byte_t*, std::size_t) { ++packets; });
+    std::this_thread::sleep_for(std::chrono::milliseconds(5));
+    framer.feed(frame.data() + half, frame.size() - half, [&packets](const packet::byte_t*, std::size_t) { ++packets; });
+    TEST_ASSERT(packets == 2);
+
+    std::vector<packet::LatencyReport> reports = packet::Latency::report();
+    const packet::LatencyReport* assembly = findLatency(reports, "assembly");
+    TEST_ASSERT(assembly != nullptr);
+    TEST_ASSERT(assembly->count == 3);
+    TEST_ASSERT(assembly->p50_ns >= 4.5e6 && assembly->p50_ns <= assembly->max_ns);
+    TEST_ASSERT(assembly->p999_ns == assembly->max_ns);
+    TEST_ASSERT(findLatency(reports, "handoff") == nullptr);
+
+    // the handoff of the packets written on a ring
+    packet::ShmRingT<TracingConfig> ring;
+    TEST_ASSERT(ring.create(1));
+    for (std::size_t i = 0; i < 100; ++i) {
+        TEST_ASSERT(ring.write(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), 10));
+        packet::PacketView view;
+        TEST_ASSERT(ring.tryRead(view));
+    }
+    reports = packet::Latency::report();
+    const packet::LatencyReport* handoff = findLatency(reports, "handoff");
+    TEST_ASSERT(handoff != nullptr && handoff->count == 100);
+    TEST_ASSERT(handoff->p50_ns <= handoff->p99_ns && handoff->p99_ns <= handoff->max_ns);
+
+    // each thread records on its own histograms, the ones of the finished threads are kept
+    const packet::detail::ThreadLatency* main_latency = &TracingConfig::tracing::local();
+    std::vector<std::thread> parsers;
+    for (std::size_t t = 0; t < 2; ++t) {
+        parsers.emplace_back([&frame, main_latency]() {
+            TEST_ASSERT(&TracingConfig::tracing::local() != main_latency);
+            Packet thread_pkt;
+            for (std::size_t consumed = 0; thread_pkt.status() == packet::Status::INCOMPLETE; ) {
+                consumed += thread_pkt.appendData(frame.data() + consumed, frame.size() - consumed);
+            }
+            TEST_ASSERT(thread_pkt.status() == packet::Status::COMPLETE);
+        });
+    }
+    for (std::thread& parser : parsers) {
+        parser.join();
+    }
+    reports = packet::Latency::report();
+    assembly = findLatency(reports, "assembly");
+    TEST_ASSERT(assembly != nullptr && assembly->count == 3 + 2);
+    packet::Latency::reset();
+    TEST_ASSERT(findLatency(packet::Latency::report(), "assembly") == nullptr);
+}
+
+struct CountingBufferPolicy {
+    static std::size_t acquired;
+
+    static inline packet::Buffer
+    acquire(const std::size_t capacity)
+    {
+        ++acquired;
+        return packet::HeapBufferPolicy::acquire(capacity);
+    }
+
+    static inline void
+    release(packet::Buffer&&)
+    {}
+};
+std::size_t CountingBufferPolicy::acquired = 0;
+
+struct ControlConfig : packet::ConfigT<packet::DefaultStartPattern, packet::DefaultEndPattern, std::uint32_t, 256> {
+    using buffer_policy = CountingBufferPolicy;
+};
+
+struct NoInlineConfig : packet::DefaultConfig {
+    static constexpr std::size_t INLINE_BUFFER_SIZE = 0;
+    using buffer_policy = CountingBufferPolicy;
+};
+
+void
+testPacketStorageIsInline()
+{
+    // control channel: the whole packet fits inline
+    using ControlPacket = packet::PacketT<ControlConfig>;
+    static_assert(std::is_same<ControlPacket::storage_t,
+                               packet::InlineBuffer<ControlPacket::PACKET_MAX_SIZE, CountingBufferPolicy> >::value,
+                  "small configurations are stored inline");
+    TEST_ASSERT(sizeof(ControlPacket) > ControlPacket::PACKET_MAX_SIZE);
+
+    CountingBufferPolicy::acquired = 0;
+    ControlPacket control;
+    for (std::size_t i = 0; i < 1000; ++i) {
+        const std::string content(1 + i % 256, char('a' + i % 26));
+        readPacketPart(serializePacketFromData<ControlPacket>(content), control);
+        TEST_ASSERT(control.status() == packet::Status::COMPLETE);
+        TEST_ASSERT(std::string(reinterpret_cast<const char*>(control.data()), control.dataLen()) == content);
+        TEST_ASSERT(control.allData().capacity() == ControlPacket::PACKET_MAX_SIZE);
+        control.reset();
+    }
+    TEST_ASSERT(CountingBufferPolicy::acquired == 0);
+
+    // detaching copies the content to a policy buffer
+    readPacketPart(serializePacketFromData<ControlPacket>("control"), control);
+    const std::size_t offset = control.dataOffset();
+    packet::Buffer detached = control.detachBuffer();
+    TEST_ASSERT(CountingBufferPolicy::acquired == 1);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(detached.data() + offset), 7) == "control");
+    TEST_ASSERT(control.status() == packet::Status::INCOMPLETE && control.allData().empty());
+
+    // bigger configurations: only the frames not fitting inline take a policy buffer
+    struct BigConfig : packet::DefaultConfig {
+        using buffer_policy = CountingBufferPolicy;
+    };
+    using BigPacket = packet::PacketT<BigConfig>;
+    using Storage = BigPacket::storage_t;
+    static_assert(std::is_same<Storage, packet::SmallBuffer<BigConfig::INLINE_BUFFER_SIZE, CountingBufferPolicy> >::value,
+                  "big configurations use the hybrid storage");
+    CountingBufferPolicy::acquired = 0;
+    BigPacket pkt;
+    const std::string small(100, 's');
+    for (std::size_t i = 0; i < 1000; ++i) {
+        readPacketPart(serializePacketFromData<BigPacket>(small), pkt);
+        TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && pkt.allData().isInline());
+        pkt.reset();
+    }
+    TEST_ASSERT(CountingBufferPolicy::acquired == 0);
+
+    const std::string big(100000, 'b');
+    readPacketPart(serializePacketFromData<BigPacket>(big), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && !pkt.allData().isInline());
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(pkt.data()), pkt.dataLen()) == big);
+    const std::size_t acquired = CountingBufferPolicy::acquired;
+    TEST_ASSERT(acquired > 0);
+
+    // once grown the buffer is kept for the next packets
+    pkt.reset();
+    readPacketPart(serializePacketFromData<BigPacket>(big), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(CountingBufferPolicy::acquired == acquired);
+
+    // detaching a policy buffer moves it out without copying
+    const packet::byte_t* content = pkt.data();
+    detached = pkt.detachBuffer();
+    TEST_ASSERT(detached.data() + BigPacket::HEADER_MAX_SIZE == content);
+    TEST_ASSERT(pkt.allData().isInline());
+    readPacketPart(serializePacketFromData<BigPacket>(small), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(CountingBufferPolicy::acquired == acquired);
+
+    // the storage on its own
+    Storage storage;
+    storage.resize(10);
+    std::memcpy(storage.data(), "0123456789", 10);
+    storage.resize(1000);
+    TEST_ASSERT(!storage.isInline() && storage.capacity() >= 1000);
+    TEST_ASSERT(std::memcmp(storage.data(), "0123456789", 10) == 0);
+    const Storage copy(storage);
+    TEST_ASSERT(copy.size() == 1000 && std::memcmp(copy.data(), "0123456789", 10) == 0);
+    packet::Buffer heap(5, 'h');
+    Storage small_storage;
+    small_storage.exchange(heap);
+    TEST_ASSERT(small_storage.isInline() && small_storage.size() == 5 && small_storage[4] == 'h');
+}
+
+template<typename Packet>
+static void
+checkPacketMoves(const std::string& content)
+{
+    const std::string frame = serializePacketFromData<Packet>(content);
+    const std::string first_half = frame.substr(0, frame.size() / 2);
+    const std::string second_half = frame.substr(frame.size() / 2);
+
+    // moved in the middle of the parsing, the new one goes on where it was
+    Packet pkt;
+    readPacketPart(first_half, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE);
+    Packet moved(std::move(pkt));
+    TEST_ASSERT(pkt.status() == packet::Status::INCOMPLETE && pkt.allData().empty());
+    readPacketPart(second_half, moved);
+    TEST_ASSERT(moved.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(moved.data()), moved.dataLen()) == content);
+    // the moved from packet parses from scratch
+    readPacketPart(frame, pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE && pkt.dataLen() == content.size());
+
+    // copies are independent
+    Packet partial;
+    readPacketPart(first_half, partial);
+    Packet copy(partial);
+    readPacketPart(second_half, copy);
+    readPacketPart(second_half, partial);
+    TEST_ASSERT(copy.status() == packet::Status::COMPLETE && partial.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(copy.data()), copy.dataLen()) == content);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(partial.data()), partial.dataLen()) == content);
+
+    // assignments and containers growing
+    std::vector<Packet> packets(3);
+    for (Packet& item : packets) {
+        readPacketPart(first_half, item);
+    }
+    packets.emplace_back();
+    packets.resize(100);
+    Packet assigned;
+    assigned = packets[1];
+    packets[0] = std::move(packets[2]);
+    readPacketPart(second_half, packets[0]);
+    readPacketPart(second_half, assigned);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(packets[0].data()), packets[0].dataLen()) == content);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(assigned.data()), assigned.dataLen()) == content);
+    TEST_ASSERT(packets[2].status() == packet::Status::INCOMPLETE && packets[2].allData().empty());
+
+    // returned by value
+    const Packet read = readPacket<Packet>(frame);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(read.data()), read.dataLen()) == content);
+}
+
+void
+testPacketMovesAndPayload()
+{
+    checkPacketMoves<packet::DefaultPacket>(std::string(100000, 'p'));
+    checkPacketMoves<packet::DefaultPacket>("small");
+    checkPacketMoves<packet::PacketT<ControlConfig>>(std::string(200, 'c'));
+    checkPacketMoves<packet::PacketT<Lz4Config>>(std::string(5000, 'z'));
+    checkPacketMoves<packet::PacketT<NoInlineConfig>>(std::string(300, 'n'));
+
+    // moves never take a buffer from the policy (they are noexcept), the moved from packet
+    // takes one once it parses again
+    using NoInlinePacket = packet::PacketT<NoInlineConfig>;
+    static_assert(std::is_nothrow_move_constructible<NoInlinePacket>::value &&
+                  std::is_nothrow_move_assignable<NoInlinePacket>::value, "moves are noexcept");
+    const std::string no_inline_frame = serializePacketFromData<NoInlinePacket>("no inline");
+    NoInlinePacket source;
+    readPacketPart(no_inline_frame.substr(0, 8), source);
+    const std::size_t acquired = CountingBufferPolicy::acquired;
+    NoInlinePacket target(std::move(source));
+    source = std::move(target);
+    TEST_ASSERT(CountingBufferPolicy::acquired == acquired);
+    readPacketPart(no_inline_frame.substr(8), source);
+    readPacketPart(no_inline_frame, target);
+    TEST_ASSERT(source.status() == packet::Status::COMPLETE && target.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(CountingBufferPolicy::acquired > acquired);
+
+    // move assigning over a packet holding a pooled buffer gives nothing back to the pool
+    // during the move, the moved from packet keeps that buffer for its next packet
+    using PooledPacket = packet::PacketT<PipelineConfig>;
+    packet::BufferPool& pool = packet::BufferPool::local();
+    const std::string first_frame = serializePacketFromData<PooledPacket>(std::string(1000, 'f'));
+    const std::string second_frame = serializePacketFromData<PooledPacket>(std::string(3000, 's'));
+    PooledPacket first;
+    PooledPacket second;
+    readPacketPart(first_frame, first);
+    readPacketPart(second_frame, second);
+    const packet::byte_t* first_buffer = first.allData().data();
+    const packet::byte_t* second_buffer = second.allData().data();
+    const std::size_t cached = pool.cachedCount();
+    first = std::move(second);
+    TEST_ASSERT(pool.cachedCount() == cached);
+    TEST_ASSERT(first.allData().data() == second_buffer && first.dataLen() == 3000);
+    TEST_ASSERT(second.status() == packet::Status::INCOMPLETE);
+    readPacketPart(first_frame, second);
+    TEST_ASSERT(second.status() == packet::Status::COMPLETE && second.allData().data() == first_buffer);
+
+    // moving a packet on the buffer policy takes its buffer
+    const std::string content(100000, 'm');
+    const std::string frame = serializePacketFromData<packet::DefaultPacket>(content);
+    packet::DefaultPacket pkt;
+    readPacketPart(frame.substr(0, 50000), pkt);
+    const packet::byte_t* buffer = pkt.allData().data();
+    packet::DefaultPacket moved(std::move(pkt));
+    TEST_ASSERT(moved.allData().data() == buffer);
+    readPacketPart(frame.substr(50000), moved);
+    TEST_ASSERT(moved.status() == packet::Status::COMPLETE);
+
+    // the payload is moved out without copying
+    packet::PacketPayload empty = pkt.takePayload();
+    TEST_ASSERT(empty.len == 0 && empty.buffer.empty());
+    const packet::byte_t* data = moved.data();
+    packet::PacketPayload payload = moved.takePayload();
+    TEST_ASSERT(payload.data() == data && payload.len == content.size());
+    TEST_ASSERT(payload.offset == packet::DefaultPacket::HEADER_MAX_SIZE);
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(payload.data()), payload.len) == content);
+    TEST_ASSERT(moved.status() == packet::Status::INCOMPLETE && moved.allData().isInline());
+    readPacketPart(serializePacketFromData<packet::DefaultPacket>("next"), moved);
+    TEST_ASSERT(moved.status() == packet::Status::COMPLETE && moved.dataLen() == 4);
+    packet::DefaultPacket::recycleBuffer(std::move(payload.buffer));
+
+    // inline packets copy their few bytes to a policy buffer
+    packet::PacketT<ControlConfig> control;
+    readPacketPart(serializePacketFromData<packet::PacketT<ControlConfig>>("control"), control);
+    payload = control.takePayload();
+    TEST_ASSERT(std::string(reinterpret_cast<const char*>(payload.data()), payload.len) == "control");
+    TEST_ASSERT(control.status() == packet::Status::INCOMPLETE);
+}
+
+struct Inbox {
+    std::vector<std::string> logins;
+    std::size_t pings = 0;
+};
+
+struct LoginRoute {
+    static constexpr std::uint16_t TYPE = 1;
+    static constexpr std::size_t MAX_DATA_LEN = 16;
+    static void handle(Inbox& inbox, const packet::PacketView& view)
+    {
+        inbox.logins.emplace_back(reinterpret_cast<const char*>(view.data), view.len);
+    }
+};
+
+struct PingRoute {
+    static constexpr std::uint16_t TYPE = 3;
+    static void handle(Inbox& inbox, const packet::PacketView&) { ++inbox.pings; }
+};
+
+using InboxDispatcher = packet::MessageDispatcher<Inbox, LoginRoute, PingRoute>;
+
+struct TypedConfig : packet::DefaultConfig {
+    using message_type = packet::MessageTypeField<std::uint16_t, InboxDispatcher>;
+};
+
+struct TypedLz4Config : Lz4Config {
+    using message_type = packet::MessageTypeField<std::uint16_t>;
+};
+
+template<typename Packet>
+static std::vector<packet::byte_t>
+serializeTyped(const std::string& content, const typename Packet::message_type_t type)
+{
+    std::vector<packet::byte_t> frame;
+    TEST_ASSERT(Packet::serialize(reinterpret_cast<const packet::byte_t*>(content.data()), content.size(), frame, type));
+    return frame;
+}
+
+void
+testMessageTypesAreDispatched()
+{
+    using Packet = packet::PacketT<TypedConfig>;
+    static_assert(InboxDispatcher::TABLE_SIZE == 4, "the table is indexed by type");
+    TEST_ASSERT(InboxDispatcher::has(1) && !InboxDispatcher::has(2) && InboxDispatcher::has(3));
+    TEST_ASSERT(!InboxDispatcher::has(4) && !InboxDispatcher::has(1000000));
+    TEST_ASSERT(InboxDispatcher::accept(1, 16) && !InboxDispatcher::accept(1, 17));
+
+    // the type is known once the header is read, before the content
+    const std::string content = "alice";
+    const std::vector<packet::byte_t> frame = serializeTyped<Packet>(content, 1);
+    TEST_ASSERT(frame.size() == Packet::serializedSize(Packet::data_len_t(content.size())));
+    Packet pkt;
+    std::size_t type_known_at = 0;
+    for (std::size_t i = 0; i < frame.size(); ++i) {
+        TEST_ASSERT(pkt.appendData(&frame[i], 1) == 1);
+        if (type_known_at == 0 && pkt.hasMessageType()) {
+            type_known_at = i + 1;
+            TEST_ASSERT(pkt.messageType() == 1);
+        }
+    }
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    TEST_ASSERT(type_known_at == frame.size() - content.size() - Packet::TRAILER_SIZE);
+
+    Inbox inbox;
+    TEST_ASSERT(InboxDispatcher::dispatch(inbox, pkt));
+    TEST_ASSERT(inbox.logins.size() == 1 && inbox.logins[0] == content);
+    pkt.reset();
+    TEST_ASSERT(!pkt.hasMessageType() && pkt.messageType() == 0);
+
+    // unknown types and contents over the route limit are invalid as soon as the type is read
+    const std::vector<packet::byte_t> unknown = serializeTyped<Packet>("x", 2);
+    const std::vector<packet::byte_t> too_long = serializeTyped<Packet>(std::string(100, 'l'), 1);
+    for (const std::vector<packet::byte_t>* bad : {&unknown, &too_long}) {
+        pkt.reset();
+        // same header size as the first frame
+        for (std::size_t offset = 0; offset < type_known_at && pkt.status() == packet::Status::INCOMPLETE; ) {
+            offset += pkt.appendData(bad->data() + offset, type_known_at - offset);
+        }
+        TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+        packet::FrameInfo info;
+        TEST_ASSERT(Packet::peekFrame(bad->data(), bad->size(), info) == packet::Status::INVALID);
+    }
+
+    // the framer views carry the type
+    std::vector<packet::byte_t> input = serializeTyped<Packet>("p", 3);
+    const std::vector<packet::byte_t> bob = serializeTyped<Packet>("bob", 1);
+    input.insert(input.end(), bob.begin(), bob.end());
+    packet::StreamFramerT<TypedConfig> framer;
+    framer.setInput(input.data(), input.size());
+    packet::PacketView view;
+    while (framer.next(view)) {
+        TEST_ASSERT(InboxDispatcher::dispatch(inbox, view));
+    }
+    TEST_ASSERT(inbox.pings == 1 && inbox.logins.size() == 2 && inbox.logins[1] == "bob");
+
+    // compressed contents keep the type
+    using Lz4Packet = packet::PacketT<TypedLz4Config>;
+    const std::string big(5000, 'z');
+    const std::vector<packet::byte_t> compressed = serializeTyped<Lz4Packet>(big, 0xBEEF);
+    TEST_ASSERT(compressed.size() < big.size());
+    Lz4Packet lz4_pkt;
+    for (std::size_t offset = 0; lz4_pkt.status() == packet::Status::INCOMPLETE; ) {
+        offset += lz4_pkt.appendData(compressed.data() + offset, compressed.size() - offset);
+    }
+    TEST_ASSERT(lz4_pkt.status() == packet::Status::COMPLETE && lz4_pkt.isCompressed());
+    TEST_ASSERT(lz4_pkt.messageType() == 0xBEEF && lz4_pkt.dataLen() == big.size());
+}
+
+void
+testWritersCarryMessageTypes()
+{
+    using Packet = packet::PacketT<TypedConfig>;
+    const std::string login = "carol";
+    const packet::byte_t* login_data = reinterpret_cast<const packet::byte_t*>(login.data());
+    packet::PacketView view;
+
+    // iovec and batch serializers
+    packet::IovSerializerT<TypedConfig> iov_serializer;
+    TEST_ASSERT(iov_serializer.add(login_data, Packet::data_len_t(login.size()), 1));
+    struct iovec fragments[] = {{const_cast<char*>("p"), 1}};
+    TEST_ASSERT(iov_serializer.add(fragments, 1, 3));
+    std::vector<packet::byte_t> input;
+    const struct iovec* iov = iov_serializer.iov();
+    for (std::size_t i = 0; i < iov_serializer.iovCount(); ++i) {
+        const packet::byte_t* base = static_cast<const packet::byte_t*>(iov[i].iov_base);
+        input.insert(input.end(), base, base + iov[i].iov_len);
+    }
+    packet::BatchSerializerT<TypedConfig> batch;
+    TEST_ASSERT(batch.add(login_data, Packet::data_len_t(login.size()), 1));
+    TEST_ASSERT(batch.add(reinterpret_cast<const packet::byte_t*>("p"), 1, 3));
+    const std::size_t batch_offset = input.size();
+    input.resize(batch_offset + batch.totalBytes());
+    batch.serialize(input.data() + batch_offset);
+
+    Inbox inbox;
+    packet::StreamFramerT<TypedConfig> framer;
+    framer.setInput(input.data(), input.size());
+    while (framer.next(view)) {
+        TEST_ASSERT(InboxDispatcher::dispatch(inbox, view));
+    }
+    TEST_ASSERT(inbox.pings == 2 && inbox.logins.size() == 2);
+    TEST_ASSERT(inbox.logins[0] == login && inbox.logins[1] == login);
+
+    // shared memory ring
+    packet::ShmRingT<TypedConfig> ring;
+    TEST_ASSERT(ring.create(1));
+    TEST_ASSERT(ring.tryWrite(login_data, login.size(), 1));
+    TEST_ASSERT(ring.write(reinterpret_cast<const packet::byte_t*>("p"), 1, -1, 3));
+    packet::byte_t* content = ring.reserve(login.size(), 1);
+    TEST_ASSERT(content != nullptr);
+    std::memcpy(content, login_data, login.size());
+    ring.commit();
+    const std::uint64_t ring_types[] = {1, 3, 1};
+    for (const std::uint64_t type : ring_types) {
+        TEST_ASSERT(ring.tryRead(view) && view.message_type == type);
+    }
+
+    // log writer, with compressed and uncompressed packets
+    char path_template[] = "/tmp/packet_log_XXXXXX";
+    const int fd = ::mkstemp(path_template);
+    TEST_ASSERT(fd >= 0);
+    ::close(fd);
+    const std::string path(path_template);
+    const std::string big(5000, 'z');
+    packet::PacketLogWriterT<TypedLz4Config> writer;
+    TEST_ASSERT(writer.open(path));
+    TEST_ASSERT(writer.append(login_data, Packet::data_len_t(login.size()), 1));
+    TEST_ASSERT(writer.append(reinterpret_cast<const packet::byte_t*>(big.data()), Packet::data_len_t(big.size()), 0xBEEF));
+    TEST_ASSERT(writer.close());
+    packet::PacketLogReaderT<TypedLz4Config> reader;
+    TEST_ASSERT(reader.open(path, false) && reader.count() == 2);
+    TEST_ASSERT(reader.view(0, view) && view.message_type == 1);
+    TEST_ASSERT(reader.view(1, view) && view.message_type == 0xBEEF && view.len == big.size());
+    ::unlink(path.c_str());
+}
+
+struct AnyTypeConfig : packet::DefaultConfig {
+    using message_type = packet::MessageTypeField<std::uint16_t>;
+};
+
+template<typename Packet>
+static std::string
+typedFrame(const std::string& content, const typename Packet::message_type_t type)
+{
+    const std::vector<packet::byte_t> frame = serializeTyped<Packet>(content, type);
+    return std::string(frame.begin(), frame.end());
+}
+
+void
+testMessageTypesAreDelivered()
+{
+    using Packet = packet::PacketT<TypedConfig>;
+
+    // the payload keeps the type
+    Packet pkt;
+    readPacketPart(typedFrame<Packet>("dave", 1), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::COMPLETE);
+    const packet::PacketPayload payload = pkt.takePayload();
+    TEST_ASSERT(payload.message_type == 1 && payload.len == 4);
+
+    // the pipeline workers get it
+    std::mutex mutex;
+    Inbox inbox;
+    packet::PacketPipelineT<TypedConfig> pipeline([&mutex, &inbox](const packet::byte_t* data,
+                                                                   std::size_t len,
+                                                                   std::uint64_t type) {
+        std::lock_guard<std::mutex> lock(mutex);
+        InboxDispatcher::dispatch(inbox, packet::PacketView{data, len, true, type});
+    }, 2);
+    for (const std::uint16_t type : {1, 3, 1}) {
+        readPacketPart(typedFrame<Packet>("erin", type), pkt);
+        TEST_ASSERT(pipeline.push(pkt));
+    }
+    pipeline.flush();
+    pipeline.stop();
+    TEST_ASSERT(inbox.pings == 1 && inbox.logins.size() == 2);
+
+    // and so do the servers, for the packets framed in place and the big ones
+    using AnyTypePacket = packet::PacketT<AnyTypeConfig>;
+    using Server = packet::UringServerT<AnyTypeConfig>;
+    const std::string big_content(2 * packet::EpollServerT<AnyTypeConfig>::READ_BUFFER_SIZE + 123, 'b');
+    const std::string frames = typedFrame<AnyTypePacket>("small", 7) +
+                               typedFrame<AnyTypePacket>(big_content, 0xBEEF) +
+                               typedFrame<AnyTypePacket>("after", 9);
+    for (const packet::ServerBackend backend : {packet::ServerBackend::AUTO, packet::ServerBackend::EPOLL}) {
+        std::vector<std::uint64_t> types;
+        Server server([&mutex, &types](int, const packet::byte_t*, std::size_t, std::uint64_t type) {
+            std::lock_guard<std::mutex> lock(mutex);
+            types.push_back(type);
+        }, 1, backend);
+        TEST_ASSERT(server.start(0, "127.0.0.1"));
+        const int fd = connectLoopback(server.port());
+        sendAll(fd, frames, 10000);
+        TEST_ASSERT(waitFor([&mutex, &types]() {
+            std::lock_guard<std::mutex> lock(mutex);
+            return types.size() == 3;
+        }));
+        server.stop();
+        ::close(fd);
+        TEST_ASSERT(types[0] == 7 && types[1] == 0xBEEF && types[2] == 9);
+    }
+}
+
+struct SmallContents {
+    static bool accept(const std::uint64_t, const std::size_t data_len) { return data_len <= 100; }
+};
+
+struct LimitedLz4Config : Lz4Config {
+    using message_type = packet::MessageTypeField<std::uint16_t, SmallContents>;
+};
+
+void
+testMessageTypeLimitsDecompressedContents()
+{
+    // the compressed content fits the limit of the type, the original one does not
+    using Packet = packet::PacketT<LimitedLz4Config>;
+    const std::vector<packet::byte_t> big = serializeTyped<Packet>(std::string(5000, 'z'), 5);
+    const std::vector<packet::byte_t> fine = serializeTyped<Packet>("fine", 6);
+    packet::FrameInfo info;
+    TEST_ASSERT(Packet::peekFrame(big.data(), big.size(), info) == packet::Status::COMPLETE);
+    TEST_ASSERT((info.flags & Packet::FLAG_COMPRESSED) != 0 && info.message_type == 5);
+
+    // refused before the original content is allocated
+    packet::Buffer decompressed;
+    TEST_ASSERT(!Packet::decompress(big.data() + info.data_offset, info.data_len, decompressed, 5));
+    TEST_ASSERT(decompressed.empty());
+
+    Packet pkt;
+    readPacketPart(std::string(big.begin(), big.end()), pkt);
+    TEST_ASSERT(pkt.status() == packet::Status::INVALID);
+
+    std::vector<packet::byte_t> input = big;
+    input.insert(input.end(), fine.begin(), fine.end());
+    packet::PacketView view;
+    packet::StreamFramerT<LimitedLz4Config> framer;
+    framer.setInput(input.data(), input.size());
+    TEST_ASSERT(!framer.next(view) && framer.status() == packet::Status::INVALID);
+    packet::StreamFramerT<LimitedLz4Config> resync_framer(true);
+    resync_framer.setInput(input.data(), input.size());
+    TEST_ASSERT(resync_framer.next(view) && view.message_type == 6 && view.len == 4);
+    TEST_ASSERT(!resync_framer.next(view) && resync_framer.skippedBytes() == big.size());
+
+    // logs and captures
+    std::vector<packet::byte_t> capture = fine;
+    capture.insert(capture.end(), input.begin(), input.end());
+    std::vector<std::uint64_t> types;
+    packet::CaptureScannerT<LimitedLz4Config> scanner;
+    packet::ScanReport report;
+    scanner.scan(capture.data(), capture.size(), report, [&types](std::uint64_t, const packet::PacketView& found) {
+        types.push_back(found.message_type);
+    });
+    TEST_ASSERT(report.packets_count == 3 && types.size() == 2);
+
+    char path_template[] = "/tmp/packet_log_XXXXXX";
+    const int fd = ::mkstemp(path_template);
+    TEST_ASSERT(fd >= 0);
+    TEST_ASSERT(::write(fd, capture.data(), capture.size()) == ssize_t(capture.size()));
+    ::close(fd);
+    const std::string path(path_template);
+    packet::PacketLogReaderT<LimitedLz4Config> reader;
+    TEST_ASSERT(reader.open(path, false) && reader.count() == 3);
+    TEST_ASSERT(reader.view(0, view) && !reader.view(1, view) && reader.view(2, view));
+    ::unlink(path.c_str());
+}
+
 int
 main(void)
 {
@@ -145,5 +2466,42 @@ main(void)
     testPacketLimits();
     testPacketPartsWorks();
     testInvalidPacketAreDetected();
+    testStreamFramerSplitsChunks();
+    testStreamFramerKeepsPartialAndDetectsInvalid();
+    testStreamFramerViewsAreInPlace();
+    testPatternSearch();
+    testStreamFramerResync();
+    testIovSerializerWritesPackets();
+    testBatchSerializer();
+    testBufferPoolRecyclesBuffers();
+    testPooledPacketsDoNotAllocate();
+    testPacketBufferGrowsWithReceivedData();
+    testLengthCodecs();
+    testPacketsWithDifferentLengthCodecs();
+    testStreamingContentToSink();
+    testCrc32c();
+    testPacketsWithChecksum();
+    testLz4Codec();
+    testCompressedPackets();
+    testStreamFramerMovesPendingPacket();
+    testEpollServerReadsConnections();
+    testUringServerReadsConnections();
+    testUringServerBacksOffOnAcceptErrors();
+    testMpmcQueue();
+    testPacketPipelineHandsPacketsToWorkers();
+    testPacketPipelineBackpressure();
+    testShmRingWrapsAround();
+    testShmRingBetweenProcesses();
+    testPacketLogReader();
+    testPacketLogWriter();
+    testCaptureScanner();
+    testMetricsCountParsersAndSerializers();
+    testLatencyTracing();
+    testPacketStorageIsInline();
+    testPacketMovesAndPayload();
+    testMessageTypesAreDispatched();
+    testWritersCarryMessageTypes();
+    testMessageTypesAreDelivered();
+    testMessageTypeLimitsDecompressedContents();
     return 0;
 }